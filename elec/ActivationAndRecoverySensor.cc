@@ -92,6 +92,16 @@ void ActivationAndRecoverySensor::eval(double time, int loop)
    }
 }
 
+/** print clears everything, so there is nothing to move right after
+ *  it. */
+bool ActivationAndRecoverySensor::canMigrate() const
+{
+   for (unsigned ii=0; ii<nLocal_; ++ii)
+      if (active_[ii] || !activationTime_[ii].empty() || !recoveryTime_[ii].empty())
+         return false;
+   return true;
+}
+
 void ActivationAndRecoverySensor::clear()
 {
    for (unsigned ii=0; ii<nLocal_; ++ii)
@@ -29,6 +29,7 @@ class ActivationAndRecoverySensor : public Sensor
    
    void print(double time, int loop);
    void eval(double time, int loop);
+   bool canMigrate() const;
    
  private:
 
@@ -5,6 +5,7 @@
 #include "pio.h"
 #include "ioUtils.h"
 #include "Simulate.hh"
+#include "OutputService.hh"
 
 #include <sstream>
 #include <iomanip>
@@ -43,20 +44,13 @@ void ActivationTimeSensor::print(double time, int loop)
 
    stringstream name;
    name << "snapshot."<<setfill('0')<<setw(12)<<loop;
-   string fullname = name.str();
-   if (myRank == 0)
-      DirTestCreate(fullname.c_str());
-   fullname += "/" + filename_;
+   string dirname = name.str();
+   string fullname = dirname + "/" + filename_;
 
    Long64 nGlobal;
    Long64 nLocal=nLocal_;
    MPI_Allreduce(&nLocal, &nGlobal, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
    
-   PFILE* file = Popen(fullname.c_str(), "w", MPI_COMM_WORLD);
-   if (nFiles_ > 0)
-     PioSet(file, "ngroup", nFiles_);
-   
-   char fmt[] = "%12llu %18.12f";
    int lRec = 32;
    int nFields = 2; 
 
@@ -78,22 +72,39 @@ void ActivationTimeSensor::print(double time, int loop)
    header.addItem("dz", dz_);
    header.addItem("printRate", printRate());
    header.addItem("evalRate", evalRate());
-   
-   if (myRank == 0)
-      header.writeHeader(file, loop, time);
 
-   char line[lRec+1];
-   for (unsigned ii=0; ii<nLocal_; ++ii)
-   {
-      int l = snprintf(line, lRec, fmt,
-                       cells_[ii], activationTime_[ii]);
-      
-      for (; l < lRec - 1; l++) line[l] = (char)' ';
-      line[l++] = (char)'\n';
-      assert (l==lRec);
-      Pwrite(line, lRec, 1, file);
-   }
-   Pclose(file);
+   // The activation times keep changing after we return and the gids
+   // change when the cells migrate, so the job needs its own copies.
+   vector<double> activationTime(activationTime_);
+   vector<Long64> cells(cells_);
+   unsigned nFiles = nFiles_;
+   OutputService::getInstance().post(
+      [=](MPI_Comm comm) mutable
+      {
+         if (myRank == 0)
+            DirTestCreate(dirname.c_str());
+
+         PFILE* file = Popen(fullname.c_str(), "w", comm);
+         if (nFiles > 0)
+            PioSet(file, "ngroup", nFiles);
+
+         if (myRank == 0)
+            header.writeHeader(file, loop, time);
+
+         char fmt[] = "%12llu %18.12f";
+         char line[lRec+1];
+         for (unsigned ii=0; ii<activationTime.size(); ++ii)
+         {
+            int l = snprintf(line, lRec, fmt,
+                             cells[ii], activationTime[ii]);
+
+            for (; l < lRec - 1; l++) line[l] = (char)' ';
+            line[l++] = (char)'\n';
+            assert (l==lRec);
+            Pwrite(line, lRec, 1, file);
+         }
+         Pclose(file);
+      });
 }
 
 void ActivationTimeSensor::eval(double time, int loop)
@@ -110,6 +121,18 @@ void ActivationTimeSensor::eval(double time, int loop)
    }
 }
 
+void ActivationTimeSensor::getCellValues(unsigned iCell, double* value) const
+{
+   value[0] = activated_[iCell] ? 1 : 0;
+   value[1] = activationTime_[iCell];
+}
+
+void ActivationTimeSensor::setCellValues(unsigned iCell, const double* value)
+{
+   activated_[iCell] = (value[0] != 0);
+   activationTime_[iCell] = value[1];
+}
+
 void ActivationTimeSensor::clear()
 {
    for (unsigned ii=0; ii<nLocal_; ++ii)
@@ -28,6 +28,10 @@ class ActivationTimeSensor : public Sensor
 
    void print(double time, int loop);
    void eval(double time, int loop);
+   bool deferredPrint() const {return true;}
+   unsigned nCellValues() const {return 2;}
+   void getCellValues(unsigned iCell, double* value) const;
+   void setCellValues(unsigned iCell, const double* value);
    
    void run(double time, int loop)
    {
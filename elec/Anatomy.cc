@@ -0,0 +1,95 @@
+#include "Anatomy.hh"
+
+#include <algorithm>
+#include <climits>
+
+using std::vector;
+
+void Anatomy::compact(bool keepConductivity)
+{
+   if (compact_)
+      return;
+
+   unsigned nCells = cell_.size();
+   int lo[3] = {INT_MAX, INT_MAX, INT_MAX};
+   int hi[3] = {-1, -1, -1};
+   for (unsigned ii=0; ii<nCells; ++ii)
+   {
+      Tuple gg = i2t_(cell_[ii].gid_);
+      lo[0] = std::min(lo[0], gg.x()); hi[0] = std::max(hi[0], gg.x());
+      lo[1] = std::min(lo[1], gg.y()); hi[1] = std::max(hi[1], gg.y());
+      lo[2] = std::min(lo[2], gg.z()); hi[2] = std::max(hi[2], gg.z());
+   }
+   if (nCells == 0)
+   {
+      lo[0] = lo[1] = lo[2] = 0;
+      hi[0] = hi[1] = hi[2] = 0;
+   }
+   int bx = hi[0]-lo[0]+1;
+   int by = hi[1]-lo[1]+1;
+   int bz = hi[2]-lo[2]+1;
+   // The brick of a task is never larger than the grid.  This only
+   // fails for grids with more than 2^32 points and a decomposition
+   // that scatters the cells of a task all over the grid.
+   assert(Long64(bx)*by*bz <= Long64(UINT_MAX)+1);
+   brickOrigin_ = Tuple(lo[0], lo[1], lo[2]);
+   brickI2t_ = IndexToTuple(bx, by, bz);
+
+   brickIndex_.resize(nCells);
+   for (unsigned ii=0; ii<nCells; ++ii)
+   {
+      Tuple gg = i2t_(cell_[ii].gid_);
+      brickIndex_[ii] = (gg.x()-lo[0]) + bx*((gg.y()-lo[1]) + unsigned(by)*(gg.z()-lo[2]));
+   }
+
+   typeTable_.clear();
+   for (unsigned ii=0; ii<nCells; ++ii)
+      typeTable_.push_back(cell_[ii].cellType_);
+   sort(typeTable_.begin(), typeTable_.end());
+   typeTable_.erase(unique(typeTable_.begin(), typeTable_.end()), typeTable_.end());
+   assert(typeTable_.size() <= 256);
+   typeIndex_.resize(nCells);
+   for (unsigned ii=0; ii<nCells; ++ii)
+      typeIndex_[ii] = lower_bound(typeTable_.begin(), typeTable_.end(), cell_[ii].cellType_)
+         - typeTable_.begin();
+
+   conductivity_.clear();
+   if (keepConductivity)
+   {
+      conductivity_.resize(nCells);
+      for (unsigned ii=0; ii<nCells; ++ii)
+         conductivity_[ii] = cell_[ii].sigma_;
+   }
+
+   vector<AnatomyCell>().swap(cell_);
+   compact_ = true;
+}
+
+/** dest_ and sortind_ aren't stored in the compact representation.
+ *  They are set to -1 and the cell index. */
+void Anatomy::expand()
+{
+   if (!compact_)
+      return;
+
+   unsigned nCells = brickIndex_.size();
+   assert(conductivity_.size() == nCells);
+   vector<AnatomyCell> cells(nCells);
+   for (unsigned ii=0; ii<nCells; ++ii)
+   {
+      Tuple gg = brickI2t_(brickIndex_[ii]);
+      gg += brickOrigin_;
+      cells[ii].gid_ = gg.x() + Long64(nx_)*(gg.y() + Long64(ny_)*gg.z());
+      cells[ii].cellType_ = typeTable_[typeIndex_[ii]];
+      cells[ii].sigma_ = conductivity_[ii];
+      cells[ii].dest_ = -1;
+      cells[ii].sortind_ = ii;
+   }
+   cell_.swap(cells);
+
+   vector<unsigned>().swap(brickIndex_);
+   vector<unsigned char>().swap(typeIndex_);
+   vector<SymmetricTensor>().swap(conductivity_);
+   typeTable_.clear();
+   compact_ = false;
+}
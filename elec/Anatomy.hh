@@ -11,12 +11,22 @@
 
 class Conductivity;
 
+/** During setup the cells are kept in an array of AnatomyCell that the
+ *  readers, load balancers and getRemoteCells manipulate directly
+ *  through cellArray().  Once the task local objects exist compact()
+ *  replaces that array by a much smaller representation: a 32-bit
+ *  index into the bounding brick of the local and remote cells, an
+ *  8-bit index into a table of cell types and (optionally) the
+ *  conductivity.  The accessors below work in both representations,
+ *  cellArray() only in the expanded one.  expand() goes back to the
+ *  cell array, which is only possible if the conductivity was kept. */
 class Anatomy
 {
  public:
 
    Anatomy()
-   : i2t_(0, 0, 0), nRemote_(0){};
+   : i2t_(0, 0, 0), nRemote_(0), compact_(false),
+     brickOrigin_(0, 0, 0), brickI2t_(0, 0, 0){};
 
    unsigned size() const;
    unsigned nLocal() const;
@@ -58,6 +68,13 @@ class Anatomy
 
    THREE_VECTOR pointFromGid(unsigned ii) const;
 
+   /** Releases the cell array.  Without keepConductivity the
+    *  conductivity is gone for good, so all objects that need it
+    *  (i.e., the diffusion) must already have been built. */
+   void compact(bool keepConductivity);
+   void expand();
+   bool isCompact() const;
+
  private:
    unsigned nx_, ny_, nz_;
    double dx_, dy_, dz_;
@@ -68,10 +85,17 @@ class Anatomy
 
    std::vector<AnatomyCell> cell_;
 
+   bool compact_;
+   Tuple brickOrigin_;
+   IndexToTuple brickI2t_;
+   std::vector<unsigned> brickIndex_;
+   std::vector<unsigned char> typeIndex_;
+   std::vector<int> typeTable_;
+   std::vector<SymmetricTensor> conductivity_;
 };
 
-inline unsigned  Anatomy::size() const { return cell_.size();}
-inline unsigned  Anatomy::nLocal() const { return cell_.size()-nRemote_;}
+inline unsigned  Anatomy::size() const { return compact_ ? brickIndex_.size() : cell_.size();}
+inline unsigned  Anatomy::nLocal() const { return size()-nRemote_;}
 inline unsigned  Anatomy::nRemote() const { return nRemote_;}
 inline unsigned& Anatomy::nRemote()       { return nRemote_;}
 inline unsigned  Anatomy::nGlobal() const { return nGlobal_;}
@@ -98,17 +122,40 @@ inline double  Anatomy::dx() const { return dx_;}
 inline double  Anatomy::dy() const { return dy_;}
 inline double  Anatomy::dz() const { return dz_;}
 
-inline Long64  Anatomy::gid(unsigned ii) const { return cell_[ii].gid_;}
-inline SymmetricTensor Anatomy::conductivity(unsigned ii) const {return cell_[ii].sigma_;}
-inline int  Anatomy::cellType(unsigned ii) const { return cell_[ii].cellType_;}
+inline Long64  Anatomy::gid(unsigned ii) const
+{
+   if (!compact_)
+      return cell_[ii].gid_;
+   Tuple gg = globalTuple(ii);
+   return gg.x() + Long64(nx_)*(gg.y() + Long64(ny_)*gg.z());
+}
+
+inline SymmetricTensor Anatomy::conductivity(unsigned ii) const
+{
+   if (!compact_)
+      return cell_[ii].sigma_;
+   assert(conductivity_.size() > ii);
+   return conductivity_[ii];
+}
+
+inline int  Anatomy::cellType(unsigned ii) const
+{
+   return compact_ ? typeTable_[typeIndex_[ii]] : cell_[ii].cellType_;
+}
 
 inline Tuple Anatomy::globalTuple(unsigned ii) const
 {
-   return i2t_(cell_[ii].gid_);
+   if (!compact_)
+      return i2t_(cell_[ii].gid_);
+   Tuple gg = brickI2t_(brickIndex_[ii]);
+   gg += brickOrigin_;
+   return gg;
 }
 
-inline       std::vector<AnatomyCell>& Anatomy::cellArray()       {return cell_;}
-inline const std::vector<AnatomyCell>& Anatomy::cellArray() const {return cell_;}
+inline       std::vector<AnatomyCell>& Anatomy::cellArray()       {assert(!compact_); return cell_;}
+inline const std::vector<AnatomyCell>& Anatomy::cellArray() const {assert(!compact_); return cell_;}
+
+inline bool Anatomy::isCompact() const {return compact_;}
 
 inline double& Anatomy::offset_x() {return offset_x_;}
 inline double& Anatomy::offset_y() {return offset_y_;}
@@ -58,12 +58,19 @@ namespace
       unsigned typeIndex = bucketP->getIndex("cellType");
       assert( gidIndex != nFields &&
               typeIndex != nFields);
+      vector<Long64> gid(nRecords);
+      vector<int> cellType(nRecords);
+      if (nRecords > 0)
+      {
+         bucketP->getColumn(gidIndex, &gid[0]);
+         bucketP->getColumn(typeIndex, &cellType[0]);
+      }
+      cells.reserve(cells.size()+nRecords);
       for (unsigned ii=0; ii<nRecords; ++ii)
       {
          AnatomyCell tmp;
-         BucketOfBits::Record rr = bucketP->getRecord(ii);
-         rr.getValue(gidIndex, tmp.gid_);
-         rr.getValue(typeIndex, tmp.cellType_);
+         tmp.gid_ = gid[ii];
+         tmp.cellType_ = cellType[ii];
          cells.push_back(tmp);
       }
    }
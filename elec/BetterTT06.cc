@@ -15,6 +15,7 @@
 #include "object_cc.hh"
 #include "mpiUtils.h"
 #include <cmath>
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
@@ -123,13 +124,35 @@ static const char* interpName[] = {
       reaction->g_pCa = g_pCa;
       reaction->g_pK = g_pK;
       reaction->g_to = g_to;
+      //Gates always use Rush-Larsen.  integrator selects the update of
+      //the non-gate states:
+      // - rushLarsen:            forward Euler (the classic scheme)
+      // - generalizedRushLarsen: exponential update with the diagonal
+      //                          of the Jacobian for the stiff calcium
+      //                          states.  Exact for the linear part of
+      //                          their dynamics, so it lifts the forward
+      //                          Euler step limit on these states.
+      string integrator;
+      objectGet(obj, "integrator", integrator, "rushLarsen");
+      if (0) {}
+      else if (integrator == "rushLarsen")
+         reaction->nonGateIntegrator = BetterTT06::ThisReaction::forwardEuler;
+      else if (integrator == "generalizedRushLarsen")
+         reaction->nonGateIntegrator = BetterTT06::ThisReaction::generalizedRushLarsen;
+      else
+      {
+         cerr << "Unknown integrator " << integrator << " for REACTION " << obj->name << endl;
+         assert(false);
+      }
       bool reusingInterpolants = false;
-      string fitName;
-      objectGet(obj, "fit", fitName, "");
+      // fit may list several FIT objects, e.g. one per dt when the
+      // multirate stepping runs the same reaction at two time steps.
+      vector<string> fitNames;
+      objectGet(obj, "fit", fitNames);
       int funcCount = sizeof(reaction->_interpolant)/sizeof(reaction->_interpolant[0])-1; //BGQ_HACKFIX, compiler bug with zero length arrays
-      if (fitName != "")
+      for (int _ifit=0; _ifit<fitNames.size() && !reusingInterpolants; _ifit++)
       {
-         OBJECT* fitObj = objectFind(fitName, "FIT");
+         OBJECT* fitObj = objectFind(fitNames[_ifit], "FIT");
          double _fit_dt; objectGet(fitObj, "dt", _fit_dt, "nan");
          double _fit_celltype; objectGet(fitObj, "celltype", _fit_celltype, "nan");
          double _fit_g_K1; objectGet(fitObj, "g_K1", _fit_g_K1, "nan");
@@ -165,7 +188,7 @@ static const char* interpName[] = {
       {
          ofstream outfile((string(obj->name) +".fit.data").c_str());
          outfile.precision(16);
-         fitName = string(obj->name) + "_fit";
+         string fitName = string(obj->name) + "_fit";
          outfile << obj->name << " REACTION { fit=" << fitName << "; }\n";
          outfile << fitName << " FIT {\n";
             outfile << "   dt = " << _dt << ";\n";
@@ -1275,13 +1298,30 @@ void ThisReaction::constructKernel()
    "{\n"
    "   _count++;\n"
    "} while (_count<50);\n"
-   "//EDIT_STATE\n"
-   "_state[_ii+Ca_SR_off*_nCells] += _dt*Ca_SR_diff;\n"
-   "_state[_ii+Ca_i_off*_nCells] += _dt*Ca_i_diff;\n"
-   "_state[_ii+Ca_ss_off*_nCells] += _dt*Ca_ss_diff;\n"
+   "//EDIT_STATE\n";
+   if (nonGateIntegrator == generalizedRushLarsen)
+   {
+      ss <<
+      "double Ca_SR_a = -Ca_sr_bufsr*(V_leak + O*V_rel);\n"
+      "double Ca_i_a = -Ca_i_bufc*(V_xfer + V_sr*V_leak/V_c);\n"
+      "double Ca_ss_a = -Ca_ss_bufss*(0.125*Cm*d*f*f2*fCass*g_CaL*i_CalTerm4/(F*V_ss) + V_c*V_xfer/V_ss + V_sr*O*V_rel/V_ss);\n"
+      "double R_prime_a = -(Ca_ss*k2 + k4);\n"
+      "_state[_ii+Ca_SR_off*_nCells] += expm1(_dt*Ca_SR_a)/Ca_SR_a*Ca_SR_diff;\n"
+      "_state[_ii+Ca_i_off*_nCells] += expm1(_dt*Ca_i_a)/Ca_i_a*Ca_i_diff;\n"
+      "_state[_ii+Ca_ss_off*_nCells] += expm1(_dt*Ca_ss_a)/Ca_ss_a*Ca_ss_diff;\n"
+      "_state[_ii+R_prime_off*_nCells] += expm1(_dt*R_prime_a)/R_prime_a*R_prime_diff;\n";
+   }
+   else
+   {
+      ss <<
+      "_state[_ii+Ca_SR_off*_nCells] += _dt*Ca_SR_diff;\n"
+      "_state[_ii+Ca_i_off*_nCells] += _dt*Ca_i_diff;\n"
+      "_state[_ii+Ca_ss_off*_nCells] += _dt*Ca_ss_diff;\n"
+      "_state[_ii+R_prime_off*_nCells] += _dt*R_prime_diff;\n";
+   }
+   ss <<
    "_state[_ii+K_i_off*_nCells] += _dt*K_i_diff;\n"
    "_state[_ii+Na_i_off*_nCells] += _dt*Na_i_diff;\n"
-   "_state[_ii+R_prime_off*_nCells] += _dt*R_prime_diff;\n"
    "_state[_ii+Xr1_off*_nCells] += _Xr1_RLA*(Xr1+_Xr1_RLB);\n"
    "_state[_ii+Xr2_off*_nCells] += _Xr2_RLA*(Xr2+_Xr2_RLB);\n"
    "_state[_ii+Xs_off*_nCells] += _Xs_RLA*(Xs+_Xs_RLB);\n"
@@ -1428,7 +1468,47 @@ void ThisReaction::calc(double _dt,
    ro_array_ptr<double> __Vm = ___Vm.useOn(CPU);
    ro_array_ptr<double> __iStim = ___iStim.useOn(CPU);
    wo_array_ptr<double> __dVm = ___dVm.useOn(CPU);
+   calcBlocks(_dt, __Vm.raw(), __iStim.raw(), __dVm.raw(), NULL, NULL, NULL);
+}
+
+void ThisReaction::calcIntegrate(double _dt,
+                rw_mgarray_ptr<double> ___Vm,
+                ro_mgarray_ptr<double> ___iStim,
+                ro_mgarray_ptr<double> ___dVmDiffusion,
+                wo_mgarray_ptr<double> ___dVm)
+{
+   rw_array_ptr<double> __Vm = ___Vm.useOn(CPU);
+   ro_array_ptr<double> __iStim = ___iStim.useOn(CPU);
+   ro_array_ptr<double> __dVmDiffusion = ___dVmDiffusion.useOn(CPU);
+   wo_array_ptr<double> __dVm = ___dVm.useOn(CPU);
+   calcBlocks(_dt, __Vm.raw(), __iStim.raw(), __dVm.raw(), __dVmDiffusion.raw(), __Vm.raw(), NULL);
+}
+
+void ThisReaction::calcSkip(double _dt,
+                ro_mgarray_ptr<double> ___Vm,
+                ro_mgarray_ptr<double> ___iStim,
+                wo_mgarray_ptr<double> ___dVm,
+                const char* __skip)
+{
+   ro_array_ptr<double> __Vm = ___Vm.useOn(CPU);
+   ro_array_ptr<double> __iStim = ___iStim.useOn(CPU);
+   wo_array_ptr<double> __dVm = ___dVm.useOn(CPU);
+   calcBlocks(_dt, __Vm.raw(), __iStim.raw(), __dVm.raw(), NULL, NULL, __skip);
+}
 
+/** When VmOut isn't NULL the forward Euler update of each block is
+ *  done right after its dVm is stored, while the block is still in
+ *  cache.  VmOut may be the same array as Vm since every block is
+ *  loaded before it is updated.  When skip isn't NULL blocks whose
+ *  cells are all flagged are not computed. */
+void ThisReaction::calcBlocks(double _dt,
+                const double* __Vm,
+                const double* __iStim,
+                double* __dVm,
+                const double* __dVmDiffusion,
+                double* __VmOut,
+                const char* __skip)
+{
    //define the constants
    double Cm = 0.185000000000000;
    double F = 96485.3415000000;
@@ -1471,6 +1551,8 @@ void ThisReaction::calc(double _dt,
    for (unsigned __jj=0; __jj<(nCells_+width-1)/width; __jj++)
    {
       const int __ii = __jj*width;
+      if (__skip != NULL && skipBlock(__skip, __ii, std::min<int>(width, nCells_-__ii)))
+         continue;
       //set Vm
       const real V = load(&__Vm[__ii]);
       const real iStim = load(&__iStim[__ii]);
@@ -1494,6 +1576,40 @@ void ThisReaction::calc(double _dt,
       real m=load(state_[__jj].m);
       real r=load(state_[__jj].r);
       real s=load(state_[__jj].s);
+      //set the per-cell parameters
+      real g_CaL;
+      real g_Kr;
+      real g_Ks;
+      real g_Na;
+      real g_bca;
+      real g_bna;
+      real g_pCa;
+      real g_pK;
+      real g_to;
+      if (param_.empty())
+      {
+         g_CaL = simdops::splat(&this->g_CaL);
+         g_Kr = simdops::splat(&this->g_Kr);
+         g_Ks = simdops::splat(&this->g_Ks);
+         g_Na = simdops::splat(&this->g_Na);
+         g_bca = simdops::splat(&this->g_bca);
+         g_bna = simdops::splat(&this->g_bna);
+         g_pCa = simdops::splat(&this->g_pCa);
+         g_pK = simdops::splat(&this->g_pK);
+         g_to = simdops::splat(&this->g_to);
+      }
+      else
+      {
+         g_CaL = load(param_[__jj].g_CaL);
+         g_Kr = load(param_[__jj].g_Kr);
+         g_Ks = load(param_[__jj].g_Ks);
+         g_Na = load(param_[__jj].g_Na);
+         g_bca = load(param_[__jj].g_bca);
+         g_bna = load(param_[__jj].g_bna);
+         g_pCa = load(param_[__jj].g_pCa);
+         g_pK = load(param_[__jj].g_pK);
+         g_to = load(param_[__jj].g_to);
+      }
       //get the gate updates (diagonalized exponential integrator)
       real fCass_inf = 0.4 + 0.6/(400.0*(Ca_ss*Ca_ss) + 1);
       real _Xr1_RLA = _interpolant[1].eval(V);
@@ -1587,12 +1703,29 @@ void ThisReaction::calc(double _dt,
       real Iion_001 = Iion;
       //Do the markov update (1 step rosenbrock with gauss siedel)
       //EDIT_STATE
-      Ca_SR += _dt*Ca_SR_diff;
-      Ca_i += _dt*Ca_i_diff;
-      Ca_ss += _dt*Ca_ss_diff;
+      if (nonGateIntegrator == generalizedRushLarsen)
+      {
+         //y += expm1(a*dt)/a * dy/dt with a the diagonal of the
+         //Jacobian.  Only the terms that are linear in y are kept in a
+         //(the buffering factors and O are frozen), so a < 0 always.
+         real Ca_SR_a = -Ca_sr_bufsr*(V_leak + O*V_rel);
+         real Ca_i_a = -Ca_i_bufc*(V_xfer + V_sr*V_leak/V_c);
+         real Ca_ss_a = -Ca_ss_bufss*(0.125*Cm*d*f*f2*fCass*g_CaL*i_CalTerm4/(F*V_ss) + V_c*V_xfer/V_ss + V_sr*O*V_rel/V_ss);
+         real R_prime_a = -(Ca_ss*k2 + k4);
+         Ca_SR += expm1(_dt*Ca_SR_a)/Ca_SR_a*Ca_SR_diff;
+         Ca_i += expm1(_dt*Ca_i_a)/Ca_i_a*Ca_i_diff;
+         Ca_ss += expm1(_dt*Ca_ss_a)/Ca_ss_a*Ca_ss_diff;
+         R_prime += expm1(_dt*R_prime_a)/R_prime_a*R_prime_diff;
+      }
+      else
+      {
+         Ca_SR += _dt*Ca_SR_diff;
+         Ca_i += _dt*Ca_i_diff;
+         Ca_ss += _dt*Ca_ss_diff;
+         R_prime += _dt*R_prime_diff;
+      }
       K_i += _dt*K_i_diff;
       Na_i += _dt*Na_i_diff;
-      R_prime += _dt*R_prime_diff;
       Xr1 += _Xr1_RLA*(Xr1+_Xr1_RLB);
       Xr2 += _Xr2_RLA*(Xr2+_Xr2_RLB);
       Xs += _Xs_RLA*(Xs+_Xs_RLB);
@@ -1623,7 +1756,9 @@ void ThisReaction::calc(double _dt,
       store(state_[__jj].m, m);
       store(state_[__jj].r, r);
       store(state_[__jj].s, s);
-      simdops::store(&__dVm.raw()[__ii],-Iion_001);
+      simdops::store_partial(&__dVm[__ii],-Iion_001,nCells_-__ii);
+      if (__VmOut != NULL)
+         eulerUpdate(_dt, __ii, std::min<int>(width, nCells_-__ii), __VmOut, __dVm, __dVmDiffusion, __iStim);
    }
 }
 #endif //USE_CUDA
@@ -1749,6 +1884,20 @@ enum varHandles
    NUMHANDLES
 };
 
+enum paramHandles
+{
+   g_CaL_param,
+   g_Kr_param,
+   g_Ks_param,
+   g_Na_param,
+   g_bca_param,
+   g_bna_param,
+   g_pCa_param,
+   g_pK_param,
+   g_to_param,
+   NUMPARAMS
+};
+
 const string ThisReaction::getUnit(const std::string& varName) const
 {
    if(0) {}
@@ -1888,6 +2037,121 @@ double ThisReaction::getValue(int iCell, int varHandle) const
    return NAN;
 }
 
+void ThisReaction::getColumn(int varHandle, int begin, int end, double* value) const
+{
+#ifdef USE_CUDA
+   auto stateData = stateTransport_.readonly(CPU);
+#endif //USE_CUDA
+
+#define COPY_COLUMN(state) for (int __ii=begin; __ii<end; __ii++) { value[__ii-begin] = READ_STATE(state,__ii); }
+   if (0) {}
+   else if (varHandle == Ca_SR_handle) { COPY_COLUMN(Ca_SR); }
+   else if (varHandle == Ca_i_handle) { COPY_COLUMN(Ca_i); }
+   else if (varHandle == Ca_ss_handle) { COPY_COLUMN(Ca_ss); }
+   else if (varHandle == K_i_handle) { COPY_COLUMN(K_i); }
+   else if (varHandle == Na_i_handle) { COPY_COLUMN(Na_i); }
+   else if (varHandle == R_prime_handle) { COPY_COLUMN(R_prime); }
+   else if (varHandle == Xr1_handle) { COPY_COLUMN(Xr1); }
+   else if (varHandle == Xr2_handle) { COPY_COLUMN(Xr2); }
+   else if (varHandle == Xs_handle) { COPY_COLUMN(Xs); }
+   else if (varHandle == d_handle) { COPY_COLUMN(d); }
+   else if (varHandle == f_handle) { COPY_COLUMN(f); }
+   else if (varHandle == f2_handle) { COPY_COLUMN(f2); }
+   else if (varHandle == fCass_handle) { COPY_COLUMN(fCass); }
+   else if (varHandle == h_handle) { COPY_COLUMN(h); }
+   else if (varHandle == j_handle) { COPY_COLUMN(j); }
+   else if (varHandle == m_handle) { COPY_COLUMN(m); }
+   else if (varHandle == r_handle) { COPY_COLUMN(r); }
+   else if (varHandle == s_handle) { COPY_COLUMN(s); }
+   else { Reaction::getColumn(varHandle, begin, end, value); }
+#undef COPY_COLUMN
+}
+
+void ThisReaction::setColumn(int varHandle, int begin, int end, const double* value)
+{
+#ifdef USE_CUDA
+   auto stateData = stateTransport_.readwrite(CPU);
+#endif //USE_CUDA
+
+#define COPY_COLUMN(state) for (int __ii=begin; __ii<end; __ii++) { READ_STATE(state,__ii) = value[__ii-begin]; }
+   if (0) {}
+   else if (varHandle == Ca_SR_handle) { COPY_COLUMN(Ca_SR); }
+   else if (varHandle == Ca_i_handle) { COPY_COLUMN(Ca_i); }
+   else if (varHandle == Ca_ss_handle) { COPY_COLUMN(Ca_ss); }
+   else if (varHandle == K_i_handle) { COPY_COLUMN(K_i); }
+   else if (varHandle == Na_i_handle) { COPY_COLUMN(Na_i); }
+   else if (varHandle == R_prime_handle) { COPY_COLUMN(R_prime); }
+   else if (varHandle == Xr1_handle) { COPY_COLUMN(Xr1); }
+   else if (varHandle == Xr2_handle) { COPY_COLUMN(Xr2); }
+   else if (varHandle == Xs_handle) { COPY_COLUMN(Xs); }
+   else if (varHandle == d_handle) { COPY_COLUMN(d); }
+   else if (varHandle == f_handle) { COPY_COLUMN(f); }
+   else if (varHandle == f2_handle) { COPY_COLUMN(f2); }
+   else if (varHandle == fCass_handle) { COPY_COLUMN(fCass); }
+   else if (varHandle == h_handle) { COPY_COLUMN(h); }
+   else if (varHandle == j_handle) { COPY_COLUMN(j); }
+   else if (varHandle == m_handle) { COPY_COLUMN(m); }
+   else if (varHandle == r_handle) { COPY_COLUMN(r); }
+   else if (varHandle == s_handle) { COPY_COLUMN(s); }
+#undef COPY_COLUMN
+}
+
+int ThisReaction::getParameterHandle(const std::string& paramName) const
+{
+#ifndef USE_CUDA
+   if (0) {}
+   else if (paramName == "g_CaL") { return g_CaL_param; }
+   else if (paramName == "g_Kr") { return g_Kr_param; }
+   else if (paramName == "g_Ks") { return g_Ks_param; }
+   else if (paramName == "g_Na") { return g_Na_param; }
+   else if (paramName == "g_bca") { return g_bca_param; }
+   else if (paramName == "g_bna") { return g_bna_param; }
+   else if (paramName == "g_pCa") { return g_pCa_param; }
+   else if (paramName == "g_pK") { return g_pK_param; }
+   else if (paramName == "g_to") { return g_to_param; }
+#endif //USE_CUDA
+   return -1;
+}
+
+void ThisReaction::setParameterColumn(int paramHandle, int begin, int end, const double* value)
+{
+#ifdef USE_CUDA
+   assert(false);
+#else //USE_CUDA
+#define READ_PARAM(param,index) (param_[index/width].param[index % width])
+   if (param_.empty())
+   {
+      param_.resize(state_.size());
+      for (int __ii=0; __ii<param_.size()*width; __ii++)
+      {
+         READ_PARAM(g_CaL,__ii) = g_CaL;
+         READ_PARAM(g_Kr,__ii) = g_Kr;
+         READ_PARAM(g_Ks,__ii) = g_Ks;
+         READ_PARAM(g_Na,__ii) = g_Na;
+         READ_PARAM(g_bca,__ii) = g_bca;
+         READ_PARAM(g_bna,__ii) = g_bna;
+         READ_PARAM(g_pCa,__ii) = g_pCa;
+         READ_PARAM(g_pK,__ii) = g_pK;
+         READ_PARAM(g_to,__ii) = g_to;
+      }
+   }
+#define COPY_PARAM(param) for (int __ii=begin; __ii<end; __ii++) { READ_PARAM(param,__ii) = value[__ii-begin]; }
+   if (0) {}
+   else if (paramHandle == g_CaL_param) { COPY_PARAM(g_CaL); }
+   else if (paramHandle == g_Kr_param) { COPY_PARAM(g_Kr); }
+   else if (paramHandle == g_Ks_param) { COPY_PARAM(g_Ks); }
+   else if (paramHandle == g_Na_param) { COPY_PARAM(g_Na); }
+   else if (paramHandle == g_bca_param) { COPY_PARAM(g_bca); }
+   else if (paramHandle == g_bna_param) { COPY_PARAM(g_bna); }
+   else if (paramHandle == g_pCa_param) { COPY_PARAM(g_pCa); }
+   else if (paramHandle == g_pK_param) { COPY_PARAM(g_pK); }
+   else if (paramHandle == g_to_param) { COPY_PARAM(g_to); }
+   else { assert(false); }
+#undef COPY_PARAM
+#undef READ_PARAM
+#endif //USE_CUDA
+}
+
 double ThisReaction::getValue(int iCell, int varHandle, double V) const
 {
 #ifdef USE_CUDA
@@ -1913,6 +2177,17 @@ double ThisReaction::getValue(int iCell, int varHandle, double V) const
    const double m=READ_STATE(m,iCell);
    const double r=READ_STATE(r,iCell);
    const double s=READ_STATE(s,iCell);
+#ifndef USE_CUDA
+   const double g_CaL = param_.empty() ? this->g_CaL : param_[iCell/width].g_CaL[iCell % width];
+   const double g_Kr = param_.empty() ? this->g_Kr : param_[iCell/width].g_Kr[iCell % width];
+   const double g_Ks = param_.empty() ? this->g_Ks : param_[iCell/width].g_Ks[iCell % width];
+   const double g_Na = param_.empty() ? this->g_Na : param_[iCell/width].g_Na[iCell % width];
+   const double g_bca = param_.empty() ? this->g_bca : param_[iCell/width].g_bca[iCell % width];
+   const double g_bna = param_.empty() ? this->g_bna : param_[iCell/width].g_bna[iCell % width];
+   const double g_pCa = param_.empty() ? this->g_pCa : param_[iCell/width].g_pCa[iCell % width];
+   const double g_pK = param_.empty() ? this->g_pK : param_[iCell/width].g_pK[iCell % width];
+   const double g_to = param_.empty() ? this->g_to : param_[iCell/width].g_to[iCell % width];
+#endif //USE_CUDA
    if (0) {}
    else if (varHandle == Ca_SR_handle)
    {
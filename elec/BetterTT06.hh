@@ -45,6 +45,18 @@ namespace BetterTT06
       double r[SIMDOPS_FLOAT64V_WIDTH];
       double s[SIMDOPS_FLOAT64V_WIDTH];
    };
+   struct Param
+   {
+      double g_CaL[SIMDOPS_FLOAT64V_WIDTH];
+      double g_Kr[SIMDOPS_FLOAT64V_WIDTH];
+      double g_Ks[SIMDOPS_FLOAT64V_WIDTH];
+      double g_Na[SIMDOPS_FLOAT64V_WIDTH];
+      double g_bca[SIMDOPS_FLOAT64V_WIDTH];
+      double g_bna[SIMDOPS_FLOAT64V_WIDTH];
+      double g_pCa[SIMDOPS_FLOAT64V_WIDTH];
+      double g_pK[SIMDOPS_FLOAT64V_WIDTH];
+      double g_to[SIMDOPS_FLOAT64V_WIDTH];
+   };
 #endif //USE_CUDA
 
    class ThisReaction : public Reaction
@@ -62,6 +74,10 @@ namespace BetterTT06
       virtual void setValue(int iCell, int varHandle, double value);
       virtual double getValue(int iCell, int varHandle) const;
       virtual double getValue(int iCell, int varHandle, double V) const;
+      virtual void getColumn(int varHandle, int begin, int end, double* value) const;
+      virtual void setColumn(int varHandle, int begin, int end, const double* value);
+      virtual int getParameterHandle(const std::string& paramName) const;
+      virtual void setParameterColumn(int paramHandle, int begin, int end, const double* value);
       virtual const std::string getUnit(const std::string& varName) const;
 
     private:
@@ -81,6 +97,9 @@ namespace BetterTT06
       double g_pCa;
       double g_pK;
       double g_to;
+      //INTEGRATOR
+      enum NonGateIntegrator {forwardEuler, generalizedRushLarsen};
+      int nonGateIntegrator;
     public:
       void calc(double dt,
                 ro_mgarray_ptr<double> Vm_m,
@@ -99,7 +118,22 @@ namespace BetterTT06
       CUfunction _kernel;
       int blockSize_;
 #else //USE_CUDA
+      bool fusedIntegrate() const {return true;}
+      void calcIntegrate(double dt,
+                         rw_mgarray_ptr<double> Vm_m,
+                         ro_mgarray_ptr<double> iStim_m,
+                         ro_mgarray_ptr<double> dVmDiffusion_m,
+                         wo_mgarray_ptr<double> dVm_m);
+      void calcSkip(double dt,
+                    ro_mgarray_ptr<double> Vm_m,
+                    ro_mgarray_ptr<double> iStim_m,
+                    wo_mgarray_ptr<double> dVm_m,
+                    const char* skip);
+      void calcBlocks(double dt, const double* Vm, const double* iStim, double* dVm,
+                      const double* dVmDiffusion, double* VmOut, const char* skip);
+
       std::vector<State, AlignedAllocator<State> > state_;
+      std::vector<Param, AlignedAllocator<Param> > param_;
 #endif
 
       //BGQ_HACKFIX, compiler bug with zero length arrays
@@ -2,20 +2,31 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include "ioUtils.h"
 
 using namespace std;
 
 namespace
 {
-   /** Returns the start position of the next field (or string::npos) in
-    *  the string buf starting from beginPos (i.e., the start of the
-    *  field after the field that beginPos points to).  A field consists
-    *  of zero or more leading whitespace characers followed by one or
-    *  more non-whitespace characters.  Hence, the next field is located
-    *  by finding the first non-whitespace character after beginPos and
-    *  then finding whilespace (or the end of buf). */
-   string::size_type findNextField(const string& buf, string::size_type beginPos);
+   /** Returns the start position of the next field (or size) in the
+    *  record buf of length size starting from beginPos (i.e., the
+    *  start of the field after the field that beginPos points to).  A
+    *  field consists of zero or more leading whitespace characers
+    *  followed by one or more non-whitespace characters.  Hence, the
+    *  next field is located by finding the first non-whitespace
+    *  character after beginPos and then finding whilespace (or the end
+    *  of buf). */
+   unsigned findNextField(const char* buf, unsigned size, unsigned beginPos);
+   bool isWhitespace(char c);
+   /** Points to field fieldIndex of the null terminated ascii record
+    *  rec, including leading whitespace. */
+   const char* asciiField(const char* rec, unsigned fieldIndex);
+   bool isBinary(BucketOfBits::DataType type);
+   unsigned binarySize(BucketOfBits::DataType type);
+   double   toDouble(const char* field, BucketOfBits::DataType type);
+   int      toInt(const char* field, BucketOfBits::DataType type);
+   uint64_t toUint64(const char* field, BucketOfBits::DataType type);
 }
 
 /** All fields are expected to have a name, a type, and a unit.  If a
@@ -26,7 +37,8 @@ BucketOfBits::BucketOfBits(const vector<string>& fieldNames,
                            const vector<string>& fieldTypes,
                            const vector<string>& fieldUnits)
 :fieldNames_(fieldNames),
- fieldUnits_(fieldUnits)
+ fieldUnits_(fieldUnits),
+ recordOffset_(1, 0)
 {
    assert(fieldNames.size() == fieldTypes.size());
    assert(fieldNames.size() == fieldUnits.size());
@@ -54,101 +66,57 @@ BucketOfBits::BucketOfBits(const vector<string>& fieldNames,
 
 
 BucketOfBits::Record::Record(const vector<DataType>& fieldTypes,
-                             const string& rawData)
-: fieldTypes_(fieldTypes), rawRecord_(rawData)
+                             const char* rawData, unsigned size)
+: fieldTypes_(fieldTypes), rawRecord_(rawData), size_(size)
 {
-   string::size_type nextField = 0;
+   unsigned nextField = 0;
    offsets_.reserve(fieldTypes_.size()+1);
    offsets_.push_back(nextField);
    for (unsigned ii=0; ii<fieldTypes_.size(); ++ii)
    {
-      switch (fieldTypes_[ii])
-      {
-        case floatType:
-        case intType:
-        case stringType:
-         nextField = findNextField(rawRecord_, offsets_[ii]);
-         break;
-        case u8Type:
-        case f8Type:
-         nextField += 8;
-         break;
-        case f4Type:
-         nextField += 4;
-         break;
-        default:
-         assert(false);
-      }
+      if (isBinary(fieldTypes_[ii]))
+         nextField += binarySize(fieldTypes_[ii]);
+      else
+         nextField = findNextField(rawRecord_, size_, offsets_[ii]);
       offsets_.push_back(nextField);
    }
 }
 
-const string& BucketOfBits::Record::getRawData() const
+const char* BucketOfBits::Record::getRawData() const
 {
    return rawRecord_;
 }
 
+unsigned BucketOfBits::Record::size() const
+{
+   return size_;
+}
+
 void BucketOfBits::Record::getValue(unsigned fieldIndex, double& value) const
 {
-   const char* startP = rawRecord_.data()+offsets_[fieldIndex];
-   switch (fieldTypes_[fieldIndex])
-   {
-     case floatType:
-      value = strtod(startP, NULL);
-      break;
-     case f8Type:
-      value = mkDouble((const unsigned char*)startP, "f8");
-      break;
-     case f4Type:
-      value = mkDouble((const unsigned char*)startP, "f4");
-      break;
-     default:
-      assert(false);
-   }
+   value = toDouble(rawRecord_+offsets_[fieldIndex], fieldTypes_[fieldIndex]);
 }
 
 void BucketOfBits::Record::getValue(unsigned fieldIndex, int& value) const
 {
-   const char* startP = rawRecord_.data()+offsets_[fieldIndex];
-   switch (fieldTypes_[fieldIndex])
-   {
-     case intType:
-      value = strtol(startP, NULL, 10);
-      break;
-     case u8Type:
-      value = mkInt((const unsigned char*)startP, "u8");
-      break;
-     default:
-      assert(false);
-   }
+   value = toInt(rawRecord_+offsets_[fieldIndex], fieldTypes_[fieldIndex]);
 }
 
 void BucketOfBits::Record::getValue(unsigned fieldIndex, uint64_t& value) const
 {
-   const char* startP = rawRecord_.data()+offsets_[fieldIndex];
-   switch (fieldTypes_[fieldIndex])
-   {
-     case intType:
-      value = strtoull(startP, NULL, 10);
-      break;
-     case u8Type:
-      value = mkInt((const unsigned char*)startP, "u8");
-      break;
-     default:
-      assert(false);
-   }
+   value = toUint64(rawRecord_+offsets_[fieldIndex], fieldTypes_[fieldIndex]);
 }
 
 void BucketOfBits::Record::getValue(unsigned fieldIndex, string& value) const
 {
    assert(fieldTypes_[fieldIndex] == stringType);
-   string::size_type len = offsets_[fieldIndex+1] - offsets_[fieldIndex];
-   value = rawRecord_.substr(offsets_[fieldIndex], len);
+   unsigned len = offsets_[fieldIndex+1] - offsets_[fieldIndex];
+   value.assign(rawRecord_+offsets_[fieldIndex], len);
 }
 
 unsigned BucketOfBits::nRecords() const
 {
-   return records_.size();
+   return recordOffset_.size()-1;
 }
 
 unsigned BucketOfBits::nFields() const
@@ -184,18 +152,102 @@ BucketOfBits::DataType BucketOfBits::dataType(unsigned index) const
 
 BucketOfBits::Record BucketOfBits::getRecord(unsigned index) const
 {
-   assert(index < records_.size());
-   return Record(fieldTypes_, records_[index]);
+   assert(index < nRecords());
+   // exclude the null byte that terminates every record
+   unsigned size = recordOffset_[index+1] - recordOffset_[index] - 1;
+   return Record(fieldTypes_, &data_[recordOffset_[index]], size);
+}
+
+namespace
+{
+   /** Column extraction is parallel over records.  Binary fields sit at
+    *  the same offset in every record, ascii fields are found by
+    *  skipping over the preceding fields. */
+   template <class T, class Convert>
+   void fillColumn(const vector<BucketOfBits::DataType>& fieldTypes, unsigned fieldIndex,
+                   const vector<char>& data, const vector<size_t>& recordOffset,
+                   T* column, Convert convert)
+   {
+      int nRecords = recordOffset.size()-1;
+      if (nRecords == 0)
+         return;
+      BucketOfBits::DataType type = fieldTypes[fieldIndex];
+      const char* base = &data[0];
+      if (isBinary(type))
+      {
+         unsigned fieldOffset = 0;
+         for (unsigned ii=0; ii<fieldIndex; ++ii)
+            fieldOffset += binarySize(fieldTypes[ii]);
+         #pragma omp parallel for
+         for (int ii=0; ii<nRecords; ++ii)
+            column[ii] = convert(base+recordOffset[ii]+fieldOffset, type);
+      }
+      else
+      {
+         #pragma omp parallel for
+         for (int ii=0; ii<nRecords; ++ii)
+            column[ii] = convert(asciiField(base+recordOffset[ii], fieldIndex), type);
+      }
+   }
+}
+
+void BucketOfBits::getColumn(unsigned fieldIndex, double* column) const
+{
+   fillColumn(fieldTypes_, fieldIndex, data_, recordOffset_, column, toDouble);
+}
+
+void BucketOfBits::getColumn(unsigned fieldIndex, int* column) const
+{
+   fillColumn(fieldTypes_, fieldIndex, data_, recordOffset_, column, toInt);
+}
+
+void BucketOfBits::getColumn(unsigned fieldIndex, uint64_t* column) const
+{
+   fillColumn(fieldTypes_, fieldIndex, data_, recordOffset_, column, toUint64);
 }
 
 void BucketOfBits::addRecord(const string& rec)
 {
-   records_.push_back(rec);
+   addRecord(rec.data(), rec.size());
+}
+
+void BucketOfBits::addRecord(const char* rec, unsigned size)
+{
+   data_.insert(data_.end(), rec, rec+size);
+   data_.push_back('\0');
+   recordOffset_.push_back(data_.size());
+}
+
+void BucketOfBits::addFixedRecords(const char* buf, size_t size, unsigned lRec)
+{
+   assert(size%lRec == 0);
+   size_t n = size/lRec;
+   data_.reserve(data_.size() + n*(lRec+1));
+   recordOffset_.reserve(recordOffset_.size() + n);
+   for (size_t ii=0; ii<n; ++ii)
+      addRecord(buf+ii*lRec, lRec);
+}
+
+void BucketOfBits::addLines(const char* buf, size_t size, unsigned nLines)
+{
+   data_.reserve(data_.size() + size + 1);
+   recordOffset_.reserve(recordOffset_.size() + nLines);
+   const char* here = buf;
+   const char* end = buf+size;
+   for (unsigned ii=0; ii<nLines && here<end; ++ii)
+   {
+      const char* eol = (const char*) memchr(here, '\n', end-here);
+      if (eol == NULL)
+         eol = end;
+      addRecord(here, eol-here);
+      here = eol+1;
+   }
 }
 
 void BucketOfBits::clearRecords()
 {
-   records_.clear();
+   vector<char>().swap(data_);
+   vector<size_t>(1, 0).swap(recordOffset_);
 }
 
 namespace
@@ -205,13 +257,86 @@ namespace
     * not even sure how you could mix types since there wout be no way
     * to tell if a whitespace was the end of an ascii field or the start
     * of a binary. */
-   string::size_type findNextField(const string& buf, string::size_type beginPos)
+   bool isWhitespace(char c)
    {
-      static string whitespace(" \n\t");
-      string::size_type begin = buf.find_first_not_of(whitespace, beginPos);
-      string::size_type endPos = buf.find_first_of(whitespace, begin);
-      return endPos;
+      return c == ' ' || c == '\n' || c == '\t';
+   }
+
+   unsigned findNextField(const char* buf, unsigned size, unsigned beginPos)
+   {
+      unsigned pos = beginPos;
+      while (pos < size && isWhitespace(buf[pos]))
+         ++pos;
+      while (pos < size && !isWhitespace(buf[pos]))
+         ++pos;
+      return pos;
+   }
+
+   const char* asciiField(const char* rec, unsigned fieldIndex)
+   {
+      for (unsigned ii=0; ii<fieldIndex; ++ii)
+      {
+         while (isWhitespace(*rec))
+            ++rec;
+         while (*rec != '\0' && !isWhitespace(*rec))
+            ++rec;
+      }
+      return rec;
+   }
+
+   bool isBinary(BucketOfBits::DataType type)
+   {
+      return type == BucketOfBits::u8Type ||
+         type == BucketOfBits::f4Type ||
+         type == BucketOfBits::f8Type;
+   }
+
+   unsigned binarySize(BucketOfBits::DataType type)
+   {
+      return type == BucketOfBits::f4Type ? 4 : 8;
+   }
+
+   double toDouble(const char* field, BucketOfBits::DataType type)
+   {
+      switch (type)
+      {
+        case BucketOfBits::floatType:
+         return strtod(field, NULL);
+        case BucketOfBits::f8Type:
+         return mkDouble((const unsigned char*)field, "f8");
+        case BucketOfBits::f4Type:
+         return mkDouble((const unsigned char*)field, "f4");
+        default:
+         assert(false);
+      }
+      return 0;
+   }
+
+   int toInt(const char* field, BucketOfBits::DataType type)
+   {
+      switch (type)
+      {
+        case BucketOfBits::intType:
+         return strtol(field, NULL, 10);
+        case BucketOfBits::u8Type:
+         return mkInt((const unsigned char*)field, "u8");
+        default:
+         assert(false);
+      }
+      return 0;
    }
-}
 
-   
+   uint64_t toUint64(const char* field, BucketOfBits::DataType type)
+   {
+      switch (type)
+      {
+        case BucketOfBits::intType:
+         return strtoull(field, NULL, 10);
+        case BucketOfBits::u8Type:
+         return mkInt((const unsigned char*)field, "u8");
+        default:
+         assert(false);
+      }
+      return 0;
+   }
+}
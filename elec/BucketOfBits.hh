@@ -5,6 +5,12 @@
 #include <vector>
 #include <stdint.h>
 
+/** The records are stored back to back in one contiguous buffer.
+ *  Each record is followed by a null byte so that the ascii parsers
+ *  can't run into the next record.
+ *
+ *  Use getColumn to extract one field of all records.  That is much
+ *  faster than getRecord(ii).getValue(...) for every record. */
 class BucketOfBits
 {
  public:
@@ -12,28 +18,32 @@ class BucketOfBits
    enum DataType{floatType, intType, stringType,
                  u8Type, f4Type, f8Type };
 
+   /** A view of one record.  Only valid as long as the bucket isn't
+    *  modified. */
    class Record
    {
     public:
       Record(const std::vector<DataType>& fieldTypes,
-             const std::string& rawData);
-   
-      const std::string& getRawData() const;
+             const char* rawData, unsigned size);
+
+      const char* getRawData() const;
+      unsigned size() const;
       void getValue(unsigned fieldIndex, double& value) const;
       void getValue(unsigned fieldIndex, int& value) const;
       void getValue(unsigned fieldIndex, uint64_t& value) const;
       void getValue(unsigned fieldIndex, std::string& value) const;
-      
+
     private:
-      std::vector<DataType>    fieldTypes_;
-      std::vector<std::string::size_type>    offsets_;
-      const std::string&       rawRecord_;
+      const std::vector<DataType>&           fieldTypes_;
+      std::vector<unsigned>                  offsets_;
+      const char*                            rawRecord_;
+      unsigned                               size_;
    };
 
    BucketOfBits(const std::vector<std::string>& fieldNames,
                 const std::vector<std::string>& fieldTypes,
                 const std::vector<std::string>& fieldUnits);
-   
+
    unsigned nRecords() const;
    unsigned nFields() const;
    unsigned getIndex(const std::string& fieldName) const;
@@ -42,14 +52,28 @@ class BucketOfBits
    DataType dataType(unsigned index) const;
    Record getRecord(unsigned index) const;
 
+   /** Store field fieldIndex of every record in column[0..nRecords).
+    *  The same conversions as Record::getValue apply. */
+   void getColumn(unsigned fieldIndex, double* column) const;
+   void getColumn(unsigned fieldIndex, int* column) const;
+   void getColumn(unsigned fieldIndex, uint64_t* column) const;
+
    void addRecord(const std::string& rec);
+   void addRecord(const char* rec, unsigned size);
+   /** Adds the size/lRec records of length lRec in buf. */
+   void addFixedRecords(const char* buf, size_t size, unsigned lRec);
+   /** Adds (up to) nLines newline terminated records from buf.  The
+    *  newlines are not part of the records. */
+   void addLines(const char* buf, size_t size, unsigned nLines);
+   /** Releases the memory of all records. */
    void clearRecords();
-   
+
  private:
    std::vector<DataType>    fieldTypes_;
    std::vector<std::string> fieldNames_;
    std::vector<std::string> fieldUnits_;
-   std::vector<std::string> records_;
+   std::vector<char>        data_;
+   std::vector<size_t>      recordOffset_; // nRecords+1 entries
 };
 
 #endif
@@ -135,8 +135,8 @@ void CaAverageSensor::bufferReactionData(const int begin, const int end, const i
 {
    if(begin==0)loop_buffer_=loop;
    
-   for (unsigned ii=begin; ii<end; ++ii)
-      buffer_val_[ii]=reaction_.getValue(ii, ca_handle_);
+   if (end > begin)
+      reaction_.getColumn(ca_handle_, begin, end, &buffer_val_[begin]);
 }
 
 void CaAverageSensor::eval(double time, int loop)
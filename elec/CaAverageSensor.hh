@@ -56,6 +56,7 @@ public:
    
    void print(double time, int loop);
    void eval(double time, int loop);
+   bool canMigrate() const {return times_.empty();}
    void bufferReactionData(const int loop);
    void bufferReactionData(const int begin, 
                            const int end, const int loop);
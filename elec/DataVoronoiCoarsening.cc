@@ -5,6 +5,7 @@
 #include "Simulate.hh"
 #include "CommTable.hh"
 #include "stringUtils.hh"
+#include "OutputService.hh"
 
 using namespace PerformanceTimers;
 
@@ -39,6 +40,20 @@ DataVoronoiCoarsening::DataVoronoiCoarsening(const SensorParms& sp,
    activationTime_.resize(owned_colors.size());	//AT-HACK, activation time in ms (normalized to initation of simulation at t=0 ms) of select gids in sensor.txt
    active_.resize(owned_colors.size(), false);	//AT-HACK, active status of select gids in sensor.txt?, true or false
    clear();	//AT-HACK, function that sets active to false and AT to -1000 ms for all select gids in sensor.txt
+
+   map<Long64, unsigned> indexFromCenterGid;
+   unsigned index = 0;
+   for (set<int>::const_iterator it = owned_colors.begin(); it != owned_colors.end(); ++it)
+      indexFromCenterGid[coarsening_.getCenterGid(*it)] = index++;
+   for (unsigned ii=0; ii<anatomy.nLocal(); ++ii)
+   {
+      map<Long64, unsigned>::const_iterator here = indexFromCenterGid.find(anatomy.gid(ii));
+      if (here != indexFromCenterGid.end())
+         ownedColorFromCell_[ii] = here->second;
+   }
+
+   Long64 nSnapSubLoc = owned_colors.size();
+   MPI_Allreduce(&nSnapSubLoc, &nSnapSub_, 1, MPI_LONG_LONG, MPI_SUM, comm_);
 }
 
 void DataVoronoiCoarsening::computeColorAverages(ro_array_ptr<double> val)
@@ -49,176 +64,112 @@ void DataVoronoiCoarsening::computeColorAverages(ro_array_ptr<double> val)
    coarsening_.exchangeAndSum(avg_valcolors_);
 }
 
-void DataVoronoiCoarsening::writeAverages(const string& filename,
-                                          const double current_time,
-                                          const int current_loop)const
+namespace
 {
-   int myRank;
-   MPI_Comm_rank(comm_, &myRank);
-
-   PFILE* file = Popen(filename.c_str(), "w", comm_);
-   if (nFiles_ > 0)
-     PioSet(file, "ngroup", nFiles_);
-
-//   const int nfields = 2+(int)times_.size(); 	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
- //  const int lrec    = 20+13*(int)times_.size() + 1;	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
-
-   const int nfields = 3; 	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
-   const int lrec    = 20+13 + 1;	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
- 
-   const std::set<int>& owned_colors(coarsening_.getOwnedColors());
-
-   static Long64 nSnapSub = -1;
-   static bool first_time = true;
-   if( first_time )
+   /** Everything the writers need from a DataVoronoiCoarsening.  The
+    *  sensor keeps evaluating while the OutputService writes so the
+    *  writers must not touch the sensor itself. */
+   struct CoarsenedSnapshot
    {
-      Long64 nSnapSubLoc = owned_colors.size();
-      MPI_Allreduce(&nSnapSubLoc, &nSnapSub, 1, MPI_LONG_LONG, MPI_SUM, comm_);
-   }
+      int nx, ny, nz;
+      unsigned nFiles;
+      Long64 nRecords;
+      std::vector<double> times;
+      std::vector<Long64> centerGid;
+      std::vector<int> nValues;
+      std::vector<float> Vm;
+      std::vector<std::vector<double> > activationTime;	//AT-HACK
+   };
 
-   if (myRank == 0)
+   void writeHeader(PFILE* file, const CoarsenedSnapshot& snap, const int current_loop)
    {
-      // write header
+      const int nfields = 3; 	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
+      const int lrec    = 20+13 + 1;	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
       int nfiles;
       Pget(file,"ngroup",&nfiles);
       Pprintf(file, "voronoi FILEHEADER {\n");
       Pprintf(file, "  lrec = %d;\n", lrec);
       Pprintf(file, "  datatype = FIXRECORDASCII;\n");
-      Pprintf(file, "  nrecords = %llu;\n", nSnapSub);
+      Pprintf(file, "  nrecords = %llu;\n", snap.nRecords);
       Pprintf(file, "  nfields = %d;\n", nfields);
 //      string fieldNames="gid nvals " + concat(vector<string>(times_.size(), "Vm"));	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
       string fieldNames="gid nvals Vm";	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
       Pprintf(file, "  field_names = %s;\n", fieldNames.c_str());
       string fieldTypes="u d f";
-//      string fieldTypes="u d " + concat(vector<string>(times_.size(), "f"));	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
-      Pprintf(file, "  field_types = %s;\n", fieldTypes.c_str());	//AT-HACK, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
+      Pprintf(file, "  field_types = %s;\n", fieldTypes.c_str());
       Pprintf(file, "  nfiles = %u;\n", nfiles);
-      Pprintf(file, "  time = %f; loop = %u;\n", times_[0], current_loop);
-      if( times_.size()>1 )
-         Pprintf(file, "  nsteps = %d; dt = %f;\n", times_.size(), times_[1]-times_[0]);	//AT-HACK, adding semicolon after dt
-      Pprintf(file, "  h = %4u  0    0\n", anatomy_.nx());
-      Pprintf(file, "        0    %4u  0\n", anatomy_.ny());
-      Pprintf(file, "        0    0    %4u;\n", anatomy_.nz());
+      Pprintf(file, "  time = %f; loop = %u;\n", snap.times[0], current_loop);
+      if( snap.times.size()>1 )
+         Pprintf(file, "  nsteps = %d; dt = %f;\n", snap.times.size(), snap.times[1]-snap.times[0]);	//AT-HACK, adding semicolon after dt
+      Pprintf(file, "  h = %4u  0    0\n", snap.nx);
+      Pprintf(file, "        0    %4u  0\n", snap.ny);
+      Pprintf(file, "        0    0    %4u;\n", snap.nz);
       Pprintf(file, "}\n\n");
    }
-   
-   for(set<int>::const_iterator it = owned_colors.begin();
-                                it!= owned_colors.end();
-                              ++it)
-   {
-      const int color=(*it);
-      
-      const map< int, vector<float> >::const_iterator itn=averages_.find(color);
-      const vector<float>& color_avg(itn->second);
-      
-      stringstream ss;
-      ss << setw(12)<< right << coarsening_.getCenterGid(color) <<" ";
-      ss << setw(7)<< right << avg_valcolors_.nValues(color);
-      
-      ss << setprecision(5) << scientific;
-      
-//      for(int it=0;it<times_.size();++it)			//AT-HACK, lines 122 o 126, disabling ability to print out data from multiple time points when evalrate<printrate in object.data, and just prints most recently evaluated data
-//      {
-//           ss<< " " << setw(12)<< color_avg[it];
-//      }
-      ss<< " " << setw(12)<< color_avg[times_.size()-1];
-      ss << endl;
-      string line(ss.str());
-      Pwrite(line.c_str(), line.size(), 1, file);
-   }
-   
-   Pclose(file);
-}
-
-void DataVoronoiCoarsening::writeAveragesAT(const string& filename,		
-                                          const double current_time,
-                                          const int current_loop)const	//AT-HACK, this whole function is new, and is a sister function of writeAverages, but this one tells cardioid how to write out coarsened AT, instead of coarsened Vm.  For confusing parts I've added further AT-HACK comments within this function.
-{
-   int myRank;
-   MPI_Comm_rank(comm_, &myRank);
 
-   PFILE* fileAT = Popen(filename.c_str(),"w",comm_);
-   if (nFiles_ > 0)
+   void writeAverages(const string& filename,
+                      const CoarsenedSnapshot& snap,
+                      const int current_loop,
+                      MPI_Comm comm)
    {
-     PioSet(fileAT, "ngroup", nFiles_);
-   }
+      int myRank;
+      MPI_Comm_rank(comm, &myRank);
 
+      PFILE* file = Popen(filename.c_str(), "w", comm);
+      if (snap.nFiles > 0)
+         PioSet(file, "ngroup", snap.nFiles);
 
-//   const int nfields = 2+(int)times_.size(); 
-//   const int lrec    = 20+13*(int)times_.size() + 1;
+      if (myRank == 0)
+         writeHeader(file, snap, current_loop);
 
-   const int nfields = 3; 
-   const int lrec    = 20+13 + 1;
- 
-
-   const std::set<int>& owned_colors(coarsening_.getOwnedColors());
+      for (unsigned ii=0; ii<snap.centerGid.size(); ++ii)
+      {
+         stringstream ss;
+         ss << setw(12)<< right << snap.centerGid[ii] <<" ";
+         ss << setw(7)<< right << snap.nValues[ii];
+         ss << setprecision(5) << scientific;
+         ss<< " " << setw(12)<< snap.Vm[ii];
+         ss << endl;
+         string line(ss.str());
+         Pwrite(line.c_str(), line.size(), 1, file);
+      }
 
-   static Long64 nSnapSub = -1;
-   static bool first_time = true;
-   if( first_time )
-   {
-      Long64 nSnapSubLoc = owned_colors.size();
-      MPI_Allreduce(&nSnapSubLoc, &nSnapSub, 1, MPI_LONG_LONG, MPI_SUM, comm_);
+      Pclose(file);
    }
 
-   if (myRank == 0)
+   // AT-HACK, this whole function is a sister function of
+   // writeAverages, but this one tells cardioid how to write out
+   // coarsened AT, instead of coarsened Vm.
+   void writeAveragesAT(const string& filename,
+                        const CoarsenedSnapshot& snap,
+                        const int current_loop,
+                        MPI_Comm comm)
    {
-      // write header
-      int nfiles;
-//      string fieldNames="gid nvals " + concat(vector<string>(times_.size(), "Vm"));
-//      string fieldTypes="u d " + concat(vector<string>(times_.size(), "f"));
+      int myRank;
+      MPI_Comm_rank(comm, &myRank);
 
-      string fieldNames="gid nvals Vm";
-      string fieldTypes="u d f";
-      
-      //write header for activation times files
-      Pget(fileAT,"ngroup",&nfiles);
-      Pprintf(fileAT, "voronoi FILEHEADER {\n");
-      Pprintf(fileAT, "  lrec = %d;\n", lrec);
-      Pprintf(fileAT, "  datatype = FIXRECORDASCII;\n");
-      Pprintf(fileAT, "  nrecords = %llu;\n", nSnapSub);
-      Pprintf(fileAT, "  nfields = %d;\n", nfields);
-      Pprintf(fileAT, "  field_names = %s;\n", fieldNames.c_str());
-      Pprintf(fileAT, "  field_types = %s;\n", fieldTypes.c_str());
-      Pprintf(fileAT, "  nfiles = %u;\n", nfiles);
-      Pprintf(fileAT, "  time = %f; loop = %u;\n", times_[0], current_loop);
-      if( times_.size()>1 )
-         Pprintf(fileAT, "  nsteps = %d; dt = %f;\n", times_.size(), times_[1]-times_[0]);
-      Pprintf(fileAT, "  h = %4u  0    0\n", anatomy_.nx());
-      Pprintf(fileAT, "        0    %4u  0\n", anatomy_.ny());
-      Pprintf(fileAT, "        0    0    %4u;\n", anatomy_.nz());
-      Pprintf(fileAT, "}\n\n");
-   }
-   
-   int ii=0;		//AT-HACK, a counter to index into activationTime array, follows the iterator "it" as it iterates through owned_colors, i.e., the colors that are averaged together to get final averaged color in Voronoi Coarsening
-   for(set<int>::const_iterator it = owned_colors.begin();
-                                it!= owned_colors.end();
-                              ++it)
-   {
-      const int color=(*it);
-      
-      const map< int, vector<float> >::const_iterator itn=averages_.find(color);
-      const vector<float>& color_avg(itn->second);
-      
-      
-      //Do same for writing to activation times
-      stringstream ssAT;
-      ssAT << setw(12)<< right << coarsening_.getCenterGid(color) <<" ";
-      ssAT << setw(7)<< right << avg_valcolors_.nValues(color);
-      
-      ssAT << setprecision(5) << scientific;
-      
-      for (unsigned jj=0; jj<activationTime_[ii].size(); ++jj)		//AT-HACK, while this jj loop implies that multiple ATs may be recorded for each coarsened_anatomy gid (ii), this in fact will never happen, accoring to the way the eval() function works below, so this for loop is kind of just an artificat
-        ssAT<< " " << setw(12)<< activationTime_[ii][jj];
-	   
-     
-      ssAT << endl;
-      string lineAT(ssAT.str());
-      Pwrite(lineAT.c_str(), lineAT.size(), 1, fileAT);
-      ii++;
+      PFILE* fileAT = Popen(filename.c_str(), "w", comm);
+      if (snap.nFiles > 0)
+         PioSet(fileAT, "ngroup", snap.nFiles);
+
+      if (myRank == 0)
+         writeHeader(fileAT, snap, current_loop);
+
+      for (unsigned ii=0; ii<snap.centerGid.size(); ++ii)
+      {
+         stringstream ssAT;
+         ssAT << setw(12)<< right << snap.centerGid[ii] <<" ";
+         ssAT << setw(7)<< right << snap.nValues[ii];
+         ssAT << setprecision(5) << scientific;
+         for (unsigned jj=0; jj<snap.activationTime[ii].size(); ++jj)		//AT-HACK, while this jj loop implies that multiple ATs may be recorded for each coarsened_anatomy gid (ii), this in fact will never happen, accoring to the way the eval() function works below, so this for loop is kind of just an artificat
+            ssAT<< " " << setw(12)<< snap.activationTime[ii][jj];
+         ssAT << endl;
+         string lineAT(ssAT.str());
+         Pwrite(lineAT.c_str(), lineAT.size(), 1, fileAT);
+      }
+
+      Pclose(fileAT);
    }
-   
-   Pclose(fileAT);
 }
 
 
@@ -277,14 +228,41 @@ void DataVoronoiCoarsening::print(double time, int loop)				//calls the writeAve
 
    stringstream name;
    name << "snapshot."<<setfill('0')<<setw(12)<<loop;
-   string fullname = name.str();
-   if (myRank == 0)
-      DirTestCreate(fullname.c_str());
-   fullname += "/" + filename_;
-   string fullnameAT = name.str() + "/" + filename_ + "AT";		//AT-HACK, filenames for AT will just be the same as for regular files, with "AT" appended
-    
-   writeAverages(fullname,time, loop); 		//Print coarsened Vm values to appropriate files
-   writeAveragesAT(fullnameAT,time,loop);  	//AT-HACK, print AT for coarsened anatomy gids to appropriate files
+   string dirname = name.str();
+   string fullname = dirname + "/" + filename_;
+   string fullnameAT = dirname + "/" + filename_ + "AT";		//AT-HACK, filenames for AT will just be the same as for regular files, with "AT" appended
+
+   const std::set<int>& owned_colors(coarsening_.getOwnedColors());
+   CoarsenedSnapshot snap;
+   snap.nx = anatomy_.nx();
+   snap.ny = anatomy_.ny();
+   snap.nz = anatomy_.nz();
+   snap.nFiles = nFiles_;
+   snap.nRecords = nSnapSub_;
+   snap.times = times_;
+   snap.centerGid.reserve(owned_colors.size());
+   snap.nValues.reserve(owned_colors.size());
+   snap.Vm.reserve(owned_colors.size());
+   for(set<int>::const_iterator it = owned_colors.begin();
+                                it!= owned_colors.end();
+                              ++it)
+   {
+      const int color=(*it);
+      const vector<float>& color_avg(averages_.find(color)->second);
+      snap.centerGid.push_back(coarsening_.getCenterGid(color));
+      snap.nValues.push_back(avg_valcolors_.nValues(color));
+      snap.Vm.push_back(color_avg[times_.size()-1]);
+   }
+   snap.activationTime = activationTime_;	//AT-HACK
+
+   OutputService::getInstance().post(
+      [=](MPI_Comm comm)
+      {
+         if (myRank == 0)
+            DirTestCreate(dirname.c_str());
+         writeAverages(fullname, snap, loop, comm); 		//Print coarsened Vm values to appropriate files
+         writeAveragesAT(fullnameAT, snap, loop, comm);  	//AT-HACK, print AT for coarsened anatomy gids to appropriate files
+      });
 
    times_.clear();
    for(map<int,std::vector<float> >::iterator itg =averages_.begin();
@@ -297,6 +275,26 @@ void DataVoronoiCoarsening::print(double time, int loop)				//calls the writeAve
    stopTimer(sensorPrintTimer);
 }
 
+/** The activation state of a color moves with its center cell.  Only
+ *  the last activation time is kept (see eval). */
+void DataVoronoiCoarsening::getCellValues(unsigned iCell, double* value) const
+{
+   map<unsigned, unsigned>::const_iterator here = ownedColorFromCell_.find(iCell);
+   if (here == ownedColorFromCell_.end())
+      return;
+   value[0] = active_[here->second] ? 1 : 0;
+   value[1] = activationTime_[here->second].back();
+}
+
+void DataVoronoiCoarsening::setCellValues(unsigned iCell, const double* value)
+{
+   map<unsigned, unsigned>::const_iterator here = ownedColorFromCell_.find(iCell);
+   if (here == ownedColorFromCell_.end())
+      return;
+   active_[here->second] = (value[0] != 0);
+   activationTime_[here->second].assign(1, value[1]);
+}
+
 void DataVoronoiCoarsening::clear()					//AT-HACK, this whole function was added as part of the hack, it resets all select gid ATs to -1000 ms and active status to false
 {
    const std::set<int>& owned_colors(coarsening_.getOwnedColors());
@@ -23,6 +23,9 @@ class DataVoronoiCoarsening : public Sensor
 
    MPI_Comm comm_;
 
+   // global number of coarsened points
+   Long64 nSnapSub_;
+
    LocalSums avg_valcolors_;
 
    // eval times
@@ -32,16 +35,12 @@ class DataVoronoiCoarsening : public Sensor
    std::map<int,std::vector<float> > averages_;
    
    void computeColorAverages(ro_array_ptr<double> val);
-   void writeAverages(const std::string& filename,
-                      const double current_time,
-                      const int current_loop)const;
-   void writeAveragesAT(const std::string& filename,
-                      const double current_time,
-                      const int current_loop)const;	//AT-HACK, this whole function is new, and is a sister function of writeAverages, but this one tells cardioid how to write out coarsened AT, instead of coarsened Vm.  For confusing parts I've added further AT-HACK comments within this function.	      
-
    std::vector<bool> active_;					//AT-HACK, active status of select gids in sensor.txt?, true or false
    std::vector<std::vector<double> > activationTime_;		//AT-HACK, activation time in ms (normalized to initation of simulation at t=0 ms) of select gids in sensor.txt
    void clear();						//AT-HACK, function that sets active to false and AT to -1000 ms for all select gids in sensor.txt
+   // index into active_ and activationTime_ of the local cells that
+   // are the center of an owned color
+   std::map<unsigned, unsigned> ownedColorFromCell_;
 
  public:
    DataVoronoiCoarsening(const SensorParms& sp,
@@ -54,6 +53,11 @@ class DataVoronoiCoarsening : public Sensor
                          const double max_distance);
    void eval(double time, int loop);
    void print(double time, int loop);
+   bool deferredPrint() const {return true;}
+   bool canMigrate() const {return times_.empty();}
+   unsigned nCellValues() const {return 2;}
+   void getCellValues(unsigned iCell, double* value) const;
+   void setCellValues(unsigned iCell, const double* value);
 };
 
 #endif
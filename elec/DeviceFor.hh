@@ -1,14 +1,77 @@
 #pragma once
 
 #include "lazy_array.hh"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** On the host the loops are split across the OpenMP threads.  Each
+ *  thread gets one contiguous range whose ends are multiples of
+ *  hostForallAlign so that no two threads write to the same cache line
+ *  (and the ranges start on a SIMD boundary).  Loops shorter than
+ *  hostForallMinSize, and loops that are reached from inside a
+ *  parallel region (such as the role threads of the parallel
+ *  diffusion/reaction loop), run on the calling thread alone. */
+enum { hostForallAlign = 8, hostForallMinSize = 4096 };
 
-#define HOST_PARALLEL_FORALL(N, VAR, BODY)      \
-do                                              \
-{                                               \
-   for (int VAR=0; VAR<(N); VAR++)              \
-   {                                            \
-      BODY;                                     \
-   }                                            \
+inline void hostForallRange(const int len, int& begin, int& end)
+{
+#ifdef _OPENMP
+   const int nThreads = omp_get_num_threads();
+   const int tid = omp_get_thread_num();
+#else
+   const int nThreads = 1;
+   const int tid = 0;
+#endif
+   const int nChunks = (len+hostForallAlign-1)/hostForallAlign;
+   const int chunkBegin = (long long)nChunks*tid/nThreads;
+   const int chunkEnd = (long long)nChunks*(tid+1)/nThreads;
+   begin = chunkBegin*hostForallAlign;
+   end = chunkEnd*hostForallAlign;
+   if (end > len) end = len;
+   if (begin > len) begin = len;
+}
+
+#define HOST_FORALL_PRAGMA(x) _Pragma(#x)
+
+#ifdef _OPENMP
+#define HOST_FORALL_IN_PARALLEL() omp_in_parallel()
+#else
+#define HOST_FORALL_IN_PARALLEL() 0
+#endif
+
+#define HOST_PARALLEL_FORALL(N, VAR, BODY)                              \
+do                                                                      \
+{                                                                       \
+   const int _len = (N);                                                \
+   HOST_FORALL_PRAGMA(omp parallel if (_len >= hostForallMinSize && !HOST_FORALL_IN_PARALLEL())) \
+   {                                                                    \
+      int _begin, _end;                                                 \
+      hostForallRange(_len, _begin, _end);                              \
+      for (int VAR=_begin; VAR<_end; VAR++)                             \
+      {                                                                 \
+         BODY;                                                          \
+      }                                                                 \
+   }                                                                    \
+} while(0)
+
+/** RESULT OP= the contributions of BODY, which has to update RESULT
+ *  with OP (e.g. HOST_PARALLEL_REDUCE(n, ii, +, sum, sum += x[ii])).
+ *  OP is any OpenMP reduction operator (+, *, max, min, ...).  The
+ *  same threading rules as HOST_PARALLEL_FORALL apply. */
+#define HOST_PARALLEL_REDUCE(N, VAR, OP, RESULT, BODY)                  \
+do                                                                      \
+{                                                                       \
+   const int _len = (N);                                                \
+   HOST_FORALL_PRAGMA(omp parallel reduction(OP:RESULT) if (_len >= hostForallMinSize && !HOST_FORALL_IN_PARALLEL())) \
+   {                                                                    \
+      int _begin, _end;                                                 \
+      hostForallRange(_len, _begin, _end);                              \
+      for (int VAR=_begin; VAR<_end; VAR++)                             \
+      {                                                                 \
+         BODY;                                                          \
+      }                                                                 \
+   }                                                                    \
 } while(0)
 
 #ifdef USE_CUDA
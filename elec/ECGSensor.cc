@@ -9,6 +9,7 @@
 #include "Simulate.hh"
 #include "PerformanceTimers.hh"
 #include "PioHeaderData.hh"
+#include "OutputService.hh"
 #include <cuda.h>
 #include <cuda_runtime_api.h>
 
@@ -152,6 +153,15 @@ void ECGSensor::calcInvR(const Simulate& sim)
  }
 }
 
+/** The ECG values saved since the last print are global sums, so they
+ *  don't depend on the decomposition. */
+void ECGSensor::continueFrom(Sensor& old)
+{
+   ECGSensor& oldEcg = dynamic_cast<ECGSensor&>(old);
+   saveLoops.swap(oldEcg.saveLoops);
+   saveEcgs.swap(oldEcg.saveEcgs);
+}
+
 void ECGSensor::print(double time, int loop)
 {
    int myRank;
@@ -159,16 +169,9 @@ void ECGSensor::print(double time, int loop)
    
    stringstream name;
    name << "snapshot."<<setfill('0')<<setw(12)<<loop;
-   string fullname = name.str();
-   if (myRank == 0)
-      DirTestCreate(fullname.c_str());
-   fullname += "/" + filename_;
+   string dirname = name.str();
+   string fullname = dirname + "/" + filename_;
 
-   PFILE* file = Popen(fullname.c_str(), "w", MPI_COMM_WORLD);
-   if (nFiles_ > 0)
-     PioSet(file, "ngroup", nFiles_);
-
-   char fmt[] = "%20.8g";
    int nFields = nEcgPoints+1;
    int lRec = 20*nFields;
 
@@ -197,35 +200,51 @@ void ECGSensor::print(double time, int loop)
    header.addItem("printRate", printRate());
    header.addItem("evalRate", evalRate());
 
-   if (myRank == 0) {
-      header.writeHeader(file, loop, time);
-
-      char line[lRec+1];
-      
-      for (unsigned ii=0; ii<saveLoops.size(); ++ii)
+   // Only rank 0 holds data.  Hand it over to the output service and
+   // clear up the loop and ecgs save values so that eval can keep
+   // accumulating while the file is written.
+   vector<int> loops;
+   vector<double> ecgs;
+   loops.swap(saveLoops);
+   ecgs.swap(saveEcgs);
+
+   int nFiles = nFiles_;
+   int nPoints = nEcgPoints;
+   OutputService::getInstance().post(
+      [=](MPI_Comm comm) mutable
       {
-         int l = snprintf(line, lRec, "%10d ", saveLoops[ii]);
-
-         for(unsigned jj=0; jj<nEcgPoints; ++jj){
-            int index = ii*nEcgPoints+jj;
-            assert(index<saveEcgs.size());
-	    int ll = snprintf(line+l, lRec, fmt, saveEcgs[index]);
-            l=l+ll;
-	 }
-         //printf("l=%d, lRec=%d, ii=%d, ecgs=%f\n", l, lRec, ii, ecgs[ii]);
-         for (; l < lRec - 1; l++) line[l] = (char)' ';
-         line[l++] = (char)'\n';
-         assert (l==lRec);
-         Pwrite(line, lRec, 1, file);
-      }
-
-      // Clear up the loop and ecgs save values in vector
-      saveLoops.clear();
-      saveEcgs.clear();
-      
-   }
+         if (myRank == 0)
+            DirTestCreate(dirname.c_str());
+
+         PFILE* file = Popen(fullname.c_str(), "w", comm);
+         if (nFiles > 0)
+            PioSet(file, "ngroup", nFiles);
+
+         if (myRank == 0)
+         {
+            header.writeHeader(file, loop, time);
+
+            char fmt[] = "%20.8g";
+            char line[lRec+1];
+            for (unsigned ii=0; ii<loops.size(); ++ii)
+            {
+               int l = snprintf(line, lRec, "%10d ", loops[ii]);
+               for (unsigned jj=0; jj<nPoints; ++jj)
+               {
+                  int index = ii*nPoints+jj;
+                  assert(index<ecgs.size());
+                  int ll = snprintf(line+l, lRec, fmt, ecgs[index]);
+                  l=l+ll;
+               }
+               for (; l < lRec - 1; l++) line[l] = (char)' ';
+               line[l++] = (char)'\n';
+               assert (l==lRec);
+               Pwrite(line, lRec, 1, file);
+            }
+         }
 
-   Pclose(file);
+         Pclose(file);
+      });
 }
 
 void calcEcg(rw_mgarray_ptr<double> _ecgs,
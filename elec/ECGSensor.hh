@@ -44,6 +44,9 @@ class ECGSensor : public Sensor
              const Simulate& sim);
    ~ECGSensor() {};
 
+   bool deferredPrint() const {return true;}
+   void continueFrom(Sensor& old);
+
  private:
 
    void print(double time, int loop);
@@ -0,0 +1,186 @@
+#include "FGRDiffusionImplicit.hh"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include "Anatomy.hh"
+#include "CommTable.hh"
+#include "mpiUtils.h"
+
+using namespace std;
+
+FGRDiffusionImplicit::FGRDiffusionImplicit(const FGRUtils::FGRDiffusionParms& parms,
+                                           const Anatomy& anatomy,
+                                           const vector<int>& sendMap,
+                                           const CommTable* commTable,
+                                           double dt, double theta,
+                                           double tolerance, double absTolerance,
+                                           int maxIterations)
+: Diffusion(parms.diffusionScale_),
+  nLocal_(anatomy.nLocal()),
+  nRemote_(anatomy.nRemote()),
+  dt_(dt),
+  theta_(theta),
+  tolerance_(tolerance),
+  absTolerance_(absTolerance),
+  maxIterations_(maxIterations),
+  comm_(commTable->_comm),
+  stencil_(parms, anatomy, commTable->_comm),
+  halo_(sendMap, commTable),
+  warnedNotConverged_(false),
+  y_(anatomy.nLocal(), 0.0),
+  b_(anatomy.nLocal()),
+  r_(anatomy.nLocal()),
+  r0_(anatomy.nLocal()),
+  p_(anatomy.nLocal()),
+  v_(anatomy.nLocal()),
+  s_(anatomy.nLocal()),
+  t_(anatomy.nLocal())
+{
+   assert(theta_ > 0 && theta_ <= 1);
+   x_.resize(nLocal_+nRemote_);
+   Lx_.resize(nLocal_);
+}
+
+void FGRDiffusionImplicit::updateLocalVoltage(ro_mgarray_ptr<double> VmLocal)
+{
+   stencil_.updateLocalVoltage(VmLocal);
+}
+
+void FGRDiffusionImplicit::updateRemoteVoltage(ro_mgarray_ptr<double> VmRemote)
+{
+   stencil_.updateRemoteVoltage(VmRemote);
+}
+
+void FGRDiffusionImplicit::setDiffusionScale(double newDiffusionScale)
+{
+   Diffusion::setDiffusionScale(newDiffusionScale);
+   stencil_.setDiffusionScale(newDiffusionScale);
+}
+
+/** Expects the stencil to hold V (local and remote), i.e., the same
+ *  state as the explicit calc. */
+void FGRDiffusionImplicit::calc(rw_mgarray_ptr<double> dVm_managed)
+{
+   // b = L V
+   stencil_.calc(Lx_);
+   {
+      ro_array_ptr<double> Lx = Lx_.readonly(CPU);
+      #pragma omp parallel for
+      for (int ii=0; ii<nLocal_; ++ii)
+         b_[ii] = Lx[ii];
+   }
+   const double bNorm = sqrt(dot(&b_[0], &b_[0]));
+   const double stopNorm = max(tolerance_*bNorm, absTolerance_);
+
+   // r = b - A y with the last solution as initial guess
+   applyA(y_, v_);
+   #pragma omp parallel for
+   for (int ii=0; ii<nLocal_; ++ii)
+   {
+      r_[ii] = b_[ii] - v_[ii];
+      r0_[ii] = r_[ii];
+      p_[ii] = 0;
+      v_[ii] = 0;
+   }
+   double rNorm = sqrt(dot(&r_[0], &r_[0]));
+
+   // BiCGStab.  A is not symmetric in general (the cross terms of a
+   // rotated or heterogeneous conductivity and the one sided gradients
+   // at the tissue boundary differ between a cell and its neighbor), so
+   // conjugate gradient can't be used.
+   double rho = 1;
+   double alpha = 1;
+   double omega = 1;
+   int iter = 0;
+   while (rNorm > stopNorm && iter < maxIterations_)
+   {
+      ++iter;
+      double rhoNew = dot(&r0_[0], &r_[0]);
+      if (rhoNew == 0)
+         break; // breakdown, restarting would need a new r0
+      double beta = (rhoNew/rho)*(alpha/omega);
+      rho = rhoNew;
+      #pragma omp parallel for
+      for (int ii=0; ii<nLocal_; ++ii)
+         p_[ii] = r_[ii] + beta*(p_[ii] - omega*v_[ii]);
+
+      applyA(p_, v_);
+      alpha = rho/dot(&r0_[0], &v_[0]);
+      #pragma omp parallel for
+      for (int ii=0; ii<nLocal_; ++ii)
+         s_[ii] = r_[ii] - alpha*v_[ii];
+      double sNorm = sqrt(dot(&s_[0], &s_[0]));
+      if (sNorm <= stopNorm)
+      {
+         #pragma omp parallel for
+         for (int ii=0; ii<nLocal_; ++ii)
+         {
+            y_[ii] += alpha*p_[ii];
+            r_[ii] = s_[ii];
+         }
+         rNorm = sNorm;
+         break;
+      }
+
+      applyA(s_, t_);
+      double tt = dot(&t_[0], &t_[0]);
+      omega = (tt > 0) ? dot(&t_[0], &s_[0])/tt : 0;
+      #pragma omp parallel for
+      for (int ii=0; ii<nLocal_; ++ii)
+      {
+         y_[ii] += alpha*p_[ii] + omega*s_[ii];
+         r_[ii] = s_[ii] - omega*t_[ii];
+      }
+      rNorm = sqrt(dot(&r_[0], &r_[0]));
+      if (omega == 0)
+         break;
+   }
+
+   if (rNorm > stopNorm && !warnedNotConverged_)
+   {
+      if (getRank(0) == 0)
+         printf("WARNING: implicit diffusion did not converge in %d iterations.\n"
+                "         residual %e, relative residual %e, tolerance %e\n",
+                iter, rNorm, rNorm/bNorm, tolerance_);
+      warnedNotConverged_ = true;
+   }
+
+   wo_array_ptr<double> dVm = dVm_managed.useOn(CPU);
+   #pragma omp parallel for
+   for (int ii=0; ii<nLocal_; ++ii)
+      dVm[ii] = y_[ii];
+}
+
+/** Ax = x - theta*dt*L x.  Fetches the remote part of x first. */
+void FGRDiffusionImplicit::applyA(const vector<double>& x, vector<double>& Ax)
+{
+   {
+      wo_array_ptr<double> xHalo = x_.writeonly(CPU);
+      #pragma omp parallel for
+      for (int ii=0; ii<nLocal_; ++ii)
+         xHalo[ii] = x[ii];
+   }
+   halo_.execute(x_, nLocal_);
+   stencil_.updateLocalVoltage(x_.readonly().slice(0, nLocal_));
+   stencil_.updateRemoteVoltage(x_.readonly().slice(nLocal_, nLocal_+nRemote_));
+   stencil_.calc(Lx_);
+
+   const double thetaDt = theta_*dt_;
+   ro_array_ptr<double> Lx = Lx_.readonly(CPU);
+   #pragma omp parallel for
+   for (int ii=0; ii<nLocal_; ++ii)
+      Ax[ii] = x[ii] - thetaDt*Lx[ii];
+}
+
+/** Global dot product over the local cells of all tasks. */
+double FGRDiffusionImplicit::dot(const double* a, const double* b) const
+{
+   double localSum = 0;
+   #pragma omp parallel for reduction(+:localSum)
+   for (int ii=0; ii<nLocal_; ++ii)
+      localSum += a[ii]*b[ii];
+   double sum;
+   MPI_Allreduce(&localSum, &sum, 1, MPI_DOUBLE, MPI_SUM, comm_);
+   return sum;
+}
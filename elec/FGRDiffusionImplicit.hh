@@ -0,0 +1,78 @@
+#ifndef FGRDIFFUSION_IMPLICIT_HH
+#define FGRDIFFUSION_IMPLICIT_HH
+
+#include <vector>
+#include "Diffusion.hh"
+#include "FGRDiffusionOMP.hh"
+#include "HaloExchange.hh"
+
+class CommTable;
+
+/** Theta-method diffusion over the FGR 19-point operator L:
+ *
+ *      (I - theta*dt*L) V' = (I + (1-theta)*dt*L) V
+ *
+ *  theta = 1 is backward Euler, theta = 0.5 is Crank-Nicolson.  The
+ *  system is solved for the rate y = (V' - V)/dt, i.e.,
+ *
+ *      (I - theta*dt*L) y = L V
+ *
+ *  with a matrix-free BiCGStab that applies L with FGRDiffusionOMP and
+ *  exchanges the halo of the vector L is applied to.  The operator
+ *  isn't symmetric for a rotated or heterogeneous conductivity, so
+ *  conjugate gradient isn't an option.  The solution of the previous
+ *  step is the initial guess.  The iteration stops when the residual
+ *  is below max(tolerance*|L V|, absTolerance); the absolute floor
+ *  keeps the tissue at rest (L V = 0) from running maxIterations.
+ *
+ *  calc() sets dVm = y so the forward Euler integrator in the omp loop
+ *  produces V' plus the reaction and stimulus contributions (first
+ *  order operator splitting).  With theta >= 0.5 dt is no longer
+ *  limited by the diffusion stability condition.
+ *
+ *  Only supports the omp simulation loop.
+ */
+class FGRDiffusionImplicit : public Diffusion
+{
+ public:
+   FGRDiffusionImplicit(
+      const FGRUtils::FGRDiffusionParms& parms,
+      const Anatomy& anatomy,
+      const std::vector<int>& sendMap,
+      const CommTable* commTable,
+      double dt, double theta,
+      double tolerance, double absTolerance, int maxIterations);
+
+   void updateLocalVoltage(ro_mgarray_ptr<double> VmLocal);
+   void updateRemoteVoltage(ro_mgarray_ptr<double> VmRemote);
+   void calc(rw_mgarray_ptr<double> dVm);
+   void setDiffusionScale(double newDiffusionScale);
+
+ private:
+   void applyA(const std::vector<double>& x, std::vector<double>& Ax);
+   double dot(const double* a, const double* b) const;
+
+   int                  nLocal_;
+   int                  nRemote_;
+   double               dt_;
+   double               theta_;
+   double               tolerance_;
+   double               absTolerance_;
+   int                  maxIterations_;
+   MPI_Comm             comm_;
+   FGRDiffusionOMP      stencil_;
+   HaloExchange<double> halo_;
+   bool                 warnedNotConverged_;
+   lazy_array<double>   x_;     // input of applyA, local + remote
+   lazy_array<double>   Lx_;
+   std::vector<double>  y_;
+   std::vector<double>  b_;
+   std::vector<double>  r_;
+   std::vector<double>  r0_;
+   std::vector<double>  p_;
+   std::vector<double>  v_;
+   std::vector<double>  s_;
+   std::vector<double>  t_;
+};
+
+#endif
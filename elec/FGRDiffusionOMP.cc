@@ -5,18 +5,29 @@
 #include "Vector.hh"
 #include <algorithm>
 #include <cstdio>
+#include <cmath>
+#include <mpi.h>
 #include "PerformanceTimers.hh"
+#include "mpiUtils.h"
 
 using namespace PerformanceTimers;
 using namespace std;
 using namespace FGRUtils;
 
 FGRDiffusionOMP::FGRDiffusionOMP(const FGRDiffusionParms& parms,
-                                 const Anatomy& anatomy)
+                                 const Anatomy& anatomy,
+                                 MPI_Comm comm)
 : Diffusion(parms.diffusionScale_),
   nLocal_(anatomy.nLocal()),
   nRemote_(anatomy.nRemote()),
-  localGrid_(DiffusionUtils::findBoundingBox(anatomy, parms.printBBox_))
+  localGrid_(DiffusionUtils::findBoundingBox(anatomy, parms.printBBox_)),
+  comm_(comm),
+  floatWeights_(parms.floatWeights_),
+  floatVm_(parms.floatWeights_ && parms.floatVm_),
+  useDouble_(false),
+  checkRate_(parms.floatWeights_ ? parms.precisionCheckRate_ : 0),
+  checkTolerance_(parms.precisionTolerance_),
+  nCalls_(0)
 {
 
    unsigned nx = localGrid_.nx();
@@ -68,7 +79,25 @@ FGRDiffusionOMP::FGRDiffusionOMP(const FGRDiffusionParms& parms,
    faceNbrOffset_[4] = offset_[ZZM];
    faceNbrOffset_[5] = offset_[ZZP];
 
-   precomputeCoefficients(anatomy);
+   precomputeCoefficients(anatomy, weight_, &A0_);
+
+   if (floatWeights_)
+   {
+      buildFloatWeights(anatomy);
+      if (checkRate_ > 0)
+      {
+         weightD_.resize(nx, ny, nz);
+         precomputeCoefficients(anatomy, weightD_, 0);
+      }
+      weight_ = Array3d<DiffWeight>();
+      A0_ = Array3d<double>();
+   }
+   if (floatVm_)
+   {
+      VmBlockF_.resize(nx, ny, nz, 0.0f);
+      if (checkRate_ == 0)
+         VmBlock_ = Array3d<double>();
+   }
 }
 
 
@@ -78,11 +107,20 @@ void FGRDiffusionOMP::updateLocalVoltage(ro_mgarray_ptr<double> VmLocal_managed)
 #pragma omp parallel
    {
       startTimer(FGR_ArrayLocal2MatrixTimer);
-      #pragma omp for
-      for (int ii=0; ii<nLocal_; ++ii)
+      if (floatVm_)
       {
-         int index = blockIndex_[ii];
-         VmBlock_(index) = VmLocal[ii];
+         #pragma omp for
+         for (int ii=0; ii<nLocal_; ++ii)
+            VmBlockF_(blockIndex_[ii]) = VmLocal[ii];
+      }
+      if (VmBlock_.size() > 0)
+      {
+         #pragma omp for
+         for (int ii=0; ii<nLocal_; ++ii)
+         {
+            int index = blockIndex_[ii];
+            VmBlock_(index) = VmLocal[ii];
+         }
       }
       stopTimer(FGR_ArrayLocal2MatrixTimer);
    }
@@ -95,11 +133,20 @@ void FGRDiffusionOMP::updateRemoteVoltage(ro_mgarray_ptr<double> VmRemote_manage
    {
       startTimer(FGR_ArrayRemote2MatrixTimer);
       unsigned* bb = &blockIndex_[nLocal_];
-      #pragma omp for
-      for (int ii=0; ii<nRemote_; ++ii)
+      if (floatVm_)
+      {
+         #pragma omp for
+         for (int ii=0; ii<nRemote_; ++ii)
+            VmBlockF_(bb[ii]) = VmRemote[ii];
+      }
+      if (VmBlock_.size() > 0)
       {
-         int index = bb[ii];
-         VmBlock_(index) = VmRemote[ii];
+         #pragma omp for
+         for (int ii=0; ii<nRemote_; ++ii)
+         {
+            int index = bb[ii];
+            VmBlock_(index) = VmRemote[ii];
+         }
       }
       stopTimer(FGR_ArrayRemote2MatrixTimer);
    }
@@ -110,6 +157,24 @@ void FGRDiffusionOMP::calc(rw_mgarray_ptr<double> dVm_managed)
 {
    rw_array_ptr<double> dVm = dVm_managed.useOn(CPU);
    int nCells = dVm.size();
+   if (!floatWeights_)
+   {
+      calcDefault(nCells, &dVm[0]);
+      return;
+   }
+   if (useDouble_)
+   {
+      calcDouble(nCells, &dVm[0]);
+      return;
+   }
+   calcMixed(nCells, &dVm[0]);
+   ++nCalls_;
+   if (checkRate_ > 0 && nCalls_ % checkRate_ == 0)
+      checkPrecision(nCells, &dVm[0]);
+}
+
+void FGRDiffusionOMP::calcDefault(int nCells, double* dVm)
+{
 #pragma omp parallel
    {// parallel section to contain timer start/stop
       startTimer(FGR_StencilTimer);
@@ -130,7 +195,108 @@ void FGRDiffusionOMP::calc(rw_mgarray_ptr<double> dVm_managed)
    } // parallel section
 }
 
+namespace
+{
+   template <class WT, class VT>
+   void differenceStencil(int nCells, const unsigned* blockIndex,
+                          const WT* weight, const VT* VmBlock,
+                          const int* offset, double scale, double* dVm)
+   {
+      # pragma omp for nowait
+      for (int iCell=0; iCell<nCells; ++iCell)
+      {
+         int ib = blockIndex[iCell];
+         const VT* phi = VmBlock + ib;
+         const auto* A = weight[ib].A;
+         double phi0 = phi[0];
+         double tmp = 0;
+         for (unsigned ii=1; ii<19; ++ii)
+            tmp += A[ii] * (phi[offset[ii]] - phi0);
+         dVm[iCell] = tmp*scale;
+      }
+   }
+}
+
+void FGRDiffusionOMP::calcMixed(int nCells, double* dVm)
+{
+#pragma omp parallel
+   {
+      startTimer(FGR_StencilTimer);
+      if (floatVm_)
+         differenceStencil(nCells, &blockIndex_[0], weightF_.cBlock(), VmBlockF_.cBlock(),
+                           offset_, diffusionScale_, dVm);
+      else
+         differenceStencil(nCells, &blockIndex_[0], weightF_.cBlock(), VmBlock_.cBlock(),
+                           offset_, diffusionScale_, dVm);
+      stopTimer(FGR_StencilTimer);
+   }
+}
+
+/** The double precision reference of the precision check. */
+void FGRDiffusionOMP::calcDouble(int nCells, double* dVm)
+{
+#pragma omp parallel
+   {
+      startTimer(FGR_StencilTimer);
+      differenceStencil(nCells, &blockIndex_[0], weightD_.cBlock(), VmBlock_.cBlock(),
+                        offset_, diffusionScale_, dVm);
+      stopTimer(FGR_StencilTimer);
+   }
+}
 
+/** Collective on comm_. */
+void FGRDiffusionOMP::checkPrecision(int nCells, double* dVm)
+{
+   dVmCheck_.resize(nCells);
+   if (nCells > 0)
+      calcDouble(nCells, &dVmCheck_[0]);
+   double local[2] = {0, 0}; // max error, max |dVm|
+   for (int ii=0; ii<nCells; ++ii)
+   {
+      local[0] = max(local[0], fabs(dVm[ii]-dVmCheck_[ii]));
+      local[1] = max(local[1], fabs(dVmCheck_[ii]));
+   }
+   double global[2];
+   MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_MAX, comm_);
+
+   bool fail = global[0] > checkTolerance_*global[1];
+   int myRank;
+   MPI_Comm_rank(comm_, &myRank);
+   if (myRank == 0)
+   {
+      printf("FGR precision check after %d steps: max |dVm error| = %e, max |dVm| = %e\n",
+             nCalls_, global[0], global[1]);
+      if (fail)
+         printf("FGR precision check: error exceeds precisionTolerance = %e"
+                " times max |dVm|.  Switching to double precision.\n", checkTolerance_);
+   }
+   if (!fail)
+      return;
+
+   for (int ii=0; ii<nCells; ++ii)
+      dVm[ii] = dVmCheck_[ii];
+   useDouble_ = true;
+   floatVm_ = false;
+   checkRate_ = 0;
+   weightF_ = Array3d<DiffWeightFloat>();
+   VmBlockF_ = Array3d<float>();
+   vector<double>().swap(dVmCheck_);
+}
+
+/** The float weights are rounded from the double weights.  The
+ *  diagonal weight isn't needed since the stencil is applied to the
+ *  differences from the center. */
+void FGRDiffusionOMP::buildFloatWeights(const Anatomy& anatomy)
+{
+   DiffWeightFloat zero = {{0}};
+   weightF_.resize(weight_.nx(), weight_.ny(), weight_.nz(), zero);
+   for (unsigned iCell=0; iCell<anatomy.nLocal(); ++iCell)
+   {
+      unsigned ib = blockIndex_[iCell];
+      for (unsigned ii=1; ii<19; ++ii)
+         weightF_(ib).A[ii] = weight_(ib).A[ii];
+   }
+}
 
 /** We're building the localTuple array only for local cells.  We can't
  * do stencil operations on remote particles so we shouldn't need
@@ -163,7 +329,13 @@ void FGRDiffusionOMP::buildBlockIndex(const Anatomy& anatomy)
    }
 }
 
-void FGRDiffusionOMP::precomputeCoefficients(const Anatomy& anatomy)
+/** Fills weight and, unless A0 is NULL, the diagonal weights A0.
+ *  Templated so the build precision weights accumulate in the build
+ *  precision and the double weights of the precision check in
+ *  double. */
+template <class W>
+void FGRDiffusionOMP::precomputeCoefficients(const Anatomy& anatomy, Array3d<W>& weight,
+                                             Array3d<double>* A0)
 {
    unsigned nx = localGrid_.nx();
    unsigned ny = localGrid_.ny();
@@ -187,9 +359,9 @@ void FGRDiffusionOMP::precomputeCoefficients(const Anatomy& anatomy)
       tissueBlk(ib) = isTissue(anatomy.cellType(ii));
    }
 
-   for (unsigned ii=0; ii<weight_.size(); ++ii)
+   for (unsigned ii=0; ii<weight.size(); ++ii)
       for (unsigned jj=0; jj<19; ++jj)
-         weight_(ii).A[jj] = 0.0;
+         weight(ii).A[jj] = 0.0;
 
    for (unsigned iCell=0; iCell<anatomy.nLocal(); ++iCell)
    {
@@ -209,13 +381,14 @@ void FGRDiffusionOMP::precomputeCoefficients(const Anatomy& anatomy)
          
          for (unsigned ii=0; ii<19; ++ii)
             for (unsigned jj=0; jj<3; ++jj)
-               weight_(ib).A[ii] += sigmaTimesS[jj] * gradPhi[jj][ii] * hInv[jj];
+               weight(ib).A[ii] += sigmaTimesS[jj] * gradPhi[jj][ii] * hInv[jj];
       }
-      double sum = weight_(ib).A[0];
+      double sum = weight(ib).A[0];
       for (unsigned ii=1; ii<19; ++ii)
       {
-         sum += weight_(ib).A[ii];
-         A0_(ib) -= weight_(ib).A[ii];
+         sum += weight(ib).A[ii];
+         if (A0 != 0)
+            (*A0)(ib) -= weight(ib).A[ii];
       }
       assert(abs(sum) < weightSumTolerance);
    }
@@ -1,6 +1,7 @@
 #ifndef FGRDIFFUSION_OMP_HH
 #define FGRDIFFUSION_OMP_HH
 
+#include <mpi.h>
 #include "Diffusion.hh"
 #include "LocalGrid.hh"
 #include "Array3d.hh"
@@ -10,12 +11,28 @@ class Anatomy;
 class Vector;
 class SymmetricTensor;
 
+/** By default the weights have the build precision (WeightType, see
+ *  FGRUtils.hh) and the stencil uses the diagonal weight A0.
+ *
+ *  With floatWeights the weights are stored as float and applied to
+ *  the differences phi[ii]-phi[0] so that a uniform Vm gives exactly
+ *  zero no matter how the weights are rounded.  floatVm also gathers
+ *  Vm into a float block.  Both roughly halve the memory traffic of
+ *  the stencil.  The sums are accumulated in double.
+ *
+ *  Only with a precisionCheckRate are double precision weights
+ *  (weightD_) and the double Vm block kept.  Every precisionCheckRate
+ *  calls dVm is compared with the double precision result.  The
+ *  largest difference over all tasks of comm is reported and if it
+ *  exceeds precisionTolerance times the largest |dVm| the diffusion
+ *  switches to the double precision weights. */
 class FGRDiffusionOMP : public Diffusion
 {
  public:
    FGRDiffusionOMP(
       const FGRUtils::FGRDiffusionParms& parms,
-      const Anatomy& anatomy);
+      const Anatomy& anatomy,
+      MPI_Comm comm);
    
    void updateLocalVoltage(ro_mgarray_ptr<double> VmLocal);
    void updateRemoteVoltage(ro_mgarray_ptr<double> VmRemote);
@@ -24,7 +41,14 @@ class FGRDiffusionOMP : public Diffusion
  private:
    void buildTupleArray(const Anatomy& anatomy);
    void buildBlockIndex(const Anatomy& anatomy);
-   void precomputeCoefficients(const Anatomy& anatomy);
+   template <class W>
+   void precomputeCoefficients(const Anatomy& anatomy, Array3d<W>& weight,
+                               Array3d<double>* A0);
+   void buildFloatWeights(const Anatomy& anatomy);
+   void calcDefault(int nCells, double* dVm);
+   void calcMixed(int nCells, double* dVm);
+   void calcDouble(int nCells, double* dVm);
+   void checkPrecision(int nCells, double* dVm);
 
    void mkTissueArray(const Array3d<int>& tissueBlk, int ib, int* tissue);
    Vector f1(int ib, int iFace, const Vector& h,
@@ -41,6 +65,18 @@ class FGRDiffusionOMP : public Diffusion
    Array3d<double>                 A0_;
    Array3d<FGRUtils::DiffWeight>   weight_;
    Array3d<double>                 VmBlock_;
+
+   MPI_Comm                        comm_;
+   bool                            floatWeights_;
+   bool                            floatVm_;
+   bool                            useDouble_;  // after a failed check
+   int                             checkRate_;
+   double                          checkTolerance_;
+   int                             nCalls_;
+   Array3d<FGRUtils::DiffWeightFloat> weightF_;
+   Array3d<float>                  VmBlockF_;
+   Array3d<FGRUtils::DiffWeightDouble> weightD_;
+   std::vector<double>             dVmCheck_;
 };
 
 #endif
@@ -0,0 +1,293 @@
+#include "FGRDiffusionSparse.hh"
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <set>
+#include "Anatomy.hh"
+#include "Vector.hh"
+#include "SymmetricTensor.hh"
+#include "PerformanceTimers.hh"
+
+using namespace PerformanceTimers;
+using namespace std;
+using namespace FGRUtils;
+
+namespace
+{
+   // x, y, z displacement of each NodeLocation.
+   const int nodeDelta[19][3] =
+   {
+      { 0, 0, 0}, {-1, 0, 0}, { 0,-1, 0}, { 1, 0, 0}, { 0, 1, 0},
+      { 0, 0,-1}, { 0, 0, 1}, {-1,-1, 0}, { 1,-1, 0}, { 1, 1, 0},
+      {-1, 1, 0}, {-1, 0,-1}, { 0,-1,-1}, { 1, 0,-1}, { 0, 1,-1},
+      {-1, 0, 1}, { 0,-1, 1}, { 1, 0, 1}, { 0, 1, 1}
+   };
+   // The face neighbors in the order FGRUtils::f2 expects.
+   const NodeLocation faceNbr[6] = {MZZ, ZMZ, PZZ, ZPZ, ZZM, ZZP};
+
+   const int B = FGRDiffusionSparse::brickSize;
+   const int V = FGRDiffusionSparse::brickVolume;
+   const int T = FGRDiffusionSparse::tileSize;
+
+   inline int siteIndex(int x, int y, int z) {return z + B*(y + B*x);}
+   inline int tileIndex(int x, int y, int z) {return z + T*(y + T*x);}
+   inline int slotIndex(int dx, int dy, int dz) {return (dz+1) + 3*((dy+1) + 3*(dx+1));}
+
+   /** out[s] = sum_ii W[ii][s] * phi(s + delta[ii]) for all sites of a
+    *  brick.  The sum starts with the center point, as in
+    *  FGRDiffusionOMP. */
+   void brickStencil(const double* W, const double* tile,
+                     const int* tileOffset, double* out)
+   {
+      for (int x=0; x<B; ++x)
+         for (int y=0; y<B; ++y)
+         {
+            const int s0 = siteIndex(x, y, 0);
+            const double* t0 = tile + tileIndex(x+1, y+1, 1);
+            for (int z=0; z<B; ++z)
+               out[s0+z] = W[s0+z] * t0[z+tileOffset[0]];
+            for (int ii=1; ii<19; ++ii)
+            {
+               const double* w = W + ii*V + s0;
+               const double* t = t0 + tileOffset[ii];
+               for (int z=0; z<B; ++z)
+                  out[s0+z] += w[z] * t[z];
+            }
+         }
+   }
+}
+
+FGRDiffusionSparse::FGRDiffusionSparse(const FGRDiffusionParms& parms,
+                                       const Anatomy& anatomy)
+: Diffusion(parms.diffusionScale_),
+  nLocal_(anatomy.nLocal()),
+  nRemote_(anatomy.nRemote())
+{
+   for (unsigned ii=0; ii<19; ++ii)
+      tileOffset_[ii] = tileIndex(nodeDelta[ii][0], nodeDelta[ii][1], nodeDelta[ii][2])
+         - tileIndex(0, 0, 0);
+
+   // Where each point of the tile comes from.  Tile coordinate 0 is
+   // the last site of the lower neighbor, T-1 the first site of the
+   // upper neighbor.
+   for (int x=0; x<T; ++x)
+      for (int y=0; y<T; ++y)
+         for (int z=0; z<T; ++z)
+         {
+            int t[3] = {x-1, y-1, z-1};
+            int d[3];
+            for (unsigned ii=0; ii<3; ++ii)
+            {
+               d[ii] = (t[ii] < 0) ? -1 : (t[ii] >= B ? 1 : 0);
+               t[ii] -= d[ii]*B;
+            }
+            tileSlot_[tileIndex(x, y, z)] = slotIndex(d[0], d[1], d[2]);
+            tileSite_[tileIndex(x, y, z)] = siteIndex(t[0], t[1], t[2]);
+         }
+
+   buildBricks(anatomy);
+   precomputeCoefficients(anatomy);
+}
+
+void FGRDiffusionSparse::updateLocalVoltage(ro_mgarray_ptr<double> VmLocal_managed)
+{
+   ro_array_ptr<double> VmLocal = VmLocal_managed.useOn(CPU);
+#pragma omp parallel
+   {
+      startTimer(FGR_ArrayLocal2MatrixTimer);
+      #pragma omp for
+      for (int ii=0; ii<nLocal_; ++ii)
+         VmBrick_[cellSite_[ii]] = VmLocal[ii];
+      stopTimer(FGR_ArrayLocal2MatrixTimer);
+   }
+}
+
+void FGRDiffusionSparse::updateRemoteVoltage(ro_mgarray_ptr<double> VmRemote_managed)
+{
+   ro_array_ptr<double> VmRemote = VmRemote_managed.useOn(CPU);
+#pragma omp parallel
+   {
+      startTimer(FGR_ArrayRemote2MatrixTimer);
+      const unsigned* ss = &cellSite_[nLocal_];
+      #pragma omp for
+      for (int ii=0; ii<nRemote_; ++ii)
+         VmBrick_[ss[ii]] = VmRemote[ii];
+      stopTimer(FGR_ArrayRemote2MatrixTimer);
+   }
+}
+
+void FGRDiffusionSparse::calc(rw_mgarray_ptr<double> dVm_managed)
+{
+   rw_array_ptr<double> dVm = dVm_managed.useOn(CPU);
+#pragma omp parallel
+   {
+      startTimer(FGR_StencilTimer);
+      double tile[tileVolume];
+      double out[brickVolume];
+      #pragma omp for nowait
+      for (int ib=0; ib<nComputeBricks_; ++ib)
+      {
+         loadTile(ib, tile);
+         brickStencil(&weight_[ib*19*V], tile, tileOffset_, out);
+         const int* cell = &siteLocal_[ib*V];
+         for (int ss=0; ss<V; ++ss)
+            if (cell[ss] >= 0)
+               dVm[cell[ss]] = out[ss]*diffusionScale_;
+      }
+      stopTimer(FGR_StencilTimer);
+   }
+}
+
+void FGRDiffusionSparse::loadTile(int iBrick, double* tile) const
+{
+   const int* nbr = &neighbor_[27*iBrick];
+   for (int tt=0; tt<tileVolume; ++tt)
+      tile[tt] = VmBrick_[nbr[tileSlot_[tt]]*V + tileSite_[tt]];
+}
+
+/** The compute bricks are numbered 1..nComputeBricks_ in the order of
+ *  their position in the grid, the bricks with only remote cells
+ *  follow. */
+void FGRDiffusionSparse::buildBricks(const Anatomy& anatomy)
+{
+   set<Tuple> localBricks;
+   set<Tuple> remoteBricks;
+   for (unsigned ii=0; ii<anatomy.size(); ++ii)
+   {
+      Tuple gg = anatomy.globalTuple(ii);
+      Tuple bb(gg.x()/B, gg.y()/B, gg.z()/B);
+      if (ii < anatomy.nLocal())
+         localBricks.insert(bb);
+      else
+         remoteBricks.insert(bb);
+   }
+   map<Tuple, int> brickNumber;
+   int nBricks = 0;
+   for (set<Tuple>::const_iterator iter=localBricks.begin(); iter!=localBricks.end(); ++iter)
+      brickNumber[*iter] = ++nBricks;
+   nComputeBricks_ = nBricks;
+   for (set<Tuple>::const_iterator iter=remoteBricks.begin(); iter!=remoteBricks.end(); ++iter)
+      if (brickNumber.count(*iter) == 0)
+         brickNumber[*iter] = ++nBricks;
+
+   cellSite_.resize(anatomy.size());
+   for (unsigned ii=0; ii<anatomy.size(); ++ii)
+   {
+      Tuple gg = anatomy.globalTuple(ii);
+      int brick = brickNumber[Tuple(gg.x()/B, gg.y()/B, gg.z()/B)];
+      cellSite_[ii] = brick*V + siteIndex(gg.x()%B, gg.y()%B, gg.z()%B);
+   }
+
+   neighbor_.assign(27*nComputeBricks_, 0);
+   for (map<Tuple, int>::const_iterator iter=brickNumber.begin(); iter!=brickNumber.end(); ++iter)
+   {
+      int ib = iter->second-1;
+      if (ib >= nComputeBricks_)
+         continue;
+      const Tuple& bb = iter->first;
+      for (int dx=-1; dx<2; ++dx)
+         for (int dy=-1; dy<2; ++dy)
+            for (int dz=-1; dz<2; ++dz)
+            {
+               map<Tuple, int>::const_iterator here =
+                  brickNumber.find(Tuple(bb.x()+dx, bb.y()+dy, bb.z()+dz));
+               if (here != brickNumber.end())
+                  neighbor_[27*ib + slotIndex(dx, dy, dz)] = here->second;
+            }
+   }
+
+   VmBrick_.assign((nBricks+1)*V, 0.0);
+   siteLocal_.assign(nComputeBricks_*V, -1);
+   for (int ii=0; ii<nLocal_; ++ii)
+      siteLocal_[cellSite_[ii]-V] = ii;
+}
+
+/** Returns the index of the cell displaced by (dx, dy, dz) from local
+ *  cell iCell or -1 if there is no such cell. */
+int FGRDiffusionSparse::neighborCell(const vector<int>& siteCell, unsigned iCell,
+                                     int dx, int dy, int dz) const
+{
+   int brick = cellSite_[iCell]/V;
+   int site = cellSite_[iCell]%V;
+   int pp[3] = {site/(B*B) + dx, (site/B)%B + dy, site%B + dz};
+   int d[3];
+   for (unsigned ii=0; ii<3; ++ii)
+   {
+      d[ii] = (pp[ii] < 0) ? -1 : (pp[ii] >= B ? 1 : 0);
+      pp[ii] -= d[ii]*B;
+   }
+   int nbr = neighbor_[27*(brick-1) + slotIndex(d[0], d[1], d[2])];
+   if (nbr == 0)
+      return -1;
+   return siteCell[nbr*V + siteIndex(pp[0], pp[1], pp[2])];
+}
+
+/** Same weights as FGRDiffusionOMP::precomputeCoefficients, but the
+ *  neighbors are found through the bricks instead of a block that
+ *  covers the bounding box. */
+void FGRDiffusionSparse::precomputeCoefficients(const Anatomy& anatomy)
+{
+   Vector hInv(1.0/anatomy.dx(), 1.0/anatomy.dy(), 1.0/anatomy.dz());
+   Vector h(anatomy.dx(), anatomy.dy(), anatomy.dz());
+   double gridCellVolume = h[0]*h[1]*h[2];
+
+   vector<int> siteCell(VmBrick_.size(), -1);
+   for (unsigned ii=0; ii<anatomy.size(); ++ii)
+      siteCell[cellSite_[ii]] = ii;
+
+   weight_.assign(nComputeBricks_*19*V, 0.0);
+   for (int iCell=0; iCell<nLocal_; ++iCell)
+   {
+      int nbrCell[19];
+      int tissue[19];
+      for (unsigned ii=0; ii<19; ++ii)
+      {
+         nbrCell[ii] = neighborCell(siteCell, iCell,
+                                    nodeDelta[ii][0], nodeDelta[ii][1], nodeDelta[ii][2]);
+         tissue[ii] = (nbrCell[ii] < 0) ? 0 : isTissue(anatomy.cellType(nbrCell[ii]));
+      }
+
+      double A[19] = {0};
+      for (unsigned iFace=0; iFace<6; ++iFace)
+      {
+         if (tissue[faceNbr[iFace]] == 0)
+            continue;
+
+         SymmetricTensor sigma = (anatomy.conductivity(iCell) +
+                                  anatomy.conductivity(nbrCell[faceNbr[iFace]])) / 2.0;
+         Vector S(0, 0, 0);
+         switch (iFace)
+         {
+           case 0: S[0] = -h[1]*h[2]; break;
+           case 1: S[1] = -h[0]*h[2]; break;
+           case 2: S[0] =  h[1]*h[2]; break;
+           case 3: S[1] =  h[0]*h[2]; break;
+           case 4: S[2] = -h[0]*h[1]; break;
+           case 5: S[2] =  h[0]*h[1]; break;
+         }
+         Vector sigmaTimesS = (sigma * S)/gridCellVolume;
+         double gradPhi[3][19] = {0};
+         f2(iFace, tissue, gradPhi);
+
+         for (unsigned ii=0; ii<19; ++ii)
+            for (unsigned jj=0; jj<3; ++jj)
+               A[ii] += sigmaTimesS[jj] * gradPhi[jj][ii] * hInv[jj];
+      }
+
+      double sum = A[0];
+      double A0 = 0;
+      for (unsigned ii=1; ii<19; ++ii)
+      {
+         sum += A[ii];
+         A0 -= A[ii];
+      }
+      assert(abs(sum) < weightSumTolerance);
+
+      int brick = cellSite_[iCell]/V - 1;
+      int site = cellSite_[iCell]%V;
+      double* W = &weight_[brick*19*V];
+      W[site] = A0;
+      for (unsigned ii=1; ii<19; ++ii)
+         W[ii*V + site] = A[ii];
+   }
+}
@@ -0,0 +1,67 @@
+#ifndef FGRDIFFUSION_SPARSE_HH
+#define FGRDIFFUSION_SPARSE_HH
+
+#include <vector>
+#include "Diffusion.hh"
+#include "FGRUtils.hh"
+
+class Anatomy;
+
+/** The same stencil as FGRDiffusionOMP, but instead of blocks that
+ *  cover the whole bounding box of the local and remote cells Vm and
+ *  the weights are stored in bricks of 4x4x4 grid points.  Only bricks
+ *  that contain a local or remote cell exist, so for thin walled
+ *  anatomies most of the bounding box costs nothing.
+ *
+ *  Bricks are aligned to the global grid.  Brick 0 is all zero and
+ *  stands in for every missing neighbor brick.  For each brick that
+ *  contains local cells (the compute bricks) we keep the indices of
+ *  its 27 neighbor bricks (itself included).  To apply the stencil
+ *  the brick and a one point halo are copied from the neighbors into a
+ *  6x6x6 tile and the 19 point stencil is applied to the tile with the
+ *  innermost loop running along z.  The weights of a compute brick are
+ *  stored point by point ([stencil point][site]) so that loop is unit
+ *  stride.
+ *
+ *  Only for the omp loop.  The weights are kept in double precision
+ *  while variant omp stores them as WeightType, which is float in the
+ *  default build (Diff_Weight_Type_Single).  The results therefore
+ *  agree with variant omp only to about single precision.
+ */
+class FGRDiffusionSparse : public Diffusion
+{
+ public:
+   FGRDiffusionSparse(
+      const FGRUtils::FGRDiffusionParms& parms,
+      const Anatomy& anatomy);
+
+   void updateLocalVoltage(ro_mgarray_ptr<double> VmLocal);
+   void updateRemoteVoltage(ro_mgarray_ptr<double> VmRemote);
+   void calc(rw_mgarray_ptr<double> dVm);
+
+   enum {brickSize = 4,
+         brickVolume = brickSize*brickSize*brickSize,
+         tileSize = brickSize+2,
+         tileVolume = tileSize*tileSize*tileSize};
+
+ private:
+   void buildBricks(const Anatomy& anatomy);
+   void precomputeCoefficients(const Anatomy& anatomy);
+   int neighborCell(const std::vector<int>& siteCell,
+                    unsigned iCell, int dx, int dy, int dz) const;
+   void loadTile(int iBrick, double* tile) const;
+
+   int                   nLocal_;
+   int                   nRemote_;
+   int                   nComputeBricks_;
+   int                   tileOffset_[19];
+   int                   tileSlot_[tileVolume];
+   int                   tileSite_[tileVolume];
+   std::vector<unsigned> cellSite_;  // for local and remote cells
+   std::vector<int>      neighbor_;  // 27 per compute brick
+   std::vector<int>      siteLocal_; // brickVolume per compute brick
+   std::vector<double>   weight_;    // 19*brickVolume per compute brick
+   std::vector<double>   VmBrick_;   // brickVolume per brick, brick 0 included
+};
+
+#endif
@@ -25,12 +25,27 @@ namespace FGRUtils
    {
       bool   printBBox_;
       double diffusionScale_;
+      // mixed precision options.  Only FGRDiffusionOMP uses these.
+      bool   floatWeights_;
+      bool   floatVm_;
+      int    precisionCheckRate_;
+      double precisionTolerance_;
    };
    
    struct DiffWeight
    {
       WeightType A[19];
    };
+
+   struct DiffWeightFloat
+   {
+      float A[19];
+   };
+
+   struct DiffWeightDouble
+   {
+      double A[19];
+   };
    
 
    void setGradientWeights(double* grad, int* tissue,
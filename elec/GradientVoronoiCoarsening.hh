@@ -141,6 +141,7 @@ class GradientVoronoiCoarsening : public Sensor
    
    void eval(double time, int loop);
    void print(double time, int loop);
+   bool canMigrate() const {return eval_count_ == 0;}
 };
 
 #endif
@@ -2409,7 +2409,7 @@ void ThisReaction::calc(double _dt,
       store(state_[__jj].xtf, xtf);
       store(state_[__jj].ykur, ykur);
       store(state_[__jj].ytf, ytf);
-      simdops::store(&__dVm.raw()[__ii],-Iion);
+      simdops::store_partial(&__dVm.raw()[__ii],-Iion,nCells_-__ii);
    }
 }
 #endif //USE_CUDA
@@ -2794,6 +2794,107 @@ double ThisReaction::getValue(int iCell, int varHandle) const
    return NAN;
 }
 
+void ThisReaction::getColumn(int varHandle, int begin, int end, double* value) const
+{
+#ifdef USE_CUDA
+   auto stateData = stateTransport_.readonly(CPU);
+#endif //USE_CUDA
+
+#define COPY_COLUMN(state) for (int __ii=begin; __ii<end; __ii++) { value[__ii-begin] = READ_STATE(state,__ii); }
+   if (0) {}
+   else if (varHandle == CaM_handle) { COPY_COLUMN(CaM); }
+   else if (varHandle == Cai_handle) { COPY_COLUMN(Cai); }
+   else if (varHandle == Caj_handle) { COPY_COLUMN(Caj); }
+   else if (varHandle == Casl_handle) { COPY_COLUMN(Casl); }
+   else if (varHandle == Casr_handle) { COPY_COLUMN(Casr); }
+   else if (varHandle == Ki_handle) { COPY_COLUMN(Ki); }
+   else if (varHandle == Myc_handle) { COPY_COLUMN(Myc); }
+   else if (varHandle == Mym_handle) { COPY_COLUMN(Mym); }
+   else if (varHandle == NaBj_handle) { COPY_COLUMN(NaBj); }
+   else if (varHandle == NaBsl_handle) { COPY_COLUMN(NaBsl); }
+   else if (varHandle == Nai_handle) { COPY_COLUMN(Nai); }
+   else if (varHandle == Naj_handle) { COPY_COLUMN(Naj); }
+   else if (varHandle == Nasl_handle) { COPY_COLUMN(Nasl); }
+   else if (varHandle == RyRi_handle) { COPY_COLUMN(RyRi); }
+   else if (varHandle == RyRo_handle) { COPY_COLUMN(RyRo); }
+   else if (varHandle == RyRr_handle) { COPY_COLUMN(RyRr); }
+   else if (varHandle == SLHj_handle) { COPY_COLUMN(SLHj); }
+   else if (varHandle == SLHsl_handle) { COPY_COLUMN(SLHsl); }
+   else if (varHandle == SLLj_handle) { COPY_COLUMN(SLLj); }
+   else if (varHandle == SLLsl_handle) { COPY_COLUMN(SLLsl); }
+   else if (varHandle == SRB_handle) { COPY_COLUMN(SRB); }
+   else if (varHandle == TnCHc_handle) { COPY_COLUMN(TnCHc); }
+   else if (varHandle == TnCHm_handle) { COPY_COLUMN(TnCHm); }
+   else if (varHandle == TnCL_handle) { COPY_COLUMN(TnCL); }
+   else if (varHandle == d_handle) { COPY_COLUMN(d); }
+   else if (varHandle == f_handle) { COPY_COLUMN(f); }
+   else if (varHandle == fcaBj_handle) { COPY_COLUMN(fcaBj); }
+   else if (varHandle == fcaBsl_handle) { COPY_COLUMN(fcaBsl); }
+   else if (varHandle == h_handle) { COPY_COLUMN(h); }
+   else if (varHandle == hL_handle) { COPY_COLUMN(hL); }
+   else if (varHandle == j_handle) { COPY_COLUMN(j); }
+   else if (varHandle == m_handle) { COPY_COLUMN(m); }
+   else if (varHandle == mL_handle) { COPY_COLUMN(mL); }
+   else if (varHandle == xkr_handle) { COPY_COLUMN(xkr); }
+   else if (varHandle == xks_handle) { COPY_COLUMN(xks); }
+   else if (varHandle == xkur_handle) { COPY_COLUMN(xkur); }
+   else if (varHandle == xtf_handle) { COPY_COLUMN(xtf); }
+   else if (varHandle == ykur_handle) { COPY_COLUMN(ykur); }
+   else if (varHandle == ytf_handle) { COPY_COLUMN(ytf); }
+   else { Reaction::getColumn(varHandle, begin, end, value); }
+#undef COPY_COLUMN
+}
+
+void ThisReaction::setColumn(int varHandle, int begin, int end, const double* value)
+{
+#ifdef USE_CUDA
+   auto stateData = stateTransport_.readwrite(CPU);
+#endif //USE_CUDA
+
+#define COPY_COLUMN(state) for (int __ii=begin; __ii<end; __ii++) { READ_STATE(state,__ii) = value[__ii-begin]; }
+   if (0) {}
+   else if (varHandle == CaM_handle) { COPY_COLUMN(CaM); }
+   else if (varHandle == Cai_handle) { COPY_COLUMN(Cai); }
+   else if (varHandle == Caj_handle) { COPY_COLUMN(Caj); }
+   else if (varHandle == Casl_handle) { COPY_COLUMN(Casl); }
+   else if (varHandle == Casr_handle) { COPY_COLUMN(Casr); }
+   else if (varHandle == Ki_handle) { COPY_COLUMN(Ki); }
+   else if (varHandle == Myc_handle) { COPY_COLUMN(Myc); }
+   else if (varHandle == Mym_handle) { COPY_COLUMN(Mym); }
+   else if (varHandle == NaBj_handle) { COPY_COLUMN(NaBj); }
+   else if (varHandle == NaBsl_handle) { COPY_COLUMN(NaBsl); }
+   else if (varHandle == Nai_handle) { COPY_COLUMN(Nai); }
+   else if (varHandle == Naj_handle) { COPY_COLUMN(Naj); }
+   else if (varHandle == Nasl_handle) { COPY_COLUMN(Nasl); }
+   else if (varHandle == RyRi_handle) { COPY_COLUMN(RyRi); }
+   else if (varHandle == RyRo_handle) { COPY_COLUMN(RyRo); }
+   else if (varHandle == RyRr_handle) { COPY_COLUMN(RyRr); }
+   else if (varHandle == SLHj_handle) { COPY_COLUMN(SLHj); }
+   else if (varHandle == SLHsl_handle) { COPY_COLUMN(SLHsl); }
+   else if (varHandle == SLLj_handle) { COPY_COLUMN(SLLj); }
+   else if (varHandle == SLLsl_handle) { COPY_COLUMN(SLLsl); }
+   else if (varHandle == SRB_handle) { COPY_COLUMN(SRB); }
+   else if (varHandle == TnCHc_handle) { COPY_COLUMN(TnCHc); }
+   else if (varHandle == TnCHm_handle) { COPY_COLUMN(TnCHm); }
+   else if (varHandle == TnCL_handle) { COPY_COLUMN(TnCL); }
+   else if (varHandle == d_handle) { COPY_COLUMN(d); }
+   else if (varHandle == f_handle) { COPY_COLUMN(f); }
+   else if (varHandle == fcaBj_handle) { COPY_COLUMN(fcaBj); }
+   else if (varHandle == fcaBsl_handle) { COPY_COLUMN(fcaBsl); }
+   else if (varHandle == h_handle) { COPY_COLUMN(h); }
+   else if (varHandle == hL_handle) { COPY_COLUMN(hL); }
+   else if (varHandle == j_handle) { COPY_COLUMN(j); }
+   else if (varHandle == m_handle) { COPY_COLUMN(m); }
+   else if (varHandle == mL_handle) { COPY_COLUMN(mL); }
+   else if (varHandle == xkr_handle) { COPY_COLUMN(xkr); }
+   else if (varHandle == xks_handle) { COPY_COLUMN(xks); }
+   else if (varHandle == xkur_handle) { COPY_COLUMN(xkur); }
+   else if (varHandle == xtf_handle) { COPY_COLUMN(xtf); }
+   else if (varHandle == ykur_handle) { COPY_COLUMN(ykur); }
+   else if (varHandle == ytf_handle) { COPY_COLUMN(ytf); }
+#undef COPY_COLUMN
+}
+
 double ThisReaction::getValue(int iCell, int varHandle, double V) const
 {
 #ifdef USE_CUDA
@@ -83,6 +83,8 @@ namespace Grandi
       virtual void setValue(int iCell, int varHandle, double value);
       virtual double getValue(int iCell, int varHandle) const;
       virtual double getValue(int iCell, int varHandle, double V) const;
+      virtual void getColumn(int varHandle, int begin, int end, double* value) const;
+      virtual void setColumn(int varHandle, int begin, int end, const double* value);
       virtual const std::string getUnit(const std::string& varName) const;
 
     private:
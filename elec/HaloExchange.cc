@@ -0,0 +1,84 @@
+#include "HaloExchange.hh"
+
+using namespace std;
+
+namespace
+{
+   HaloExchangeMethod g_haloExchangeMethod = haloIsend;
+}
+
+void setHaloExchangeMethod(HaloExchangeMethod method)
+{
+   g_haloExchangeMethod = method;
+}
+
+HaloExchangeMethod haloExchangeMethod()
+{
+   return g_haloExchangeMethod;
+}
+
+bool haloExchangeMethodFromName(const string& name, HaloExchangeMethod& method)
+{
+   if (name == "isend")
+      method = haloIsend;
+   else if (name == "persistent")
+      method = haloPersistent;
+   else if (name == "neighbor")
+      method = haloNeighbor;
+   else if (name == "rma")
+      method = haloRma;
+   else if (name == "shm")
+      method = haloShm;
+   else
+      return false;
+   return true;
+}
+
+/** Every task tells each of the tasks it receives from where that
+ *  task's data starts in its receive buffer.  This is the information
+ *  the SPI build gets from CommTable::_putOffset. */
+void exchangePutOffsets(const CommTable* comm,
+                        vector<int>& putOffset,
+                        vector<int>& targetRecvSize)
+{
+   const int tag = 151517;
+   const vector<int>& sendTask = comm->_sendTask;
+   const vector<int>& recvTask = comm->_recvTask;
+   vector<int> sendInfo(2*recvTask.size()+1);
+   vector<int> recvInfo(2*sendTask.size()+1);
+   vector<MPI_Request> request(sendTask.size()+recvTask.size()+1);
+   for (unsigned ii=0; ii<sendTask.size(); ++ii)
+      MPI_Irecv(&recvInfo[2*ii], 2, MPI_INT, sendTask[ii], tag, comm->_comm, &request[ii]);
+   for (unsigned ii=0; ii<recvTask.size(); ++ii)
+   {
+      sendInfo[2*ii] = comm->_recvOffset[ii];
+      sendInfo[2*ii+1] = comm->recvSize();
+      MPI_Isend(&sendInfo[2*ii], 2, MPI_INT, recvTask[ii], tag, comm->_comm,
+                &request[sendTask.size()+ii]);
+   }
+   MPI_Waitall(sendTask.size()+recvTask.size(), &request[0], MPI_STATUSES_IGNORE);
+
+   putOffset.resize(sendTask.size());
+   targetRecvSize.resize(sendTask.size());
+   for (unsigned ii=0; ii<sendTask.size(); ++ii)
+   {
+      putOffset[ii] = recvInfo[2*ii];
+      targetRecvSize[ii] = recvInfo[2*ii+1];
+   }
+}
+
+void exchangeSendOffsets(const CommTable* comm, vector<int>& sourceOffset)
+{
+   const int tag = 151518;
+   const vector<int>& sendTask = comm->_sendTask;
+   const vector<int>& recvTask = comm->_recvTask;
+   sourceOffset.resize(recvTask.size()+1);
+   vector<MPI_Request> request(sendTask.size()+recvTask.size()+1);
+   for (unsigned ii=0; ii<recvTask.size(); ++ii)
+      MPI_Irecv(&sourceOffset[ii], 1, MPI_INT, recvTask[ii], tag, comm->_comm, &request[ii]);
+   for (unsigned ii=0; ii<sendTask.size(); ++ii)
+      MPI_Isend(&comm->_sendOffset[ii], 1, MPI_INT, sendTask[ii], tag, comm->_comm,
+                &request[recvTask.size()+ii]);
+   MPI_Waitall(sendTask.size()+recvTask.size(), &request[0], MPI_STATUSES_IGNORE);
+   sourceOffset.resize(recvTask.size());
+}
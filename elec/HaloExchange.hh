@@ -1,8 +1,14 @@
 #ifndef HALO_EXCHANGE_HH
 #define HALO_EXCHANGE_HH
 
+#include <algorithm>
 #include <vector>
+#include <string>
 #include <cassert>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <thread>
 #include "CommTable.hh"
 #include <iostream>
 #include "PerformanceTimers.hh"
@@ -32,6 +38,58 @@
  *  exchange. 
  */
 
+/** Backends of the MPI HaloExchange.  Every HaloExchange uses the
+ *  method that is current when it is constructed.
+ *
+ *  - isend:      MPI_Irecv/MPI_Isend posted every exchange.
+ *  - persistent: MPI_Recv_init/MPI_Send_init once, MPI_Startall every
+ *                exchange.
+ *  - neighbor:   MPI_Ineighbor_alltoallv over a distributed graph
+ *                communicator built from the CommTable.
+ *  - rma:        MPI_Put into a double buffered window with
+ *                post/start/complete/wait synchronization among
+ *                neighbors only.  Like the SPI version the two
+ *                halves alternate, so the data of one exchange is not
+ *                overwritten by the next one.
+ *  - shm:        Tasks on the same node publish their send buffer in an
+ *                MPI_Win_allocate_shared segment and bump an epoch
+ *                counter.  On-node receivers spin on the counter and
+ *                copy their part straight out of the neighbor's
+ *                segment, so no MPI message is involved.  Off-node
+ *                neighbors use isend.
+ *
+ *  The SPI build ignores the method. */
+enum HaloExchangeMethod {haloIsend, haloPersistent, haloNeighbor, haloRma, haloShm};
+
+void setHaloExchangeMethod(HaloExchangeMethod method);
+HaloExchangeMethod haloExchangeMethod();
+/** Returns false if name is not a known method. */
+bool haloExchangeMethodFromName(const std::string& name, HaloExchangeMethod& method);
+
+/** For each send task, the offset (in items) of our data in the
+ *  receive buffer of that task, and the total receive size of that
+ *  task.  Collective over the neighbors in comm. */
+void exchangePutOffsets(const CommTable* comm,
+                        std::vector<int>& putOffset,
+                        std::vector<int>& targetRecvSize);
+
+/** For each recv task, the offset (in items) of our data in the send
+ *  buffer of that task.  Collective over the neighbors in comm. */
+void exchangeSendOffsets(const CommTable* comm, std::vector<int>& sourceOffset);
+
+/** Start of the shared segment of each task in the shm method.  The
+ *  counters live on separate cache lines.  epoch is the number of the
+ *  last exchange whose data the owner published, consumed the number
+ *  of the last exchange the owner has copied from all its on-node
+ *  sources. */
+struct HaloShmHeader
+{
+   std::atomic<long long> epoch;
+   char pad0[64-sizeof(std::atomic<long long>)];
+   std::atomic<long long> consumed;
+   char pad1[64-sizeof(std::atomic<long long>)];
+};
+
 template <class T>
 class HaloExchangeBase
 {
@@ -188,50 +246,130 @@ class HaloExchange : public HaloExchangeBase<T>
 
    HaloExchange(const std::vector<int>& sendMap, const CommTable* comm) 
    : HaloExchangeBase<T>(sendMap,comm),
-     recvReq_(comm->recvSize()),
-     sendReq_(comm->sendSize())
+     method_(haloExchangeMethod()),
+     // one request per neighbor task.  Never empty: MPI rejects a
+     // NULL request array even for 0 requests, and the neighbor method
+     // always needs one
+     recvReq_(std::max<size_t>(comm->_recvTask.size(), 1)),
+     sendReq_(std::max<size_t>(comm->_sendTask.size(), 1)),
+     bw_(0)
+   {
+      if (method_ == haloRma)
+         recvBuf_.resize(2*comm->recvSize());
+      else
+         recvBuf_.resize(comm->recvSize());
+      switch (method_)
+      {
+        case haloIsend:
+         break;
+        case haloPersistent:
+         initPersistent();
+         break;
+        case haloNeighbor:
+         initNeighbor();
+         break;
+        case haloRma:
+         initRma();
+         break;
+        case haloShm:
+         initShm();
+         break;
+      }
+   }
+
+   ~HaloExchange()
    {
-      recvBuf_.resize(comm->recvSize());
+      // Can't free MPI objects after MPI_Finalize.
+      int finalized;
+      MPI_Finalized(&finalized);
+      if (finalized)
+         return;
+      if (method_ == haloPersistent)
+         freePersistent();
+      if (method_ == haloNeighbor)
+         MPI_Comm_free(&graphComm_);
+      if (method_ == haloRma)
+      {
+         MPI_Win_free(&window_);
+         MPI_Group_free(&originGroup_);
+         MPI_Group_free(&targetGroup_);
+      }
+      if (method_ == haloShm)
+      {
+         MPI_Win_free(&window_);
+         MPI_Comm_free(&nodeComm_);
+      }
    }
    
    virtual void startComm()
    {
+      if (method_ == haloShm)
+         spinShmTargets();
 #pragma omp critical 
       {
-         const char* sendBuf = (const char*)sendBuf_.readonly(CPU).raw();
-         char* recvBuf = (char*)recvBuf_.writeonly(CPU).raw();
-
-         MPI_Request* recvReq = &recvReq_[0];
-         const int tag = 151515;
-         for (unsigned ii=0; ii< commTable_->_recvTask.size(); ++ii)
-         {
-            assert(recvBuf);
-            unsigned sender = commTable_->_recvTask[ii];
-            unsigned nItems = commTable_->_recvOffset[ii+1] - commTable_->_recvOffset[ii];
-            unsigned len = nItems * width_;
-            char* recvPtr = recvBuf + commTable_->_recvOffset[ii]*width_;
-            MPI_Irecv(recvPtr, len, MPI_CHAR, sender, tag, commTable_->_comm, recvReq+ii);
-         }
- 
-         MPI_Request* sendReq = &sendReq_[0];
-         for (unsigned ii=0; ii<commTable_->_sendTask.size(); ++ii)
+         switch (method_)
          {
-            assert(sendBuf);
-            unsigned target = commTable_->_sendTask[ii];
-            unsigned nItems = commTable_->_sendOffset[ii+1] - commTable_->_sendOffset[ii];
-            unsigned len = nItems * width_;
-            const char* sendPtr = sendBuf + commTable_->_sendOffset[ii]*width_;
-            MPI_Isend(sendPtr, len, MPI_CHAR, target, tag, commTable_->_comm, sendReq+ii);
+           case haloIsend:
+            startIsend();
+            break;
+           case haloPersistent:
+            {
+               // the requests are bound to the buffer addresses.  Bind
+               // them again if a buffer moved.
+               const char* sendBuf = (const char*)sendBuf_.readonly(CPU).raw();
+               char* recvBuf = (char*)recvBuf_.writeonly(CPU).raw();
+               if (sendBuf != sendPtr_ || recvBuf != recvPtr_)
+               {
+                  freePersistent();
+                  initPersistent();
+               }
+            }
+            MPI_Startall(commTable_->_recvTask.size(), &recvReq_[0]);
+            MPI_Startall(commTable_->_sendTask.size(), &sendReq_[0]);
+            break;
+           case haloNeighbor:
+            {
+               const char* sendBuf = (const char*)sendBuf_.readonly(CPU).raw();
+               char* recvBuf = (char*)recvBuf_.writeonly(CPU).raw();
+               MPI_Ineighbor_alltoallv(sendBuf, &sendCount_[0], &sendDispl_[0], MPI_BYTE,
+                                       recvBuf, &recvCount_[0], &recvDispl_[0], MPI_BYTE,
+                                       graphComm_, &recvReq_[0]);
+            }
+            break;
+           case haloRma:
+            startRma();
+            break;
+           case haloShm:
+            startShm();
+            break;
          }
       }
    };
    
    virtual void wait()
    {
+      if (method_ == haloShm)
+         spinShmSources();
 #pragma omp critical              
       {                                            
-         MPI_Waitall(commTable_->_sendTask.size(), &sendReq_[0], MPI_STATUS_IGNORE);
-         MPI_Waitall(commTable_->_recvTask.size(), &recvReq_[0], MPI_STATUS_IGNORE);
+         switch (method_)
+         {
+           case haloIsend:
+           case haloPersistent:
+            MPI_Waitall(commTable_->_sendTask.size(), &sendReq_[0], MPI_STATUS_IGNORE);
+            MPI_Waitall(commTable_->_recvTask.size(), &recvReq_[0], MPI_STATUS_IGNORE);
+            break;
+           case haloNeighbor:
+            MPI_Wait(&recvReq_[0], MPI_STATUS_IGNORE);
+            break;
+           case haloRma:
+            MPI_Win_complete(window_);
+            MPI_Win_wait(window_);
+            break;
+           case haloShm:
+            waitShm();
+            break;
+         }
       }
    };
 
@@ -242,13 +380,318 @@ class HaloExchange : public HaloExchangeBase<T>
    
    virtual ro_mgarray_ptr<T> getRecvBuf()
    {
+      if (method_ == haloRma)
+      {
+         ro_mgarray_ptr<T> recvBuf = recvBuf_;
+         return recvBuf.slice(this->recvSize()*bw_, this->recvSize()*(bw_+1));
+      }
       return recvBuf_;
    }
    
  private:
+   void startIsend()
+   {
+      const char* sendBuf = (const char*)sendBuf_.readonly(CPU).raw();
+      char* recvBuf = (char*)recvBuf_.writeonly(CPU).raw();
+
+      MPI_Request* recvReq = &recvReq_[0];
+      const int tag = 151515;
+      for (unsigned ii=0; ii< commTable_->_recvTask.size(); ++ii)
+      {
+         if (!recvShm_.empty() && recvShm_[ii])
+         {
+            recvReq[ii] = MPI_REQUEST_NULL;
+            continue;
+         }
+         assert(recvBuf);
+         unsigned sender = commTable_->_recvTask[ii];
+         unsigned nItems = commTable_->_recvOffset[ii+1] - commTable_->_recvOffset[ii];
+         unsigned len = nItems * width_;
+         char* recvPtr = recvBuf + commTable_->_recvOffset[ii]*width_;
+         MPI_Irecv(recvPtr, len, MPI_CHAR, sender, tag, commTable_->_comm, recvReq+ii);
+      }
+ 
+      MPI_Request* sendReq = &sendReq_[0];
+      for (unsigned ii=0; ii<commTable_->_sendTask.size(); ++ii)
+      {
+         if (!sendShm_.empty() && sendShm_[ii])
+         {
+            sendReq[ii] = MPI_REQUEST_NULL;
+            continue;
+         }
+         assert(sendBuf);
+         unsigned target = commTable_->_sendTask[ii];
+         unsigned nItems = commTable_->_sendOffset[ii+1] - commTable_->_sendOffset[ii];
+         unsigned len = nItems * width_;
+         const char* sendPtr = sendBuf + commTable_->_sendOffset[ii]*width_;
+         MPI_Isend(sendPtr, len, MPI_CHAR, target, tag, commTable_->_comm, sendReq+ii);
+      }
+   }
+
+   /** The requests are bound to the CPU buffers of sendBuf_ and
+    *  recvBuf_.  startComm calls this again if either buffer moved. */
+   void initPersistent()
+   {
+      sendPtr_ = (const char*)sendBuf_.readonly(CPU).raw();
+      recvPtr_ = (char*)recvBuf_.writeonly(CPU).raw();
+      const int tag = 151516;
+      for (unsigned ii=0; ii<commTable_->_recvTask.size(); ++ii)
+      {
+         unsigned nItems = commTable_->_recvOffset[ii+1] - commTable_->_recvOffset[ii];
+         MPI_Recv_init(recvPtr_ + commTable_->_recvOffset[ii]*width_, nItems*width_, MPI_BYTE,
+                       commTable_->_recvTask[ii], tag, commTable_->_comm, &recvReq_[ii]);
+      }
+      for (unsigned ii=0; ii<commTable_->_sendTask.size(); ++ii)
+      {
+         unsigned nItems = commTable_->_sendOffset[ii+1] - commTable_->_sendOffset[ii];
+         MPI_Send_init(sendPtr_ + commTable_->_sendOffset[ii]*width_, nItems*width_, MPI_BYTE,
+                       commTable_->_sendTask[ii], tag, commTable_->_comm, &sendReq_[ii]);
+      }
+   }
+
+   void freePersistent()
+   {
+      for (unsigned ii=0; ii<commTable_->_recvTask.size(); ++ii)
+         MPI_Request_free(&recvReq_[ii]);
+      for (unsigned ii=0; ii<commTable_->_sendTask.size(); ++ii)
+         MPI_Request_free(&sendReq_[ii]);
+   }
+
+   /** Sources are ordered like _recvTask and destinations like
+    *  _sendTask so the counts map directly onto the CommTable
+    *  offsets.  Collective over commTable_->_comm. */
+   void initNeighbor()
+   {
+      const std::vector<int>& recvTask = commTable_->_recvTask;
+      const std::vector<int>& sendTask = commTable_->_sendTask;
+      const int none = 0;
+      MPI_Dist_graph_create_adjacent(commTable_->_comm,
+                                     recvTask.size(), recvTask.empty() ? &none : &recvTask[0], MPI_UNWEIGHTED,
+                                     sendTask.size(), sendTask.empty() ? &none : &sendTask[0], MPI_UNWEIGHTED,
+                                     MPI_INFO_NULL, 0, &graphComm_);
+      recvCount_.resize(recvTask.size()+1);
+      recvDispl_.resize(recvTask.size()+1);
+      for (unsigned ii=0; ii<recvTask.size(); ++ii)
+      {
+         recvCount_[ii] = (commTable_->_recvOffset[ii+1] - commTable_->_recvOffset[ii])*width_;
+         recvDispl_[ii] = commTable_->_recvOffset[ii]*width_;
+      }
+      sendCount_.resize(sendTask.size()+1);
+      sendDispl_.resize(sendTask.size()+1);
+      for (unsigned ii=0; ii<sendTask.size(); ++ii)
+      {
+         sendCount_[ii] = (commTable_->_sendOffset[ii+1] - commTable_->_sendOffset[ii])*width_;
+         sendDispl_[ii] = commTable_->_sendOffset[ii]*width_;
+      }
+      recvReq_.resize(1);
+   }
+
+   /** Exposes both halves of recvBuf_ in one window.  Collective over
+    *  commTable_->_comm. */
+   void initRma()
+   {
+      exchangePutOffsets(commTable_, putOffset_, targetRecvSize_);
+      char* base = (char*)recvBuf_.readwrite(CPU).raw();
+      MPI_Win_create(base, 2*this->recvSize()*width_, 1, MPI_INFO_NULL, commTable_->_comm, &window_);
+      MPI_Group group;
+      MPI_Comm_group(commTable_->_comm, &group);
+      const std::vector<int>& recvTask = commTable_->_recvTask;
+      const std::vector<int>& sendTask = commTable_->_sendTask;
+      const int none = 0;
+      MPI_Group_incl(group, recvTask.size(), recvTask.empty() ? &none : &recvTask[0], &originGroup_);
+      MPI_Group_incl(group, sendTask.size(), sendTask.empty() ? &none : &sendTask[0], &targetGroup_);
+      MPI_Group_free(&group);
+   }
+
+   /** Alternates between the halves of the receive buffer so that the
+    *  data of the previous exchange isn't overwritten. */
+   void startRma()
+   {
+      bw_ = 1-bw_;
+      const char* sendBuf = (const char*)sendBuf_.readonly(CPU).raw();
+      recvBuf_.readwrite(CPU);
+      MPI_Win_post(originGroup_, 0, window_);
+      MPI_Win_start(targetGroup_, 0, window_);
+      for (unsigned ii=0; ii<commTable_->_sendTask.size(); ++ii)
+      {
+         unsigned nItems = commTable_->_sendOffset[ii+1] - commTable_->_sendOffset[ii];
+         MPI_Aint displ = MPI_Aint(bw_*targetRecvSize_[ii] + putOffset_[ii])*width_;
+         MPI_Put(sendBuf + commTable_->_sendOffset[ii]*width_, nItems*width_, MPI_BYTE,
+                 commTable_->_sendTask[ii], displ, nItems*width_, MPI_BYTE, window_);
+      }
+   }
+
+   /** Every task allocates a segment with a HaloShmHeader followed by
+    *  two copies of its send buffer.  Exchange e is published in copy
+    *  e%2, so a sender only has to wait for its on-node targets to
+    *  have consumed exchange e-2 before it overwrites that copy.
+    *  Collective over commTable_->_comm. */
+   void initShm()
+   {
+      const std::vector<int>& recvTask = commTable_->_recvTask;
+      const std::vector<int>& sendTask = commTable_->_sendTask;
+      int myRank;
+      MPI_Comm_rank(commTable_->_comm, &myRank);
+      MPI_Comm_split_type(commTable_->_comm, MPI_COMM_TYPE_SHARED, myRank, MPI_INFO_NULL, &nodeComm_);
+
+      MPI_Group group, nodeGroup;
+      MPI_Comm_group(commTable_->_comm, &group);
+      MPI_Comm_group(nodeComm_, &nodeGroup);
+      std::vector<int> recvNodeRank(recvTask.size()+1);
+      std::vector<int> sendNodeRank(sendTask.size()+1);
+      MPI_Group_translate_ranks(group, recvTask.size(), recvTask.empty() ? &myRank : &recvTask[0],
+                                nodeGroup, &recvNodeRank[0]);
+      MPI_Group_translate_ranks(group, sendTask.size(), sendTask.empty() ? &myRank : &sendTask[0],
+                                nodeGroup, &sendNodeRank[0]);
+      MPI_Group_free(&group);
+      MPI_Group_free(&nodeGroup);
+
+      MPI_Aint segmentSize = sizeof(HaloShmHeader) + MPI_Aint(2*commTable_->sendSize())*width_;
+      char* base;
+      MPI_Win_allocate_shared(segmentSize, 1, MPI_INFO_NULL, nodeComm_, &base, &window_);
+      myHeader_ = new (base) HaloShmHeader;
+      myHeader_->epoch.store(0);
+      myHeader_->consumed.store(0);
+      myData_ = base + sizeof(HaloShmHeader);
+      epoch_ = 0;
+
+      recvShm_.assign(recvTask.size(), 0);
+      sourceHeader_.assign(recvTask.size(), 0);
+      sourceData_.assign(recvTask.size(), 0);
+      sourceSize_.assign(recvTask.size(), 0);
+      for (unsigned ii=0; ii<recvTask.size(); ++ii)
+      {
+         if (recvNodeRank[ii] == MPI_UNDEFINED)
+            continue;
+         MPI_Aint size;
+         int dispUnit;
+         char* sourceBase;
+         MPI_Win_shared_query(window_, recvNodeRank[ii], &size, &dispUnit, &sourceBase);
+         recvShm_[ii] = 1;
+         sourceHeader_[ii] = (HaloShmHeader*) sourceBase;
+         sourceData_[ii] = sourceBase + sizeof(HaloShmHeader);
+         sourceSize_[ii] = (size - sizeof(HaloShmHeader))/(2*width_);
+      }
+      sendShm_.assign(sendTask.size(), 0);
+      targetHeader_.assign(sendTask.size(), 0);
+      for (unsigned ii=0; ii<sendTask.size(); ++ii)
+      {
+         if (sendNodeRank[ii] == MPI_UNDEFINED)
+            continue;
+         MPI_Aint size;
+         int dispUnit;
+         char* targetBase;
+         MPI_Win_shared_query(window_, sendNodeRank[ii], &size, &dispUnit, &targetBase);
+         sendShm_[ii] = 1;
+         targetHeader_[ii] = (HaloShmHeader*) targetBase;
+      }
+      exchangeSendOffsets(commTable_, sourceOffset_);
+      // Nobody may look at a header before its owner initialized it.
+      MPI_Barrier(nodeComm_);
+   }
+
+   // The spin waits of the shm method only read the headers of the
+   // neighbors, so they run outside the omp critical section of
+   // startComm and wait.  A thread that waits for a slow neighbor
+   // doesn't keep the other threads out of their MPI calls.
+
+   /** Waits until the on-node targets consumed the copy the next
+    *  startShm overwrites. */
+   void spinShmTargets() const
+   {
+      const long long next = epoch_+1;
+      for (unsigned ii=0; ii<sendShm_.size(); ++ii)
+      {
+         if (!sendShm_[ii])
+            continue;
+         while (targetHeader_[ii]->consumed.load(std::memory_order_acquire) < next-2)
+            std::this_thread::yield();
+      }
+   }
+
+   /** Waits until the on-node sources published the current epoch. */
+   void spinShmSources() const
+   {
+      for (unsigned ii=0; ii<recvShm_.size(); ++ii)
+      {
+         if (!recvShm_[ii])
+            continue;
+         while (sourceHeader_[ii]->epoch.load(std::memory_order_acquire) < epoch_)
+            std::this_thread::yield();
+      }
+   }
+
+   void startShm()
+   {
+      ++epoch_;
+      const char* sendBuf = (const char*)sendBuf_.readonly(CPU).raw();
+      const std::vector<int>& sendOffset = commTable_->_sendOffset;
+      char* myCopy = myData_ + (epoch_%2)*commTable_->sendSize()*width_;
+      for (unsigned ii=0; ii<sendShm_.size(); ++ii)
+      {
+         if (!sendShm_[ii])
+            continue;
+         unsigned nItems = sendOffset[ii+1] - sendOffset[ii];
+         memcpy(myCopy + sendOffset[ii]*width_, sendBuf + sendOffset[ii]*width_, nItems*width_);
+      }
+      myHeader_->epoch.store(epoch_, std::memory_order_release);
+      startIsend();
+   }
+
+   void waitShm()
+   {
+      char* recvBuf = (char*)recvBuf_.readwrite(CPU).raw();
+      const std::vector<int>& recvOffset = commTable_->_recvOffset;
+      for (unsigned ii=0; ii<recvShm_.size(); ++ii)
+      {
+         if (!recvShm_[ii])
+            continue;
+         assert(sourceHeader_[ii]->epoch.load(std::memory_order_acquire) >= epoch_);
+         const char* sourceCopy = sourceData_[ii] + (epoch_%2)*sourceSize_[ii]*width_;
+         unsigned nItems = recvOffset[ii+1] - recvOffset[ii];
+         memcpy(recvBuf + recvOffset[ii]*width_, sourceCopy + sourceOffset_[ii]*width_, nItems*width_);
+      }
+      myHeader_->consumed.store(epoch_, std::memory_order_release);
+      MPI_Waitall(commTable_->_sendTask.size(), &sendReq_[0], MPI_STATUS_IGNORE);
+      MPI_Waitall(commTable_->_recvTask.size(), &recvReq_[0], MPI_STATUS_IGNORE);
+   }
+
+   HaloExchangeMethod method_;
    lazy_array<T> recvBuf_;
    std::vector<MPI_Request> recvReq_;
    std::vector<MPI_Request> sendReq_;
+
+   // persistent
+   const char* sendPtr_;
+   char* recvPtr_;
+
+   // neighbor
+   MPI_Comm graphComm_;
+   std::vector<int> sendCount_;
+   std::vector<int> sendDispl_;
+   std::vector<int> recvCount_;
+   std::vector<int> recvDispl_;
+
+   // rma
+   int bw_;
+   MPI_Win window_;
+   MPI_Group originGroup_;
+   MPI_Group targetGroup_;
+   std::vector<int> putOffset_;
+   std::vector<int> targetRecvSize_;
+
+   // shm (shares window_)
+   MPI_Comm nodeComm_;
+   long long epoch_;
+   HaloShmHeader* myHeader_;
+   char* myData_;
+   std::vector<char> recvShm_;
+   std::vector<char> sendShm_;
+   std::vector<HaloShmHeader*> sourceHeader_;
+   std::vector<const char*> sourceData_;
+   std::vector<long long> sourceSize_;
+   std::vector<int> sourceOffset_;
+   std::vector<HaloShmHeader*> targetHeader_;
 };
 
 #endif // ifdef SPI
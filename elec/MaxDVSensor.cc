@@ -42,20 +42,34 @@ MaxDVSensor::MaxDVSensor(const SensorParms& sp,
 
    nlocal_=anatomy.nLocal();
    
+   opened_file_=false;
+   os_=0;
    if( filename == "cout" ){
       os_= &std::cout;
    }else{
-      os_ = new ofstream(filename.data(),ios_base::out);
-      opened_file_=true;
+      filename_=filename;
    }
+}
 
-   assert( os_!=0 );
+void MaxDVSensor::continueFrom(Sensor& old)
+{
+   MaxDVSensor& oldMaxDV = dynamic_cast<MaxDVSensor&>(old);
+   if( oldMaxDV.opened_file_ ){
+      os_=oldMaxDV.os_;
+      opened_file_=true;
+      oldMaxDV.opened_file_=false;
+   }
 }
 
 void MaxDVSensor::print(double time, int loop)
 {
    static bool first_time=true;
    
+   if( os_==0 && myRank_==0 ){
+      os_ = new ofstream(filename_.data(),ios_base::out);
+      opened_file_=true;
+   }
+   
    if( first_time ){
       if( myRank_==0 )(*os_) << "#   Loop     Time         min. dVm        max. dVm"<<endl;
       first_time=false;
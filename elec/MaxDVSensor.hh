@@ -24,6 +24,8 @@ class MaxDVSensor : public Sensor
    int myRank_;
    std::ostream* os_;
    bool opened_file_;
+   // opened by the first print of task 0
+   std::string filename_;
 
  public:
    MaxDVSensor(const SensorParms& sp, const Anatomy& anatomy, const PotentialData& vdata, 
@@ -38,6 +40,7 @@ class MaxDVSensor : public Sensor
    void print(double time, int loop);
    void eval(double time, int loop)
    {} // no eval function.    
+   void continueFrom(Sensor& old);
 };
 
 #endif
@@ -17,30 +17,33 @@ MinMaxSensor::MinMaxSensor(const SensorParms& sp, const MinMaxSensorParms& p,
                                  const PotentialData& vdata)
 : Sensor(sp),
   vdata_(vdata),
-  nLocal_(anatomy.nLocal())
+  nLocal_(anatomy.nLocal()),
+  fout_(0)
 {
   MPI_Comm comm = MPI_COMM_WORLD;
   MPI_Comm_rank(comm, &myRank_);
 
-  string filename = p.dirname + "/" + p.filename;
+  filename_ = p.dirname + "/" + p.filename;
       
   if (myRank_ == 0)
-  {
      DirTestCreate(p.dirname.c_str());
-     fout_ = new ofstream;
-     fout_->open(filename.c_str(),ofstream::out);
-     fout_->setf(ios::scientific,ios::floatfield);
-     (*fout_) << "#    time   min V_m    max V_m    max-min" << endl;
-  }
   MPI_Barrier(MPI_COMM_WORLD);
 }
 
+// only rank 0 has a file.  The Rebalancer deletes sensors on all
+// ranks.
 MinMaxSensor::~MinMaxSensor()
 {
-   fout_->close();
    delete fout_;
 }
 
+void MinMaxSensor::continueFrom(Sensor& old)
+{
+   MinMaxSensor& oldMinMax = dynamic_cast<MinMaxSensor&>(old);
+   fout_ = oldMinMax.fout_;
+   oldMinMax.fout_ = 0;
+}
+
 void MinMaxSensor::print(double time, int /*loop*/)
 {
    // find local min/max voltages
@@ -62,6 +65,13 @@ void MinMaxSensor::print(double time, int /*loop*/)
    
    if (myRank_ == 0)
    {
+      if (fout_ == 0)
+      {
+         fout_ = new ofstream;
+         fout_->open(filename_.c_str(),ofstream::out);
+         fout_->setf(ios::scientific,ios::floatfield);
+         (*fout_) << "#    time   min V_m    max V_m    max-min" << endl;
+      }
       (*fout_) << setprecision(10) << " " << time << "     " << vmin << "      " << vmax << "    " << vmax-vmin << endl;
       //ewd DEBUG cout << setprecision(10) << " " << time << "     " << vmin << "      " << vmax << endl;
    }
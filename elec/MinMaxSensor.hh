@@ -27,9 +27,11 @@ class MinMaxSensor : public Sensor
    void print(double time, int loop);
    void eval(double time, int loop)
    {} // no eval function.
+   void continueFrom(Sensor& old);
     
  private:
     void print(double time);
+    string filename_;
     int nLocal_;
     int myRank_;
     ofstream* fout_;
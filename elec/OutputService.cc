@@ -0,0 +1,142 @@
+#include "OutputService.hh"
+
+#include <iostream>
+#include <cassert>
+#include <utility>
+
+#include "mpiUtils.h"
+#include "PerformanceTimers.hh"
+
+using namespace std;
+using PerformanceTimers::outputWaitTimer;
+
+OutputService& OutputService::getInstance()
+{
+   static OutputService instance;
+   return instance;
+}
+
+OutputService::OutputService()
+: async_(false),
+  done_(false),
+  maxQueueDepth_(1),
+  nActive_(0),
+  comm_(MPI_COMM_WORLD)
+{
+}
+
+OutputService::~OutputService()
+{
+   // Can't call MPI here since the singleton may be destroyed after
+   // MPI_Finalize.  stop() should already have joined the thread.
+   assert(!thread_.joinable());
+}
+
+/** Collective on MPI_COMM_WORLD.  Must be called before any job is
+ *  posted.  Calling start again on a running service is harmless. */
+void OutputService::start(bool async, unsigned maxQueueDepth)
+{
+   if (async_)
+      return;
+
+   if (async)
+   {
+      int provided;
+      MPI_Query_thread(&provided);
+      if (provided < MPI_THREAD_MULTIPLE)
+      {
+         if (getRank(0) == 0)
+            cout << "OutputService: MPI does not provide MPI_THREAD_MULTIPLE.\n"
+                 << "   Falling back to synchronous output." << endl;
+         async = false;
+      }
+   }
+   if (!async)
+      return;
+
+   async_ = true;
+   done_ = false;
+   maxQueueDepth_ = max(1u, maxQueueDepth);
+   MPI_Comm_dup(MPI_COMM_WORLD, &comm_);
+   thread_ = std::thread(&OutputService::threadMain, this);
+}
+
+/** Hands job to the background thread.  Blocks while the queue is
+ *  full.  In synchronous mode the job is executed immediately.  job is
+ *  taken by value and moved through the queue so the data it carries
+ *  is never copied. */
+void OutputService::post(Job job)
+{
+   if (!async_)
+   {
+      job(comm_);
+      return;
+   }
+
+   startTimer(outputWaitTimer);
+   {
+      unique_lock<mutex> lock(mutex_);
+      notFull_.wait(lock, [this]{return queue_.size() < maxQueueDepth_;});
+      queue_.push_back(std::move(job));
+   }
+   stopTimer(outputWaitTimer);
+   notEmpty_.notify_one();
+}
+
+/** Waits until every posted job has completed. */
+void OutputService::flush()
+{
+   if (!async_)
+      return;
+
+   startTimer(outputWaitTimer);
+   unique_lock<mutex> lock(mutex_);
+   idle_.wait(lock, [this]{return queue_.empty() && nActive_ == 0;});
+   stopTimer(outputWaitTimer);
+}
+
+/** Collective on MPI_COMM_WORLD.  Drains the queue, joins the
+ *  background thread, and returns the service to synchronous mode.
+ *  Must be called before MPI_Finalize. */
+void OutputService::stop()
+{
+   if (!async_)
+      return;
+
+   flush();
+   {
+      lock_guard<mutex> lock(mutex_);
+      done_ = true;
+   }
+   notEmpty_.notify_one();
+   thread_.join();
+   MPI_Comm_free(&comm_);
+   comm_ = MPI_COMM_WORLD;
+   async_ = false;
+}
+
+void OutputService::threadMain()
+{
+   while (true)
+   {
+      Job job;
+      {
+         unique_lock<mutex> lock(mutex_);
+         notEmpty_.wait(lock, [this]{return done_ || !queue_.empty();});
+         if (queue_.empty())
+            break;
+         job = std::move(queue_.front());
+         queue_.pop_front();
+         ++nActive_;
+      }
+      notFull_.notify_one();
+
+      job(comm_);
+
+      {
+         lock_guard<mutex> lock(mutex_);
+         --nActive_;
+      }
+      idle_.notify_all();
+   }
+}
@@ -0,0 +1,74 @@
+#ifndef OUTPUT_SERVICE_HH
+#define OUTPUT_SERVICE_HH
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <mpi.h>
+
+/** The OutputService moves file output (sensor prints, snapshots) off
+ *  of the compute threads.  Callers package the data they need to
+ *  write into a self contained job and post it to the service.  Jobs
+ *  are executed by a single background thread in the order they were
+ *  posted.  Since every task posts the same sequence of jobs the
+ *  collectives inside pio (Popen, Pclose, etc.) match up across tasks.
+ *
+ *  Jobs receive a private duplicate of MPI_COMM_WORLD.  They must do
+ *  all of their communication on that communicator so that they never
+ *  collide with traffic on the compute threads.
+ *
+ *  The queue is bounded.  When it is full post() blocks until the
+ *  oldest job has finished (back-pressure), so a slow file system
+ *  throttles the simulation instead of exhausting memory.
+ *
+ *  pio and the scratch heap are not thread safe.  While the service is
+ *  running in asynchronous mode any code that calls pio directly on a
+ *  compute thread must call flush() first.
+ *
+ *  If asynchronous output is not enabled, or the MPI library does not
+ *  provide MPI_THREAD_MULTIPLE, jobs are executed immediately in the
+ *  calling thread and the service behaves exactly like the old
+ *  synchronous code.
+ *
+ *  This implementation isn't thread safe on the producer side.  Only
+ *  post from one thread (the thread that runs loopIO).
+ */
+class OutputService
+{
+ public:
+   typedef std::function<void(MPI_Comm)> Job;
+
+   static OutputService& getInstance();
+
+   void start(bool async, unsigned maxQueueDepth);
+   void post(Job job);
+   void flush();
+   void stop();
+
+   bool isAsync() const {return async_;}
+   MPI_Comm comm() const {return comm_;}
+
+ private:
+   OutputService();
+   ~OutputService();
+   OutputService(const OutputService&);
+   OutputService& operator=(const OutputService&);
+
+   void threadMain();
+
+   bool async_;
+   bool done_;
+   unsigned maxQueueDepth_;
+   unsigned nActive_;
+   MPI_Comm comm_;
+   std::deque<Job> queue_;
+   std::mutex mutex_;
+   std::condition_variable notEmpty_;
+   std::condition_variable notFull_;
+   std::condition_variable idle_;
+   std::thread thread_;
+};
+
+#endif
@@ -15,6 +15,7 @@
 #include "object_cc.hh"
 #include "mpiUtils.h"
 #include <cmath>
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iostream>
@@ -314,23 +315,80 @@ void ThisReaction::calc(double _dt,
    ro_array_ptr<double> __Vm = ___Vm.useOn(CPU);
    ro_array_ptr<double> __iStim = ___iStim.useOn(CPU);
    wo_array_ptr<double> __dVm = ___dVm.useOn(CPU);
+   calcBlocks(_dt, __Vm.raw(), __iStim.raw(), __dVm.raw(), NULL, NULL, NULL);
+}
+
+void ThisReaction::calcIntegrate(double _dt,
+                rw_mgarray_ptr<double> ___Vm,
+                ro_mgarray_ptr<double> ___iStim,
+                ro_mgarray_ptr<double> ___dVmDiffusion,
+                wo_mgarray_ptr<double> ___dVm)
+{
+   rw_array_ptr<double> __Vm = ___Vm.useOn(CPU);
+   ro_array_ptr<double> __iStim = ___iStim.useOn(CPU);
+   ro_array_ptr<double> __dVmDiffusion = ___dVmDiffusion.useOn(CPU);
+   wo_array_ptr<double> __dVm = ___dVm.useOn(CPU);
+   calcBlocks(_dt, __Vm.raw(), __iStim.raw(), __dVm.raw(), __dVmDiffusion.raw(), __Vm.raw(), NULL);
+}
+
+void ThisReaction::calcSkip(double _dt,
+                ro_mgarray_ptr<double> ___Vm,
+                ro_mgarray_ptr<double> ___iStim,
+                wo_mgarray_ptr<double> ___dVm,
+                const char* __skip)
+{
+   ro_array_ptr<double> __Vm = ___Vm.useOn(CPU);
+   ro_array_ptr<double> __iStim = ___iStim.useOn(CPU);
+   wo_array_ptr<double> __dVm = ___dVm.useOn(CPU);
+   calcBlocks(_dt, __Vm.raw(), __iStim.raw(), __dVm.raw(), NULL, NULL, __skip);
+}
 
+/** When VmOut isn't NULL the forward Euler update of each block is
+ *  done right after its dVm is stored, while the block is still in
+ *  cache.  VmOut may be the same array as Vm since every block is
+ *  loaded before it is updated.  When skip isn't NULL blocks whose
+ *  cells are all flagged are not computed. */
+void ThisReaction::calcBlocks(double _dt,
+                const double* __Vm,
+                const double* __iStim,
+                double* __dVm,
+                const double* __dVmDiffusion,
+                double* __VmOut,
+                const char* __skip)
+{
    //define the constants
    for (unsigned __jj=0; __jj<(nCells_+width-1)/width; __jj++)
    {
       const int __ii = __jj*width;
+      if (__skip != NULL && skipBlock(__skip, __ii, std::min<int>(width, nCells_-__ii)))
+         continue;
       //set Vm
       const real V = load(&__Vm[__ii]);
       const real iStim = load(&__iStim[__ii]);
 
       //set all state variables
+      //set the per-cell parameters
+      real E_R;
+      real G;
+      if (param_.empty())
+      {
+         E_R = simdops::splat(&this->E_R);
+         G = simdops::splat(&this->G);
+      }
+      else
+      {
+         E_R = load(param_[__jj].E_R);
+         G = load(param_[__jj].G);
+      }
       //get the gate updates (diagonalized exponential integrator)
       //get the other differential updates
       //get Iion
       real Iion = G*(-E_R + V);
       //Do the markov update (1 step rosenbrock with gauss siedel)
       //EDIT_STATE
-      simdops::store(&__dVm.raw()[__ii],-Iion);
+      simdops::store_partial(&__dVm[__ii],-Iion,nCells_-__ii);
+      if (__VmOut != NULL)
+         eulerUpdate(_dt, __ii, std::min<int>(width, nCells_-__ii), __VmOut, __dVm, __dVmDiffusion, __iStim);
    }
 }
 #endif //USE_CUDA
@@ -361,6 +419,15 @@ void ThisReaction::initializeMembraneVoltage(wo_mgarray_ptr<double> __Vm_m)
    }
 
    __Vm.assign(__Vm.size(), V_init);
+#ifndef USE_CUDA
+   if (!param_.empty())
+   {
+      for (int iCell=0; iCell<nCells_; iCell++)
+      {
+         __Vm[iCell] = param_[iCell/width].E_R[iCell % width];
+      }
+   }
+#endif //USE_CUDA
 }
 
 enum varHandles
@@ -368,6 +435,13 @@ enum varHandles
    NUMHANDLES
 };
 
+enum paramHandles
+{
+   E_R_param,
+   G_param,
+   NUMPARAMS
+};
+
 const string ThisReaction::getUnit(const std::string& varName) const
 {
    if(0) {}
@@ -403,6 +477,64 @@ double ThisReaction::getValue(int iCell, int varHandle) const
    return NAN;
 }
 
+void ThisReaction::getColumn(int varHandle, int begin, int end, double* value) const
+{
+#ifdef USE_CUDA
+   auto stateData = stateTransport_.readonly(CPU);
+#endif //USE_CUDA
+
+#define COPY_COLUMN(state) for (int __ii=begin; __ii<end; __ii++) { value[__ii-begin] = READ_STATE(state,__ii); }
+   if (0) {}
+   else { Reaction::getColumn(varHandle, begin, end, value); }
+#undef COPY_COLUMN
+}
+
+void ThisReaction::setColumn(int varHandle, int begin, int end, const double* value)
+{
+#ifdef USE_CUDA
+   auto stateData = stateTransport_.readwrite(CPU);
+#endif //USE_CUDA
+
+#define COPY_COLUMN(state) for (int __ii=begin; __ii<end; __ii++) { READ_STATE(state,__ii) = value[__ii-begin]; }
+   if (0) {}
+#undef COPY_COLUMN
+}
+
+int ThisReaction::getParameterHandle(const std::string& paramName) const
+{
+#ifndef USE_CUDA
+   if (0) {}
+   else if (paramName == "E_R") { return E_R_param; }
+   else if (paramName == "G") { return G_param; }
+#endif //USE_CUDA
+   return -1;
+}
+
+void ThisReaction::setParameterColumn(int paramHandle, int begin, int end, const double* value)
+{
+#ifdef USE_CUDA
+   assert(false);
+#else //USE_CUDA
+#define READ_PARAM(param,index) (param_[index/width].param[index % width])
+   if (param_.empty())
+   {
+      param_.resize(state_.size());
+      for (int __ii=0; __ii<param_.size()*width; __ii++)
+      {
+         READ_PARAM(E_R,__ii) = E_R;
+         READ_PARAM(G,__ii) = G;
+      }
+   }
+#define COPY_PARAM(param) for (int __ii=begin; __ii<end; __ii++) { READ_PARAM(param,__ii) = value[__ii-begin]; }
+   if (0) {}
+   else if (paramHandle == E_R_param) { COPY_PARAM(E_R); }
+   else if (paramHandle == G_param) { COPY_PARAM(G); }
+   else { assert(false); }
+#undef COPY_PARAM
+#undef READ_PARAM
+#endif //USE_CUDA
+}
+
 double ThisReaction::getValue(int iCell, int varHandle, double V) const
 {
 #ifdef USE_CUDA
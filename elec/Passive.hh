@@ -27,6 +27,11 @@ namespace Passive
    {
 
    };
+   struct Param
+   {
+      double E_R[SIMDOPS_FLOAT64V_WIDTH];
+      double G[SIMDOPS_FLOAT64V_WIDTH];
+   };
 #endif //USE_CUDA
 
    class ThisReaction : public Reaction
@@ -44,6 +49,10 @@ namespace Passive
       virtual void setValue(int iCell, int varHandle, double value);
       virtual double getValue(int iCell, int varHandle) const;
       virtual double getValue(int iCell, int varHandle, double V) const;
+      virtual void getColumn(int varHandle, int begin, int end, double* value) const;
+      virtual void setColumn(int varHandle, int begin, int end, const double* value);
+      virtual int getParameterHandle(const std::string& paramName) const;
+      virtual void setParameterColumn(int paramHandle, int begin, int end, const double* value);
       virtual const std::string getUnit(const std::string& varName) const;
 
     private:
@@ -73,7 +82,22 @@ namespace Passive
       int blockSize_;
 #else //USE_CUDA
 
+      bool fusedIntegrate() const {return true;}
+      void calcIntegrate(double dt,
+                         rw_mgarray_ptr<double> Vm_m,
+                         ro_mgarray_ptr<double> iStim_m,
+                         ro_mgarray_ptr<double> dVmDiffusion_m,
+                         wo_mgarray_ptr<double> dVm_m);
+      void calcSkip(double dt,
+                    ro_mgarray_ptr<double> Vm_m,
+                    ro_mgarray_ptr<double> iStim_m,
+                    wo_mgarray_ptr<double> dVm_m,
+                    const char* skip);
+      void calcBlocks(double dt, const double* Vm, const double* iStim, double* dVm,
+                      const double* dVmDiffusion, double* VmOut, const char* skip);
+
       std::vector<State, AlignedAllocator<State> > state_;
+      std::vector<Param, AlignedAllocator<Param> > param_;
 #endif
 
       //BGQ_HACKFIX, compiler bug with zero length arrays
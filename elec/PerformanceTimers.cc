@@ -10,12 +10,20 @@
 #include <cmath>
 #include <omp.h>
 #include <cstring>
+#include <cstdio>
 #include <stdint.h>
+#ifdef PERF_EVENT
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#endif
 #include "pio.h"
 #include "mpiUtils.h"
 #include "ioUtils.h"
 #include "tagServer.h"
 #include "unionOfStrings.hh"
+#include "ThreadServer.hh"
 
 using namespace std;
 namespace PerformanceTimers
@@ -39,12 +47,14 @@ namespace PerformanceTimers
 */
 
 #include "PerformanceTimersBGQ.hh"
+#include "PerformanceTimersPerf.hh"
 #include "PerformanceTimersGeneric.hh"
 
    struct TimerStruct
    {
       uint64_t start[8];
       uint64_t total[8];
+      bool readCounters; // even if allCounters_ is off
    };
    TimerHandle loopIOTimer;
    TimerHandle simulationLoopTimer;
@@ -62,6 +72,7 @@ namespace PerformanceTimers
    TimerHandle stimulusTimer;
    TimerHandle reactionTimer;
    TimerHandle reactionMiscTimer;
+   TimerHandle reactionMultirateTimer;
    TimerHandle nonGateTimer;
    TimerHandle nonGateRLTimer;
    TimerHandle GateNonGateTimer;
@@ -101,6 +112,8 @@ namespace PerformanceTimers
    TimerHandle timingBarrierTimer;
    TimerHandle FGR_2D_StencilTimerTimer;
    TimerHandle stencilOverlapTimer;
+   TimerHandle outputWaitTimer;
+   TimerHandle rebalanceTimer;
    
    vector<TimerStruct> timers_;
    typedef map<string, TimerHandle> HandleMap;
@@ -108,6 +121,45 @@ namespace PerformanceTimers
    vector<string> printOrder_;
    string refTimer_;
    bool allCounters_;
+
+   /** A profileStop, or the start of a loop if handle is
+    *  traceLoopMarker. */
+   struct TraceEvent
+   {
+      TimerHandle handle;
+      int loop;
+      uint64_t start;
+      uint64_t duration;
+   };
+   const TimerHandle traceLoopMarker = ~0u;
+
+   struct TraceBuffer
+   {
+      bool active;
+      int loop;
+      uint64_t nEvents; // recorded so far.  Event ii is in slot ii%event.size()
+      vector<TraceEvent> event;
+      string name;
+      char pad[64];     // threads write their own buffer, keep them apart
+   };
+
+   bool traceOn_ = false;
+   int traceFirstLoop_;
+   int traceLastLoop_;
+   uint64_t traceOrigin_;
+   string traceDir_;
+   vector<TraceBuffer> trace_; // indexed by omp thread
+
+   inline void traceRecord(int tid, TimerHandle handle, uint64_t start, uint64_t duration)
+   {
+      TraceBuffer& buf = trace_[tid];
+      TraceEvent& ev = buf.event[buf.nEvents % buf.event.size()];
+      ev.handle = handle;
+      ev.loop = buf.loop;
+      ev.start = start;
+      ev.duration = duration;
+      ++buf.nEvents;
+   }
 }
 
 using namespace PerformanceTimers;
@@ -131,6 +183,7 @@ void  profileInit()
    stimulusTimer = profileGetHandle("Stimulus");
    reactionTimer= profileGetHandle("Reaction");
    reactionMiscTimer= profileGetHandle("ReactionMisc");
+   reactionMultirateTimer= profileGetHandle("ReactionMultirate");
    rangeCheckTimer= profileGetHandle("rangeCheck");
    nonGateTimer= profileGetHandle("Reaction_nonGate");
    nonGateRLTimer= profileGetHandle("Reaction_nonGateRL");
@@ -170,6 +223,8 @@ void  profileInit()
    timingBarrierTimer = profileGetHandle("TimingBarrier");
    FGR_2D_StencilTimer = profileGetHandle("FGR_2D_Stencil");
    stencilOverlapTimer = profileGetHandle("stencilOverlap");
+   outputWaitTimer = profileGetHandle("OutputWait");
+   rebalanceTimer = profileGetHandle("Rebalance");
    machineSpecficInit(); 
 }
 void profileStart(const TimerHandle& handle)
@@ -177,7 +232,7 @@ void profileStart(const TimerHandle& handle)
    int tid=omp_get_thread_num() ;
    int id=handle+tid; 
    timers_[id].start[CYCLES] = getTime();
-   if (allCounters_)
+   if (allCounters_ || timers_[id].readCounters)
    {
       for (int i=2; i<nCounters_;i++) 
       {
@@ -195,7 +250,9 @@ void profileStop(const TimerHandle& handle)
    timers_[id].total[NCALLS] += 1;
    uint64_t delta = getTime() - timers_[id].start[CYCLES];
    timers_[id].total[CYCLES] += delta;
-   if (allCounters_)
+   if (traceOn_ && trace_[tid].active)
+      traceRecord(tid, handle, timers_[id].start[CYCLES], delta);
+   if (allCounters_ || timers_[id].readCounters)
    {
       for (int i=2; i<nCounters_;i++) 
       {
@@ -219,28 +276,34 @@ void profileStop(const std::string& timerName)
 
 void profileStart_HW(const TimerHandle& handle)
 {
+   bool allCounters = allCounters_;
    allCounters_=1; 
    profileStart(handle);
-   allCounters_=0; 
+   allCounters_=allCounters; 
 }
 
 void profileStop_HW(const TimerHandle& handle)
 {
+   bool allCounters = allCounters_;
    allCounters_=1; 
    profileStop(handle);
-   allCounters_=0; 
+   allCounters_=allCounters; 
 }
 void profileStart_HW(const std::string& timerName)
 {
-   allCounters_=1; 
-   profileStart(profileGetHandle(timerName));
-   allCounters_=0; 
+   profileStart_HW(profileGetHandle(timerName));
 }
 void profileStop_HW(const std::string& timerName)
 {
-   allCounters_=1; 
-   profileStop(profileGetHandle(timerName));
-   allCounters_=0; 
+   profileStop_HW(profileGetHandle(timerName));
+}
+
+void profileSetCounterTimer(const string& timerName)
+{
+   TimerHandle handle = profileGetHandle(timerName);
+   int nThreads = omp_get_max_threads(); 
+   for (int id=0; id<nThreads; id++)
+      timers_[handle+id].readCounters = true;
 }
 
 TimerHandle profileGetHandle(string timerName)
@@ -557,6 +620,41 @@ void profileDumpStats(ostream& out)
          }
       }
    }
+   // IPC and memory bandwidth of the timers that read the counters.
+   // Sums over the tasks, so the rates are the average of one thread.
+   int cyclesIndex = -1;
+   int instructionsIndex = -1;
+   int llcMissIndex = -1;
+   for (int ii=2; ii<nPrintCounters_; ++ii)
+   {
+      if (strcmp(counterNames_[ii], "Cycles") == 0) cyclesIndex = ii;
+      if (strcmp(counterNames_[ii], "Instructions") == 0) instructionsIndex = ii;
+      if (strcmp(counterNames_[ii], "LLCMisses") == 0) llcMissIndex = ii;
+   }
+   if (myRank == 0 && cyclesIndex > 0 && instructionsIndex > 0 && llcMissIndex > 0)
+   {
+      const double bytesPerMiss = 64; // a cache line from memory per LLC miss
+      string::size_type maxLen = 0;
+      for (unsigned ii=0; ii<nTimers; ++ii)
+         maxLen = max(maxLen, outputOrder[ii].size());
+      out << endl << setw(maxLen) << left << "Counters" << "   " << right
+          << setw(10) << "IPC"
+          << setw(10) << "GB/s"
+          << endl;
+      out << "--------------------------------------------------------------------------------" << endl;
+      for (unsigned ii=0; ii<nTimers; ++ii)
+      {
+         if (outputOrder[ii].empty() || perfCount[ii][cyclesIndex] < 1)
+            continue;
+         double seconds = perfCount[ii][CYCLES]*tick;
+         out << setw(maxLen) << left << outputOrder[ii] << " : " << right
+             << setprecision(2)
+             << setw(10) << perfCount[ii][instructionsIndex]/perfCount[ii][cyclesIndex]
+             << setw(10) << perfCount[ii][llcMissIndex]*bytesPerMiss/seconds*1e-9
+             << endl;
+      }
+   }
+
    if (myRank ==0 && nPrintCounters_ > 2) 
    {
       FILE *file=fopen("perfCount.data","w"); 
@@ -586,7 +684,7 @@ void profileDumpStats(ostream& out)
             if (jjcoreID == coreID && jjtimerID == timerID) cycle+=perfCount[jj][CYCLES]; 
          }
          double flop = 0.0 ; 
-         if (cycle > 1e-9) flop = perfCount[ii][7]/(cycle*tick);
+         if (cycle > 1e-9 && nCounters_ > 7) flop = perfCount[ii][7]/(cycle*tick);
          
          if (perfCount[ii][NCALLS]>1e-9) 
          {
@@ -600,3 +698,121 @@ void profileDumpStats(ostream& out)
    }
    out.setf(oldFlags);
 }
+
+void profileTraceSetup(int firstLoop, int lastLoop, unsigned bufferSize,
+                       const string& dirname)
+{
+   traceFirstLoop_ = firstLoop;
+   traceLastLoop_ = lastLoop;
+   traceDir_ = dirname;
+   trace_.resize(omp_get_max_threads());
+   for (unsigned ii=0; ii<trace_.size(); ++ii)
+   {
+      trace_[ii].active = false;
+      trace_[ii].loop = -1;
+      trace_[ii].nEvents = 0;
+      trace_[ii].event.resize(max(bufferSize, 1u));
+   }
+   unsigned long long now = getTime();
+   unsigned long long origin;
+   MPI_Allreduce(&now, &origin, 1, MPI_UNSIGNED_LONG_LONG, MPI_MIN, MPI_COMM_WORLD);
+   traceOrigin_ = origin;
+   traceOn_ = true;
+}
+
+void profileTraceLoop(int loop)
+{
+   if (!traceOn_)
+      return;
+   bool active = (loop >= traceFirstLoop_ && (traceLastLoop_ < 0 || loop <= traceLastLoop_));
+   int tid = omp_get_thread_num();
+   int begin = tid;
+   int end = tid+1;
+   if (!omp_in_parallel())
+   {
+      begin = 0;
+      end = trace_.size();
+   }
+   for (int ii=begin; ii<end; ++ii)
+   {
+      trace_[ii].active = active;
+      trace_[ii].loop = loop;
+   }
+   if (active)
+      traceRecord(tid, traceLoopMarker, getTime(), 0);
+}
+
+void profileTraceNameThreads(const ThreadTeam& team, const string& role)
+{
+   if (!traceOn_)
+      return;
+   for (int ii=0; ii<team.nThreads(); ++ii)
+   {
+      int ompID = team.hwInfo(ii).ompID_;
+      stringstream name;
+      name << role << " " << team.teamRank(ompID);
+      trace_[ompID].name = name.str();
+   }
+}
+
+void profileTraceWrite()
+{
+   if (!traceOn_)
+      return;
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   if (myRank == 0)
+      DirTestCreate(traceDir_.c_str());
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   map<TimerHandle, string> timerName;
+   for (HandleMap::const_iterator iter=handleMap_.begin(); iter!=handleMap_.end(); ++iter)
+      if (iter->first.compare(0, 3, "00:") == 0)
+         timerName[iter->second] = iter->first.substr(3);
+
+   stringstream filename;
+   filename << traceDir_ << "/trace." << myRank << ".json";
+   FILE* file = fopen(filename.str().c_str(), "w");
+   if (file == NULL)
+   {
+      cerr << "Can't write " << filename.str() << endl;
+      return;
+   }
+
+   const double usPerTick = getTick()*1e6;
+   uint64_t nDropped = 0;
+   fprintf(file, "{\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+   fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"rank %d\"}}",
+           myRank, myRank);
+   for (unsigned tid=0; tid<trace_.size(); ++tid)
+   {
+      const TraceBuffer& buf = trace_[tid];
+      if (buf.nEvents == 0)
+         continue;
+      stringstream name;
+      if (buf.name.empty())
+         name << "thread " << tid;
+      else
+         name << buf.name;
+      fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+              myRank, tid, name.str().c_str());
+
+      uint64_t size = buf.event.size();
+      uint64_t first = (buf.nEvents > size) ? buf.nEvents-size : 0;
+      nDropped += first;
+      for (uint64_t ii=first; ii<buf.nEvents; ++ii)
+      {
+         const TraceEvent& ev = buf.event[ii%size];
+         double ts = ((double)ev.start - (double)traceOrigin_)*usPerTick;
+         if (ev.handle == traceLoopMarker)
+            fprintf(file, ",\n{\"name\": \"loop %d\", \"ph\": \"i\", \"s\": \"t\", \"pid\": %d, \"tid\": %u, \"ts\": %.3f}",
+                    ev.loop, myRank, tid, ts);
+         else
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"loop\": %d}}",
+                    timerName[ev.handle].c_str(), myRank, tid, ts, ev.duration*usPerTick, ev.loop);
+      }
+   }
+   fprintf(file, "\n],\n\"otherData\": {\"rank\": %d, \"firstLoop\": %d, \"lastLoop\": %d, \"droppedEvents\": %llu}}\n",
+           myRank, traceFirstLoop_, traceLastLoop_, (unsigned long long)nDropped);
+   fclose(file);
+}
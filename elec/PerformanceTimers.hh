@@ -5,6 +5,7 @@
 #include <iosfwd>
 
 typedef unsigned TimerHandle;
+class ThreadTeam;
 
 namespace PerformanceTimers
 {
@@ -24,6 +25,7 @@ namespace PerformanceTimers
    extern TimerHandle stimulusTimer;
    extern TimerHandle reactionTimer;
    extern TimerHandle reactionMiscTimer;
+   extern TimerHandle reactionMultirateTimer;
    extern TimerHandle nonGateTimer;
    extern TimerHandle nonGateRLTimer;
    extern TimerHandle GateNonGateTimer;
@@ -62,6 +64,8 @@ namespace PerformanceTimers
    extern TimerHandle printDataTimer;
    extern TimerHandle timingBarrierTimer;
    extern TimerHandle stencilOverlapTimer;
+   extern TimerHandle outputWaitTimer;
+   extern TimerHandle rebalanceTimer;
 };
 
 /** Use the startTimer and stopTimer macros for timers that are inside
@@ -105,9 +109,34 @@ TimerHandle profileGetHandle(std::string timerName);
 void profileSetVerbosity(const bool verbosity);
 void profileSetRefTimer(const std::string& timerName);
 void profileSetPrintOrder(const std::string& timerName);
+/** Read the hardware counters in every call of this timer, also when
+ *  the counters are off for the other timers (profileSetVerbosity). */
+void profileSetCounterTimer(const std::string& timerName);
 void profileDumpTimes(std::ostream&);
 void profileDumpAll(const std::string& dirname);
 void profileDumpStats(std::ostream& out);
 void profileInit();
 void profilePrintName();
+
+/** Timeline of the timers of a window of loops.  While a thread is
+ *  inside the window every profileStop it makes is recorded (timer,
+ *  start, duration and loop) in a ring buffer of bufferSize events per
+ *  thread, so a long window keeps the most recent events.
+ *  profileTraceWrite writes dirname/trace.<rank>.json in the Chrome
+ *  trace format (chrome://tracing, ui.perfetto.dev) with one process
+ *  per rank and one track per thread.  The time stamps of all ranks
+ *  start from the same origin, so the traceEvents of several files can
+ *  be concatenated to look at ranks side by side.
+ *
+ *  lastLoop < 0 means to the end of the run.  Setup and write are
+ *  collective over MPI_COMM_WORLD. */
+void profileTraceSetup(int firstLoop, int lastLoop, unsigned bufferSize,
+                       const std::string& dirname);
+/** Called at the top of every iteration of a simulation loop.  From a
+ *  parallel region it moves only the calling thread to loop, from a
+ *  serial region all threads. */
+void profileTraceLoop(int loop);
+/** Names the trace tracks of the members of team "role teamRank". */
+void profileTraceNameThreads(const ThreadTeam& team, const std::string& role);
+void profileTraceWrite();
 #endif
@@ -0,0 +1,107 @@
+#if defined(PERF_EVENT) && !defined(MACHINE)
+/*====================================================================*/
+/* Linux perf_event counters.  Every thread opens one group (cycles,  */
+/* instructions, last level cache misses) that counts the user space  */
+/* of that thread only.  Memory traffic is estimated as one cache     */
+/* line per LLC miss: the memory controller counters would be exact   */
+/* but they count the whole socket and need a system wide (root)      */
+/* perf_event.  If the counters can't be opened on some thread of     */
+/* some task (no PMU in the VM, perf_event_paranoid > 2, ...) they    */
+/* are off on all tasks and only #Calls and Time are reported.        */
+/*====================================================================*/
+enum { perfNEvents = 3 };
+int nCounters_ = 2 + perfNEvents;
+const char *counterNames_[] = {"#Calls", "Time", "Cycles", "Instructions", "LLCMisses"};
+const int perfBytesPerMiss = 64;
+
+struct PerfGroup
+{
+   int fd[perfNEvents];
+   uint64_t value[perfNEvents]; // of the last read of the leader
+   char pad[64];
+};
+vector<PerfGroup> perfGroup_;
+vector<unsigned> counterHandle;
+
+inline uint64_t getTime()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return ((uint64_t)1000000000)*(uint64_t)ts.tv_sec + (uint64_t)ts.tv_nsec;
+}
+double getTick()
+{
+   double seconds_per_cycle = 1.0e-9;
+   return seconds_per_cycle;
+}
+int getNCores() { return sysconf(_SC_NPROCESSORS_ONLN); }
+
+/** The group is read at once when the first counter (i == 0) is
+ *  asked for and the others come from that read.  profileStart and
+ *  profileStop ask for the counters in order. */
+void perfReadCounter(unsigned handle, int i, uint64_t* counter)
+{
+   PerfGroup& group = perfGroup_[handle];
+   if (i == 0)
+   {
+      uint64_t buf[1+perfNEvents];
+      if (read(group.fd[0], buf, sizeof(buf)) == sizeof(buf))
+         for (int ii=0; ii<perfNEvents; ++ii)
+            group.value[ii] = buf[1+ii];
+   }
+   *counter = group.value[i];
+}
+
+int perfOpen(uint64_t config, int groupFd)
+{
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.config = config;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP;
+   return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+void profileInitPerf(void)
+{
+   const uint64_t config[perfNEvents] = {PERF_COUNT_HW_CPU_CYCLES,
+                                         PERF_COUNT_HW_INSTRUCTIONS,
+                                         PERF_COUNT_HW_CACHE_MISSES};
+   int nThreads = omp_get_max_threads();
+   perfGroup_.resize(nThreads);
+   counterHandle.resize(nThreads);
+   int ok = 1;
+   #pragma omp parallel reduction(min:ok)
+   {
+      int tid = omp_get_thread_num();
+      counterHandle[tid] = tid;
+      PerfGroup& group = perfGroup_[tid];
+      group.fd[0] = -1;
+      for (int ii=0; ii<perfNEvents; ++ii)
+      {
+         group.value[ii] = 0;
+         group.fd[ii] = perfOpen(config[ii], group.fd[0]);
+         if (group.fd[ii] < 0)
+            ok = 0;
+      }
+   }
+   int allOk;
+   MPI_Allreduce(&ok, &allOk, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+   if (!allOk)
+   {
+      for (unsigned tid=0; tid<perfGroup_.size(); ++tid)
+         for (int ii=0; ii<perfNEvents; ++ii)
+            if (perfGroup_[tid].fd[ii] >= 0)
+               close(perfGroup_[tid].fd[ii]);
+      nCounters_ = 2;
+      if (getRank(0) == 0)
+         cout << "perf_event_open failed: no hardware counters in the timers." << endl;
+   }
+}
+void (*machineSpecficInit)() = profileInitPerf;
+void (*readCounter)(unsigned int, int, uint64_t*) = perfReadCounter;
+#define MACHINE PERF_EVENT
+#endif
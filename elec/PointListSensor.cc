@@ -17,6 +17,8 @@ PointListSensor::PointListSensor(const SensorParms& sp, const PointListSensorPar
                                  const PotentialData& vdata)
 : Sensor(sp),
   printDerivs_(p.printDerivs),
+  opened_(false),
+  append_(false),
   vdata_(vdata)
 {
   int myRank;
@@ -26,7 +28,6 @@ PointListSensor::PointListSensor(const SensorParms& sp, const PointListSensorPar
   const int plistsize = p.pointList.size();
   assert(plistsize > 0);
 
-  vector<string> outfiles_loc;  // filenames of output files owned by this task
   vector<int> gidfound(plistsize,0);
   
   // loop through grid points on this task, check against pointlist
@@ -44,7 +45,7 @@ PointListSensor::PointListSensor(const SensorParms& sp, const PointListSensorPar
         ossnum.fill('0');
         ossnum << ii;
         string filename = p.dirname + "/" + p.filename + "." + ossnum.str();
-        outfiles_loc.push_back(filename);
+        outfiles_loc_.push_back(filename);
         gidfound[ii] = 1;
       }
     }
@@ -67,22 +68,36 @@ PointListSensor::PointListSensor(const SensorParms& sp, const PointListSensorPar
   if (myRank == 0)
      DirTestCreate(p.dirname.c_str());
   MPI_Barrier(comm); // none shall pass before task 0 creates directory
-  
-  // loop through local files, initialize ofstream, print header
-  if (outfiles_loc.size() > 0)
+}
+
+// The Rebalancer may have moved the points to other tasks, so the new
+// owners reopen the files and append to them.
+void PointListSensor::continueFrom(Sensor& old)
+{
+  append_ = dynamic_cast<PointListSensor&>(old).opened_;
+}
+
+// loop through local files, initialize ofstream, print header
+void PointListSensor::open()
+{
+  for (unsigned ii=0; ii<outfiles_loc_.size(); ++ii)
   {
-    for (unsigned ii=0; ii<outfiles_loc.size(); ++ii)
+    ofstream* fout_ii = new ofstream;
+    fout_loc_.push_back(fout_ii);
+    if (append_)
     {
-      ofstream* fout_ii = new ofstream;
-      fout_loc_.push_back(fout_ii);
-      fout_loc_[ii]->open(outfiles_loc[ii].c_str(),ofstream::out);
+      fout_loc_[ii]->open(outfiles_loc_[ii].c_str(),ofstream::app);
       fout_loc_[ii]->setf(ios::scientific,ios::floatfield);
-      if (printDerivs_)
-        (*fout_loc_[ii]) << "#    time   V_m  dVm_r  dVm_d   for grid point " << localCells_[ii] << endl;
-      else
-        (*fout_loc_[ii]) << "#    time   V_m   for grid point " << localCells_[ii] << endl;
+      continue;
     }
+    fout_loc_[ii]->open(outfiles_loc_[ii].c_str(),ofstream::out);
+    fout_loc_[ii]->setf(ios::scientific,ios::floatfield);
+    if (printDerivs_)
+      (*fout_loc_[ii]) << "#    time   V_m  dVm_r  dVm_d   for grid point " << localCells_[ii] << endl;
+    else
+      (*fout_loc_[ii]) << "#    time   V_m   for grid point " << localCells_[ii] << endl;
   }
+  opened_ = true;
 }
 
 PointListSensor::~PointListSensor()
@@ -96,6 +111,8 @@ PointListSensor::~PointListSensor()
 
 void PointListSensor::print(double time, int /*loop*/)
 {
+   if (!opened_)
+      open();
    if (printDerivs_)
       printDerivs(time);
    else
@@ -27,14 +27,21 @@ class PointListSensor : public Sensor
    void print(double time, int loop);
    void eval(double time, int loop)
    {} // no eval function.
+   void continueFrom(Sensor& old);
     
  private:
+   void open();
    void print(double time);
    void printDerivs(double time);
 
    std::vector<Long64> localCells_;  // grid gids owned by this task
    std::vector<unsigned> sensorind_;      // corresponding local array index 
+   std::vector<std::string> outfiles_loc_; // filenames of output files owned by this task
    std::vector<std::ofstream*> fout_loc_;
+   // true once the files are open.  The same on all tasks.
+   bool opened_;
+   // files written by the sensor this one continues from
+   bool append_;
    bool printDerivs_;
    
    const PotentialData& vdata_;
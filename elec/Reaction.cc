@@ -115,3 +115,40 @@ const string Reaction::getUnit(const string& varName) const
    assert(false);
    return string();
 }
+
+void Reaction::calcIntegrate(double dt,
+                             rw_mgarray_ptr<double> _Vm,
+                             ro_mgarray_ptr<double> _iStim,
+                             ro_mgarray_ptr<double> _dVmDiffusion,
+                             wo_mgarray_ptr<double> _dVm)
+{
+   calc(dt, _Vm, _iStim, _dVm);
+   rw_array_ptr<double> Vm = _Vm.useOn(CPU);
+   ro_array_ptr<double> iStim = _iStim.useOn(CPU);
+   ro_array_ptr<double> dVmDiffusion = _dVmDiffusion.useOn(CPU);
+   wo_array_ptr<double> dVm = _dVm.useOn(CPU);
+   eulerUpdate(dt, 0, Vm.size(), Vm.raw(), dVm.raw(), dVmDiffusion.raw(), iStim.raw());
+}
+
+void Reaction::getColumn(int varHandle, int begin, int end, double* value) const
+{
+   for (int ii=begin; ii<end; ++ii)
+      value[ii-begin] = getValue(ii, varHandle);
+}
+
+void Reaction::setColumn(int varHandle, int begin, int end, const double* value)
+{
+   for (int ii=begin; ii<end; ++ii)
+      setValue(ii, varHandle, value[ii-begin]);
+}
+
+int Reaction::getParameterHandle(const string& paramName) const
+{
+   return -1;
+}
+
+void Reaction::setParameterColumn(int paramHandle, int begin, int end, const double* value)
+{
+   // Only reactions that hand out parameter handles can be called.
+   assert(false);
+}
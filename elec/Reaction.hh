@@ -16,6 +16,29 @@ class Reaction
                      ro_mgarray_ptr<double> Vm,
                      ro_mgarray_ptr<double> iStim,
                      wo_mgarray_ptr<double> dVm) = 0;
+   /** Fused reaction and forward Euler step.  Computes dVm like calc
+    *  and then sets Vm += dt*(dVm + dVmDiffusion + iStim) for the cells
+    *  of the reaction.  The default calls calc and then makes a second
+    *  pass for the update.  Models that override calcIntegrate to do
+    *  both in one sweep over the cells (so Vm, iStim and dVm are
+    *  streamed once per step instead of twice) return true from
+    *  fusedIntegrate. */
+   virtual bool fusedIntegrate() const {return false;}
+   virtual void calcIntegrate(double dt,
+                              rw_mgarray_ptr<double> Vm,
+                              ro_mgarray_ptr<double> iStim,
+                              ro_mgarray_ptr<double> dVmDiffusion,
+                              wo_mgarray_ptr<double> dVm);
+   /** calc for the cells whose skip flag is zero.  The multirate
+    *  stepping integrates the skipped cells on its own and then
+    *  overwrites their state and dVm, so a model may leave them alone
+    *  or compute them anyway.  The default computes every cell. */
+   virtual void calcSkip(double dt,
+                         ro_mgarray_ptr<double> Vm,
+                         ro_mgarray_ptr<double> iStim,
+                         wo_mgarray_ptr<double> dVm,
+                         const char* skip)
+   {calc(dt, Vm, iStim, dVm);}
    virtual void updateNonGate(double dt, ro_mgarray_ptr<double> Vm, wo_mgarray_ptr<double> dVR) {};
    virtual void updateGate   (double dt, ro_mgarray_ptr<double> Vm) {};
 
@@ -36,8 +59,43 @@ class Reaction
                          const std::vector<int>& handle,
                          std::vector<double>& value) const;
    virtual const std::string getUnit(const std::string& varName) const;
+
+   /** Bulk accessors.  Copy one variable for the cells [begin, end)
+    *  to/from a contiguous buffer.  The defaults loop over
+    *  getValue/setValue.  Concrete classes should override these to
+    *  sweep their state storage directly. */
+   virtual void getColumn(int varHandle, int begin, int end, double* value) const;
+   virtual void setColumn(int varHandle, int begin, int end, const double* value);
+
+   /** Per-cell parameters.  getParameterHandle returns -1 for any
+    *  parameter that must be the same for every cell of the reaction
+    *  (the default).  Models that can vary a parameter from cell to
+    *  cell return a handle that can be passed to setParameterColumn
+    *  to override the value set by the factory for cells [begin, end). */
+   virtual int getParameterHandle(const std::string& paramName) const;
+   virtual void setParameterColumn(int paramHandle, int begin, int end, const double* value);
 };
 
+/** The forward Euler update of cells [begin, begin+n) for the fused
+ *  calcIntegrate kernels.  Same arithmetic as the update in the
+ *  simulation loop. */
+inline void eulerUpdate(double dt, int begin, int n, double* Vm, const double* dVm,
+                        const double* dVmDiffusion, const double* iStim)
+{
+   for (int ii=begin; ii<begin+n; ++ii)
+      Vm[ii] += dt*(dVm[ii]+dVmDiffusion[ii]+iStim[ii]);
+}
+
+/** True when all of the cells [begin, begin+n) are flagged in skip.
+ *  Lets the calcSkip kernels drop whole SIMD blocks. */
+inline bool skipBlock(const char* skip, int begin, int n)
+{
+   for (int ii=begin; ii<begin+n; ++ii)
+      if (!skip[ii])
+         return false;
+   return true;
+}
+
 //! Call this instead of initializeMembraneVoltage directly.
 void initializeMembraneState(Reaction* reaction, const std::string& objectName, wo_mgarray_ptr<double> Vm);
 
@@ -1,15 +1,37 @@
 
 #include <set>
 #include <algorithm>
+#include <limits>
+#include <cmath>
+#include <sstream>
+#include <mpi.h>
 #include "ReactionManager.hh"
 #include "Reaction.hh"
 #include "object_cc.hh"
 #include "units.h"
 #include "reactionFactory.hh"
 #include "slow_fix.hh"
+#include "PerformanceTimers.hh"
+#include "mpiUtils.h"
 
 
 using namespace std;
+using PerformanceTimers::reactionMultirateTimer;
+
+ReactionManager::ReactionManager()
+: dt_(0),
+  nSubsteps_(1),
+  fastThreshold_(0),
+  fastBatchSize_(0),
+  sampleCost_(false)
+{
+}
+
+ReactionManager::~ReactionManager()
+{
+   for (int ridx=0; ridx<fastCells_.size(); ++ridx)
+      delete fastCells_[ridx].fine;
+}
 
 ///pass through routines.
 void ReactionManager::calc(double dt,
@@ -19,13 +41,69 @@ void ReactionManager::calc(double dt,
 {
    for (int ii=0; ii<reactions_.size(); ++ii)
    {
-      reactions_[ii]->calc(dt,
-                           Vm.slice(extents_[ii],extents_[ii+1]),
-                           iStim.slice(extents_[ii],extents_[ii+1]),
-                           dVm.slice(extents_[ii],extents_[ii+1]));
+      double start = sampleCost_ ? MPI_Wtime() : 0;
+      if (multirate() && !fastCells_[ii].run.empty())
+         reactions_[ii]->calcSkip(dt,
+                                  Vm.slice(extents_[ii],extents_[ii+1]),
+                                  iStim.slice(extents_[ii],extents_[ii+1]),
+                                  dVm.slice(extents_[ii],extents_[ii+1]),
+                                  &fastCells_[ii].skip[0]);
+      else
+         reactions_[ii]->calc(dt,
+                              Vm.slice(extents_[ii],extents_[ii+1]),
+                              iStim.slice(extents_[ii],extents_[ii+1]),
+                              dVm.slice(extents_[ii],extents_[ii+1]));
+      if (sampleCost_)
+      {
+         costSeconds_[ii] += MPI_Wtime()-start;
+         costCellSteps_[ii] += extents_[ii+1]-extents_[ii];
+      }
    }
 }
    
+bool ReactionManager::fusedIntegrate() const
+{
+   if (multirate())
+      return false;
+   for (int ii=0; ii<reactions_.size(); ++ii)
+      if (reactions_[ii]->fusedIntegrate())
+         return true;
+   return false;
+}
+
+void ReactionManager::calcIntegrate(double dt,
+                                    rw_mgarray_ptr<double> Vm,
+                                    ro_mgarray_ptr<double> iStim,
+                                    ro_mgarray_ptr<double> dVmDiffusion,
+                                    wo_mgarray_ptr<double> dVm)
+{
+   for (int ii=0; ii<reactions_.size(); ++ii)
+   {
+      double start = sampleCost_ ? MPI_Wtime() : 0;
+      reactions_[ii]->calcIntegrate(dt,
+                                    Vm.slice(extents_[ii],extents_[ii+1]),
+                                    iStim.slice(extents_[ii],extents_[ii+1]),
+                                    dVmDiffusion.slice(extents_[ii],extents_[ii+1]),
+                                    dVm.slice(extents_[ii],extents_[ii+1]));
+      if (sampleCost_)
+      {
+         costSeconds_[ii] += MPI_Wtime()-start;
+         costCellSteps_[ii] += extents_[ii+1]-extents_[ii];
+      }
+   }
+   // cells without a reaction still follow the diffusion and stimulus.
+   const int nReaction = extents_.back();
+   if (nReaction < Vm.size())
+   {
+      rw_array_ptr<double> VmCpu = Vm.useOn(CPU);
+      ro_array_ptr<double> iStimCpu = iStim.useOn(CPU);
+      ro_array_ptr<double> dVmDCpu = dVmDiffusion.useOn(CPU);
+      wo_array_ptr<double> dVmCpu = dVm.useOn(CPU);
+      eulerUpdate(dt, nReaction, Vm.size()-nReaction, VmCpu.raw(),
+                  dVmCpu.raw(), dVmDCpu.raw(), iStimCpu.raw());
+   }
+}
+
 void ReactionManager::updateNonGate(double dt, ro_mgarray_ptr<double> Vm, wo_mgarray_ptr<double> dVR)
 {
    for (int ii=0; ii<reactions_.size(); ++ii)
@@ -61,6 +139,28 @@ void ReactionManager::addReaction(const std::string& rxnObjectName)
    objectNameFromRidx_.push_back(rxnObjectName);
 }
 
+/** Splits the keyword=value; pairs of an object. */
+static vector<pair<string, string> > keywordsFromObject(OBJECT* obj)
+{
+   vector<pair<string, string> > keywords;
+   stringstream buf(obj->value);
+   string entry;
+   while (getline(buf, entry, ';'))
+   {
+      size_t equals = entry.find('=');
+      if (equals == string::npos)
+         continue;
+      string key = entry.substr(0, equals);
+      string value = entry.substr(equals+1);
+      key.erase(0, key.find_first_not_of(" \t\n"));
+      key.erase(key.find_last_not_of(" \t\n")+1);
+      value.erase(0, value.find_first_not_of(" \t\n"));
+      value.erase(value.find_last_not_of(" \t\n")+1);
+      keywords.push_back(make_pair(key, value));
+   }
+   return keywords;
+}
+
 class SortByRidxThenAnatomyThenGid {
  public:
    const map<int, int>& ridxFromTag_;
@@ -98,62 +198,57 @@ class SortByRidxThenAnatomyThenGid {
 
 void ReactionManager::create(const double dt, Anatomy& anatomy, const ThreadTeam &group)
 {
+   dt_ = dt;
    //construct an array of all the objects
    int numReactions=objectNameFromRidx_.size();
    vector<OBJECT*> objects(numReactions);
+   vector<string> methodFromObject(numReactions);
    for (int ii=0; ii<numReactions; ++ii)
    {
        objects[ii] = objectFind(objectNameFromRidx_[ii], "REACTION");
+       objectGet(objects[ii], "method", methodFromObject[ii], "");
+       assert(methodFromObject[ii] != "");
    }
 
    //get all the method types
    int numTypes;
+   map<string, int> typeFromMethod;
    {
-      set<string> methodTypeSet;
-      for (int ii=0; ii<numReactions; ++ii)
-      {
-         string method;
-         objectGet(objects[ii], "method", method, "");
-         assert(method != "");
-         methodTypeSet.insert(method);
-      }
+      set<string> methodTypeSet(methodFromObject.begin(), methodFromObject.end());
       numTypes = methodTypeSet.size();
       methodNameFromType_.resize(numTypes);
       copy(methodTypeSet.begin(), methodTypeSet.end(), methodNameFromType_.begin());
+      for (int itype=0; itype<numTypes; ++itype)
+      {
+         typeFromMethod[methodNameFromType_[itype]] = itype;
+      }
    }
 
    typeFromRidx_.resize(numReactions);
    {
+      //stable counting sort of the reactions by type.
+      vector<int> cursorFromType(numTypes+1, 0);
+      for (int ireaction=0; ireaction<numReactions; ++ireaction)
+      {
+         cursorFromType[typeFromMethod[methodFromObject[ireaction]]+1]++;
+      }
+      for (int itype=0; itype<numTypes; ++itype)
+      {
+         cursorFromType[itype+1] += cursorFromType[itype];
+      }
       vector<int> reactionReordering(numReactions);
+      for (int ireaction=0; ireaction<numReactions; ++ireaction)
       {
-         int cursor=0;
-         for (int itype=0; itype<numTypes; ++itype)
-         {
-            for (int ireaction=0; ireaction<numReactions; ++ireaction) //bottleneck when #reactions large
-            {
-               string method;
-               objectGet(objects[ireaction], "method", method, "");
-               if (method == methodNameFromType_[itype])
-               {
-                  /*
-                    note, we use cursor instead of ireaction here
-                    because we're about to reorder the object arrays.
-                    This ensures that the typeFromRidx array
-                    corresponds to the same things as what the
-                    objects[] array and objectNameFromRidx_ arrays
-                    point to.
-
-                    If we used ireaction instead, we would have to
-                    permute the arrays below, and we don't want to do
-                    that.
-                  */
-                  typeFromRidx_[cursor] = itype;
-                  reactionReordering[ireaction] = cursor++;
-                  
-               }
-            }
-         }
-         assert(cursor == numReactions);
+         /*
+           note, we index typeFromRidx by the new position rather than
+           ireaction because we're about to reorder the object arrays.
+           This ensures that the typeFromRidx array corresponds to the
+           same things as what the objects[] array and
+           objectNameFromRidx_ arrays point to.
+         */
+         int itype = typeFromMethod[methodFromObject[ireaction]];
+         typeFromRidx_[cursorFromType[itype]] = itype;
+         reactionReordering[ireaction] = cursorFromType[itype]++;
       }
 
       vector<string> nameCopy(numReactions);
@@ -205,19 +300,117 @@ void ReactionManager::create(const double dt, Anatomy& anatomy, const ThreadTeam
       assert(!foundCellTypeProblem);
    }
    
+   //Merge reactions of the same method whose objects differ only in
+   //parameters the model can vary from cell to cell.  Heterogeneous
+   //tissue then runs as one sweep per method instead of one pass per
+   //REACTION object.  From here on ridx refers to the merged
+   //reactions.  memberObjects holds the original objects.
+   vector<OBJECT*> memberObjects(objects);
+   vector<int> ridxFromMember(numReactions);
+   vector<vector<string> > variedParamsFromRidx;
+   {
+      vector<OBJECT*> mergedObjects;
+      vector<string> mergedNames;
+      vector<int> mergedTypes;
+      vector<vector<string> > perCellParamsFromRidx;
+      map<string, int> ridxFromSignature;
+      Reaction* prototype = NULL;
+      int prototypeType = -1;
+      for (int ireaction=0; ireaction<numReactions; ++ireaction)
+      {
+         int itype = typeFromRidx_[ireaction];
+         bool typeHasSiblings =
+            (ireaction > 0 && typeFromRidx_[ireaction-1] == itype) ||
+            (ireaction+1 < numReactions && typeFromRidx_[ireaction+1] == itype);
+         string signature;
+         vector<string> perCellParams;
+         if (typeHasSiblings)
+         {
+            if (prototypeType != itype)
+            {
+               delete prototype;
+               prototype = reactionFactory(objectNameFromRidx_[ireaction], dt, 0, group);
+               prototypeType = itype;
+            }
+            vector<pair<string, string> > keywords = keywordsFromObject(objects[ireaction]);
+            sort(keywords.begin(), keywords.end());
+            for (int ikey=0; ikey<keywords.size(); ++ikey)
+            {
+               const string& key(keywords[ikey].first);
+               if (key == "cellTypes")
+                  continue;
+               signature += key;
+               if (prototype->getParameterHandle(key) != -1)
+                  perCellParams.push_back(key);
+               else
+                  signature += "=" + keywords[ikey].second;
+               signature += ";";
+            }
+            map<string, int>::const_iterator iter = ridxFromSignature.find(signature);
+            if (iter != ridxFromSignature.end())
+            {
+               ridxFromMember[ireaction] = iter->second;
+               continue;
+            }
+            ridxFromSignature[signature] = mergedObjects.size();
+         }
+         ridxFromMember[ireaction] = mergedObjects.size();
+         mergedObjects.push_back(objects[ireaction]);
+         mergedNames.push_back(objectNameFromRidx_[ireaction]);
+         mergedTypes.push_back(itype);
+         perCellParamsFromRidx.push_back(perCellParams);
+      }
+      delete prototype;
+
+      //only parameters that actually differ need per-cell storage.
+      variedParamsFromRidx.resize(mergedObjects.size());
+      for (int ridx=0; ridx<mergedObjects.size(); ++ridx)
+      {
+         for (int iparam=0; iparam<perCellParamsFromRidx[ridx].size(); ++iparam)
+         {
+            const string& param(perCellParamsFromRidx[ridx][iparam]);
+            double baseValue;
+            objectGet(mergedObjects[ridx], param, baseValue, "0");
+            for (int imember=0; imember<numReactions; ++imember)
+            {
+               if (ridxFromMember[imember] != ridx)
+                  continue;
+               double value;
+               objectGet(memberObjects[imember], param, value, "0");
+               if (value != baseValue)
+               {
+                  variedParamsFromRidx[ridx].push_back(param);
+                  break;
+               }
+            }
+         }
+      }
+
+      if (mergedObjects.size() < memberObjects.size() && getRank(0) == 0)
+         printf("Merged %d REACTION objects into %d reactions with per-cell parameters.\n",
+                int(memberObjects.size()), int(mergedObjects.size()));
+
+      objects = mergedObjects;
+      objectNameFromRidx_ = mergedNames;
+      typeFromRidx_ = mergedTypes;
+      numReactions = mergedObjects.size();
+   }
+
    //find all the anatomy tags that have been set as reaction models
    map<int, int> ridxFromCellType;
-   for (int ireaction=0; ireaction<numReactions; ++ireaction)
+   map<int, int> memberFromCellType;
+   for (int imember=0; imember<memberObjects.size(); ++imember)
    {
       vector<int> anatomyCellTypes;
-      objectGet(objects[ireaction], "cellTypes", anatomyCellTypes);
+      objectGet(memberObjects[imember], "cellTypes", anatomyCellTypes);
       for (int itag=0; itag<anatomyCellTypes.size(); ++itag)
       {
          if (ridxFromCellType.find(anatomyCellTypes[itag]) != ridxFromCellType.end())
          {
             assert(0 && "Duplicate cellTypes within the reaction models");
          }
-         ridxFromCellType[anatomyCellTypes[itag]] = ireaction;
+         ridxFromCellType[anatomyCellTypes[itag]] = ridxFromMember[imember];
+         memberFromCellType[anatomyCellTypes[itag]] = imember;
          allCellTypes_.insert(anatomyCellTypes[itag]);
       }
    }
@@ -273,6 +466,37 @@ void ReactionManager::create(const double dt, Anatomy& anatomy, const ThreadTeam
       extents_[ireaction+1] = extents_[ireaction]+localSize;
       int bufferSize = convertActualSizeToBufferSize(localSize);
    }
+   resetCost();
+
+   //hand the per-cell parameters of merged reactions to the models.
+   //Keep a copy so that setMultirate can pass them on.
+   paramColumnsFromRidx_.resize(numReactions);
+   for (int ireaction=0; ireaction<numReactions; ++ireaction)
+   {
+      const vector<string>& variedParams(variedParamsFromRidx[ireaction]);
+      for (int iparam=0; iparam<variedParams.size(); ++iparam)
+      {
+         int paramHandle = reactions_[ireaction]->getParameterHandle(variedParams[iparam]);
+         assert(paramHandle != -1);
+         map<int, double> valueFromCellType;
+         for (map<int, int>::const_iterator iter=memberFromCellType.begin();
+              iter != memberFromCellType.end();
+              ++iter)
+         {
+            if (ridxFromMember[iter->second] != ireaction)
+               continue;
+            objectGet(memberObjects[iter->second], variedParams[iparam],
+                      valueFromCellType[iter->first], "0");
+         }
+         vector<double> column(countFromRidx[ireaction]);
+         for (int icell=extents_[ireaction]; icell<extents_[ireaction+1]; ++icell)
+         {
+            column[icell-extents_[ireaction]] = valueFromCellType[cellArray[icell].cellType_];
+         }
+         reactions_[ireaction]->setParameterColumn(paramHandle, 0, column.size(), &column[0]);
+         paramColumnsFromRidx_[ireaction].push_back(make_pair(paramHandle, column));
+      }
+   }
 
    //Ok, now we've created the reaction objects.  Now we need to
    //figure out the state variables will map.
@@ -446,6 +670,266 @@ void ReactionManager::getValue(int iCell,
    for (unsigned ii=0; ii<handle.size(); ++ii)
       value[ii] = getValue(iCell, handle[ii]);
 }
+/** Resolves the sub-reaction and sub-handle once per reaction rather
+ *  than once per cell.  Cells whose reaction doesn't define varHandle
+ *  get NaN, just like getValue. */
+void ReactionManager::getColumn(int varHandle, int begin, int end, double* value) const
+{
+   for (int ridx=getRidxFromCell(begin); ridx<reactions_.size() && extents_[ridx]<end; ++ridx)
+   {
+      int lo = max(begin, extents_[ridx]);
+      int hi = min(end, extents_[ridx+1]);
+      if (lo >= hi)
+         continue;
+      double* out = value+(lo-begin);
+      int subHandle;
+      double myUnitFromTheirUnit;
+      if (subUsesHandle(ridx, varHandle, subHandle, myUnitFromTheirUnit))
+      {
+         reactions_[ridx]->getColumn(subHandle, lo-extents_[ridx], hi-extents_[ridx], out);
+         if (myUnitFromTheirUnit != 1.0)
+            for (int ii=0; ii<hi-lo; ++ii)
+               out[ii] *= myUnitFromTheirUnit;
+      }
+      else
+      {
+         fill(out, out+(hi-lo), numeric_limits<double>::quiet_NaN());
+      }
+   }
+}
+
+void ReactionManager::setColumn(int varHandle, int begin, int end, const double* value)
+{
+   vector<double> tmp;
+   for (int ridx=getRidxFromCell(begin); ridx<reactions_.size() && extents_[ridx]<end; ++ridx)
+   {
+      int lo = max(begin, extents_[ridx]);
+      int hi = min(end, extents_[ridx+1]);
+      int subHandle;
+      double myUnitFromTheirUnit;
+      if (lo >= hi || !subUsesHandle(ridx, varHandle, subHandle, myUnitFromTheirUnit))
+         continue;
+      const double* in = value+(lo-begin);
+      if (myUnitFromTheirUnit != 1.0)
+      {
+         tmp.resize(hi-lo);
+         for (int ii=0; ii<hi-lo; ++ii)
+            tmp[ii] = in[ii]/myUnitFromTheirUnit;
+         in = &tmp[0];
+      }
+      reactions_[ridx]->setColumn(subHandle, lo-extents_[ridx], hi-extents_[ridx], in);
+   }
+}
+
+/** Creates a companion reaction for every ridx that runs at
+ *  dt/nSubsteps on batchSize cells.  Must be called after create.
+ *  nSubsteps <= 1 turns multirate stepping off. */
+void ReactionManager::setMultirate(int nSubsteps, double threshold, int batchSize,
+                                   const ThreadTeam& group)
+{
+   assert(dt_ > 0);
+   assert(batchSize > 0);
+   for (int ridx=0; ridx<fastCells_.size(); ++ridx)
+      delete fastCells_[ridx].fine;
+   fastCells_.clear();
+
+   nSubsteps_ = max(1, nSubsteps);
+   fastThreshold_ = threshold;
+   fastBatchSize_ = batchSize;
+   if (!multirate())
+      return;
+
+   fastCells_.resize(reactions_.size());
+   for (int ridx=0; ridx<reactions_.size(); ++ridx)
+   {
+      FastCells& fast(fastCells_[ridx]);
+      fast.fine = reactionFactory(objectNameFromRidx_[ridx], dt_/nSubsteps_, fastBatchSize_, group);
+      vector<string> fieldNames, fieldUnits;
+      reactions_[ridx]->getCheckpointInfo(fieldNames, fieldUnits);
+      fast.stateHandle = reactions_[ridx]->getVarHandle(fieldNames);
+      fast.Vm.resize(fastBatchSize_);
+      fast.iStim.resize(fastBatchSize_);
+      fast.dVm.resize(fastBatchSize_);
+      wo_array_ptr<double> iStim = fast.iStim.writeonly(CPU);
+      for (int ii=0; ii<fastBatchSize_; ++ii)
+         iStim[ii] = 0;
+   }
+}
+
+/** A cell is fast when the total rate of change of its membrane
+ *  voltage at the last step exceeds the threshold.  Cells are picked
+ *  in aligned groups of fastGroup so that calcSkip can drop whole
+ *  SIMD blocks.  Stores the state of the fast cells in case the model
+ *  can't skip them in calc. */
+void ReactionManager::selectFastCells(ro_mgarray_ptr<double> iStim_mg,
+                                      ro_mgarray_ptr<double> dVmReaction_mg,
+                                      ro_mgarray_ptr<double> dVmDiffusion_mg)
+{
+   if (!multirate())
+      return;
+   startTimer(reactionMultirateTimer);
+   // a multiple of every SIMD width we build for.
+   const int fastGroup = 8;
+   ro_array_ptr<double> iStim = iStim_mg.useOn(CPU);
+   ro_array_ptr<double> dVmR = dVmReaction_mg.useOn(CPU);
+   ro_array_ptr<double> dVmD = dVmDiffusion_mg.useOn(CPU);
+   for (int ridx=0; ridx<reactions_.size(); ++ridx)
+   {
+      FastCells& fast(fastCells_[ridx]);
+      int offset = extents_[ridx];
+      int nCells = extents_[ridx+1]-offset;
+      fast.cell.clear();
+      fast.run.clear();
+      fast.skip.assign(nCells, 0);
+      for (int lo=0; lo<nCells; lo+=fastGroup)
+      {
+         int hi = min(lo+fastGroup, nCells);
+         bool isFast = false;
+         for (int ii=lo; ii<hi && !isFast; ++ii)
+            isFast = fabs(dVmR[offset+ii]+dVmD[offset+ii]+iStim[offset+ii]) > fastThreshold_;
+         if (!isFast)
+            continue;
+         if (!fast.run.empty() && fast.run.back().second == lo)
+            fast.run.back().second = hi;
+         else
+            fast.run.push_back(make_pair(lo, hi));
+         for (int ii=lo; ii<hi; ++ii)
+         {
+            fast.cell.push_back(ii);
+            fast.skip[ii] = 1;
+         }
+      }
+      int nFast = fast.cell.size();
+      fast.state.resize(nFast*fast.stateHandle.size());
+      if (nFast == 0)
+         continue;
+      for (int jj=0; jj<fast.stateHandle.size(); ++jj)
+      {
+         double* column = &fast.state[0]+jj*nFast;
+         for (int kk=0; kk<fast.run.size(); ++kk)
+         {
+            reactions_[ridx]->getColumn(fast.stateHandle[jj], fast.run[kk].first, fast.run[kk].second, column);
+            column += fast.run[kk].second-fast.run[kk].first;
+         }
+      }
+   }
+   stopTimer(reactionMultirateTimer);
+}
+
+/** Starts the fast cells from the state saved by selectFastCells and
+ *  takes nSubsteps reaction steps with the diffusion and stimulus
+ *  currents of this step held fixed. */
+void ReactionManager::calcFastCells(double dt,
+                                    ro_mgarray_ptr<double> Vm_mg,
+                                    ro_mgarray_ptr<double> iStim_mg,
+                                    ro_mgarray_ptr<double> dVmDiffusion_mg,
+                                    rw_mgarray_ptr<double> dVmReaction_mg)
+{
+   if (!multirate())
+      return;
+   startTimer(reactionMultirateTimer);
+   assert(dt == dt_);
+   ro_array_ptr<double> Vm = Vm_mg.useOn(CPU);
+   ro_array_ptr<double> iStim = iStim_mg.useOn(CPU);
+   ro_array_ptr<double> dVmD = dVmDiffusion_mg.useOn(CPU);
+   rw_array_ptr<double> dVmR = dVmReaction_mg.useOn(CPU);
+   double h = dt/nSubsteps_;
+   vector<double> column(fastBatchSize_);
+   vector<double> source(fastBatchSize_);
+   vector<char> padding(fastBatchSize_);
+   for (int ridx=0; ridx<reactions_.size(); ++ridx)
+   {
+      FastCells& fast(fastCells_[ridx]);
+      int nState = fast.stateHandle.size();
+      int nFast = fast.cell.size();
+      int offset = extents_[ridx];
+      if (nFast == 0)
+         continue;
+      double start = sampleCost_ ? MPI_Wtime() : 0;
+      for (int first=0; first<nFast; first+=fastBatchSize_)
+      {
+         int nBatch = min(fastBatchSize_, nFast-first);
+         //pad the batch by repeating the last cell so that the unused
+         //lanes stay physiological in models that can't skip them.
+         const int* cell = &fast.cell[first];
+         fill(padding.begin(), padding.begin()+nBatch, 0);
+         fill(padding.begin()+nBatch, padding.end(), 1);
+         for (int jj=0; jj<nState; ++jj)
+         {
+            const double* saved = &fast.state[jj*nFast+first];
+            copy(saved, saved+nBatch, column.begin());
+            fill(column.begin()+nBatch, column.end(), saved[nBatch-1]);
+            fast.fine->setColumn(fast.stateHandle[jj], 0, fastBatchSize_, &column[0]);
+         }
+         const vector<pair<int, vector<double> > >& params(paramColumnsFromRidx_[ridx]);
+         for (int kk=0; kk<params.size(); ++kk)
+         {
+            for (int ii=0; ii<fastBatchSize_; ++ii)
+               column[ii] = params[kk].second[cell[min(ii, nBatch-1)]];
+            fast.fine->setParameterColumn(params[kk].first, 0, fastBatchSize_, &column[0]);
+         }
+         {
+            wo_array_ptr<double> VmB = fast.Vm.writeonly(CPU);
+            for (int ii=0; ii<fastBatchSize_; ++ii)
+            {
+               int icell = offset+cell[min(ii, nBatch-1)];
+               VmB[ii] = Vm[icell];
+               source[ii] = dVmD[icell]+iStim[icell];
+            }
+         }
+         for (int istep=0; istep<nSubsteps_; ++istep)
+         {
+            fast.fine->calcSkip(h, fast.Vm, fast.iStim, fast.dVm, &padding[0]);
+            rw_array_ptr<double> VmB = fast.Vm.readwrite(CPU);
+            ro_array_ptr<double> dVmB = fast.dVm.readonly(CPU);
+            for (int ii=0; ii<nBatch; ++ii)
+               VmB[ii] += h*(dVmB[ii]+source[ii]);
+         }
+         for (int jj=0; jj<nState; ++jj)
+            fast.fine->getColumn(fast.stateHandle[jj], 0, nBatch, &fast.state[jj*nFast+first]);
+         ro_array_ptr<double> VmB = fast.Vm.readonly(CPU);
+         for (int ii=0; ii<nBatch; ++ii)
+         {
+            int icell = offset+cell[ii];
+            dVmR[icell] = (VmB[ii]-Vm[icell])/dt - source[ii];
+         }
+      }
+      // the fast cells are contiguous runs in the reaction.
+      for (int jj=0; jj<nState; ++jj)
+      {
+         const double* column = &fast.state[0]+jj*nFast;
+         for (int kk=0; kk<fast.run.size(); ++kk)
+         {
+            reactions_[ridx]->setColumn(fast.stateHandle[jj], fast.run[kk].first, fast.run[kk].second, column);
+            column += fast.run[kk].second-fast.run[kk].first;
+         }
+      }
+      if (sampleCost_)
+         costSeconds_[ridx] += MPI_Wtime()-start;
+   }
+   stopTimer(reactionMultirateTimer);
+}
+
+int ReactionManager::nFastCells() const
+{
+   int nFast = 0;
+   for (int ridx=0; ridx<fastCells_.size(); ++ridx)
+      nFast += fastCells_[ridx].cell.size();
+   return nFast;
+}
+
+void ReactionManager::getCost(vector<double>& seconds, vector<double>& cellSteps) const
+{
+   seconds = costSeconds_;
+   cellSteps = costCellSteps_;
+}
+
+void ReactionManager::resetCost()
+{
+   costSeconds_.assign(reactions_.size(), 0.0);
+   costCellSteps_.assign(reactions_.size(), 0.0);
+}
+
 const std::string ReactionManager::getUnit(const std::string& varName) const
 {
    return unitFromHandle_[getVarHandle(varName)];
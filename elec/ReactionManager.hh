@@ -15,10 +15,27 @@ class Reaction;
 class ReactionManager
 {
  public:
+   ReactionManager();
+   ~ReactionManager();
+
    void calc(double dt,
              ro_mgarray_ptr<double> Vm,
              ro_mgarray_ptr<double> iStim,
              wo_mgarray_ptr<double> dVm);
+   /** True when every step can use calcIntegrate instead of calc
+    *  followed by the Euler update: at least one reaction has a fused
+    *  kernel and there is no multirate sub-cycling, which has to
+    *  change dVm between the two.  The loop only uses it when the
+    *  SIMULATE keyword fusedIntegrate asks for it. */
+   bool fusedIntegrate() const;
+   /** calc and Vm += dt*(dVm + dVmDiffusion + iStim) in one pass per
+    *  reaction.  dVm is still filled in for the sensors and the range
+    *  checks. */
+   void calcIntegrate(double dt,
+                      rw_mgarray_ptr<double> Vm,
+                      ro_mgarray_ptr<double> iStim,
+                      ro_mgarray_ptr<double> dVmDiffusion,
+                      wo_mgarray_ptr<double> dVm);
    void updateNonGate(double dt, ro_mgarray_ptr<double> Vm, wo_mgarray_ptr<double> dVR);
    void updateGate   (double dt, ro_mgarray_ptr<double> Vm);
    std::string stateDescription() const;
@@ -42,9 +59,58 @@ class ReactionManager
                  const std::vector<int>& handle,
                  std::vector<double>& value) const;
    const std::string getUnit(const std::string& varName) const;
+   void getColumn(int varHandle, int begin, int end, double* value) const;
+   void setColumn(int varHandle, int begin, int end, const double* value);
    std::vector<int> allCellTypes() const;
-   
+
+   /** Multirate reaction stepping.  Cells whose |dVm/dt| exceeds
+    *  threshold (mV/ms) are integrated with nSubsteps steps of
+    *  dt/nSubsteps, batchSize cells at a time, while the rest of the
+    *  tissue takes one step of the global dt.  Call selectFastCells
+    *  before calc (dVmReaction and dVmDiffusion still hold the values
+    *  from the previous step) and calcFastCells once dVmDiffusion for
+    *  the current step is known.  calc leaves out the fast cells when
+    *  the model supports Reaction::calcSkip.  calcFastCells replaces
+    *  dVmReaction of the fast cells with the effective rate over the
+    *  whole step so that the usual forward Euler update lands on the
+    *  sub-cycled voltage. */
+   void setMultirate(int nSubsteps, double threshold, int batchSize, const ThreadTeam& group);
+   bool multirate() const {return nSubsteps_ > 1;}
+   void selectFastCells(ro_mgarray_ptr<double> iStim,
+                        ro_mgarray_ptr<double> dVmReaction,
+                        ro_mgarray_ptr<double> dVmDiffusion);
+   void calcFastCells(double dt,
+                      ro_mgarray_ptr<double> Vm,
+                      ro_mgarray_ptr<double> iStim,
+                      ro_mgarray_ptr<double> dVmDiffusion,
+                      rw_mgarray_ptr<double> dVmReaction);
+   int nFastCells() const;
+
+   /** Wall clock time spent by each reaction in calc (including the
+    *  sub-cycled cells) and the number of cell updates it made in the
+    *  steps sampled since the last call to resetCost.  Indexed by ridx,
+    *  which is the same on every task.  Used by the Rebalancer, which
+    *  turns sampling on only for a few steps before each check. */
+   void getCost(std::vector<double>& seconds, std::vector<double>& cellSteps) const;
+   void resetCost();
+   void sampleCost(bool on) {sampleCost_ = on;}
+   int getRidxFromCell(const int iCell) const;
+
  private:
+   /** Work space for the sub-cycled cells of one reaction. */
+   struct FastCells
+   {
+      Reaction* fine;
+      std::vector<int> stateHandle;
+      std::vector<int> cell;
+      std::vector<std::pair<int, int> > run;
+      std::vector<char> skip;
+      std::vector<double> state;
+      lazy_array<double> Vm;
+      lazy_array<double> iStim;
+      lazy_array<double> dVm;
+   };
+
    std::vector<std::string> objectNameFromRidx_;
    std::vector<Reaction*> reactions_;
    std::vector<int> extents_;
@@ -52,7 +118,6 @@ class ReactionManager
    std::vector<std::string> unitFromHandle_;
    std::map<std::string, int> handleFromVarname_;
 
-   int getRidxFromCell(const int iCell) const;
    bool subUsesHandle(const int ridx, const int handle, int& subHandle, double& myUnitFromTheirUnit) const;
    
    std::vector<std::map<int, std::pair<int, double> > > subHandleInfoFromTypeAndHandle_;
@@ -60,6 +125,16 @@ class ReactionManager
    std::vector<int> typeFromRidx_;
    std::vector<std::string> methodNameFromType_;
    std::set<int> allCellTypes_;
+
+   double dt_;
+   std::vector<std::vector<std::pair<int, std::vector<double> > > > paramColumnsFromRidx_;
+   int nSubsteps_;
+   double fastThreshold_;
+   int fastBatchSize_;
+   std::vector<FastCells> fastCells_;
+   bool sampleCost_;
+   std::vector<double> costSeconds_;
+   std::vector<double> costCellSteps_;
 };
 
 #endif
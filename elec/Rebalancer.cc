@@ -0,0 +1,535 @@
+#include "Rebalancer.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <cassert>
+#include <mpi.h>
+
+#include "Simulate.hh"
+#include "Anatomy.hh"
+#include "ReactionManager.hh"
+#include "Diffusion.hh"
+#include "Stimulus.hh"
+#include "Sensor.hh"
+#include "initializeSimulate.hh"
+#include "OutputService.hh"
+#include "PerformanceTimers.hh"
+#include "mpiUtils.h"
+#include "CommTable.hh"
+
+using namespace std;
+using PerformanceTimers::rebalanceTimer;
+
+namespace
+{
+   void weightedBisection(const Anatomy& anatomy, const vector<double>& weight,
+                          vector<int>& dest, MPI_Comm comm);
+}
+
+Rebalancer::Rebalancer(int rate, double threshold, const string& variantHint)
+: rate_(rate),
+  nSample_(min(rate, 10)),
+  threshold_(threshold),
+  variantHint_(variantHint),
+  diffusionSeconds_(0),
+  diffusionCellSteps_(0),
+  warnedSensors_(false)
+{
+   assert(rate_ > 0);
+}
+
+void Rebalancer::addDiffusionTime(double seconds, int nCells)
+{
+   diffusionSeconds_ += seconds;
+   diffusionCellSteps_ += nCells;
+}
+
+bool Rebalancer::rebalance(Simulate& sim)
+{
+   MPI_Comm comm = MPI_COMM_WORLD;
+   int nTasks;  MPI_Comm_size(comm, &nTasks);
+   int myRank;  MPI_Comm_rank(comm, &myRank);
+
+   // cost measured since the last check.  The per-cell costs are
+   // global averages, the task time decides whether to act.
+   vector<double> seconds, cellSteps;
+   sim.reaction_->getCost(seconds, cellSteps);
+   sim.reaction_->resetCost();
+   int nReactions = seconds.size();
+   vector<double> myCost(2*nReactions+2);
+   copy(seconds.begin(), seconds.end(), myCost.begin());
+   copy(cellSteps.begin(), cellSteps.end(), myCost.begin()+nReactions);
+   myCost[2*nReactions] = diffusionSeconds_;
+   myCost[2*nReactions+1] = diffusionCellSteps_;
+   double myTime = accumulate(seconds.begin(), seconds.end(), diffusionSeconds_);
+   diffusionSeconds_ = 0;
+   diffusionCellSteps_ = 0;
+
+   // sensors that hold data for their next print would lose it.
+   {
+      int myCanMigrate = 1;
+      for (unsigned ii=0; ii<sim.sensor_.size(); ++ii)
+         if (!sim.sensor_[ii]->canMigrate())
+            myCanMigrate = 0;
+      int canMigrate;
+      MPI_Allreduce(&myCanMigrate, &canMigrate, 1, MPI_INT, MPI_MIN, comm);
+      if (canMigrate == 0)
+      {
+         if (myRank == 0 && !warnedSensors_)
+            cout << "Rebalance at loop " << sim.loop_
+                 << ": skipped, sensors hold data for their next print" << endl;
+         warnedSensors_ = true;
+         return false;
+      }
+   }
+
+   vector<double> cost(myCost.size());
+   MPI_Allreduce(&myCost[0], &cost[0], myCost.size(), MPI_DOUBLE, MPI_SUM, comm);
+   double maxTime, sumTime;
+   MPI_Allreduce(&myTime, &maxTime, 1, MPI_DOUBLE, MPI_MAX, comm);
+   MPI_Allreduce(&myTime, &sumTime, 1, MPI_DOUBLE, MPI_SUM, comm);
+   if (sumTime <= 0)
+      return false;
+   double imbalance = maxTime*nTasks/sumTime;
+   if (imbalance <= threshold_)
+      return false;
+
+   profileStart(rebalanceTimer);
+   const Anatomy& anatomy = sim.anatomy_;
+   unsigned nLocal = anatomy.nLocal();
+   vector<double> costPerCellFromRidx(nReactions, 0.0);
+   for (int ridx=0; ridx<nReactions; ++ridx)
+      if (cost[nReactions+ridx] > 0)
+         costPerCellFromRidx[ridx] = cost[ridx]/cost[nReactions+ridx];
+   double diffusionCostPerCell = 0;
+   if (cost[2*nReactions+1] > 0)
+      diffusionCostPerCell = cost[2*nReactions]/cost[2*nReactions+1];
+
+   vector<double> weight(nLocal);
+   for (unsigned ii=0; ii<nLocal; ++ii)
+      weight[ii] = diffusionCostPerCell + costPerCellFromRidx[sim.reaction_->getRidxFromCell(ii)];
+
+   vector<int> dest(nLocal);
+   weightedBisection(anatomy, weight, dest, comm);
+
+   // report the imbalance the measured costs predict for the new
+   // partition.
+   {
+      vector<double> myLoad(nTasks, 0.0);
+      Long64 myMoved = 0;
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         myLoad[dest[ii]] += weight[ii];
+         if (dest[ii] != myRank)
+            ++myMoved;
+      }
+      vector<double> load(nTasks);
+      Long64 nMoved;
+      MPI_Allreduce(&myLoad[0], &load[0], nTasks, MPI_DOUBLE, MPI_SUM, comm);
+      MPI_Allreduce(&myMoved, &nMoved, 1, MPI_LONG_LONG, MPI_SUM, comm);
+      double maxLoad = *max_element(load.begin(), load.end());
+      double sumLoad = accumulate(load.begin(), load.end(), 0.0);
+      double predicted = maxLoad*nTasks/sumLoad;
+      if (nMoved == 0 || predicted >= imbalance)
+      {
+         if (myRank == 0)
+            cout << "Rebalance at loop " << sim.loop_
+                 << ": measured imbalance " << imbalance
+                 << ", no better partition found (predicted " << predicted << ", " << nMoved << " cells moved)" << endl;
+         profileStop(rebalanceTimer);
+         return false;
+      }
+      if (myRank == 0)
+      {
+         cout << "Rebalance at loop " << sim.loop_
+              << ": measured imbalance " << imbalance
+              << ", predicted imbalance " << predicted
+              << ", " << nMoved << " cells moved" << endl;
+         for (int ridx=0; ridx<nReactions; ++ridx)
+            cout << "   reaction " << ridx << ": "
+                 << costPerCellFromRidx[ridx]*1e9 << " ns/cell/step" << endl;
+         cout << "   diffusion: " << diffusionCostPerCell*1e9 << " ns/cell/step" << endl;
+      }
+   }
+
+   migrate(sim, dest);
+   profileStop(rebalanceTimer);
+   return true;
+}
+
+/** Moves each local cell to task dest together with Vm, dVmReaction,
+ *  dVmDiffusion, every reaction state variable and the cell values of
+ *  the sensors, then rebuilds the objects that depend on the
+ *  decomposition and restores the cell data by gid.  The new sensors
+ *  continue from the old ones (see Sensor::continueFrom). */
+void Rebalancer::migrate(Simulate& sim, const vector<int>& dest)
+{
+   MPI_Comm comm = MPI_COMM_WORLD;
+   int nTasks;  MPI_Comm_size(comm, &nTasks);
+   int myRank;  MPI_Comm_rank(comm, &myRank);
+   Anatomy& anatomy = sim.anatomy_;
+   unsigned nLocal = anatomy.nLocal();
+
+   vector<string> fieldNames, fieldUnits;
+   sim.reaction_->getCheckpointInfo(fieldNames, fieldUnits);
+   vector<int> handle = sim.reaction_->getVarHandle(fieldNames);
+   const int nReactionValues = 3 + handle.size();
+   vector<int> sensorOffset(sim.sensor_.size()+1, nReactionValues);
+   for (unsigned kk=0; kk<sim.sensor_.size(); ++kk)
+      sensorOffset[kk+1] = sensorOffset[kk] + sim.sensor_[kk]->nCellValues();
+   const int nValues = sensorOffset.back();
+
+   vector<double> value(nLocal*nValues);
+   {
+      ro_array_ptr<double> Vm = sim.vdata_.VmTransport_.readonly(CPU);
+      ro_array_ptr<double> dVmR = sim.vdata_.dVmReactionTransport_.readonly(CPU);
+      ro_array_ptr<double> dVmD = sim.vdata_.dVmDiffusionTransport_.readonly(CPU);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         value[ii*nValues+0] = Vm[ii];
+         value[ii*nValues+1] = dVmR[ii];
+         value[ii*nValues+2] = dVmD[ii];
+      }
+      vector<double> column(nLocal);
+      for (unsigned jj=0; jj<handle.size(); ++jj)
+      {
+         sim.reaction_->getColumn(handle[jj], 0, nLocal, &column[0]);
+         for (unsigned ii=0; ii<nLocal; ++ii)
+            value[ii*nValues+3+jj] = column[ii];
+      }
+      for (unsigned kk=0; kk<sim.sensor_.size(); ++kk)
+         if (sim.sensor_[kk]->nCellValues() > 0)
+            for (unsigned ii=0; ii<nLocal; ++ii)
+               sim.sensor_[kk]->getCellValues(ii, &value[ii*nValues+sensorOffset[kk]]);
+   }
+
+   // pack the records in destination order for assignArray
+   const unsigned width = sizeof(AnatomyCell) + nValues*sizeof(double);
+   vector<int> order(nLocal);
+   for (unsigned ii=0; ii<nLocal; ++ii)
+      order[ii] = ii;
+   stable_sort(order.begin(), order.end(),
+               [&dest](int a, int b) {return dest[a] < dest[b];});
+   unsigned capacity;
+   {
+      vector<int> myCount(nTasks, 0);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+         ++myCount[dest[ii]];
+      vector<int> count(nTasks);
+      MPI_Allreduce(&myCount[0], &count[0], nTasks, MPI_INT, MPI_SUM, comm);
+      capacity = max<unsigned>(max<unsigned>(nLocal, count[myRank]), 1);
+   }
+   vector<unsigned char> buf(capacity*width);
+   vector<unsigned> sortedDest(max(nLocal, 1u));
+   anatomy.expand();
+   const vector<AnatomyCell>& cells = anatomy.cellArray();
+   for (unsigned kk=0; kk<nLocal; ++kk)
+   {
+      int ii = order[kk];
+      memcpy(&buf[kk*width], &cells[ii], sizeof(AnatomyCell));
+      memcpy(&buf[kk*width+sizeof(AnatomyCell)], &value[ii*nValues], nValues*sizeof(double));
+      sortedDest[kk] = dest[ii];
+   }
+   unsigned nRecv = nLocal;
+   assignArray(&buf[0], &nRecv, capacity, width, &sortedDest[0], 0, comm);
+
+   // Sensors may have posted output that refers to the old
+   // decomposition.  The old sensors (and the CommTable they use) live
+   // until the new ones have taken over from them.
+   OutputService::getInstance().flush();
+   delete sim.diffusion_;
+   delete sim.reaction_;
+   for (unsigned ii=0; ii<sim.stimulus_.size(); ++ii)
+      delete sim.stimulus_[ii];
+   sim.stimulus_.clear();
+   vector<Sensor*> oldSensor;
+   oldSensor.swap(sim.sensor_);
+   CommTable* oldCommTable = sim.commTable_;
+
+   vector<AnatomyCell>& newCells = anatomy.cellArray();
+   newCells.resize(nRecv);
+   map<Long64, unsigned> recordFromGid;
+   for (unsigned ii=0; ii<nRecv; ++ii)
+   {
+      memcpy(&newCells[ii], &buf[ii*width], sizeof(AnatomyCell));
+      newCells[ii].dest_ = myRank;
+      recordFromGid[newCells[ii].gid_] = ii;
+   }
+   anatomy.nRemote() = 0;
+
+   buildTaskLocalObjects(sim.name_, sim, variantHint_);
+   anatomy.compact(true);
+
+   // the reaction manager sorted the local cells.
+   nLocal = anatomy.nLocal();
+   assert(nLocal == nRecv);
+   vector<double> record(nLocal*nValues);
+   for (unsigned ii=0; ii<nLocal; ++ii)
+   {
+      unsigned irec = recordFromGid[anatomy.gid(ii)];
+      memcpy(&record[ii*nValues], &buf[irec*width+sizeof(AnatomyCell)], nValues*sizeof(double));
+   }
+   sim.vdata_.setup(anatomy);
+   {
+      wo_array_ptr<double> Vm = sim.vdata_.VmTransport_.writeonly(CPU);
+      wo_array_ptr<double> dVmR = sim.vdata_.dVmReactionTransport_.writeonly(CPU);
+      wo_array_ptr<double> dVmD = sim.vdata_.dVmDiffusionTransport_.writeonly(CPU);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         Vm[ii] = record[ii*nValues+0];
+         dVmR[ii] = record[ii*nValues+1];
+         dVmD[ii] = record[ii*nValues+2];
+      }
+      for (unsigned ii=nLocal; ii<anatomy.size(); ++ii)
+         Vm[ii] = 0;
+   }
+   // Handles are the same as before since the reaction objects are
+   // the same.  Reactions that don't use a handle ignore the column.
+   vector<double> column(nLocal);
+   for (unsigned jj=0; jj<handle.size(); ++jj)
+   {
+      for (unsigned ii=0; ii<nLocal; ++ii)
+         column[ii] = record[ii*nValues+3+jj];
+      sim.reaction_->setColumn(handle[jj], 0, nLocal, &column[0]);
+   }
+
+   // The sensors are built from the same list of names, so they are in
+   // the same order as before.
+   assert(sim.sensor_.size() == oldSensor.size());
+   for (unsigned kk=0; kk<sim.sensor_.size(); ++kk)
+   {
+      assert(sim.sensor_[kk]->nCellValues() == oldSensor[kk]->nCellValues());
+      if (sim.sensor_[kk]->nCellValues() > 0)
+         for (unsigned ii=0; ii<nLocal; ++ii)
+            sim.sensor_[kk]->setCellValues(ii, &record[ii*nValues+sensorOffset[kk]]);
+      sim.sensor_[kk]->continueFrom(*oldSensor[kk]);
+      delete oldSensor[kk];
+   }
+   delete oldCommTable;
+   // a file closed by an old sensor may be opened by a new sensor on
+   // another task.
+   MPI_Barrier(comm);
+
+   sim.printIndex_ = -1;
+   for (unsigned ii=0; ii<nLocal; ++ii)
+      if (anatomy.gid(ii) == sim.printGid_)
+      {
+         sim.printIndex_ = ii;
+         break;
+      }
+   if (sim.printIndex_ >= 0 && sim.printFile_ == NULL)
+      sim.printFile_ = fopen("data", "a");
+   if (sim.printIndex_ < 0 && sim.printFile_ != NULL)
+   {
+      fclose(sim.printFile_);
+      sim.printFile_ = NULL;
+   }
+}
+
+namespace
+{
+   /** Sums the weight of the cells in each part whose key along
+    *  axis[part] is below cut[part]. */
+   void weightBelow(const vector<long long>& key, const vector<int>& part,
+                    const vector<double>& weight,
+                    const vector<int>& axis, const vector<long long>& cut,
+                    vector<double>& below, MPI_Comm comm)
+   {
+      vector<double> myBelow(cut.size(), 0.0);
+      for (unsigned ii=0; ii<part.size(); ++ii)
+      {
+         int pp = part[ii];
+         if (key[3*ii+axis[pp]] < cut[pp])
+            myBelow[pp] += weight[ii];
+      }
+      below.resize(cut.size());
+      MPI_Allreduce(&myBelow[0], &below[0], cut.size(), MPI_DOUBLE, MPI_SUM, comm);
+   }
+}
+
+namespace
+{
+   /** Weighted recursive coordinate bisection of the cells of all
+    *  tasks.  Each level splits every part that still holds more than
+    *  one task across the longest extent of its bounding box so that
+    *  the weight on each side is proportional to the number of tasks
+    *  on that side.  Cells are ordered along the axis by (coordinate,
+    *  gid) so that a cut can fall inside a plane of cells; otherwise
+    *  small grids can't be balanced better than one plane.  The cut is
+    *  found by bisection on that key, which costs one allreduce per
+    *  step for all parts of a level together. */
+   void weightedBisection(const Anatomy& anatomy, const vector<double>& weight,
+                          vector<int>& dest, MPI_Comm comm)
+   {
+      int nTasks;  MPI_Comm_size(comm, &nTasks);
+      unsigned nLocal = anatomy.nLocal();
+      long long nGrid = (long long)anatomy.nx()*anatomy.ny()*anatomy.nz();
+      vector<int> coord(3*nLocal);
+      vector<long long> key(3*nLocal);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         Tuple gg = anatomy.globalTuple(ii);
+         coord[3*ii+0] = gg.x();
+         coord[3*ii+1] = gg.y();
+         coord[3*ii+2] = gg.z();
+         for (int dd=0; dd<3; ++dd)
+            key[3*ii+dd] = coord[3*ii+dd]*nGrid + anatomy.gid(ii);
+      }
+
+      vector<int> partLo(1, 0);
+      vector<int> partHi(1, nTasks);
+      vector<int> part(nLocal, 0);
+      while (true)
+      {
+         int nParts = partLo.size();
+         bool done = true;
+         for (int pp=0; pp<nParts; ++pp)
+            if (partHi[pp]-partLo[pp] > 1)
+               done = false;
+         if (done)
+            break;
+
+         // bounding box (min of x, y, z, -x, -y, -z) and weight of
+         // every part
+         vector<int> myBox(6*nParts, INT_MAX);
+         vector<double> myWeight(nParts, 0.0);
+         for (unsigned ii=0; ii<nLocal; ++ii)
+         {
+            int pp = part[ii];
+            for (int dd=0; dd<3; ++dd)
+            {
+               myBox[6*pp+dd] = min(myBox[6*pp+dd], coord[3*ii+dd]);
+               myBox[6*pp+3+dd] = min(myBox[6*pp+3+dd], -coord[3*ii+dd]);
+            }
+            myWeight[pp] += weight[ii];
+         }
+         vector<int> box(6*nParts);
+         vector<double> partWeight(nParts);
+         MPI_Allreduce(&myBox[0], &box[0], 6*nParts, MPI_INT, MPI_MIN, comm);
+         MPI_Allreduce(&myWeight[0], &partWeight[0], nParts, MPI_DOUBLE, MPI_SUM, comm);
+
+         vector<int> axis(nParts, 0);
+         for (int pp=0; pp<nParts; ++pp)
+         {
+            int extent = -1;
+            for (int dd=0; dd<3; ++dd)
+            {
+               int ee = -box[6*pp+3+dd] - box[6*pp+dd];
+               if (box[6*pp+dd] != INT_MAX && ee > extent)
+               {
+                  extent = ee;
+                  axis[pp] = dd;
+               }
+            }
+         }
+
+         // key range (min of key, -key) along the chosen axis
+         vector<long long> myRange(2*nParts, LLONG_MAX);
+         for (unsigned ii=0; ii<nLocal; ++ii)
+         {
+            int pp = part[ii];
+            long long kk = key[3*ii+axis[pp]];
+            myRange[2*pp] = min(myRange[2*pp], kk);
+            myRange[2*pp+1] = min(myRange[2*pp+1], -kk);
+         }
+         vector<long long> range(2*nParts);
+         MPI_Allreduce(&myRange[0], &range[0], 2*nParts, MPI_LONG_LONG, MPI_MIN, comm);
+
+         // cells with key < cut go left.  Any cut in [lo, hi] leaves
+         // cells on both sides.  Parts that aren't split get lo == hi.
+         vector<long long> lo(nParts);
+         vector<long long> hi(nParts);
+         vector<double> target(nParts);
+         for (int pp=0; pp<nParts; ++pp)
+         {
+            int nPartTasks = partHi[pp]-partLo[pp];
+            target[pp] = partWeight[pp]*(nPartTasks/2)/nPartTasks;
+            lo[pp] = range[2*pp]+1;
+            hi[pp] = -range[2*pp+1];
+            if (nPartTasks == 1 || range[2*pp] == LLONG_MAX)
+               lo[pp] = hi[pp] = 0;
+         }
+
+         // smallest cut with at least target weight below it
+         vector<double> below;
+         while (true)
+         {
+            bool converged = true;
+            vector<long long> mid(nParts);
+            for (int pp=0; pp<nParts; ++pp)
+            {
+               mid[pp] = lo[pp] + (hi[pp]-lo[pp])/2;
+               if (lo[pp] < hi[pp])
+                  converged = false;
+            }
+            if (converged)
+               break;
+            weightBelow(key, part, weight, axis, mid, below, comm);
+            for (int pp=0; pp<nParts; ++pp)
+            {
+               if (lo[pp] >= hi[pp])
+                  continue;
+               if (below[pp] >= target[pp])
+                  hi[pp] = mid[pp];
+               else
+                  lo[pp] = mid[pp]+1;
+            }
+         }
+         // the cell just below the cut may be closer to the target
+         vector<long long> cut(lo);
+         {
+            vector<long long> prev(nParts);
+            for (int pp=0; pp<nParts; ++pp)
+               prev[pp] = cut[pp]-1;
+            vector<double> belowPrev;
+            weightBelow(key, part, weight, axis, cut, below, comm);
+            weightBelow(key, part, weight, axis, prev, belowPrev, comm);
+            for (int pp=0; pp<nParts; ++pp)
+            {
+               if (prev[pp] > range[2*pp] && partHi[pp]-partLo[pp] > 1 &&
+                   fabs(belowPrev[pp]-target[pp]) < fabs(below[pp]-target[pp]))
+                  cut[pp] = prev[pp];
+            }
+         }
+
+         vector<int> newLo;
+         vector<int> newHi;
+         vector<int> left(nParts);
+         vector<int> right(nParts);
+         for (int pp=0; pp<nParts; ++pp)
+         {
+            int nPartTasks = partHi[pp]-partLo[pp];
+            left[pp] = newLo.size();
+            if (nPartTasks == 1)
+            {
+               right[pp] = left[pp];
+               newLo.push_back(partLo[pp]);
+               newHi.push_back(partHi[pp]);
+               continue;
+            }
+            int mid = partLo[pp] + nPartTasks/2;
+            newLo.push_back(partLo[pp]);
+            newHi.push_back(mid);
+            right[pp] = newLo.size();
+            newLo.push_back(mid);
+            newHi.push_back(partHi[pp]);
+         }
+         for (unsigned ii=0; ii<nLocal; ++ii)
+         {
+            int pp = part[ii];
+            part[ii] = (key[3*ii+axis[pp]] < cut[pp]) ? left[pp] : right[pp];
+         }
+         partLo = newLo;
+         partHi = newHi;
+      }
+
+      dest.resize(nLocal);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+         dest[ii] = partLo[part[ii]];
+   }
+}
@@ -0,0 +1,64 @@
+#ifndef REBALANCER_HH
+#define REBALANCER_HH
+
+#include <string>
+#include <vector>
+
+class Simulate;
+
+/** Runtime load balancing driven by measured cost.
+ *
+ *  The startup balancers (koradi, grid, workBound, ...) rely on cost
+ *  models that don't know the relative cost of the reaction models.
+ *  Every rate time steps the Rebalancer gathers the time each task
+ *  spent in each reaction (from ReactionManager::getCost) and in the
+ *  diffusion (reported by the loop through addDiffusionTime).  When
+ *  the ratio of the slowest task to the average exceeds threshold the
+ *  cells are repartitioned by weighted recursive coordinate bisection
+ *  with the measured cost per cell of each reaction plus the measured
+ *  diffusion cost per cell as weights.  Cells migrate together with
+ *  Vm, dVm and all reaction state, and everything that depends on the
+ *  decomposition is rebuilt (see buildTaskLocalObjects).
+ *
+ *  The anatomy is expanded for the migration and compacted again
+ *  afterwards, so the conductivity must have been kept when it was
+ *  compacted at startup.
+ *
+ *  Sensors are rebuilt as well.  Their per-cell data (e.g., activation
+ *  times) moves with the cells and the new sensors take the open
+ *  output files of the old ones (see Sensor::continueFrom).  Data
+ *  that sensors buffer between prints (e.g., the averages of the
+ *  Voronoi sensors) can't be moved, so the Rebalancer skips the check
+ *  while any sensor holds such data.  Choose rate as a multiple of
+ *  the printRate of those sensors.
+ *  Only the last nSample steps before each check are timed.
+ */
+class Rebalancer
+{
+ public:
+   Rebalancer(int rate, double threshold, const std::string& variantHint);
+
+   bool due(int loop) const {return loop > 0 && loop % rate_ == 0;}
+   /** True for the last few steps before each check.  Only those steps
+    *  are timed, so the steps in between carry no timing overhead. */
+   bool sampling(int loop) const {return loop % rate_ >= rate_ - nSample_;}
+   void addDiffusionTime(double seconds, int nCells);
+
+   /** Collective on MPI_COMM_WORLD.  Returns true if the cells were
+    *  repartitioned.  In that case sim.sendMap_, sim.commTable_ and
+    *  the sizes of all cell arrays have changed. */
+   bool rebalance(Simulate& sim);
+
+ private:
+   void migrate(Simulate& sim, const std::vector<int>& dest);
+
+   int rate_;
+   int nSample_;
+   double threshold_;
+   std::string variantHint_;
+   double diffusionSeconds_;
+   double diffusionCellSteps_;
+   bool warnedSensors_;
+};
+
+#endif
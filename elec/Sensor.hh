@@ -62,6 +62,36 @@ class Sensor
       return (loop % evalRate_ == 0);
    }
 
+   // Sensors that hand their output to the OutputService instead of
+   // calling pio directly from print() should return true.  Other
+   // sensors force the service to drain before they print.
+   virtual bool deferredPrint() const
+   { return false; }
+
+   // The Rebalancer builds new sensors for the new decomposition and
+   // hands each of them the data of the sensor it replaces:
+   // nCellValues() values of each local cell move with the cell
+   // (getCellValues is called on the old sensor before the move,
+   // setCellValues on the new one after it) and continueFrom lets the
+   // new sensor take anything else, e.g. its open output files, from
+   // the old one before that is deleted.  Sensors that write as the
+   // simulation goes should therefore open their files on the first
+   // print rather than in the constructor.
+   //
+   // canMigrate returns false while the sensor holds data for its next
+   // print that can't be moved.  The Rebalancer waits until it is true
+   // on all tasks.
+   virtual bool canMigrate() const
+   { return true; }
+   virtual unsigned nCellValues() const
+   { return 0; }
+   virtual void getCellValues(unsigned iCell, double* value) const
+   { return; }
+   virtual void setCellValues(unsigned iCell, const double* value)
+   { return; }
+   virtual void continueFrom(Sensor& old)
+   { return; }
+
  private:
    int evalRate_;
    int printRate_;
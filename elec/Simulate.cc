@@ -4,6 +4,7 @@
 #include <cmath>
 #include <mpi.h>
 #include "Diffusion.hh"
+#include "DeviceFor.hh"
 #include <stdio.h>
 
 //using std::isnan;
@@ -44,7 +45,13 @@ void Simulate::checkRanges(ro_mgarray_ptr<double> _Vm,
    //const double vMin = -110.;
    const double vMax = checkRange_.vMax;
    const double vMin = checkRange_.vMin;
-   #pragma omp parallel for
+   // Count first.  Cells out of range are rare and the warnings come
+   // out in order when they are printed by one thread.
+   int nOut = 0;
+   HOST_PARALLEL_REDUCE(nLocal, ii, +, nOut,
+                        nOut += (Vm[ii] > vMax || Vm[ii] < vMin));
+   if (nOut == 0)
+      return;
    for (int ii=0; ii<nLocal; ++ii)
    {
       if ( Vm[ii] > vMax || Vm[ii] < vMin )
@@ -20,6 +20,7 @@ class Stimulus;
 class Sensor;
 class Drug;
 class CommTable;
+class Rebalancer;
 //using std::isnan;
 
 // storage class for persistent data such as potentials that may 
@@ -95,6 +96,8 @@ class Simulate
    int printIndex_;
    FILE *printFile_; 
    int checkpointRate_;
+   bool profileStats_;
+   bool fusedIntegrate_;
    bool asciiCheckpoints_;
 
    ThreadTeam diffusionThreads_;
@@ -118,6 +121,7 @@ class Simulate
    ReactionManager* reaction_;
    std::vector<Stimulus*> stimulus_;
    std::vector<Sensor*> sensor_;
+   Rebalancer* rebalancer_;
     
    void initSensors(const std::vector<std::string>& names);
 
@@ -0,0 +1,671 @@
+#include "SnapshotIndex.hh"
+#include "snapshotIndexApi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace
+{
+   const char indexMagic[8] = {'g', 'i', 'd', 'x', '0', '0', '0', '2'};
+
+   /** Records that are at most this far apart are read together. */
+   const uint64_t maxReadGap = 4096;
+   const uint64_t maxReadSize = 1<<20;
+
+   bool readHeader(const string& fileName, map<string, string>& keys,
+                   uint64_t& headerLength);
+   vector<string> splitWords(const string& value);
+   unsigned binarySize(const string& type);
+   bool isWhitespace(char c);
+   void swapBytes(char* data, unsigned size);
+   uint64_t mtimeNs(const struct stat& statbuf);
+}
+
+SnapshotIndex::SnapshotIndex(const string& stem, bool saveIndex)
+: stem_(stem), ok_(false), binary_(false), swap_(false), nFiles_(0),
+  lrec_(0), headerLength_(0), time_(0), gidField_(-1)
+{
+   struct stat statbuf;
+   if (stem_.empty() || stem_[stem_.size()-1] != '#')
+   {
+      if (stat(stem_.c_str(), &statbuf) == 0 && S_ISDIR(statbuf.st_mode))
+         stem_ += "/state#";
+      else
+      {
+         error_ = "file name " + stem_ + " doesn't end with #";
+         return;
+      }
+   }
+
+   if (!parseHeader())
+      return;
+
+   fileStamp_.resize(nFiles_);
+   for (unsigned ii=0; ii<nFiles_; ++ii)
+   {
+      if (stat(fileName(ii).c_str(), &statbuf) != 0)
+      {
+         error_ = "can't stat " + fileName(ii);
+         return;
+      }
+      fileStamp_[ii].size_ = statbuf.st_size;
+      fileStamp_[ii].mtime_ = mtimeNs(statbuf);
+      fileStamp_[ii].inode_ = statbuf.st_ino;
+   }
+   fd_.assign(nFiles_, -1);
+
+   if (!loadIndex())
+   {
+      if (!buildIndex())
+         return;
+      if (saveIndex)
+         this->saveIndex();
+   }
+   ok_ = true;
+}
+
+SnapshotIndex::~SnapshotIndex()
+{
+   for (unsigned ii=0; ii<fd_.size(); ++ii)
+      if (fd_[ii] >= 0)
+         close(fd_[ii]);
+}
+
+int SnapshotIndex::fieldIndex(const string& name) const
+{
+   for (unsigned ii=0; ii<fieldNames_.size(); ++ii)
+      if (fieldNames_[ii] == name)
+         return ii;
+   return -1;
+}
+
+uint64_t SnapshotIndex::read(const uint64_t* gids, uint64_t nGids,
+                             const int* fields, unsigned nRead, double* value) const
+{
+   fill(value, value+nGids*nRead, NAN);
+
+   // (entry, request) pairs in file order
+   vector<pair<const Entry*, uint64_t> > request;
+   request.reserve(nGids);
+   for (uint64_t ii=0; ii<nGids; ++ii)
+   {
+      Entry key;
+      key.gid_ = gids[ii];
+      vector<Entry>::const_iterator here = lower_bound(entry_.begin(), entry_.end(), key);
+      if (here != entry_.end() && here->gid_ == gids[ii])
+         request.push_back(make_pair(&*here, ii));
+   }
+   sort(request.begin(), request.end(), fileOrder);
+
+   vector<char> buf;
+   uint64_t nFound = 0;
+   uint64_t begin = 0;
+   while (begin < request.size())
+   {
+      const Entry* first = request[begin].first;
+      uint64_t runEnd = first->offset_ + first->length_;
+      uint64_t end = begin+1;
+      for (; end<request.size(); ++end)
+      {
+         const Entry* next = request[end].first;
+         if (next->file_ != first->file_ ||
+             next->offset_ > runEnd + maxReadGap ||
+             next->offset_ + next->length_ - first->offset_ > maxReadSize)
+            break;
+         runEnd = max(runEnd, next->offset_ + next->length_);
+      }
+
+      uint64_t size = runEnd - first->offset_;
+      buf.resize(size);
+      ssize_t nBytes = pread(fd(first->file_), &buf[0], size, first->offset_);
+      if (nBytes == ssize_t(size))
+      {
+         for (uint64_t ii=begin; ii<end; ++ii)
+         {
+            const Entry* ee = request[ii].first;
+            decode(&buf[ee->offset_ - first->offset_], ee->length_,
+                   fields, nRead, value + request[ii].second*nRead);
+         }
+         nFound += end - begin;
+      }
+      begin = end;
+   }
+   return nFound;
+}
+
+bool SnapshotIndex::fileOrder(const pair<const Entry*, uint64_t>& a,
+                              const pair<const Entry*, uint64_t>& b)
+{
+   if (a.first->file_ != b.first->file_)
+      return a.first->file_ < b.first->file_;
+   return a.first->offset_ < b.first->offset_;
+}
+
+bool SnapshotIndex::parseHeader()
+{
+   map<string, string> keys;
+   if (!readHeader(fileName(0), keys, headerLength_))
+   {
+      error_ = "can't read the header of " + fileName(0);
+      return false;
+   }
+
+   string datatype = keys["datatype"];
+   if (datatype == "FIXRECORDBINARY")
+      binary_ = true;
+   else if (datatype != "FIXRECORDASCII" && datatype != "VARRECORDASCII")
+   {
+      error_ = "unsupported datatype " + datatype + " in " + fileName(0);
+      return false;
+   }
+   nFiles_ = atoi(keys["nfiles"].c_str());
+   lrec_ = atoi(keys["lrec"].c_str());
+   time_ = atof(keys["time"].c_str());
+   fieldNames_ = splitWords(keys["field_names"]);
+   fieldTypes_ = splitWords(keys["field_types"]);
+   if (nFiles_ == 0 || fieldNames_.size() != fieldTypes_.size())
+   {
+      error_ = "bad header in " + fileName(0);
+      return false;
+   }
+   gidField_ = fieldIndex("gid");
+   if (gidField_ < 0)
+   {
+      error_ = "no gid field in " + fileName(0);
+      return false;
+   }
+
+   if (binary_)
+   {
+      unsigned keyLocal;
+      memcpy(&keyLocal, "1234", 4);
+      swap_ = (strtoul(keys["endian_key"].c_str(), NULL, 10) != keyLocal);
+      binaryOffset_.assign(1, 0);
+      for (unsigned ii=0; ii<fieldTypes_.size(); ++ii)
+      {
+         unsigned size = binarySize(fieldTypes_[ii]);
+         if (size == 0)
+         {
+            error_ = "unsupported binary field type " + fieldTypes_[ii];
+            return false;
+         }
+         binaryOffset_.push_back(binaryOffset_.back() + size);
+      }
+      if (lrec_ < binaryOffset_.back())
+      {
+         error_ = "lrec is too short in " + fileName(0);
+         return false;
+      }
+   }
+   return true;
+}
+
+/** The index file is
+ *    magic, "1234", nFiles, the file stamps, nRecords, the entries.
+ *  Anything that doesn't match the data files makes us rebuild it. */
+bool SnapshotIndex::loadIndex()
+{
+   FILE* file = fopen(indexName().c_str(), "r");
+   if (file == NULL)
+      return false;
+
+   char magic[8];
+   char endian[4];
+   uint32_t nFiles;
+   uint64_t nRecords;
+   vector<FileStamp> fileStamp(nFiles_);
+   bool good =
+      fread(magic, 8, 1, file) == 1 && memcmp(magic, indexMagic, 8) == 0 &&
+      fread(endian, 4, 1, file) == 1 && memcmp(endian, "1234", 4) == 0 &&
+      fread(&nFiles, 4, 1, file) == 1 && nFiles == nFiles_ &&
+      fread(&fileStamp[0], sizeof(FileStamp), nFiles_, file) == nFiles_ &&
+      fileStamp == fileStamp_ &&
+      fread(&nRecords, 8, 1, file) == 1;
+   if (good)
+   {
+      entry_.resize(nRecords);
+      good = (nRecords == 0 || fread(&entry_[0], sizeof(Entry), nRecords, file) == nRecords);
+   }
+   fclose(file);
+   if (!good)
+      entry_.clear();
+   return good;
+}
+
+bool SnapshotIndex::buildIndex()
+{
+   entry_.clear();
+   for (unsigned ii=0; ii<nFiles_; ++ii)
+      if (!scanFile(ii))
+         return false;
+   stable_sort(entry_.begin(), entry_.end());
+   return true;
+}
+
+/** Written to a temporary file that is renamed at the end so readers
+ *  never see a partial index.  Failure isn't an error, we just don't
+ *  have a saved index. */
+void SnapshotIndex::saveIndex() const
+{
+   char suffix[32];
+   sprintf(suffix, ".tmp%d", int(getpid()));
+   string tmpName = indexName() + suffix;
+   FILE* file = fopen(tmpName.c_str(), "w");
+   if (file == NULL)
+      return;
+
+   uint32_t nFiles = nFiles_;
+   uint64_t nRecords = entry_.size();
+   bool good =
+      fwrite(indexMagic, 8, 1, file) == 1 &&
+      fwrite("1234", 4, 1, file) == 1 &&
+      fwrite(&nFiles, 4, 1, file) == 1 &&
+      fwrite(&fileStamp_[0], sizeof(FileStamp), nFiles_, file) == nFiles_ &&
+      fwrite(&nRecords, 8, 1, file) == 1 &&
+      (nRecords == 0 || fwrite(&entry_[0], sizeof(Entry), nRecords, file) == nRecords);
+   good = (fclose(file) == 0) && good;
+   if (good)
+      good = (rename(tmpName.c_str(), indexName().c_str()) == 0);
+   if (!good)
+      remove(tmpName.c_str());
+}
+
+/** Reads the file in large chunks.  Ascii records are the lines that
+ *  aren't blank (fixed length records end with a newline too), binary
+ *  records are lrec bytes. */
+bool SnapshotIndex::scanFile(unsigned iFile)
+{
+   FILE* file = fopen(fileName(iFile).c_str(), "r");
+   if (file == NULL)
+   {
+      error_ = "can't open " + fileName(iFile);
+      return false;
+   }
+   uint64_t offset = (iFile == 0 ? headerLength_ : 0);
+   fseeko(file, offset, SEEK_SET);
+
+   const size_t chunkSize = 1<<22;
+   vector<char> buf;
+   size_t nBuf = 0;
+   bool good = true;
+   while (good)
+   {
+      buf.resize(nBuf + chunkSize);
+      size_t nNew = fread(&buf[nBuf], 1, chunkSize, file);
+      bool atEnd = (nNew < chunkSize);
+      nBuf += nNew;
+
+      size_t pos = 0;
+      if (binary_)
+      {
+         const unsigned gidSize = binarySize(fieldTypes_[gidField_]);
+         for (; pos+lrec_<=nBuf; pos+=lrec_)
+         {
+            Entry ee;
+            char gid[8];
+            memcpy(gid, &buf[pos+binaryOffset_[gidField_]], gidSize);
+            if (swap_)
+               swapBytes(gid, gidSize);
+            if (gidSize == 4)
+            {
+               uint32_t gid4;
+               memcpy(&gid4, gid, 4);
+               ee.gid_ = gid4;
+            }
+            else
+               memcpy(&ee.gid_, gid, 8);
+            ee.offset_ = offset + pos;
+            ee.file_ = iFile;
+            ee.length_ = lrec_;
+            entry_.push_back(ee);
+         }
+         if (atEnd && pos != nBuf)
+         {
+            error_ = "partial record at the end of " + fileName(iFile);
+            good = false;
+         }
+      }
+      else
+      {
+         while (pos < nBuf)
+         {
+            char* eol = (char*) memchr(&buf[pos], '\n', nBuf-pos);
+            if (eol == NULL && !atEnd)
+               break;
+            size_t length = (eol == NULL ? nBuf : eol-&buf[0]) - pos;
+            vector<const char*> start;
+            asciiFields(&buf[pos], length, gidField_, start);
+            if (int(start.size()) > gidField_)
+            {
+               Entry ee;
+               ee.gid_ = strtoull(start[gidField_], NULL, 10);
+               ee.offset_ = offset + pos;
+               ee.file_ = iFile;
+               ee.length_ = length;
+               entry_.push_back(ee);
+            }
+            pos += length + 1;
+         }
+         pos = min(pos, nBuf);
+      }
+
+      offset += pos;
+      nBuf -= pos;
+      if (nBuf > 0)
+         memmove(&buf[0], &buf[pos], nBuf);
+      if (atEnd)
+         break;
+   }
+   fclose(file);
+   return good;
+}
+
+/** Blank ascii records decode as all NaN. */
+void SnapshotIndex::decode(const char* rec, unsigned length,
+                           const int* fields, unsigned nRead, double* value) const
+{
+   if (binary_)
+   {
+      for (unsigned jj=0; jj<nRead; ++jj)
+      {
+         int ff = fields[jj];
+         value[jj] = NAN;
+         if (ff < 0 || ff >= int(fieldTypes_.size()))
+            continue;
+         const string& type = fieldTypes_[ff];
+         unsigned size = binarySize(type);
+         char data[8];
+         memcpy(data, rec+binaryOffset_[ff], size);
+         if (swap_)
+            swapBytes(data, size);
+         if (type == "f8")
+         {
+            double f8; memcpy(&f8, data, 8); value[jj] = f8;
+         }
+         else if (type == "f4")
+         {
+            float f4; memcpy(&f4, data, 4); value[jj] = f4;
+         }
+         else if (type == "u8")
+         {
+            uint64_t u8; memcpy(&u8, data, 8); value[jj] = u8;
+         }
+         else if (type == "u4")
+         {
+            uint32_t u4; memcpy(&u4, data, 4); value[jj] = u4;
+         }
+      }
+      return;
+   }
+
+   int maxField = -1;
+   for (unsigned jj=0; jj<nRead; ++jj)
+      maxField = max(maxField, fields[jj]);
+   vector<const char*> start;
+   asciiFields(rec, length, maxField, start);
+
+   // the record isn't null terminated
+   char field[64];
+   for (unsigned jj=0; jj<nRead; ++jj)
+   {
+      int ff = fields[jj];
+      value[jj] = NAN;
+      if (ff < 0 || ff >= int(start.size()) || fieldTypes_[ff] == "s")
+         continue;
+      unsigned len = 0;
+      const char* end = rec+length;
+      while (start[ff]+len < end && !isWhitespace(start[ff][len]) && len < sizeof(field)-1)
+         ++len;
+      memcpy(field, start[ff], len);
+      field[len] = '\0';
+      value[jj] = strtod(field, NULL);
+   }
+}
+
+/** Stores the start of fields 0..maxField of the ascii record rec (or
+ *  of as many as there are) in start. */
+void SnapshotIndex::asciiFields(const char* rec, unsigned length, int maxField,
+                                vector<const char*>& start)
+{
+   start.clear();
+   unsigned pos = 0;
+   while (int(start.size()) <= maxField)
+   {
+      while (pos < length && isWhitespace(rec[pos]))
+         ++pos;
+      if (pos == length)
+         break;
+      start.push_back(rec+pos);
+      while (pos < length && !isWhitespace(rec[pos]))
+         ++pos;
+   }
+}
+
+string SnapshotIndex::fileName(unsigned iFile) const
+{
+   char number[16];
+   sprintf(number, "%6.6d", iFile);
+   return stem_ + number;
+}
+
+string SnapshotIndex::indexName() const
+{
+   return stem_.substr(0, stem_.size()-1) + ".gidx";
+}
+
+int SnapshotIndex::fd(unsigned iFile) const
+{
+   if (fd_[iFile] < 0)
+      fd_[iFile] = open(fileName(iFile).c_str(), O_RDONLY);
+   return fd_[iFile];
+}
+
+int64_t gatherTimeSeries(const vector<string>& stems,
+                         const uint64_t* gids, uint64_t nGids,
+                         const vector<string>& fieldNames,
+                         double* time, double* value, string& error)
+{
+   const unsigned nRead = fieldNames.size();
+   int64_t nFound = 0;
+   for (unsigned iSnap=0; iSnap<stems.size(); ++iSnap)
+   {
+      SnapshotIndex index(stems[iSnap]);
+      if (!index.ok())
+      {
+         error = index.error();
+         return -1;
+      }
+      vector<int> fields(nRead);
+      for (unsigned jj=0; jj<nRead; ++jj)
+         fields[jj] = index.fieldIndex(fieldNames[jj]);
+      time[iSnap] = index.time();
+      nFound += index.read(gids, nGids, (nRead > 0 ? &fields[0] : NULL), nRead,
+                           value + iSnap*nGids*nRead);
+   }
+   return nFound;
+}
+
+namespace
+{
+   /** A pio header is everything up to and including the first blank
+    *  line.  The keywords are in name CLASS { key = value; ... }. */
+   bool readHeader(const string& fileName, map<string, string>& keys,
+                   uint64_t& headerLength)
+   {
+      FILE* file = fopen(fileName.c_str(), "r");
+      if (file == NULL)
+         return false;
+      string header;
+      char line[1024];
+      headerLength = 0;
+      while (fgets(line, sizeof(line), file) != NULL)
+      {
+         headerLength += strlen(line);
+         if (strlen(line) <= 1)
+            break;
+         header += line;
+      }
+      fclose(file);
+
+      size_t open = header.find('{');
+      size_t close = header.rfind('}');
+      if (open == string::npos || close == string::npos || close < open)
+         return false;
+      string body = header.substr(open+1, close-open-1);
+      size_t begin = 0;
+      while (begin < body.size())
+      {
+         size_t end = body.find(';', begin);
+         if (end == string::npos)
+            end = body.size();
+         string item = body.substr(begin, end-begin);
+         begin = end+1;
+         size_t eq = item.find('=');
+         if (eq == string::npos)
+            continue;
+         vector<string> name = splitWords(item.substr(0, eq));
+         if (name.size() != 1)
+            continue;
+         string value = item.substr(eq+1);
+         size_t first = value.find_first_not_of(" \t\n");
+         size_t last = value.find_last_not_of(" \t\n");
+         keys[name[0]] = (first == string::npos ? "" : value.substr(first, last-first+1));
+      }
+      return true;
+   }
+
+   vector<string> splitWords(const string& value)
+   {
+      vector<string> words;
+      size_t pos = 0;
+      while (pos < value.size())
+      {
+         while (pos < value.size() && isWhitespace(value[pos]))
+            ++pos;
+         size_t begin = pos;
+         while (pos < value.size() && !isWhitespace(value[pos]))
+            ++pos;
+         if (pos > begin)
+            words.push_back(value.substr(begin, pos-begin));
+      }
+      return words;
+   }
+
+   unsigned binarySize(const string& type)
+   {
+      if (type == "f8" || type == "u8")
+         return 8;
+      if (type == "f4" || type == "u4")
+         return 4;
+      return 0;
+   }
+
+   bool isWhitespace(char c)
+   {
+      return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\0';
+   }
+
+   void swapBytes(char* data, unsigned size)
+   {
+      for (unsigned ii=0; ii<size/2; ++ii)
+         swap(data[ii], data[size-1-ii]);
+   }
+
+   uint64_t mtimeNs(const struct stat& statbuf)
+   {
+#ifdef __APPLE__
+      const struct timespec& mtime = statbuf.st_mtimespec;
+#else
+      const struct timespec& mtime = statbuf.st_mtim;
+#endif
+      return uint64_t(mtime.tv_sec)*1000000000 + mtime.tv_nsec;
+   }
+}
+
+
+/** The C interface. */
+
+struct SnapshotIndexHandle
+{
+   SnapshotIndexHandle(const char* stem, int saveIndex) : index_(stem, saveIndex) {}
+   SnapshotIndex index_;
+};
+
+namespace
+{
+   string lastError;
+}
+
+SnapshotIndexHandle* snapshotIndex_open(const char* stem, int saveIndex)
+{
+   SnapshotIndexHandle* handle = new SnapshotIndexHandle(stem, saveIndex);
+   if (handle->index_.ok())
+      return handle;
+   lastError = handle->index_.error();
+   delete handle;
+   return NULL;
+}
+
+void snapshotIndex_close(SnapshotIndexHandle* handle)
+{
+   delete handle;
+}
+
+const char* snapshotIndex_error(void)
+{
+   return lastError.c_str();
+}
+
+int64_t snapshotIndex_nRecords(const SnapshotIndexHandle* handle)
+{
+   return handle->index_.nRecords();
+}
+
+int snapshotIndex_nFields(const SnapshotIndexHandle* handle)
+{
+   return handle->index_.nFields();
+}
+
+const char* snapshotIndex_fieldName(const SnapshotIndexHandle* handle, int index)
+{
+   if (index < 0 || index >= int(handle->index_.nFields()))
+      return NULL;
+   return handle->index_.fieldName(index).c_str();
+}
+
+int snapshotIndex_fieldIndex(const SnapshotIndexHandle* handle, const char* name)
+{
+   return handle->index_.fieldIndex(name);
+}
+
+double snapshotIndex_time(const SnapshotIndexHandle* handle)
+{
+   return handle->index_.time();
+}
+
+int64_t snapshotIndex_read(const SnapshotIndexHandle* handle,
+                           const uint64_t* gids, uint64_t nGids,
+                           const int* fields, int nFields, double* value)
+{
+   return handle->index_.read(gids, nGids, fields, nFields, value);
+}
+
+int64_t snapshotIndex_gatherTimeSeries(const char** stems, int nStems,
+                                       const uint64_t* gids, uint64_t nGids,
+                                       const char** fieldNames, int nFields,
+                                       double* time, double* value)
+{
+   vector<string> stemList(stems, stems+nStems);
+   vector<string> nameList(fieldNames, fieldNames+nFields);
+   int64_t nFound = gatherTimeSeries(stemList, gids, nGids, nameList, time, value, lastError);
+   return nFound;
+}
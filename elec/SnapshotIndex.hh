@@ -0,0 +1,120 @@
+#ifndef SNAPSHOT_INDEX_HH
+#define SNAPSHOT_INDEX_HH
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/** Random access to the records of a pio file set (such as
+ *  snapshot.000000001000/state#) by gid.
+ *
+ *  The first time a file set is opened every file is scanned once and
+ *  the file and byte offset of every record are stored, sorted by gid,
+ *  in stem.gidx next to the data (state.gidx for state#).  Later opens
+ *  load that index, so a read only touches the pages that hold the
+ *  requested records.  The index is rebuilt when the size, modification
+ *  time or inode of a data file doesn't match the ones it was built
+ *  for, so a snapshot that is rewritten in place isn't read through a
+ *  stale index.  If the index can't be written it is only kept in
+ *  memory.
+ *
+ *  This is serial code without MPI or simUtil so it can be built as a
+ *  shared library for the python tools (see snapshotIndexApi.h).
+ *  Errors don't abort.  Check ok() after construction.
+ *
+ *  All pio datatypes are supported.  String fields read as NaN.
+ */
+class SnapshotIndex
+{
+ public:
+   /** stem is the pio file name ending in #.  A directory is taken to
+    *  mean dir/state#.  If saveIndex is false a newly built index isn't
+    *  written to disk. */
+   SnapshotIndex(const std::string& stem, bool saveIndex = true);
+   ~SnapshotIndex();
+
+   bool ok() const {return ok_;}
+   const std::string& error() const {return error_;}
+
+   const std::string& stem() const {return stem_;}
+   uint64_t nRecords() const {return entry_.size();}
+   unsigned nFields() const {return fieldNames_.size();}
+   const std::string& fieldName(unsigned index) const {return fieldNames_[index];}
+   /** Returns -1 if there is no such field. */
+   int fieldIndex(const std::string& name) const;
+   /** The time in the header (0 if there is none). */
+   double time() const {return time_;}
+
+   /** Stores field fields[jj] of the record of gids[ii] in
+    *  value[ii*nRead+jj].  The values of gids that aren't in the file
+    *  are NaN.  Returns the number of gids that were found.
+    *
+    *  The records are read in file order and records that are close
+    *  to each other are fetched with one pread. */
+   uint64_t read(const uint64_t* gids, uint64_t nGids,
+                 const int* fields, unsigned nRead, double* value) const;
+
+ private:
+   struct Entry
+   {
+      uint64_t gid_;
+      uint64_t offset_;
+      uint32_t file_;
+      uint32_t length_;
+      bool operator<(const Entry& b) const {return gid_ < b.gid_;}
+   };
+
+   /** What identifies the version of a data file. */
+   struct FileStamp
+   {
+      uint64_t size_;
+      uint64_t mtime_;  // ns
+      uint64_t inode_;
+      bool operator==(const FileStamp& b) const
+      {return size_ == b.size_ && mtime_ == b.mtime_ && inode_ == b.inode_;}
+   };
+
+   bool parseHeader();
+   bool loadIndex();
+   bool buildIndex();
+   void saveIndex() const;
+   bool scanFile(unsigned iFile);
+   void decode(const char* rec, unsigned length,
+               const int* fields, unsigned nRead, double* value) const;
+   static void asciiFields(const char* rec, unsigned length, int maxField,
+                           std::vector<const char*>& start);
+   static bool fileOrder(const std::pair<const Entry*, uint64_t>& a,
+                         const std::pair<const Entry*, uint64_t>& b);
+   std::string fileName(unsigned iFile) const;
+   std::string indexName() const;
+   int fd(unsigned iFile) const;
+
+   std::string              stem_;
+   std::string              error_;
+   bool                     ok_;
+   bool                     binary_;
+   bool                     swap_;
+   unsigned                 nFiles_;
+   unsigned                 lrec_;
+   uint64_t                 headerLength_;
+   double                   time_;
+   int                      gidField_;
+   std::vector<std::string> fieldNames_;
+   std::vector<std::string> fieldTypes_;
+   std::vector<unsigned>    binaryOffset_; // nFields+1 entries
+   std::vector<FileStamp>   fileStamp_;
+   std::vector<Entry>       entry_;        // sorted by gid
+   mutable std::vector<int> fd_;
+};
+
+/** Gathers field values of the same gids from a series of snapshots.
+ *  value[(iSnap*nGids + ii)*nFields + jj] is field fieldNames[jj] of
+ *  gids[ii] in stems[iSnap], time[iSnap] is the time of the snapshot.
+ *  Missing gids and fields are NaN.  Returns the number of records
+ *  found, or -1 (and sets error) if a file set can't be opened. */
+int64_t gatherTimeSeries(const std::vector<std::string>& stems,
+                         const uint64_t* gids, uint64_t nGids,
+                         const std::vector<std::string>& fieldNames,
+                         double* time, double* value, std::string& error);
+
+#endif
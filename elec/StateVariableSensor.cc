@@ -17,6 +17,7 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
 
 using namespace std;
 
@@ -120,12 +121,12 @@ StateVariableSensor::~StateVariableSensor()
 {
 }
 
-/** It can be argued that looping over the handles_ and getting each
- *  value individually incurs more branching and function call overhead
- *  than necessary.  However I doubt it will be an issue, and it allows
- *  us to write the data in the file in the same order that the user
- *  specified the fields.  We can always change it if the performance is
- *  an issue.
+/** When the requested cells are dense in the local index space the
+ *  values are gathered a whole column at a time through the bulk
+ *  accessors.  The column buffer is at most twice as large as the data
+ *  we write.  For sparse requests (a handful of probe points) we fall
+ *  back to getting each value individually.  Either way the data is
+ *  written in the order the user specified the fields.
  */
 void StateVariableSensor::print(double time, int loop)
 {
@@ -144,16 +145,42 @@ void StateVariableSensor::print(double time, int loop)
    if (myRank == 0)
       header_.writeHeader(file, loop, time);
 
+   int lo = sim_.anatomy_.nLocal();
+   int hi = 0;
+   for (MapType::const_iterator iter = localCells_.begin();
+        iter != localCells_.end(); ++iter)
+   {
+      lo = min(lo, int(iter->second));
+      hi = max(hi, int(iter->second)+1);
+   }
+   int span = max(0, hi-lo);
+   // a task without requested cells has nothing to fetch
+   bool dense = !localCells_.empty() && 2*localCells_.size() >= span;
+
+   vector<double> column;
+   if (dense)
+   {
+      column.resize(handles_.size()*span);
+      for (unsigned ii=0; ii<handles_.size(); ++ii)
+         if (handles_[ii] >= 0)
+            sim_.reaction_->getColumn(handles_[ii], lo, hi, &column[ii*span]);
+         else
+            getSimColumn(handles_[ii], lo, hi, &column[ii*span]);
+   }
+
    vector<double> values(handles_.size());
    char buf[lRec_+1];
    for (MapType::const_iterator iter = localCells_.begin();
         iter != localCells_.end(); ++iter)
    {
+      int iCell = iter->second;
       for (unsigned ii=0; ii<handles_.size(); ++ii)
-         if (handles_[ii] >= 0)
-            values[ii] = sim_.reaction_->getValue(iter->second, handles_[ii]);
+         if (dense)
+            values[ii] = column[ii*span + iCell-lo];
+         else if (handles_[ii] >= 0)
+            values[ii] = sim_.reaction_->getValue(iCell, handles_[ii]);
          else
-            values[ii] = getSimValue(iter->second, handles_[ii]);
+            getSimColumn(handles_[ii], iCell, iCell+1, &values[ii]);
 
       if (binaryOutput_)
       {
@@ -177,33 +204,25 @@ void StateVariableSensor::print(double time, int loop)
    Pclose(file);
 }
 
-double StateVariableSensor::getSimValue(int iCell, int varHandle)
+void StateVariableSensor::getSimColumn(int varHandle, int begin, int end, double* value)
 {
-   double value;
+   const lazy_array<double>* source = 0;
    switch (varHandle)
    {
      case -1:
-      {
-         ro_array_ptr<double> VmArray = sim_.vdata_.VmTransport_.useOn(CPU);
-         value = VmArray[iCell];
-      }
+      source = &sim_.vdata_.VmTransport_;
       break;
      case -2:
-      {
-         ro_array_ptr<double> dVmDiffusion = sim_.vdata_.dVmDiffusionTransport_.useOn(CPU);
-         value = dVmDiffusion[iCell];
-      }
+      source = &sim_.vdata_.dVmDiffusionTransport_;
       break;
      case -3:
-      {
-         ro_array_ptr<double> dVmReaction = sim_.vdata_.dVmReactionTransport_.useOn(CPU);
-         value = dVmReaction[iCell];
-      }
+      source = &sim_.vdata_.dVmReactionTransport_;
       break;
      default:
       assert(false);
    }
-   return value;
+   ro_array_ptr<double> array = source->readonly(CPU);
+   copy(array.raw()+begin, array.raw()+end, value);
 }
 
 
@@ -38,7 +38,7 @@ class StateVariableSensor : public Sensor
    
  private:
 
-   double getSimValue(int iCell, int varHandle);
+   void getSimColumn(int varHandle, int begin, int end, double* value);
    
    bool binaryOutput_;
    const Simulate& sim_;
@@ -297,7 +297,7 @@ void TT06Dev_Reaction::mkWorkBundles_(TT06Dev_ReactionParms& parms)
 TT06Dev_Reaction::~TT06Dev_Reaction()
 {
    free(stateBuffer_);
-   delete fit_;
+   delete [] fit_;
 }
 // void TT06Dev_Reaction::writeStateDev(int loop)
 // {
@@ -515,6 +515,17 @@ void TT06Dev_Reaction::getValue(int iCell,
       value[ii] = getValue(iCell, handle[ii]);
 }
 
+void TT06Dev_Reaction::getColumn(int varHandle, int begin, int end, double* value) const
+{
+   assert(varHandle >= 0 && varHandle < nStateVar);
+   copy(state_[varHandle]+begin, state_[varHandle]+end, value);
+}
+
+void TT06Dev_Reaction::setColumn(int varHandle, int begin, int end, const double* value)
+{
+   assert(varHandle >= 0 && varHandle < nStateVar);
+   copy(value, value+(end-begin), state_[varHandle]+begin);
+}
 
 const string TT06Dev_Reaction::getUnit(const string& varName) const
 {
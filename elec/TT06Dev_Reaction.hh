@@ -61,6 +61,8 @@ class TT06Dev_Reaction : public Reaction
    void getValue(int iCell,
                  const std::vector<int>& handle,
                  std::vector<double>& value) const;
+   void getColumn(int varHandle, int begin, int end, double* value) const;
+   void setColumn(int varHandle, int begin, int end, const double* value);
    const std::string getUnit(const std::string& varName) const;
 
    
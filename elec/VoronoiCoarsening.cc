@@ -119,16 +119,18 @@ VoronoiCoarsening::VoronoiCoarsening(const Anatomy& anatomy,
    // sensor point mapping is now trivial.  I.e., the color of
    // sensorPoint[iColor] is iColor.
    for (unsigned color=0; color<sensorPoint.size(); ++color)
-      colorToGidMap_.insert(make_pair(color, sensorPoint[color]));
+      colorToGidMap_.insert(colorToGidMap_.end(),
+                            make_pair(color, sensorPoint[color]));
 
-   
-   set<Long64> localCells;
+   // sensorPoint is sorted, so look up the local cells in it instead
+   // of building a set of the local gids.
    for (unsigned ii=0; ii<anatomy.nLocal(); ++ii)
-      localCells.insert(anatomy.gid(ii));
-   for (map<int, Long64>::iterator iter=colorToGidMap_.begin();
-        iter!=colorToGidMap_.end(); ++iter)
-      if (localCells.count(iter->second) == 1)
-         ownedColors_.insert(iter->first);
+   {
+      vector<Long64>::const_iterator here =
+         lower_bound(sensorPoint.begin(), sensorPoint.end(), anatomy.gid(ii));
+      if (here != sensorPoint.end() && *here == anatomy.gid(ii))
+         ownedColors_.insert(here - sensorPoint.begin());
+   }
    
    MPI_Barrier(comm_);
    
@@ -253,382 +255,223 @@ void VoronoiCoarsening::colorDisplacements(std::vector<double>& dx,
    }
 }
 
-void VoronoiCoarsening::setupComm(const map< int, int* >& nremote_colors_from_task, 
-                                  const int size_nremote_colors_from_task)
+VoronoiCoarsening::~VoronoiCoarsening()
 {
-   int myRank;
-   MPI_Comm_rank(comm_, &myRank);  
-
-   dst_tasks_=remote_tasks_;
-   src_tasks_=remote_tasks_;
-   
-   // removed unused communications
-   ncolors_to_send_.clear();
-   ncolors_to_recv_.clear();
-   
-   for(set<int>::const_iterator  itp =remote_tasks_.begin();
-                                 itp!=remote_tasks_.end();
-                               ++itp)
-   {
-      const map< int, int* >::const_iterator itn=nremote_colors_from_task.find(*itp);
-      assert( itn!=nremote_colors_from_task.end() );
-      const int* const nremote_colors=itn->second;
-      for(int i=0;i<size_nremote_colors_from_task;++i)
-      {
-         const int color=nremote_colors[2*i];
-         const int nc   =nremote_colors[2*i+1];
-         set<int>::const_iterator iti=localColors_.find(color);
-         
-         // do something only if I know that color locally
-         //if( iti!=localColors_.end() )
-         if( color>=0 )
-         {
-            ncolors_to_recv_[*itp]++;
-         }else{
-            break;
-         }
-      }
-      ncolors_to_send_[*itp]=(int)localColors_.size();
-   }
+   int finalized;
+   MPI_Finalized(&finalized);
+   if (finalized)
+      return;
+   for (map<int, SumExchange>::iterator iter=sumExchange_.begin();
+        iter!=sumExchange_.end(); ++iter)
+      for (unsigned ii=0; ii<iter->second.request.size(); ++ii)
+         MPI_Request_free(&iter->second.request[ii]);
 }
 
-void VoronoiCoarsening::computeRemoteTasks()
+namespace
 {
-   int myRank;
-   MPI_Comm_rank(comm_, &myRank);  
-   timestampBarrier("Starting VoronoiCoarsening:computeRemoteTasks", comm_);
-
-#if 0
-   for(map<int,int>::const_iterator itr =ncolors_.begin();
-                                    itr!=ncolors_.end();
-                                  ++itr)
-      assert( localColors_.find(itr->first)!=localColors_.end() );
-#endif
-   
-   int nlocalcolors=(int)(localColors_.size());
-   int max_nlocalcolors;
-   MPI_Allreduce(&nlocalcolors, &max_nlocalcolors, 1, MPI_INT, MPI_MAX, comm_);
-   if( myRank==0 )
-      cout<<"VoronoiCoarsening: max_nlocalcolors/task="<<max_nlocalcolors<<endl;
-   
-   // copy localColors_ into vector
-   vector<int> local_colors(localColors_.size());
-   copy(localColors_.begin(),localColors_.end(),local_colors.begin());
-   local_colors.resize(max_nlocalcolors,-1);
+   // A color and a task that has cells of that color.
+   struct ColorTask
+   {
+      int color;
+      int task;
+   };
 
-#if 1
-   int nTasks;
-   MPI_Comm_size(comm_, &nTasks);
-   // calculate all the remote tasks which share colors with local task
-   // (simplest algorithm... may not scale...)
-   
-   remote_tasks_.clear();
-   vector<int> remote_colors(max_nlocalcolors*nTasks,-1);
-   MPI_Allgather(&local_colors[0],  max_nlocalcolors, MPI_INT, 
-                 &remote_colors[0], max_nlocalcolors, MPI_INT, comm_);
-   
-   // get set of tasks I need to talk to
-   for(int pe=0;pe<nTasks;pe++)
-   if( pe!=myRank ){
-      int* remote_colors_pe=&remote_colors[max_nlocalcolors*pe];
-      for(int j=0;j<max_nlocalcolors;j++){
-         if( ncolors_.find(remote_colors_pe[j])!=ncolors_.end() ){
-            remote_tasks_.insert(pe);
-            break;
-         }
-      }
-   }
-#else
-   
-   int nRecvTasks=commTable_->_recvTask.size();
-   int nSendTasks=commTable_->_sendTask.size();
-   int nTasks=nRecvTasks;
-   vector<int> remote_colors(max_nlocalcolors*nRecvTasks,-1);
-   
+   // A ColorTask on its way to task dest.
+   struct ColorTaskMsg
    {
-      
-      std::vector<MPI_Request> recvReq(nRecvTasks);
-      std::vector<MPI_Request> sendReq(nSendTasks);
-   
-      MPI_Request* precvReq = &recvReq[0];      
-      const int tag = 181818;
-      for (unsigned ii=0; ii< commTable_->_recvTask.size(); ++ii)
-      {
-         unsigned sender = commTable_->_recvTask[ii];
-         MPI_Irecv(&remote_colors[ii*max_nlocalcolors], max_nlocalcolors, MPI_INT, sender, tag, commTable_->_comm, precvReq+ii);
-      }
- 
-      MPI_Request* psendReq = &sendReq[0];
-      for (unsigned ii=0; ii<commTable_->_sendTask.size(); ++ii)
-      {
-         unsigned target = commTable_->_sendTask[ii];
-         MPI_Isend(&local_colors[0], max_nlocalcolors, MPI_INT, target, tag, commTable_->_comm, psendReq+ii);
-      }
-   }
-   // get set of tasks I need to talk to
-   for(int ii=0;ii<commTable_->_recvTask.size();ii++){
-      unsigned sender = commTable_->_recvTask[ii];
-      int* remote_colors_pe=&remote_colors[max_nlocalcolors*ii];
-      for(int j=0;j<max_nlocalcolors;j++){
-         if( ncolors_.find(remote_colors_pe[j])!=ncolors_.end() ){
-            remote_tasks_.insert(sender);
-            break;
-         }
-      }
-   }
-#endif   
-   
-   int tag=822;
-   MPI_Request* recvReq=0;
-   MPI_Request* sendReq=0;
-   if( remote_tasks_.size()>0 ){
-      recvReq=new MPI_Request[remote_tasks_.size()];
-      sendReq=new MPI_Request[remote_tasks_.size()];
-   }
+      unsigned dest;
+      ColorTask item;
+   };
 
-   // pack colors and their count into vector
-   vector<int> nlocal_colors;
-   for(map<int,int>::const_iterator itr =ncolors_.begin();
-                                    itr!=ncolors_.end();
-                                  ++itr)
+   bool operator<(const ColorTask& a, const ColorTask& b)
    {
-      nlocal_colors.push_back((int)itr->first);
-      nlocal_colors.push_back((int)itr->second);
+      if (a.color == b.color)
+         return a.task < b.task;
+      return a.color < b.color;
    }
-   assert( nlocal_colors.size()<=2*max_nlocalcolors );
 
-   nlocal_colors.resize(2*max_nlocalcolors,-1);
-
-   map< int, int* > nremote_colors_from_task;
-   int it=0;
-   for(set<int>::const_iterator  itp =remote_tasks_.begin();
-                                 itp!=remote_tasks_.end();
-                               ++itp)
+   bool taskLess(const ColorTask& a, const ColorTask& b)
    {
-      // recv
-      int* buffer=new int[2*max_nlocalcolors];
-      MPI_Irecv(&buffer[0], 2*max_nlocalcolors, MPI_INT, *itp, tag, comm_, recvReq+it);
-      nremote_colors_from_task.insert(pair<int,int*> (*itp,buffer));
-
-      // send
-      MPI_Isend(&nlocal_colors[0],  2*max_nlocalcolors, MPI_INT, *itp, tag, comm_, sendReq+it);
-      
-      it++;
+      if (a.task == b.task)
+         return a.color < b.color;
+      return a.task < b.task;
    }
 
-   // wait
-   if( remote_tasks_.size()>0 ){
-      MPI_Waitall(remote_tasks_.size(), sendReq, MPI_STATUS_IGNORE);
-      MPI_Waitall(remote_tasks_.size(), recvReq, MPI_STATUS_IGNORE);
-   
-      delete[] recvReq;
-      delete[] sendReq;
+   bool operator<(const ColorTaskMsg& a, const ColorTaskMsg& b)
+   {
+      if (a.dest == b.dest)
+         return a.item < b.item;
+      return a.dest < b.dest;
    }
 
-#ifdef DEBUG
-   //for(set<int>::const_iterator  itp =remote_tasks_.begin();
-   //                              itp!=remote_tasks_.end();
-   //                            ++itp)
-   //   cout<<"PE "<<myRank<<" exchange data with task "<<*itp<<endl;
-#endif
+   /** Sends every message to its destination task and returns the
+    *  items received on this task.  msg must be sorted. */
+   vector<ColorTask> sendToDest(const vector<ColorTaskMsg>& msg, MPI_Comm comm)
+   {
+      int nTasks;
+      MPI_Comm_size(comm, &nTasks);
 
-   setupComm(nremote_colors_from_task, max_nlocalcolors);
+      int nRecv;
+      {
+         vector<int> buf(nTasks, 0);
+         for (unsigned ii=0; ii<msg.size(); ++ii)
+            ++buf[msg[ii].dest];
+         vector<int> recvCnt(nTasks, 1);
+         MPI_Reduce_scatter(&buf[0], &nRecv, &recvCnt[0], MPI_INT, MPI_SUM, comm);
+      }
 
-   for(set<int>::const_iterator  itp =remote_tasks_.begin();
-                                 itp!=remote_tasks_.end();
-                               ++itp)
-   {
-      map< int, int* >::const_iterator itn=nremote_colors_from_task.find(*itp);
-      assert( itn!=nremote_colors_from_task.end() );
-      delete[] itn->second;
+      unsigned nLocal = msg.size();
+      vector<ColorTask> data(max(nLocal, unsigned(nRecv)) + 1);
+      vector<unsigned> dest(nLocal + 1);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         data[ii] = msg[ii].item;
+         dest[ii] = msg[ii].dest;
+      }
+      assignArray((unsigned char*) &data[0],
+                  &nLocal,
+                  data.size(),
+                  sizeof(ColorTask),
+                  &dest[0],
+                  0,
+                  comm);
+      data.resize(nLocal);
+      return data;
    }
-   timestampBarrier("Finished VoronoiCoarsening:computeRemoteTasks", comm_);
-
-   //cout<<"Task "<<myRank<<" receives data from "<<src_tasks_.size()
-   //                     <<" tasks and sends data to "<<dst_tasks_.size()<<endl;
 }
 
-void VoronoiCoarsening::exchangeAndSum(LocalSums& valcolors)
+// Finds the tasks that share colors with the local task with a
+// rendezvous: the colors are split in blocks over the tasks and every
+// task sends (color, rank) for its colors to the directory task of the
+// color.  The directory then sends each task with a color the other
+// tasks with that color.  Unlike an Allgather of the color lists of
+// all tasks, no task sees more than its own colors and those of its
+// block.
+void VoronoiCoarsening::computeRemoteTasks()
 {
-   // set up send buffer
-   if( valcolors.size()==0 )
+   int myRank;
+   int nTasks;
+   MPI_Comm_rank(comm_, &myRank);  
+   MPI_Comm_size(comm_, &nTasks);
+   timestampBarrier("Starting VoronoiCoarsening:computeRemoteTasks", comm_);
+
+   const Long64 nColors = colorToGidMap_.size();
+   assert(nColors > 0);
+
+   // localColors_ is sorted, so are the directory tasks
+   vector<ColorTaskMsg> msg;
+   for (set<int>::const_iterator iter=localColors_.begin();
+        iter!=localColors_.end(); ++iter)
    {
-      assert( ncolors_to_recv_.size()==0 );
-      assert( src_tasks_.size()==0 );
-      assert( dst_tasks_.size()==0 );
-      return;
+      ColorTaskMsg tmp = {unsigned((*iter*Long64(nTasks))/nColors), {*iter, myRank}};
+      msg.push_back(tmp);
    }
+   vector<ColorTask> directory = sendToDest(msg, comm_);
 
-   PackedData* localpackeddata=new PackedData[valcolors.size()];
-   valcolors.packData(localpackeddata,valcolors.size());
-   
-   // set up buffer to recv remote data
-   int ndata2recv=0;
-   for(map<int,int>::const_iterator p = ncolors_to_recv_.begin();
-                                    p!= ncolors_to_recv_.end();
-                                  ++p)
-      ndata2recv+=p->second;
-   
-   PackedData* remotepackeddata=0;
-   if( ndata2recv>0 )
-      remotepackeddata=new PackedData[ndata2recv];
-   
-   // exchange local sums
-   MPI_Request* recvReq=0;
-   if(src_tasks_.size()>0)recvReq=new MPI_Request[src_tasks_.size()];
-   MPI_Request* sendReq=0;
-   if(dst_tasks_.size()>0)sendReq=new MPI_Request[dst_tasks_.size()];
-   int tag=823;
-   int it=0;
-   int offset=0;
-   for(set<int>::const_iterator itp =src_tasks_.begin();
-                                itp!=src_tasks_.end();
-                              ++itp)
+   sort(directory.begin(), directory.end());
+   msg.clear();
+   for (unsigned first=0; first<directory.size(); )
    {
-      // recv
-      MPI_Irecv(&remotepackeddata[offset], 
-                ncolors_to_recv_[*itp]*sizeof(PackedData), 
-                MPI_BYTE, *itp, tag, comm_, recvReq+it);
-      offset+=ncolors_to_recv_[*itp];
-      it++;
+      unsigned last = first+1;
+      while (last<directory.size() && directory[last].color == directory[first].color)
+         ++last;
+      for (unsigned ii=first; ii<last; ++ii)
+         for (unsigned jj=first; jj<last; ++jj)
+            if (ii != jj)
+            {
+               ColorTaskMsg tmp = {unsigned(directory[ii].task), directory[jj]};
+               msg.push_back(tmp);
+            }
+      first = last;
    }
-   
-   it=0;
-   for(set<int>::const_iterator itp =dst_tasks_.begin();
-                                itp!=dst_tasks_.end();
-                              ++itp)
+   sort(msg.begin(), msg.end());
+   vector<ColorTask> shared = sendToDest(msg, comm_);
+
+   // group the shared colors by task.  Both tasks of a pair get the
+   // same sorted list.
+   sort(shared.begin(), shared.end(), taskLess);
+   sharedTask_.clear();
+   sharedOffset_.clear();
+   sharedColor_.resize(shared.size());
+   for (unsigned ii=0; ii<shared.size(); ++ii)
    {
-      // send
-      MPI_Isend(&localpackeddata[0], ncolors_to_send_[*itp]*sizeof(PackedData), MPI_BYTE, *itp, tag, comm_, sendReq+it);
-      it++;
+      if (ii == 0 || shared[ii].task != shared[ii-1].task)
+      {
+         sharedTask_.push_back(shared[ii].task);
+         sharedOffset_.push_back(ii);
+      }
+      sharedColor_[ii] = shared[ii].color;
    }
+   sharedOffset_.push_back(shared.size());
 
-   // wait
-   if(sendReq!=0)MPI_Waitall(dst_tasks_.size(), sendReq, MPI_STATUS_IGNORE);
-   if(recvReq!=0)MPI_Waitall(src_tasks_.size(), recvReq, MPI_STATUS_IGNORE);
-   //MPI_Barrier(comm_);
-   
-   if(recvReq!=0)delete[] recvReq;
-   if(sendReq!=0)delete[] sendReq;
-   
-   // accumulate data in valcolors
-   offset=0;
-   for(set<int>::const_iterator itp =src_tasks_.begin();
-                                itp!=src_tasks_.end();
-                              ++itp)
+   int nRemote = sharedTask_.size();
+   int maxRemote;
+   MPI_Allreduce(&nRemote, &maxRemote, 1, MPI_INT, MPI_MAX, comm_);
+   if( myRank==0 )
+      cout<<"VoronoiCoarsening: max remote tasks/task="<<maxRemote<<endl;
+
+   timestampBarrier("Finished VoronoiCoarsening:computeRemoteTasks", comm_);
+}
+
+// Sets up the persistent requests of exchangeAndSum for nvect
+// LocalSums the first time they are needed.
+VoronoiCoarsening::SumExchange& VoronoiCoarsening::sumExchange(const int nvect)
+{
+   map<int, SumExchange>::iterator here = sumExchange_.find(nvect);
+   if (here != sumExchange_.end())
+      return here->second;
+
+   SumExchange& exchange = sumExchange_[nvect];
+   const unsigned nTasks = sharedTask_.size();
+   exchange.sendBuf.resize(nvect*sharedColor_.size());
+   exchange.recvBuf.resize(nvect*sharedColor_.size());
+   exchange.request.resize(2*nTasks);
+   const int tag = 823;
+   for (unsigned ii=0; ii<nTasks; ++ii)
    {
-      for(int i=0;i<ncolors_to_recv_[*itp];i++)
-      {
-         int ii=offset+i;
-         int color=remotepackeddata[ii].color;
-         if( localColors_.find(color)!=localColors_.end() )
-         {
-            valcolors.addnvalues(color,remotepackeddata[ii].value,
-                                       remotepackeddata[ii].n);
-         }
-      }
-      
-      offset+=ncolors_to_recv_[*itp];
+      const int offset = nvect*sharedOffset_[ii];
+      const int size = nvect*(sharedOffset_[ii+1]-sharedOffset_[ii])*sizeof(PackedData);
+      MPI_Recv_init(&exchange.recvBuf[offset], size, MPI_BYTE, sharedTask_[ii],
+                    tag, comm_, &exchange.request[ii]);
+      MPI_Send_init(&exchange.sendBuf[offset], size, MPI_BYTE, sharedTask_[ii],
+                    tag, comm_, &exchange.request[nTasks+ii]);
    }
-   
-   delete[] localpackeddata;
-   if( ndata2recv>0 )delete[] remotepackeddata;
+   return exchange;
 }
 
+void VoronoiCoarsening::exchangeAndSum(LocalSums& valcolors)
+{
+   exchangeAndSum(vector<LocalSums*>(1, &valcolors));
+}
+
+// Adds the sums of the other tasks with the same colors to valcolors.
+// Each task only gets the colors it shares with the sender.
 void VoronoiCoarsening::exchangeAndSum(vector<LocalSums*> valcolors)
 {
-   const unsigned short nvect=(unsigned short)valcolors.size();
-   if( valcolors[0]->size()==0 )
-   {
-      //cout<<"WARNING: valcolors.size()=0 in VoronoiCoarsening::exchangeAndSum()"<<endl;
-      assert( ncolors_to_recv_.size()==0 );
-      assert( src_tasks_.size()==0 );
-      assert( dst_tasks_.size()==0 );
+   if (sharedTask_.empty())
       return;
-   }
-   
-   // set up send buffer
-   PackedData* localpackeddata=new PackedData[nvect*valcolors[0]->size()];
-   for(unsigned short i=0;i<nvect;i++)
-      valcolors[i]->packData(localpackeddata+i*valcolors[i]->size(),valcolors[i]->size());
-   
-   // set up buffer to recv remote data
-   int ndata2recv=0;
-   for(map<int,int>::const_iterator p = ncolors_to_recv_.begin();
-                                    p!= ncolors_to_recv_.end();
-                                  ++p)
-      ndata2recv+=p->second;
-   
-   ndata2recv*=nvect;
-   
-   PackedData* remotepackeddata=0;
-   if( ndata2recv>0 )
-      remotepackeddata=new PackedData[ndata2recv];
-   
-   // exchange local sums
-   MPI_Request* recvReq=0;
-   if(src_tasks_.size()>0)recvReq=new MPI_Request[src_tasks_.size()];
-   MPI_Request* sendReq=0;
-   if(dst_tasks_.size()>0)sendReq=new MPI_Request[dst_tasks_.size()];
-   int tag=824;
-   int it=0;
-   int offset=0;
-   for(set<int>::const_iterator itp =src_tasks_.begin();
-                                itp!=src_tasks_.end();
-                              ++itp)
-   {
-      const int ndata=nvect*ncolors_to_recv_[*itp];
-      
-      // recv
-      MPI_Irecv(&remotepackeddata[offset], 
-                ndata*sizeof(PackedData), 
-                MPI_BYTE, *itp, tag, comm_, recvReq+it);
-      offset+=ndata;
-      it++;
-   }
-   
-   it=0;
-   for(set<int>::const_iterator itp =dst_tasks_.begin();
-                                itp!=dst_tasks_.end();
-                              ++itp)
-   {
-      // send
-      MPI_Isend(&localpackeddata[0], nvect*ncolors_to_send_[*itp]*sizeof(PackedData), MPI_BYTE, *itp, tag, comm_, sendReq+it);
-      it++;
-   }
+   const int nvect = valcolors.size();
+   SumExchange& exchange = sumExchange(nvect);
+
+   PackedData* send = &exchange.sendBuf[0];
+   for (unsigned ii=0; ii<sharedTask_.size(); ++ii)
+      for (int jj=0; jj<nvect; ++jj)
+         for (int kk=sharedOffset_[ii]; kk<sharedOffset_[ii+1]; ++kk)
+            valcolors[jj]->packColor(sharedColor_[kk], *send++);
+
+   MPI_Startall(exchange.request.size(), &exchange.request[0]);
+   MPI_Waitall(exchange.request.size(), &exchange.request[0], MPI_STATUSES_IGNORE);
 
-   // wait
-   if(sendReq!=0)MPI_Waitall(dst_tasks_.size(), sendReq, MPI_STATUS_IGNORE);
-   if(recvReq!=0)MPI_Waitall(src_tasks_.size(), recvReq, MPI_STATUS_IGNORE);
-   //MPI_Barrier(comm_);
-   
-   if(recvReq!=0)delete[] recvReq;
-   if(sendReq!=0)delete[] sendReq;
-   
    // accumulate data in valcolors
-   offset=0;
-   for(set<int>::const_iterator itp =src_tasks_.begin();
-                                itp!=src_tasks_.end();
-                              ++itp)
-   {
-      for(unsigned short j=0;j<nvect;j++){
-         for(int i=0;i<ncolors_to_recv_[*itp];i++)
+   const PackedData* recv = &exchange.recvBuf[0];
+   for (unsigned ii=0; ii<sharedTask_.size(); ++ii)
+      for (int jj=0; jj<nvect; ++jj)
+         for (int kk=sharedOffset_[ii]; kk<sharedOffset_[ii+1]; ++kk)
          {
-            int ii=offset+i;
-            int color=remotepackeddata[ii].color;
-            if( localColors_.find(color)!=localColors_.end() )
-            {
-               valcolors[j]->addnvalues(color,remotepackeddata[ii].value,
-                                        remotepackeddata[ii].n);
-            }
+            assert( recv->color==sharedColor_[kk] );
+            valcolors[jj]->addnvalues(recv->color, recv->value, recv->n);
+            ++recv;
          }
-      
-         offset+=ncolors_to_recv_[*itp];
-      }
-   }
-   
-   delete[] localpackeddata;
-   if( ndata2recv>0 )delete[] remotepackeddata;
 }
 
 void VoronoiCoarsening::accumulateValues(ro_array_ptr<double> val, LocalSums& valcolors)
@@ -656,39 +499,37 @@ void preScreenSensorPoints(vector<Long64>& sensorPoints, const Anatomy& anatomy,
    sort(sensorPoints.begin(), sensorPoints.end());
    vector<Long64>::iterator
       uniqEnd = unique(sensorPoints.begin(), sensorPoints.end());
-   set<Long64> duplicatePoints(uniqEnd, sensorPoints.end());
+   const unsigned nDuplicatePoints = distance(uniqEnd, sensorPoints.end());
    sensorPoints.erase(uniqEnd, sensorPoints.end());
 
-   // count appearances of sensorPoints in Anatomy
-   set<Long64> localCells;
+   // count appearances of sensorPoints in Anatomy.  sensorPoints is
+   // sorted, so the local cells are looked up in it.
+   vector<int> count(sensorPoints.size(), 0);
    for (unsigned ii=0; ii<anatomy.nLocal(); ++ii)
-      localCells.insert(anatomy.gid(ii));
-   vector<int> count(sensorPoints.size());
-   for (unsigned ii=0; ii<sensorPoints.size(); ++ii)
-      count[ii] = localCells.count(sensorPoints[ii]);
+   {
+      vector<Long64>::const_iterator here =
+         lower_bound(sensorPoints.begin(), sensorPoints.end(), anatomy.gid(ii));
+      if (here != sensorPoints.end() && *here == anatomy.gid(ii))
+         ++count[here - sensorPoints.begin()];
+   }
    allReduce(count, MPI_INT, MPI_SUM, comm);
    
    // erase sensorPoints not in the Anatomy
-   vector<Long64> nonTissuePoints;
-   for (vector<int>::iterator iter=count.begin(); iter!=count.end();)
+   unsigned nTissuePoints = 0;
+   for (unsigned ii=0; ii<sensorPoints.size(); ++ii)
    {
-      assert(*iter <= 1);
-      if (*iter == 0)
-      {
-         int dist = distance(count.begin(), iter);
-         iter = count.erase(iter);
-         nonTissuePoints.push_back(*(sensorPoints.begin()+dist));
-         sensorPoints.erase(sensorPoints.begin()+dist);
-      }
-      else
-         ++iter;
+      assert(count[ii] <= 1);
+      if (count[ii] == 1)
+         sensorPoints[nTissuePoints++] = sensorPoints[ii];
    }
+   const unsigned nNonTissuePoints = sensorPoints.size() - nTissuePoints;
+   sensorPoints.resize(nTissuePoints);
    
    if (myRank != 0)
       return;
          
-   cout << "Duplicate points removed:  " << duplicatePoints.size() << endl;
-   cout << "Non-tissue points removed: " << nonTissuePoints.size() << endl;
+   cout << "Duplicate points removed:  " << nDuplicatePoints << endl;
+   cout << "Non-tissue points removed: " << nNonTissuePoints << endl;
    
 }
 
@@ -17,6 +17,14 @@
 class CommTable;
 class LocalSums;
 
+// packed format for communications
+struct PackedData
+{
+   int color;
+   int n;
+   double value;
+};
+
 class VoronoiCoarsening
 {
  public:
@@ -24,6 +32,7 @@ class VoronoiCoarsening
                      std::vector<Long64>& sensorPoint,
                      const double maxDistance,
                      const CommTable* commtable);
+   ~VoronoiCoarsening();
    void exchangeAndSum(LocalSums& valcolors);
    void exchangeAndSum(std::vector<LocalSums*> valcolors);
    void colorDisplacements(std::vector<double>& dx,
@@ -44,13 +53,27 @@ class VoronoiCoarsening
 
  private:
 
+   /** Persistent requests and buffers of exchangeAndSum for one
+    *  number of LocalSums.  The buffers hold one block per task in
+    *  sharedTask_ and the sends and recvs of a pair of tasks line up
+    *  because both have the same list of shared colors. */
+   struct SumExchange
+   {
+      std::vector<PackedData> sendBuf;
+      std::vector<PackedData> recvBuf;
+      std::vector<MPI_Request> request; // recvs, then sends
+   };
+
+   // owns the persistent requests in sumExchange_
+   VoronoiCoarsening(const VoronoiCoarsening&);
+   VoronoiCoarsening& operator=(const VoronoiCoarsening&);
+
    int gaoColoring(const double maxDistance,
                    const std::vector<Long64>& sensorPoint);   
    void computeRemoteTasks();
+   SumExchange& sumExchange(const int nvect);
    void computeColorAverages(const std::vector<double>& val);
    void computeColorCenterValues(const std::vector<double>& val);
-   void setupComm(const std::map< int, int* >& nremote_colors_for_task, 
-                  const int size_nremote_colors_for_task);
 
    Vector getDomaincenter()const;
    double getDomainRadius(const Vector& domain_center)const;
@@ -59,12 +82,14 @@ class VoronoiCoarsening
    
 
 
-   std::map<int,int> ncolors_to_send_; // remote pe -> number of colors
-   std::map<int,int> ncolors_to_recv_; // remote pe -> number of colors
+   // tasks that have cells of a local color and, for each of them,
+   // the (sorted) colors shared with it in
+   // sharedColor_[sharedOffset_[ii]] ... sharedColor_[sharedOffset_[ii+1]-1]
+   std::vector<int> sharedTask_;
+   std::vector<int> sharedOffset_;
+   std::vector<int> sharedColor_;
 
-   std::set<int> remote_tasks_;
-   std::set<int> dst_tasks_;
-   std::set<int> src_tasks_;
+   std::map<int, SumExchange> sumExchange_; // number of LocalSums -> comm
 
    std::set<int> localColors_;
 
@@ -88,14 +113,6 @@ class VoronoiCoarsening
 
 };
 
-// packed format for communications
-struct PackedData
-{
-   int color;
-   int n;
-   double value;
-};
-
 // local sums of values for each color
 class LocalSums
 {
@@ -138,6 +155,16 @@ class LocalSums
       sum_[color]+=value;
    }
    
+   /// Packs the sum of one color (zero if there are no values).
+   void packColor(const int color, PackedData& packeddata)const
+   {
+      std::map<int,int>::const_iterator in=nval_.find(color);
+      std::map<int,double>::const_iterator is=sum_.find(color);
+      packeddata.color=color;
+      packeddata.n    =( in==nval_.end() ) ? 0 : in->second;
+      packeddata.value=( is==sum_.end() ) ? 0. : is->second;
+   }
+
    void packData(PackedData* packeddata, const int ndata)
    {
       assert( nval_.size()==sum_.size() );
@@ -25,6 +25,7 @@
 #include "heap.h"
 #include "object_cc.hh"
 #include "Version.hh"
+#include "OutputService.hh"
 
 #ifdef HPM
 #include <bgpm/include/bgpm.h>
@@ -67,8 +68,8 @@ MPI_Comm COMM_LOCAL = MPI_COMM_WORLD;
 
 int main(int argc, char** argv)
 {
-   int npes, mype;
-   MPI_Init(&argc,&argv);
+   int npes, mype, provided;
+   MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
    MPI_Comm_size(MPI_COMM_WORLD, &npes);
    MPI_Comm_rank(MPI_COMM_WORLD, &mype);  
 
@@ -122,6 +123,8 @@ int main(int argc, char** argv)
       assert(false);
    }
    profileStop_HW("Loop");
+   OutputService::getInstance().stop();
+   profileTraceWrite();
    timestampBarrier("Finished Simulation Loop", MPI_COMM_WORLD);
 #ifdef HPM
   HPM_Stop("Loop"); 
@@ -157,6 +160,11 @@ int main(int argc, char** argv)
       //cout << "\n" << endl;
    }
    //profileDumpStats(cout);
+   if (sim.profileStats_)
+   {
+      profileSetRefTimer("00:Loop");
+      profileDumpStats(cout);
+   }
    stringstream dirname;
    dirname << "snapshot."<<setfill('0')<<setw(12)<<sim.loop_;
    //profileDumpAll(dirname.str());
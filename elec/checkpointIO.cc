@@ -5,6 +5,7 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <unistd.h>
 #include "pio.h"
 #include "ioUtils.h"
@@ -173,29 +174,39 @@ void writeCheckpoint(const Simulate& sim, MPI_Comm comm)
       writeRestart(headerData, dirName);
    }
    
+   // Pull the reaction state a chunk of cells at a time so that each
+   // variable is resolved once per chunk instead of once per cell.
+   const unsigned chunkSize = 4096;
+   const unsigned nLocal = anatomy.nLocal();
    char buf[lRec+1];
-   vector<double> value(handle.size(), 0.0);
+   vector<double> column(handle.size()*chunkSize);
    ro_array_ptr<double> vmarray = sim.vdata_.VmTransport_.useOn(CPU);
-   for (unsigned ii=0; ii<anatomy.nLocal(); ++ii)
+   for (unsigned begin=0; begin<nLocal; begin+=chunkSize)
    {
-      if (sim.asciiCheckpoints_)
-      {
-         int bufPos = sprintf(buf, gidVmFormat, anatomy.gid(ii), vmarray[ii]);
-         sim.reaction_->getValue(ii, handle, value);
-         for (unsigned jj=0; jj<value.size(); ++jj)
-            bufPos += sprintf(buf+bufPos, itemFormat, value[jj]);
-         sprintf(buf+bufPos, "\n");
-      }
-      else
+      unsigned end = min(nLocal, begin+chunkSize);
+      for (unsigned jj=0; jj<handle.size(); ++jj)
+         sim.reaction_->getColumn(handle[jj], begin, end, &column[jj*chunkSize]);
+      
+      for (unsigned ii=begin; ii<end; ++ii)
       {
-         Long64 gid = anatomy.gid(ii);
-         copyBytes(buf, &gid, 8);
-         copyBytes(buf+8, &vmarray[ii], 8);
-         sim.reaction_->getValue(ii, handle, value);
-         for (unsigned jj=0; jj<value.size(); ++jj)
-            copyBytes(buf+16+jj*8, &(value[0])+jj, 8);
+         const double* value = &column[ii-begin];
+         if (sim.asciiCheckpoints_)
+         {
+            int bufPos = sprintf(buf, gidVmFormat, anatomy.gid(ii), vmarray[ii]);
+            for (unsigned jj=0; jj<handle.size(); ++jj)
+               bufPos += sprintf(buf+bufPos, itemFormat, value[jj*chunkSize]);
+            sprintf(buf+bufPos, "\n");
+         }
+         else
+         {
+            Long64 gid = anatomy.gid(ii);
+            copyBytes(buf, &gid, 8);
+            copyBytes(buf+8, &vmarray[ii], 8);
+            for (unsigned jj=0; jj<handle.size(); ++jj)
+               copyBytes(buf+16+jj*8, value+jj*chunkSize, 8);
+         }
+         Pwrite(buf, lRec, 1, file);
       }
-      Pwrite(buf, lRec, 1, file);
    }
    int rc = Pclose(file);
    if (rc == 0) 
@@ -228,41 +239,45 @@ void readCheckpoint(const string& filename, Simulate& sim, MPI_Comm comm)
       }
    }
    
-   for (unsigned ii=0; ii<sim.anatomy_.nLocal(); ++ii)
+   // Fill one column at a time and hand the whole column to the
+   // reaction.
+   const unsigned nLocal = sim.anatomy_.nLocal();
+   assert(data->nRecords() == nLocal);
+   vector<double> column(nLocal);
+   vector<int> intColumn(nLocal);
+   for (FieldMap::const_iterator iter=fieldMap.begin();
+        iter!=fieldMap.end(); ++iter)
    {
-      BucketOfBits::Record iRec = data->getRecord(ii);
-      for (FieldMap::const_iterator iter=fieldMap.begin();
-           iter!=fieldMap.end(); ++iter)
+      int iField = iter->first;
+      int handle = iter->second;
+      switch (data->dataType(iField))
       {
-         int iField = iter->first;
-         int handle = iter->second;
-         double value;
-         switch (data->dataType(iField))
-         {
-           case BucketOfBits::floatType:
-           case BucketOfBits::f8Type:
-           case BucketOfBits::f4Type:
-            iRec.getValue(iField, value);
-            break;
-           case BucketOfBits::intType:
-           case BucketOfBits::u8Type:
-            int tmp;
-            iRec.getValue(iField, tmp);
-            value = double(tmp);
-            break;
-           default:
-            assert(false);
-         }
-         value *= unitConvert[iField];
-         sim.reaction_->setValue(ii, handle, value);
+        case BucketOfBits::floatType:
+        case BucketOfBits::f8Type:
+        case BucketOfBits::f4Type:
+         if (nLocal > 0)
+            data->getColumn(iField, &column[0]);
+         break;
+        case BucketOfBits::intType:
+        case BucketOfBits::u8Type:
+         if (nLocal > 0)
+            data->getColumn(iField, &intColumn[0]);
+         for (unsigned ii=0; ii<nLocal; ++ii)
+            column[ii] = double(intColumn[ii]);
+         break;
+        default:
+         assert(false);
       }
+      for (unsigned ii=0; ii<nLocal; ++ii)
+         column[ii] *= unitConvert[iField];
+      if (nLocal > 0)
+         sim.reaction_->setColumn(handle, 0, nLocal, &column[0]);
    }
 
    // Load membrane voltage from checkpoint file into VmArray.
    wo_array_ptr<double> vmarray = sim.vdata_.VmTransport_.useOn(CPU); 
    unsigned vmIndex = data->getIndex("Vm");
-   if (vmIndex != data->nFields())
-      for (unsigned ii=0; ii<data->nRecords(); ++ii)
-         data->getRecord(ii).getValue(vmIndex, vmarray.raw()[ii]);
+   if (vmIndex != data->nFields() && data->nRecords() > 0)
+      data->getColumn(vmIndex, vmarray.raw());
    delete data;
 }
@@ -2,36 +2,62 @@
 #include <iomanip>
 #include <string>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <set>
 #include <vector>
 #include <mpi.h>
 #include <algorithm>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
 #include <sys/stat.h>
 
-#include "Simulate.hh"
-#include "PerformanceTimers.hh"
-#include "checkpointIO.hh"
 #include "BucketOfBits.hh"
-#include "AnatomyReader.hh"
-#include "stateLoader.hh"
-#include "cellState.hh"
 #include "object_cc.hh"
 #include "readPioFile.hh"
 #include "mpiUtils.h"
 #include "pio.h"
-#include "units.h"
-#include "ioUtils.h"
 
 // compareSnapshots goes through all snapshot subdirectories in two simulation directories and
-// computes the max, min, and rms differences in all floating-point fields for plotting and
+// computes the rms, mean, and max differences in all floating-point fields for plotting and
 // comparison.
+//
+// Usage:  compareSnapshots [-f field1,field2,...] dir1 dir2
+//
+// With -f only the listed fields are compared.
+//
+// Every task reads its pio chunk of the two state files of a snapshot, pulls the gid and the
+// compared fields out as columns and throws the text away.  The columns are then sent to the
+// task that owns the gid range (so that runs with different decompositions can be compared),
+// sorted by gid and compared.  Before a snapshot is compared we ask the kernel to start
+// reading the files of the next snapshot so that the reading overlaps the comparison.  Pio
+// reads are collective, so the next snapshot can't be read by another thread.
 
 using namespace std;
 namespace
 {
-    void readAnatomyBucket(Anatomy& anatomy, BucketOfBits* bucketP);
-    BucketOfBits* fillDataBucket(Simulate& sim, string dirName, double &time, int &nrecord);
+   /** The compared fields of one snapshot directory.  Record ii is
+    *  gid_[ii] followed by value_[nFields*ii .. nFields*(ii+1)). */
+   struct StateColumns
+   {
+      double time_;
+      uint64_t nRecord_;
+      int nx_, ny_, nz_;
+      vector<uint64_t> gid_;
+      vector<double> value_;
+   };
+
+   BucketOfBits* readState(const string& dirName, StateColumns& state);
+   void extractColumns(const BucketOfBits& data, const vector<unsigned>& fieldIndex,
+                       StateColumns& state);
+   void distributeByGid(StateColumns& state, unsigned nFields, uint64_t nGlobal);
+   void sortByGid(StateColumns& state, unsigned nFields);
+   void prefetchState(const string& dirName, int myRank, int nTasks);
+   vector<string> splitFieldList(const string& list);
 }
 
 MPI_Comm COMM_LOCAL = MPI_COMM_WORLD;
@@ -41,17 +67,30 @@ int main(int argc, char** argv)
    int nTasks, myRank;
    MPI_Init(&argc,&argv);
    MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
-   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);  
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
 
-   if (argc != 3)
+   vector<string> selected;
+   int iArg = 1;
+   if (argc == 5 && string(argv[1]) == "-f")
+   {
+      selected = splitFieldList(argv[2]);
+      iArg = 3;
+      if (selected.empty())
+      {
+         if (myRank == 0)
+            cout << "ERROR: -f needs at least one field name" << endl;
+         exit(1);
+      }
+   }
+   if (argc-iArg != 2)
    {
       if (myRank == 0)
-         cout << "Usage:  compareSnapshots [simulation directory 1] [simulation directory 2]" << endl << endl;
+         cout << "Usage:  compareSnapshots [-f field1,field2,...] [simulation directory 1] [simulation directory 2]" << endl << endl;
       exit(1);
    }
-   
-   string runDir1(argv[1]);
-   string runDir2(argv[2]);
+
+   string runDir1(argv[iArg]);
+   string runDir2(argv[iArg+1]);
    const string snapshot("snapshot");  // text that identifies snapshot directory name
 
    // test if runDir1 exists
@@ -65,7 +104,6 @@ int main(int argc, char** argv)
 
    // go through all subdirectories of runDir1, save snapshot directory names
    vector<string> snapshotDirs1;
-   struct dirent *dptr;
    DIR *dir = opendir(runDir1.c_str());
    struct dirent *entry = readdir(dir);
    while (entry != NULL)
@@ -79,7 +117,8 @@ int main(int argc, char** argv)
       }
       entry = readdir(dir);
    }
-   
+   closedir(dir);
+
    // Compute the subset of snapshot directories that exist in both run directories.
    // (If runDir2 doesn't exist, this union will be empty and the code will exit without
    // doing anything.)
@@ -95,13 +134,14 @@ int main(int argc, char** argv)
    if (snapshotUnion.size() <= 0)
    {
       if (myRank == 0)
-         cout << "ERROR: no common snapshot directories in " << runDir1 << " and " << runDir1 << endl;
+         cout << "ERROR: no common snapshot directories in " << runDir1 << " and " << runDir2 << endl;
       exit(1);
    }
 
    // sort snapshotUnion
    sort(snapshotUnion.begin(),snapshotUnion.end());
-   
+
+   set<string> outputStarted;
 
    // compare each set of snapshots across run directories
    for (int isnap=0; isnap<snapshotUnion.size(); isnap++)
@@ -111,238 +151,135 @@ int main(int argc, char** argv)
          cout << endl;
          cout << "Comparing snapshot " << snapshotUnion[isnap] << "..." << endl;
       }
-      
+
       string snapshotDir1 = runDir1 + '/' + snapshotUnion[isnap];
       string snapshotDir2 = runDir2 + '/' + snapshotUnion[isnap];
-      
-      // read state data from first directory
-      Simulate sim1;
-      int nrecord1;
-      double time1;
-      BucketOfBits* data1 = fillDataBucket(sim1,snapshotDir1,time1,nrecord1);
-      
-      // read state data from second directory
-      Simulate sim2;
-      int nrecord2;
-      double time2;
-      BucketOfBits* data2 = fillDataBucket(sim2,snapshotDir2,time2,nrecord2);
-      
-
-      // determine which fields both directories have in common
+
+      StateColumns state1;
+      StateColumns state2;
+      BucketOfBits* data1 = readState(snapshotDir1, state1);
+      BucketOfBits* data2 = readState(snapshotDir2, state2);
+
+      // the reads of this snapshot are done.  Get the next one going.
+      if (isnap+1 < snapshotUnion.size())
+      {
+         prefetchState(runDir1 + '/' + snapshotUnion[isnap+1], myRank, nTasks);
+         prefetchState(runDir2 + '/' + snapshotUnion[isnap+1], myRank, nTasks);
+      }
+
+      // determine which floating point fields both directories have in
+      // common (and are selected)
       vector<string> fieldUnion;
-      vector<int> fieldIndex1;
-      vector<int> fieldIndex2;
-      int gidindex1 = -1;
-      int gidindex2 = -1;
-      int nFields1 = data1->nFields();
-      int nFields2 = data2->nFields();
-      int nFloats = 0;
-
-      for (int ifield=0; ifield<nFields1; ifield++)
+      vector<unsigned> fieldIndex1;
+      vector<unsigned> fieldIndex2;
+      for (unsigned ifield=0; ifield<data1->nFields(); ifield++)
       {
-         for (int jfield=0; jfield<nFields2; jfield++)
-         {
-            if (data1->fieldName(ifield) == data2->fieldName(jfield))
-            {
-               if (data1->fieldName(ifield) == "gid")
-               {
-                  gidindex1 = ifield;
-                  gidindex2 = jfield;
-               }
-               else
-               {
-                  fieldUnion.push_back(data1->fieldName(ifield));
-                  fieldIndex1.push_back(ifield);
-                  fieldIndex2.push_back(jfield);
-                  nFloats++;
-               }
-            }
-         }
+         const string& name = data1->fieldName(ifield);
+         unsigned jfield = data2->getIndex(name);
+         if (name == "gid" || jfield == data2->nFields())
+            continue;
+         if (data1->dataType(ifield) == BucketOfBits::intType ||
+             data1->dataType(ifield) == BucketOfBits::stringType ||
+             data1->dataType(ifield) == BucketOfBits::u8Type)
+            continue;
+         if (!selected.empty() && find(selected.begin(), selected.end(), name) == selected.end())
+            continue;
+         fieldUnion.push_back(name);
+         fieldIndex1.push_back(ifield);
+         fieldIndex2.push_back(jfield);
       }
-      assert(nFloats > 0);
-      
-      assert(gidindex1 >= 0 && gidindex2 >= 0);
-      assert(sim1.anatomy_.nx() == sim2.anatomy_.nx());
-      assert(sim1.anatomy_.ny() == sim2.anatomy_.ny());
-      assert(sim1.anatomy_.nz() == sim2.anatomy_.nz());
-      
-      const int nGlobal = sim1.anatomy_.nx()*sim1.anatomy_.ny()*sim1.anatomy_.nz();
-      const int nLocal1 = sim1.anatomy_.nLocal();
-      const int nLocal2 = sim2.anatomy_.nLocal();
-      vector<cellState> state1(nLocal1*nFloats);
-      vector<cellState> state2(nLocal2*nFloats);
-      
-      // distribute data across all tasks in a consistent way so we can compare state files
-      // generated with different load balance algorithms
-      
-      // directory 1
-      for (unsigned ii=0; ii<nLocal1; ++ii)
+      if (myRank == 0)
+         for (unsigned ii=0; ii<selected.size(); ++ii)
+            if (find(fieldUnion.begin(), fieldUnion.end(), selected[ii]) == fieldUnion.end())
+               cout << "WARNING: field " << selected[ii]
+                    << " is not a floating point field of both snapshots" << endl;
+      const unsigned nFloats = fieldUnion.size();
+      if (nFloats == 0)
       {
-         BucketOfBits::Record iRec = data1->getRecord(ii);
-         int gid;
-         iRec.getValue(gidindex1, gid);
-         assert(gid >= 0 && gid < nGlobal);
-         
-         double gidFrac = (double)gid/(double)nGlobal;
-         int dest = gidFrac*nTasks;
-         if (dest >= nTasks) dest = nTasks-1;
-         
-         int floatCnt1 = 0;
-         for (unsigned jj=0; jj<nFloats; ++jj)
-         {
-            int find = fieldIndex1[jj];
-            if (data1->dataType(find) == BucketOfBits::floatType)
-            {
-               double value;
-               iRec.getValue(find, value);
-               state1[nFloats*ii + floatCnt1].value_ = value;
-               state1[nFloats*ii + floatCnt1].gid_ = gid;
-               state1[nFloats*ii + floatCnt1].dest_ = dest;
-               state1[nFloats*ii + floatCnt1].sortind_ = nFloats*gid + floatCnt1;
-               floatCnt1++;
-            }
-         }
+         if (myRank == 0)
+            cout << "ERROR: no selected floating point field is in both "
+                 << snapshotDir1 << " and " << snapshotDir2 << endl;
+         exit(1);
       }
-      
-      // directory 2
-      for (unsigned ii=0; ii<nLocal2; ++ii)
+
+      assert(data1->getIndex("gid") != data1->nFields());
+      assert(data2->getIndex("gid") != data2->nFields());
+      extractColumns(*data1, fieldIndex1, state1);
+      extractColumns(*data2, fieldIndex2, state2);
+      delete data1;
+      delete data2;
+
+      assert(state1.nx_ == state2.nx_);
+      assert(state1.ny_ == state2.ny_);
+      assert(state1.nz_ == state2.nz_);
+      const uint64_t nGlobal = uint64_t(state1.nx_)*state1.ny_*state1.nz_;
+
+      // distribute data across all tasks in a consistent way so we can compare state files
+      // generated with different load balance algorithms
+      distributeByGid(state1, nFloats, nGlobal);
+      distributeByGid(state2, nFloats, nGlobal);
+
+      // sort data arrays so that local gids are in same order for both
+      sortByGid(state1, nFloats);
+      sortByGid(state2, nFloats);
+
+      assert(state1.gid_ == state2.gid_);
+      const unsigned nLoc = state1.gid_.size();
+
+      // sum of squares and sum of the differences
+      vector<double> sumLoc(2*nFloats, 0.0);
+      vector<double> maxdiffLoc(nFloats, 0.0);
+      vector<uint64_t> gidMaxLoc(nFloats, nLoc > 0 ? state1.gid_[0] : UINT64_MAX);
+      for (unsigned ii=0; ii<nLoc; ++ii)
       {
-         BucketOfBits::Record iRec = data2->getRecord(ii);
-         int gid;
-         iRec.getValue(gidindex2, gid);
-         assert(gid >= 0 && gid < nGlobal);
-         double gidFrac = (double)gid/(double)nGlobal;
-         int dest = gidFrac*nTasks;
-         if (dest >= nTasks) dest = nTasks-1;
-         
-         int floatCnt2 = 0;
+         const double* val1 = &state1.value_[nFloats*ii];
+         const double* val2 = &state2.value_[nFloats*ii];
          for (unsigned jj=0; jj<nFloats; ++jj)
          {
-            int find = fieldIndex2[jj];
-            if (data2->dataType(find) == BucketOfBits::floatType)
+            double diff = val1[jj] - val2[jj];
+            sumLoc[2*jj] += diff*diff;
+            sumLoc[2*jj+1] += diff;
+            if (fabs(diff) > maxdiffLoc[jj])
             {
-               double value;
-               iRec.getValue(find, value);
-               state2[nFloats*ii + floatCnt2].value_ = value;
-               state2[nFloats*ii + floatCnt2].gid_ = gid;
-               state2[nFloats*ii + floatCnt2].dest_ = dest;
-               state2[nFloats*ii + floatCnt2].sortind_ = nFloats*gid + floatCnt2;
-               floatCnt2++;
+               maxdiffLoc[jj] = fabs(diff);
+               gidMaxLoc[jj] = state1.gid_[ii];
             }
          }
       }
-      unsigned nSize1 = nLocal1*nFloats;
-      unsigned nSize2 = nLocal2*nFloats;
-      
-      // distribute state values
-      
-      // directory 1
-      sort(state1.begin(),state1.end(),cellState::destLessThan);
-      vector<unsigned> dest1(nSize1);
-      for (unsigned ii=0; ii<state1.size(); ++ii)
-         dest1[ii] = state1[ii].dest_;
-      
-      int maxLocbuf1 = nSize1;
-      int nMax1;
-      MPI_Allreduce(&maxLocbuf1, &nMax1, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-      
-      state1.resize(10*nMax1);
-      assignArray((unsigned char*)&(state1[0]), &nSize1, state1.capacity(),
-                  sizeof(cellState), &(dest1[0]), 0, MPI_COMM_WORLD);
-      
-      assert(nSize1 <= (unsigned)nMax1);
-      state1.resize(nSize1);
-      
-      // directory 2
-      sort(state2.begin(),state2.end(),cellState::destLessThan);
-      vector<unsigned> dest2(nSize2);
-      for (unsigned ii=0; ii<state2.size(); ++ii)
-         dest2[ii] = state2[ii].dest_;
-      
-      int maxLocbuf2 = nSize2;
-      int nMax2;
-      MPI_Allreduce(&maxLocbuf2, &nMax2, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-      
-      state2.resize(10*nMax2);
-      assignArray((unsigned char*)&(state2[0]), &nSize2, state2.capacity(),
-                  sizeof(cellState), &(dest2[0]), 0, MPI_COMM_WORLD);
-      
-      assert(nSize2 <= (unsigned)nMax2);
-      state2.resize(nSize2);
-      
-      // sort data arrays so that local gids are in same order for both
-      sort(state1.begin(),state1.end(),cellState::indLessThan);
-      sort(state2.begin(),state2.end(),cellState::indLessThan);
-      
-      assert(nSize1 == nSize2);
-      int nLoc = nSize1/nFloats;
-      
-      int floatCnt1 = 0;
+      vector<double> sum(2*nFloats);
+      vector<double> maxdiff(nFloats);
+      MPI_Allreduce(&sumLoc[0], &sum[0], 2*nFloats, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+      MPI_Allreduce(&maxdiffLoc[0], &maxdiff[0], nFloats, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      // when several tasks have the max difference report the smallest gid
       for (unsigned jj=0; jj<nFloats; ++jj)
-      {
-         double rmssqLoc = 0.0;
-         int rmscnt = 0;
-         double maxdiffLoc = 0.0;
-         for (unsigned ii=0; ii<nLoc; ++ii)
-         {
-            Long64 gid1 = state1[nFloats*ii+jj].gid_;
-            Long64 gid2 = state2[nFloats*ii+jj].gid_;
-            assert(gid1 == gid2);
-            
-            double val1 = state1[nFloats*ii+jj].value_;
-            double val2 = state2[nFloats*ii+jj].value_;
-            rmssqLoc += (val1-val2)*(val1-val2);
-            rmscnt++;
-            if (abs(val1-val2) > maxdiffLoc) maxdiffLoc = abs(val1-val2);
-         }
-         double rmssq;
-         MPI_Allreduce(&rmssqLoc, &rmssq, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-         double rms = sqrt(rmssq);
-         double maxdiff;
-         MPI_Allreduce(&maxdiffLoc, &maxdiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
-
-         //ewd DEBUG:  print out gid of all cells with Vm difference within 0.95 of max
-         if (fieldUnion[jj] == "Vm")
-         {
-            cout.setf(ios::scientific,ios::floatfield);
-            for (unsigned ii=0; ii<nLoc; ++ii)
-            {
-               Long64 gid1 = state1[nFloats*ii+jj].gid_;
-               Long64 gid2 = state2[nFloats*ii+jj].gid_;
-               assert(gid1 == gid2);
-               
-               double val1 = state1[nFloats*ii+jj].value_;
-               double val2 = state2[nFloats*ii+jj].value_;
-               double diff = abs(val1-val2);
-               if (diff > 0.99*maxdiff && maxdiff > 1.E-9) 
-                  cout << "  gid " << gid1 << ", Vm difference = " << setprecision(10) << diff << ", maximum difference = " << maxdiff << endl;               
-            }
-         }
-         //ewd DEBUG
+         if (maxdiffLoc[jj] != maxdiff[jj])
+            gidMaxLoc[jj] = UINT64_MAX;
+      vector<uint64_t> gidMax(nFloats);
+      MPI_Allreduce(&gidMaxLoc[0], &gidMax[0], nFloats, MPI_UINT64_T, MPI_MIN, MPI_COMM_WORLD);
 
-         
-         // save output to file
-         if (myRank == 0)
+      // save output to file
+      if (myRank == 0)
+      {
+         for (unsigned jj=0; jj<nFloats; ++jj)
          {
             string fieldFile = "verif." + fieldUnion[jj] + ".dat";
             ofstream ofout;
-            if (isnap == 0)
+            if (outputStarted.insert(fieldUnion[jj]).second)
             {
                ofout.open(fieldFile.c_str(),ofstream::out);
-               ofout << "#      time            rms avg            rms tot           max diff" << endl;
+               ofout << "#      time            rms avg            rms tot           max diff          mean diff     gid of max" << endl;
             }
             else
                ofout.open(fieldFile.c_str(),ofstream::app);
-            double rmsavg = (nrecord1 > 0 ? rms/nrecord1 : 0.0);
+            double rms = sqrt(sum[2*jj]);
+            double rmsavg = (state1.nRecord_ > 0 ? rms/state1.nRecord_ : 0.0);
+            double mean = (state1.nRecord_ > 0 ? sum[2*jj+1]/state1.nRecord_ : 0.0);
             ofout.setf(ios::scientific,ios::floatfield);
-            ofout << setprecision(10) << time1 << "    " << rmsavg << "    " << rms << "    " << maxdiff << endl;
+            ofout << setprecision(10) << state1.time_ << "    " << rmsavg << "    " << rms << "    "
+                  << maxdiff[jj] << "    " << mean << "    " << gidMax[jj] << endl;
             ofout.close();
          }
       }
-
-      delete data1;
-      delete data2;
-
    }
    MPI_Finalize();
    return 0;
@@ -350,57 +287,149 @@ int main(int argc, char** argv)
 
 namespace
 {
-    void readAnatomyBucket(Anatomy& anatomy, BucketOfBits* bucketP)
-    {
-       vector<AnatomyCell>& cells = anatomy.cellArray();
-       
-       unsigned nRecords =  bucketP->nRecords();
-       unsigned nFields =   bucketP->nFields();
-       unsigned gidIndex =  bucketP->getIndex("gid");
-       assert( gidIndex != nFields);
-       for (unsigned ii=0; ii<nRecords; ++ii)
-       {
-          AnatomyCell tmp;
-          BucketOfBits::Record rr = bucketP->getRecord(ii);
-          rr.getValue(gidIndex, tmp.gid_);
-          tmp.cellType_ = 100; // hack since state files don't have cell type information
-          cells.push_back(tmp);
-       }
-    }
-    
-    BucketOfBits* fillDataBucket(Simulate& sim, string dirName, double &time, int &nrecord)
-    {
-       string stateFile = dirName + "/state#";
-       PFILE* file = Popen(stateFile.c_str(), "r", MPI_COMM_WORLD);
-       OBJECT* hObj = file->headerObject;
-
-       int nx, ny, nz;
-       objectGet(hObj, "nx", nx, "0");
-       objectGet(hObj, "ny", ny, "0");
-       objectGet(hObj, "nz", nz, "0");
-       assert(nx*ny*nz > 0);
-       objectGet(hObj, "time", time, "0.0");
-       objectGet(hObj, "nrecord", nrecord, "0");
-       
-       
-       //string rTmp;
-       //objectGet(hObj, "reactionMethod", rTmp, "reaction");
-       //sim.reaction_ = reactionFactory(rTmp, sim.anatomy_, sim.reactionThreads_);
-
-       sim.anatomy_.setGridSize(nx,ny,nz);
-
-       // fill sim.anatomy_ with gids, arbitrary cell type
-       BucketOfBits* bucketP = readPioFile(file);
-       Pclose(file);
-       readAnatomyBucket(sim.anatomy_, bucketP);
-       delete bucketP;
-       
-       //cout << "First state directory, myRank = " << myRank << ", grid = " << nx << " x " << ny << " x " << nz << ", sim.nLocal = " << sim.anatomy_.nLocal() << endl;
-
-       BucketOfBits* data = loadAndDistributeState(stateFile, sim.anatomy_);
-       assert(data->nRecords() == sim.anatomy_.nLocal());
-
-       return data;
-    }
+   /** Reads the state file in dirName.  Each task gets the records in
+    *  the pio chunk it read.  The header data is stored in state. */
+   BucketOfBits* readState(const string& dirName, StateColumns& state)
+   {
+      string stateFile = dirName + "/state#";
+      PFILE* file = Popen(stateFile.c_str(), "r", MPI_COMM_WORLD);
+      OBJECT* hObj = file->headerObject;
+
+      objectGet(hObj, "nx", state.nx_, "0");
+      objectGet(hObj, "ny", state.ny_, "0");
+      objectGet(hObj, "nz", state.nz_, "0");
+      assert(state.nx_*state.ny_*state.nz_ > 0);
+      objectGet(hObj, "time", state.time_, "0.0");
+      state.nRecord_ = file->numberRecords;
+
+      BucketOfBits* data = readPioFile(file);
+      Pclose(file);
+      return data;
+   }
+
+   void extractColumns(const BucketOfBits& data, const vector<unsigned>& fieldIndex,
+                       StateColumns& state)
+   {
+      const unsigned nRecords = data.nRecords();
+      const unsigned nFields = fieldIndex.size();
+      state.gid_.resize(nRecords);
+      state.value_.resize(nFields*nRecords);
+      if (nRecords == 0)
+         return;
+      data.getColumn(data.getIndex("gid"), &state.gid_[0]);
+
+      vector<double> column(nRecords);
+      for (unsigned jj=0; jj<nFields; ++jj)
+      {
+         data.getColumn(fieldIndex[jj], &column[0]);
+         for (unsigned ii=0; ii<nRecords; ++ii)
+            state.value_[nFields*ii+jj] = column[ii];
+      }
+   }
+
+   /** Sends every record to the task that owns its gid.  The gids are
+    *  split in nTasks equal ranges. */
+   void distributeByGid(StateColumns& state, unsigned nFields, uint64_t nGlobal)
+   {
+      int nTasks, myRank;
+      MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+      // bucket sort the records by destination while packing them in
+      // one buffer.  A record is the gid followed by the values.
+      const unsigned nLocal = state.gid_.size();
+      const unsigned width = sizeof(double)*(nFields+1);
+      vector<unsigned> dest(nLocal);
+      vector<unsigned> count(nTasks, 0);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         assert(state.gid_[ii] < nGlobal);
+         double gidFrac = (double)state.gid_[ii]/(double)nGlobal;
+         unsigned dd = gidFrac*nTasks;
+         if (dd >= nTasks) dd = nTasks-1;
+         dest[ii] = dd;
+         ++count[dd];
+      }
+      vector<unsigned> nRecv(nTasks);
+      MPI_Allreduce(&count[0], &nRecv[0], nTasks, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD);
+      const unsigned capacity = max(nLocal, nRecv[myRank]);
 
+      vector<unsigned> offset(nTasks+1, 0);
+      for (int ii=0; ii<nTasks; ++ii)
+         offset[ii+1] = offset[ii] + count[ii];
+      vector<double> buf(size_t(capacity)*(nFields+1));
+      vector<unsigned> sortedDest(nLocal);
+      for (unsigned ii=0; ii<nLocal; ++ii)
+      {
+         unsigned kk = offset[dest[ii]]++;
+         sortedDest[kk] = dest[ii];
+         double* rec = &buf[size_t(kk)*(nFields+1)];
+         memcpy(rec, &state.gid_[ii], sizeof(uint64_t));
+         copy(&state.value_[0]+size_t(ii)*nFields, &state.value_[0]+size_t(ii+1)*nFields, rec+1);
+      }
+
+      unsigned n = nLocal;
+      assignArray((unsigned char*)(buf.empty() ? NULL : &buf[0]), &n, capacity, width,
+                  (sortedDest.empty() ? NULL : &sortedDest[0]), 0, MPI_COMM_WORLD);
+      assert(n == nRecv[myRank]);
+
+      state.gid_.resize(n);
+      state.value_.resize(size_t(n)*nFields);
+      for (unsigned ii=0; ii<n; ++ii)
+      {
+         const double* rec = &buf[size_t(ii)*(nFields+1)];
+         memcpy(&state.gid_[ii], rec, sizeof(uint64_t));
+         copy(rec+1, rec+1+nFields, &state.value_[0]+size_t(ii)*nFields);
+      }
+   }
+
+   void sortByGid(StateColumns& state, unsigned nFields)
+   {
+      const unsigned n = state.gid_.size();
+      vector<pair<uint64_t, unsigned> > order(n);
+      for (unsigned ii=0; ii<n; ++ii)
+         order[ii] = make_pair(state.gid_[ii], ii);
+      sort(order.begin(), order.end());
+
+      vector<double> value(size_t(n)*nFields);
+      for (unsigned ii=0; ii<n; ++ii)
+      {
+         state.gid_[ii] = order[ii].first;
+         const double* src = &state.value_[0] + size_t(order[ii].second)*nFields;
+         copy(src, src+nFields, &value[0]+size_t(ii)*nFields);
+      }
+      state.value_.swap(value);
+   }
+
+   /** Asks the kernel to start reading the files of the state file in
+    *  dirName.  Task ii takes files ii, ii+nTasks, ... */
+   void prefetchState(const string& dirName, int myRank, int nTasks)
+   {
+      for (int fid=myRank; ; fid+=nTasks)
+      {
+         char filename[1024];
+         sprintf(filename, "%s/state#%6.6d", dirName.c_str(), fid);
+         int fd = open(filename, O_RDONLY);
+         if (fd < 0)
+            break;
+         posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+         close(fd);
+      }
+   }
+
+   vector<string> splitFieldList(const string& list)
+   {
+      vector<string> fields;
+      size_t begin = 0;
+      while (begin <= list.size())
+      {
+         size_t end = list.find(',', begin);
+         if (end == string::npos)
+            end = list.size();
+         if (end > begin)
+            fields.push_back(list.substr(begin, end-begin));
+         begin = end+1;
+      }
+      return fields;
+   }
 }
@@ -1,6 +1,7 @@
 #include "diffusionFactory.hh"
 
 #include <cassert>
+#include <iostream>
 
 #include "Diffusion.hh"
 #include "object_cc.hh"
@@ -11,11 +12,15 @@
 #include "FGRDiffusionThreads.hh"
 #include "FGRDiffusionStrip.hh"
 #include "FGRDiffusionOverlap.hh"
+#include "FGRDiffusionSparse.hh"
+#include "FGRDiffusionImplicit.hh"
 #include "NullDiffusion.hh"
 //#include "OpenmpGpuRedblackDiffusion.hh"
 //#include "OpenmpGpuFlatDiffusion.hh"
 #include "CUDADiffusion.hh"
 #include "Simulate.hh"
+#include "CommTable.hh"
+#include "mpiUtils.h"
 
 class Anatomy;
 class ThreadTeam;
@@ -29,7 +34,12 @@ namespace
    Diffusion* fgrDiffusionFactory(OBJECT* obj, const Anatomy& anatomy,
                                   const ThreadTeam& threadInfo,
                                   const ThreadTeam& reactionThreadInfo,
-                                  int simLoopType, string loadLevelVariant);
+                                  int simLoopType, string loadLevelVariant,
+                                  const CommTable* commTable);
+   Diffusion* implicitDiffusionFactory(OBJECT* obj, const Anatomy& anatomy,
+                                       int simLoopType, double dt,
+                                       const vector<int>& sendMap,
+                                       const CommTable* commTable);
    void checkForObsoleteKeywords(OBJECT* obj);
 }
 
@@ -37,7 +47,10 @@ namespace
 Diffusion* diffusionFactory(const string& name, const Anatomy& anatomy,
                             const ThreadTeam& threadInfo,
                             const ThreadTeam& reactionThreadInfo,
-                            int simLoopType, string &variantHint)
+                            int simLoopType, string &variantHint,
+                            double dt,
+                            const vector<int>& sendMap,
+                            const CommTable* commTable)
 {
    OBJECT* obj = objectFind(name, "DIFFUSION");
 
@@ -50,7 +63,9 @@ Diffusion* diffusionFactory(const string& name, const Anatomy& anatomy,
    if (method.empty())
       assert(1==0);
    else if (method == "FGR")
-      return fgrDiffusionFactory(obj, anatomy, threadInfo, reactionThreadInfo, simLoopType, variantHint);
+      return fgrDiffusionFactory(obj, anatomy, threadInfo, reactionThreadInfo, simLoopType, variantHint, commTable);
+   else if (method == "implicit")
+      return implicitDiffusionFactory(obj, anatomy, simLoopType, dt, sendMap, commTable);
    //else if (method == "gpu" || method == "OpenmpGpuRedblack")
    //   return new OpenmpGpuRedblackDiffusion(anatomy, simLoopType);
    //else if (method == "OpenmpGpuFlat")
@@ -68,22 +83,53 @@ Diffusion* diffusionFactory(const string& name, const Anatomy& anatomy,
 
 namespace
 {
+   /** Keywords for method = FGR (besides diffusionScale, printBBox and
+    *  variant):
+    *  - floatWeights:       1 to store the stencil weights in single
+    *                        precision.  Sums are still accumulated in
+    *                        double.  Default 0.
+    *  - floatVm:            1 to also gather Vm into a single precision
+    *                        block.  Needs floatWeights.  Default 0.
+    *  - precisionCheckRate: every so many time steps compare dVm with
+    *                        the double precision stencil.  Default 0
+    *                        (never).
+    *  - precisionTolerance: largest acceptable difference of dVm
+    *                        relative to the largest |dVm|.  If a check
+    *                        finds a larger difference the diffusion
+    *                        switches to double precision for the rest
+    *                        of the run.  Default 1e-2.
+    *  Only variant omp supports the single precision options.
+    *
+    *  variant = sparse stores only the 4x4x4 bricks of the grid that
+    *  contain cells (see FGRDiffusionSparse).  omp loop only.
+    */
    Diffusion* fgrDiffusionFactory(OBJECT* obj, const Anatomy& anatomy,
                                   const ThreadTeam& threadInfo,
                                   const ThreadTeam& reactionThreadInfo,
-                                  int simLoopType, string variantHint)
+                                  int simLoopType, string variantHint,
+                                  const CommTable* commTable)
    {
       FGRUtils::FGRDiffusionParms p;
       objectGet(obj, "diffusionScale", p.diffusionScale_, "1.0", "l^3/capacitance");
       objectGet(obj, "printBBox",      p.printBBox_, "0");
+      objectGet(obj, "floatWeights",   p.floatWeights_, "0");
+      objectGet(obj, "floatVm",        p.floatVm_, "0");
+      objectGet(obj, "precisionCheckRate", p.precisionCheckRate_, "0");
+      objectGet(obj, "precisionTolerance", p.precisionTolerance_, "1e-2");
       string defaultVariant = "omp";
       if (! variantHint.empty())
          defaultVariant = variantHint;
       string variant;
       objectGet(obj, "variant", variant, defaultVariant);
+      bool useSparse = (variant == "sparse" && simLoopType == Simulate::omp);
+      bool useOmp = !useSparse && (variant == "omp" || simLoopType == Simulate::omp);
+      if (p.floatWeights_ && !useOmp && getRank(0) == 0)
+         cout << "floatWeights is only supported by variant omp.  Ignored." << endl;
       if (0) {}
-      else if (variant == "omp" || simLoopType == Simulate::omp)
-         return new FGRDiffusionOMP(p, anatomy);
+      else if (useSparse)
+         return new FGRDiffusionSparse(p, anatomy);
+      else if (useOmp)
+         return new FGRDiffusionOMP(p, anatomy, commTable->_comm);
       else if (variant == "threads")
          return new FGRDiffusionThreads(p, anatomy, threadInfo, reactionThreadInfo);
       else if (variant == "simd")
@@ -101,6 +147,48 @@ namespace
    }
 }
 
+namespace
+{
+   /** Keywords for method = implicit:
+    *  - diffusionScale: as for FGR.
+    *  - theta:          1 (backward Euler, default) to 0.5 (Crank-Nicolson).
+    *  - tolerance:      relative residual at which BiCGStab stops.
+    *                    Default 1e-8.
+    *  - absTolerance:   residual (mV/ms, 2-norm over all cells) below
+    *                    which it stops anyway.  Default 1e-10.
+    *  - maxIterations:  Default 200.
+    */
+   Diffusion* implicitDiffusionFactory(OBJECT* obj, const Anatomy& anatomy,
+                                       int simLoopType, double dt,
+                                       const vector<int>& sendMap,
+                                       const CommTable* commTable)
+   {
+      FGRUtils::FGRDiffusionParms p;
+      objectGet(obj, "diffusionScale", p.diffusionScale_, "1.0", "l^3/capacitance");
+      objectGet(obj, "printBBox",      p.printBBox_, "0");
+      p.floatWeights_ = false;
+      p.floatVm_ = false;
+      p.precisionCheckRate_ = 0;
+      p.precisionTolerance_ = 0;
+      double theta;
+      double tolerance;
+      double absTolerance;
+      int maxIterations;
+      objectGet(obj, "theta",         theta,         "1.0");
+      objectGet(obj, "tolerance",     tolerance,     "1e-8");
+      objectGet(obj, "absTolerance",  absTolerance,  "1e-10");
+      objectGet(obj, "maxIterations", maxIterations, "200");
+      if (simLoopType != Simulate::omp)
+      {
+         std::cerr << "ERROR --- DIFFUSION method = implicit requires loopType = omp" << std::endl;
+         assert(false);
+      }
+      return new FGRDiffusionImplicit(p, anatomy, sendMap, commTable,
+                                      dt, theta, tolerance, absTolerance,
+                                      maxIterations);
+   }
+}
+
 
 namespace
 {
@@ -2,14 +2,19 @@
 #define DIFFUSION_FACTORY_HH
 
 #include <string>
+#include <vector>
 class Diffusion;
 class Anatomy;
 class ThreadTeam;
+class CommTable;
 
 Diffusion* diffusionFactory(const std::string& name,
                             const Anatomy& anatomy,
                             const ThreadTeam& threadInfo,
                             const ThreadTeam& reactionThreadInfo,
-                            int simLoopType, std::string &variant);
+                            int simLoopType, std::string &variant,
+                            double dt,
+                            const std::vector<int>& sendMap,
+                            const CommTable* commTable);
 
 #endif
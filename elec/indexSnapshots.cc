@@ -0,0 +1,151 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "SnapshotIndex.hh"
+
+// indexSnapshots builds the gid indices of pio file sets and uses them to read single records
+// or time traces without reading the whole files.  A file set is a name ending in # (e.g.
+// snapshot.000000001000/state#) or a snapshot directory, which means dir/state#.
+//
+// Usage:
+//   indexSnapshots build [file set]...
+//   indexSnapshots read [file set] [field1,field2,...] [gid]...
+//   indexSnapshots trace [field1,field2,...] [gid1,gid2,...] [file set]...
+//
+// read prints one line per gid.  trace prints one line per file set: the time followed by the
+// fields of the first gid, the fields of the second gid, ...
+
+using namespace std;
+
+namespace
+{
+   vector<string> splitList(const string& list);
+   void usage();
+}
+
+int main(int argc, char** argv)
+{
+   if (argc < 3)
+      usage();
+   string command(argv[1]);
+
+   cout.setf(ios::scientific, ios::floatfield);
+   cout << setprecision(12);
+
+   if (command == "build")
+   {
+      for (int ii=2; ii<argc; ++ii)
+      {
+         SnapshotIndex index(argv[ii]);
+         if (!index.ok())
+         {
+            cerr << "ERROR: " << index.error() << endl;
+            return 1;
+         }
+         cout << index.stem() << ": " << index.nRecords() << " records" << endl;
+      }
+      return 0;
+   }
+
+   if (command == "read" && argc >= 5)
+   {
+      SnapshotIndex index(argv[2]);
+      if (!index.ok())
+      {
+         cerr << "ERROR: " << index.error() << endl;
+         return 1;
+      }
+      vector<string> names = splitList(argv[3]);
+      vector<int> fields(names.size());
+      for (unsigned jj=0; jj<names.size(); ++jj)
+      {
+         fields[jj] = index.fieldIndex(names[jj]);
+         if (fields[jj] < 0)
+            cerr << "WARNING: no field " << names[jj] << " in " << index.stem() << endl;
+      }
+      vector<uint64_t> gids;
+      for (int ii=4; ii<argc; ++ii)
+         gids.push_back(strtoull(argv[ii], NULL, 10));
+
+      vector<double> value(gids.size()*fields.size());
+      index.read(&gids[0], gids.size(), &fields[0], fields.size(), &value[0]);
+      for (unsigned ii=0; ii<gids.size(); ++ii)
+      {
+         cout << gids[ii];
+         for (unsigned jj=0; jj<fields.size(); ++jj)
+            cout << "  " << value[ii*fields.size()+jj];
+         cout << endl;
+      }
+      return 0;
+   }
+
+   if (command == "trace" && argc >= 5)
+   {
+      vector<string> names = splitList(argv[2]);
+      vector<string> gidList = splitList(argv[3]);
+      vector<uint64_t> gids(gidList.size());
+      for (unsigned ii=0; ii<gids.size(); ++ii)
+         gids[ii] = strtoull(gidList[ii].c_str(), NULL, 10);
+      vector<string> stems(argv+4, argv+argc);
+
+      const unsigned nRead = names.size();
+      vector<double> time(stems.size());
+      vector<double> value(stems.size()*gids.size()*nRead);
+      string error;
+      if (gatherTimeSeries(stems, &gids[0], gids.size(), names, &time[0], &value[0], error) < 0)
+      {
+         cerr << "ERROR: " << error << endl;
+         return 1;
+      }
+
+      cout << "# time";
+      for (unsigned ii=0; ii<gids.size(); ++ii)
+         for (unsigned jj=0; jj<nRead; ++jj)
+            cout << "  " << names[jj] << "(" << gids[ii] << ")";
+      cout << endl;
+      for (unsigned iSnap=0; iSnap<stems.size(); ++iSnap)
+      {
+         cout << time[iSnap];
+         const double* vv = &value[iSnap*gids.size()*nRead];
+         for (unsigned kk=0; kk<gids.size()*nRead; ++kk)
+            cout << "  " << vv[kk];
+         cout << endl;
+      }
+      return 0;
+   }
+
+   usage();
+   return 1;
+}
+
+namespace
+{
+   vector<string> splitList(const string& list)
+   {
+      vector<string> items;
+      size_t begin = 0;
+      while (begin <= list.size())
+      {
+         size_t end = list.find(',', begin);
+         if (end == string::npos)
+            end = list.size();
+         if (end > begin)
+            items.push_back(list.substr(begin, end-begin));
+         begin = end+1;
+      }
+      return items;
+   }
+
+   void usage()
+   {
+      cout << "Usage:  indexSnapshots build [file set]...\n"
+           << "        indexSnapshots read [file set] [field1,field2,...] [gid]...\n"
+           << "        indexSnapshots trace [field1,field2,...] [gid1,gid2,...] [file set]..."
+           << endl;
+      exit(1);
+   }
+}
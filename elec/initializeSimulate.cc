@@ -3,6 +3,7 @@
 #include <iostream>
 #include <sstream>
 #include <map>
+#include <cassert>
 
 #include "object_cc.hh"
 #include "Simulate.hh"
@@ -22,6 +23,9 @@
 #include "pio.h"
 #include "heap.h"
 #include "LoadLevel.hh"
+#include "OutputService.hh"
+#include "Rebalancer.hh"
+#include "HaloExchange.hh"
 
 using namespace std;
 
@@ -46,6 +50,10 @@ namespace
    
    @beginkeywords
    @kw{anatomy, The name of the ANATOMY object for this simulation., anatomy}
+   @kw{asyncIO, Set to 1 to write sensor output that supports it
+     (activationTime\, dataVoronoiCoarsening\, ECG) from a background
+     thread so that the simulation does not wait for the file system.
+     Requires an MPI library that provides MPI_THREAD_MULTIPLE., 0}
    @kw{checkpointRate, The rate (in time steps) at which
      checkpoint/restart files are created., -1 (no checkpointing)}
    @kw{checkRanges, Enables run-tim checking for membrane voltages that
@@ -58,12 +66,68 @@ namespace
      simulation., decomposition}
    @kw{diffusion, The name of the DIFFUSION object for this simulation.,
      diffusion}
+   @kw{fusedIntegrate, Set to 1 to do the reaction and the forward
+     Euler update in one pass over the cells for the reaction models
+     that have such a kernel (BetterTT06\, Passive).  The reaction then
+     has to wait for the diffusion\, so it no longer overlaps the halo
+     exchange.  That pays off when the exchange is cheap compared to
+     the memory traffic saved (few tasks\, large bricks).  Ignored with
+     reactionSubsteps > 1., 0}
+   @kw{haloExchange, MPI method used for halo exchanges: isend
+     (MPI_Irecv/MPI_Isend every step)\, persistent (persistent
+     requests)\, neighbor (MPI_Ineighbor_alltoallv on a distributed
+     graph communicator)\, rma (MPI_Put with double buffering)\, or
+     shm (on-node neighbors copy from a shared memory segment guarded
+     by an epoch counter while off-node neighbors use isend).
+     Ignored by the SPI build., isend}
    @kw{heap, Storage allocated for IO buffers, 500}
+   @kw{ioQueueDepth, Maximum number of outstanding output jobs when
+     asyncIO is enabled.  The simulation blocks when the queue is
+     full., 4}
+   @kw{ioWriteMethod, How the files of snapshots and checkpoints are
+     written: pipelined (one writer per file that overlaps receiving
+     the data of the next task with writing the current one) or mpiio
+     (MPI_File_write_at_all by all tasks of a file)., pipelined}
    @kw{dt, The time step., 0.01 msec}
    @kw{loop, The initial loop count for the simulation., 0}
    @kw{maxLoop, The maximum value for the loop count., 1000}
    @kw{printRate, , }
+   @kw{profileAllCounters, Set to 1 to read the hardware counters in
+     every timer., 0}
+   @kw{profileCounterTimers, Timers that read the hardware counters
+     even when profileAllCounters is 0.  With the perf_event counters of
+     Linux profileStats reports their instructions per cycle and the
+     memory bandwidth estimated from the last level cache misses.,
+     Reaction Reaction_nonGate Reaction_Gate DiffusionCalc FGR_Stencil}
+   @kw{profileStats, Set to 1 to print the timers (min\, max and sigma
+     across the tasks) and the hardware counter rates at the end of the
+     run., 0}
+   @kw{multirateBatchSize, Number of fast cells that are sub-cycled
+     together when reactionSubsteps > 1., 256}
+   @kw{multirateThreshold, Cells whose |dVm/dt| (reaction + diffusion +
+     stimulus) at the previous step exceeds this value (mV/ms) are
+     sub-cycled when reactionSubsteps > 1., 1}
    @kw{reaction, The name of the REACTION object for this simulation., reaction}
+   @kw{rebalanceRate, The rate (in time steps) at which the measured
+     cost of the reaction models and the diffusion is compared across
+     tasks.  When the imbalance exceeds rebalanceThreshold the cells are
+     repartitioned with the measured per-cell cost of each reaction
+     model and migrated together with their state and the data the
+     sensors keep for them.  Sensors that buffer data between prints
+     (caAverage\, voronoiCoarsening\, activationAndRecovery\, ...)
+     only allow a rebalance right after they printed\, so use a
+     multiple of their printRate.
+     Only supported by the omp loop type., -1 (off)}
+   @kw{rebalanceThreshold, Ratio of the maximum to the average task
+     time above which a rebalance is triggered., 1.1}
+   @kw{reactionSubsteps, Number of reaction sub-steps taken by cells in
+     fast phases (upstroke\, early repolarization) per time step.  The
+     rest of the tissue\, and the diffusion\, advance with dt.  With
+     values > 1 dt can typically be set to the value needed by the
+     diffusion and the resting/plateau tissue rather than the value
+     needed to resolve the upstroke.  A BetterTT06 reaction with a fit
+     needs a FIT for dt and one for dt/reactionSubsteps\, both listed in
+     its fit keyword.  Only supported by the omp loop type., 1 (off)}
    @kw{sensor, The name of the sensor object(s) for this simulation.
      Multiple sensors may be specified., No sensors}
    @kw{stateFile, The name of the file(s) from which to load cell model
@@ -75,6 +139,14 @@ namespace
      not specified there will be no external stimulus in the simulation.}
      {No Stimulus}
    @kw{time, The initial simulation time., 0 msec}
+   @kw{traceBufferSize, Number of timer events per thread kept for the
+     trace.  When a thread records more the oldest are overwritten., 65536}
+   @kw{traceDir, Directory for the trace files., trace}
+   @kw{traceFirstLoop, First loop of a timeline of the timers of every
+     thread.  At the end of the run each task writes
+     traceDir/trace.<rank>.json in the Chrome trace format (open it
+     with chrome://tracing or ui.perfetto.dev)., -1 (no trace)}
+   @kw{traceLastLoop, Last loop of the trace., -1 (end of run)}
    @endkeywords
 */
 
@@ -94,6 +166,7 @@ void initializeSimulate(const string& name, Simulate& sim)
    heap_start(heapSize);
    
    objectGet(obj, "checkRanges", sim.checkRange_.on, "1");
+   objectGet(obj, "fusedIntegrate", sim.fusedIntegrate_, "0");
    objectGet(obj, "VmMin", sim.checkRange_.vMin, "-150");
    objectGet(obj, "VmMax", sim.checkRange_.vMax, " 100");
    objectGet(obj, "loop", (int&)sim.loop_, "0"); // cast away volatile
@@ -111,6 +184,32 @@ void initializeSimulate(const string& name, Simulate& sim)
       else
          profileSetVerbosity(false);
    }
+   {
+      vector<string> counterTimers;
+      objectGet(obj, "profileCounterTimers", counterTimers);
+      if (counterTimers.empty())
+      {
+         counterTimers.push_back("Reaction");
+         counterTimers.push_back("Reaction_nonGate");
+         counterTimers.push_back("Reaction_Gate");
+         counterTimers.push_back("DiffusionCalc");
+         counterTimers.push_back("FGR_Stencil");
+      }
+      for (unsigned ii=0; ii<counterTimers.size(); ++ii)
+         profileSetCounterTimer(counterTimers[ii]);
+   }
+   objectGet(obj, "profileStats", sim.profileStats_, "0");
+   {
+      int firstLoop, lastLoop;
+      unsigned bufferSize;
+      string dirname;
+      objectGet(obj, "traceFirstLoop", firstLoop, "-1");
+      objectGet(obj, "traceLastLoop", lastLoop, "-1");
+      objectGet(obj, "traceBufferSize", bufferSize, "65536");
+      objectGet(obj, "traceDir", dirname, "trace");
+      if (firstLoop >= 0)
+         profileTraceSetup(firstLoop, lastLoop, bufferSize, dirname);
+   }
    {
       int tmp;         objectGet(obj, "writeTorusMap", tmp, "1");
       string filename; objectGet(obj, "torusMapFile", filename, "torusMap");
@@ -124,11 +223,39 @@ void initializeSimulate(const string& name, Simulate& sim)
       else
          sim.asciiCheckpoints_ = true;
    }
+   {
+      string tmp; objectGet(obj, "haloExchange", tmp, "isend");
+      HaloExchangeMethod method;
+      if (!haloExchangeMethodFromName(tmp, method))
+      {
+         if (myRank == 0)
+            cout << "Unknown haloExchange method " << tmp << endl;
+         assert(false);
+      }
+      #ifdef SPI
+      if (method != haloIsend && myRank == 0)
+         cout << "haloExchange is ignored by the SPI build." << endl;
+      #endif
+      setHaloExchangeMethod(method);
+   }
    {
       unsigned nFiles; objectGet(obj, "nFiles", nFiles, "0");
       if (nFiles > 0)
          Pio_setNumWriteFiles(nFiles);
    }
+   {
+      string method; objectGet(obj, "ioWriteMethod", method, "pipelined");
+      if (method == "pipelined")
+         Pio_setWriteMethod(PIO_WRITE_PIPELINED);
+      else if (method == "mpiio")
+         Pio_setWriteMethod(PIO_WRITE_MPIIO);
+      else
+      {
+         if (myRank == 0)
+            cout << "Unknown ioWriteMethod " << method << endl;
+         assert(false);
+      }
+   }
       
    timestampBarrier("initializing anatomy", MPI_COMM_WORLD);
    string nameTmp;
@@ -200,16 +327,7 @@ void initializeSimulate(const string& name, Simulate& sim)
          cout << "Reaction Threads: " << sim.reactionThreads_ << endl;
    }
    
-   timestampBarrier("building reaction object", MPI_COMM_WORLD);
-   vector<string> reactionNames;
-   objectGet(obj, "reaction", reactionNames);
-   sim.reaction_ = new ReactionManager;
-   for (int ii=0; ii<reactionNames.size(); ++ii) {
-      const string& reactionName(reactionNames[ii]);
-      sim.reaction_->addReaction(reactionName);
-   }
-   sim.reaction_->create(sim.dt_, sim.anatomy_, sim.reactionThreads_);
-   timestampBarrier("finished building reaction object", MPI_COMM_WORLD);
+   buildTaskLocalObjects(name, sim, loadLevel.variantHint);
 
    sim.printIndex_ = -1;
    // -2 -> print index 0 rank 0
@@ -235,15 +353,84 @@ void initializeSimulate(const string& name, Simulate& sim)
       printf(                "#   Loop     Time         gid            Vm(t)              dVm_r(t-h)             dVm_d(t-h)\n");
       fprintf(sim.printFile_,"#   Loop     Time         gid            Vm(t)              dVm_r(t-h)             dVm_d(t-h)\n");
    }
-   
-   
+
+   {
+      int rebalanceRate;          objectGet(obj, "rebalanceRate", rebalanceRate, "-1");
+      double rebalanceThreshold;  objectGet(obj, "rebalanceThreshold", rebalanceThreshold, "1.1");
+      sim.rebalancer_ = NULL;
+      if (rebalanceRate > 0 && sim.loopType_ == Simulate::pdr)
+      {
+         if (myRank == 0)
+            cout << "rebalanceRate is not supported by loopType pdr.  Ignored." << endl;
+      }
+      else if (rebalanceRate > 0)
+      {
+         sim.rebalancer_ = new Rebalancer(rebalanceRate, rebalanceThreshold, loadLevel.variantHint);
+      }
+   }
+
+   // The diffusion has its weights.  Only the rebalancer needs the
+   // conductivity again.
+   sim.anatomy_.compact(sim.rebalancer_ != NULL);
+
+   {
+      int asyncIO;         objectGet(obj, "asyncIO", asyncIO, "0");
+      unsigned queueDepth; objectGet(obj, "ioQueueDepth", queueDepth, "4");
+      OutputService::getInstance().start(asyncIO == 1, queueDepth);
+   }
+
+}
+
+
+/** Everything in here depends on which cells each task owns.  The
+ *  anatomy must hold the local cells only (nRemote == 0).  Note that
+ *  ReactionManager::create sorts the local cells and getRemoteCells
+ *  appends the remote cells. */
+void buildTaskLocalObjects(const string& name, Simulate& sim, string variantHint)
+{
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+   OBJECT* obj = objectFind(name, "SIMULATE");
+   assert(sim.anatomy_.nRemote() == 0);
+
+   timestampBarrier("building reaction object", MPI_COMM_WORLD);
+   vector<string> reactionNames;
+   objectGet(obj, "reaction", reactionNames);
+   sim.reaction_ = new ReactionManager;
+   for (int ii=0; ii<reactionNames.size(); ++ii) {
+      const string& reactionName(reactionNames[ii]);
+      sim.reaction_->addReaction(reactionName);
+   }
+   sim.reaction_->create(sim.dt_, sim.anatomy_, sim.reactionThreads_);
+   {
+      int reactionSubsteps;
+      double multirateThreshold;
+      int multirateBatchSize;
+      objectGet(obj, "reactionSubsteps", reactionSubsteps, "1");
+      objectGet(obj, "multirateThreshold", multirateThreshold, "1");
+      objectGet(obj, "multirateBatchSize", multirateBatchSize, "256");
+      if (reactionSubsteps > 1 && sim.loopType_ == Simulate::pdr)
+      {
+         if (myRank == 0)
+            cout << "reactionSubsteps is not supported by loopType pdr.  Ignored." << endl;
+         reactionSubsteps = 1;
+      }
+      sim.reaction_->setMultirate(reactionSubsteps, multirateThreshold,
+                                  multirateBatchSize, sim.reactionThreads_);
+   }
+   timestampBarrier("finished building reaction object", MPI_COMM_WORLD);
+
+   string decompositionName;
+   objectGet(obj, "decomposition", decompositionName, "decomposition");
    getRemoteCells(sim, decompositionName, MPI_COMM_WORLD);
 
    timestampBarrier("building diffusion object", MPI_COMM_WORLD);
+   string nameTmp;
    objectGet(obj, "diffusion", nameTmp, "diffusion");
    sim.diffusion_ = diffusionFactory(nameTmp, sim.anatomy_, sim.diffusionThreads_,
                                      sim.reactionThreads_,
-                                     sim.loopType_,loadLevel.variantHint);
+                                     sim.loopType_, variantHint,
+                                     sim.dt_, sim.sendMap_, sim.commTable_);
    
    timestampBarrier("building stimulus object", MPI_COMM_WORLD);
    vector<string> names;
@@ -262,10 +449,8 @@ void initializeSimulate(const string& name, Simulate& sim)
    objectGet(obj, "sensor", names);
    for (unsigned ii=0; ii<names.size(); ++ii)
       sim.sensor_.push_back(sensorFactory(names[ii], sim));
-
 }
 
-
 namespace
 {
    void checkForObsoleteKeywords(OBJECT* obj)
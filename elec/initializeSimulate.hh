@@ -6,5 +6,11 @@
 class Simulate;
 void initializeSimulate(const std::string& name, Simulate& sim);
 
+/** Builds the reaction, halo, diffusion, stimulus, and sensor objects
+ *  for the cells currently owned by this task.  Used at startup and
+ *  by the Rebalancer after cells have moved. */
+void buildTaskLocalObjects(const std::string& name, Simulate& sim,
+                           std::string variantHint);
+
 
 #endif
@@ -0,0 +1,580 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Anatomy.hh"
+#include "CommTable.hh"
+#include "Diffusion.hh"
+#include "diffusionFactory.hh"
+#include "FGRUtils.hh"
+#include "HaloExchange.hh"
+#include "PerformanceTimers.hh"
+#include "Reaction.hh"
+#include "reactionFactory.hh"
+#include "Simulate.hh"
+#include "ThreadServer.hh"
+#include "lazy_array.hh"
+#include "object_cc.hh"
+#include "units.h"
+
+// kernelBenchmark times the compute kernels of the omp simulation loop
+// on fixed synthetic inputs so that releases can be compared by
+// script instead of by hand.
+//
+// Usage:  kernelBenchmark [-n nx,ny,nz] [-s steps] [-k reaction,diffusion,halo] [-o file.json]
+//
+//  -n  size of the box of cells on every task (default 64,64,64)
+//  -s  time steps per kernel (default 50)
+//  -k  kernels to time (default all three)
+//  -o  JSON report (default kernelBenchmark.json)
+//
+// Every task works on its own copy of the box, so the rates are for
+// nTasks boxes and the slowest task sets the time.
+//
+//  reaction   calc of every reaction model registered in this build
+//             (default parameters, no fit, Vm from the model).
+//  diffusion  updateLocalVoltage + calc of the FGR variants of the omp
+//             loop (omp, omp with floatWeights, sparse), implicit and
+//             null on a box with a constant anisotropic conductivity.
+//             The pdr variants (threads, simd, strip, overlap) need the
+//             diffusion and reaction thread teams and barriers of the
+//             pdr loop and are not covered.
+//  halo       HaloExchange between task pairs (0,1), (2,3), ... for
+//             every exchange method and message sizes from 8 bytes to
+//             2 MB.  Needs at least 2 tasks.  If a task receives wrong
+//             data no report is written and the exit code is 1.
+//
+// bytesPerCell is the minimum memory traffic of a kernel per cell and
+// step (each array read or written once, no write allocate).  The
+// roofline is the bandwidth of a STREAM triad measured on all tasks at
+// the same time, so fractionOfRoofline tells how close a kernel gets
+// to being memory bound.  The implicit diffusion runs a BiCGStab
+// solve per step whose iteration count depends on the input, so it
+// has no fixed traffic per cell.  Its bytesPerCell is 0 and its line
+// of the report has no bytesPerSecond and fractionOfRoofline.
+
+using namespace std;
+
+MPI_Comm COMM_LOCAL = MPI_COMM_WORLD;
+
+namespace
+{
+   struct Options
+   {
+      int nx_, ny_, nz_;
+      int nSteps_;
+      bool reaction_, diffusion_, halo_;
+      string outFile_;
+   };
+
+   /** One line of the report. */
+   struct KernelResult
+   {
+      string name_;
+      unsigned nCells_;
+      double secondsPerStep_;
+      double bytesPerCell_;
+   };
+
+   struct HaloResult
+   {
+      string method_;
+      int nItems_;
+      int nReps_;
+      double secondsPerExchange_;
+   };
+
+   bool parseOptions(int argc, char** argv, Options& opt);
+   double triadBandwidth();
+   vector<KernelResult> benchmarkReactions(const Options& opt, const ThreadTeam& threads);
+   vector<KernelResult> benchmarkDiffusion(const Options& opt, const ThreadTeam& threads);
+   vector<HaloResult> benchmarkHalo(bool& correct);
+   void writeReport(const Options& opt, double roofline,
+                    const vector<KernelResult>& reaction,
+                    const vector<KernelResult>& diffusion,
+                    const vector<HaloResult>& halo);
+   double maxOverTasks(double value);
+}
+
+
+int main(int argc, char** argv)
+{
+   int nTasks, myRank;
+   MPI_Init(&argc,&argv);
+   MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+   units_internal(1e-3, 1e-9, 1e-3, 1e-3, 1, 1e-9, 1);
+   units_external(1e-3, 1e-9, 1e-3, 1e-3, 1, 1e-9, 1);
+   // the kernels start and stop their timers
+   profileInit();
+
+   Options opt;
+   if (!parseOptions(argc, argv, opt))
+   {
+      if (myRank == 0)
+         cout << "Usage:  kernelBenchmark [-n nx,ny,nz] [-s steps] [-k reaction,diffusion,halo] [-o file.json]" << endl;
+      MPI_Finalize();
+      return 1;
+   }
+
+   ThreadServer& threadServer = ThreadServer::getInstance();
+   ThreadTeam threads = threadServer.getThreadTeam(vector<unsigned>());
+
+   double roofline = triadBandwidth();
+   if (myRank == 0)
+      cout << "triad bandwidth " << roofline*1e-9 << " GB/s" << endl;
+
+   vector<KernelResult> reaction;
+   vector<KernelResult> diffusion;
+   vector<HaloResult> halo;
+   bool haloCorrect = true;
+   if (opt.reaction_)
+      reaction = benchmarkReactions(opt, threads);
+   if (opt.diffusion_)
+      diffusion = benchmarkDiffusion(opt, threads);
+   if (opt.halo_)
+   {
+      if (nTasks >= 2)
+         halo = benchmarkHalo(haloCorrect);
+      else if (myRank == 0)
+         cout << "halo benchmark needs at least 2 tasks.  Skipped." << endl;
+   }
+
+   if (!haloCorrect)
+   {
+      MPI_Finalize();
+      return 1;
+   }
+
+   if (myRank == 0)
+      writeReport(opt, roofline, reaction, diffusion, halo);
+
+   MPI_Finalize();
+   return 0;
+}
+
+namespace
+{
+   vector<string> splitList(const string& list)
+   {
+      vector<string> item;
+      stringstream ss(list);
+      string word;
+      while (getline(ss, word, ','))
+         item.push_back(word);
+      return item;
+   }
+
+   bool parseOptions(int argc, char** argv, Options& opt)
+   {
+      opt.nx_ = opt.ny_ = opt.nz_ = 64;
+      opt.nSteps_ = 50;
+      opt.reaction_ = opt.diffusion_ = opt.halo_ = true;
+      opt.outFile_ = "kernelBenchmark.json";
+
+      int c;
+      while ((c = getopt(argc, argv, "n:s:k:o:")) != -1)
+      {
+         switch (c)
+         {
+           case 'n':
+            if (sscanf(optarg, "%d,%d,%d", &opt.nx_, &opt.ny_, &opt.nz_) != 3)
+               return false;
+            break;
+           case 's':
+            opt.nSteps_ = atoi(optarg);
+            break;
+           case 'k':
+           {
+            opt.reaction_ = opt.diffusion_ = opt.halo_ = false;
+            vector<string> kernel = splitList(optarg);
+            for (unsigned ii=0; ii<kernel.size(); ++ii)
+            {
+               if (kernel[ii] == "reaction") opt.reaction_ = true;
+               else if (kernel[ii] == "diffusion") opt.diffusion_ = true;
+               else if (kernel[ii] == "halo") opt.halo_ = true;
+               else return false;
+            }
+            break;
+           }
+           case 'o':
+            opt.outFile_ = optarg;
+            break;
+           default:
+            return false;
+         }
+      }
+      return (optind == argc && opt.nx_ > 0 && opt.ny_ > 0 && opt.nz_ > 0 && opt.nSteps_ > 0);
+   }
+
+   double maxOverTasks(double value)
+   {
+      double result;
+      MPI_Allreduce(&value, &result, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      return result;
+   }
+
+   /** a = b + s*c on arrays well beyond the caches, run on all tasks at
+    *  once.  Returns the sum over the tasks of the best of 5 tries, in
+    *  bytes per second. */
+   double triadBandwidth()
+   {
+      const int n = 1 << 23;
+      vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+      double* aa = &a[0];
+      const double* bb = &b[0];
+      const double* cc = &c[0];
+      double best = 1e30;
+      for (int iTry=0; iTry<5; ++iTry)
+      {
+         MPI_Barrier(MPI_COMM_WORLD);
+         double t0 = MPI_Wtime();
+         #pragma omp parallel for
+         for (int ii=0; ii<n; ++ii)
+            aa[ii] = bb[ii] + 3.0*cc[ii];
+         double time = maxOverTasks(MPI_Wtime() - t0);
+         best = min(best, time);
+      }
+      int nTasks;
+      MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
+      return 3.0*sizeof(double)*n*nTasks/best;
+   }
+
+   /** Seconds per call of step, slowest task, after one untimed call. */
+   template <class Step>
+   double timeSteps(int nSteps, Step step)
+   {
+      step();
+      MPI_Barrier(MPI_COMM_WORLD);
+      double t0 = MPI_Wtime();
+      for (int ii=0; ii<nSteps; ++ii)
+         step();
+      return maxOverTasks(MPI_Wtime() - t0)/nSteps;
+   }
+
+   struct ReactionStep
+   {
+      Reaction* reaction_;
+      double dt_;
+      lazy_array<double>& Vm_;
+      lazy_array<double>& iStim_;
+      lazy_array<double>& dVm_;
+      void operator()() { reaction_->calc(dt_, Vm_, iStim_, dVm_); }
+   };
+
+   vector<KernelResult> benchmarkReactions(const Options& opt, const ThreadTeam& threads)
+   {
+      int myRank;
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+      const unsigned nCells = opt.nx_*opt.ny_*opt.nz_;
+      const double dt = 0.01;
+
+      vector<KernelResult> result;
+      vector<string> method = registeredReactionMethods();
+      for (unsigned im=0; im<method.size(); ++im)
+      {
+         string objectName = "kernelBenchmark_" + method[im];
+         string text = objectName + " REACTION { method = " + method[im] + "; }";
+         object_compilestring(const_cast<char*>(text.c_str()));
+         Reaction* reaction = reactionFactory(objectName, dt, nCells, threads);
+
+         lazy_array<double> Vm, iStim, dVm;
+         Vm.resize(nCells);
+         iStim.resize(nCells);
+         dVm.resize(nCells);
+         {
+            wo_array_ptr<double> iStimPtr = iStim.writeonly(CPU);
+            for (unsigned ii=0; ii<nCells; ++ii)
+               iStimPtr[ii] = 0;
+         }
+         initializeMembraneState(reaction, objectName, Vm);
+
+         vector<string> fieldName, fieldUnit;
+         reaction->getCheckpointInfo(fieldName, fieldUnit);
+
+         ReactionStep step = {reaction, dt, Vm, iStim, dVm};
+         KernelResult r;
+         r.name_ = method[im];
+         r.nCells_ = nCells;
+         r.secondsPerStep_ = timeSteps(opt.nSteps_, step);
+         // Vm and iStim in, dVm out, the state read and written
+         r.bytesPerCell_ = 3*sizeof(double) + 2*sizeof(double)*fieldName.size();
+         result.push_back(r);
+         if (myRank == 0)
+            cout << "reaction " << r.name_ << ": " << nCells/r.secondsPerStep_*1e-6
+                 << " Mcells/s per task" << endl;
+         delete reaction;
+      }
+      return result;
+   }
+
+   /** nx*ny*nz box of tissue, all cells local.  The conductivity has
+    *  off-diagonal terms so that all 19 stencil weights are used. */
+   void buildBoxAnatomy(const Options& opt, Anatomy& anatomy)
+   {
+      anatomy.setGridSize(opt.nx_, opt.ny_, opt.nz_);
+      anatomy.dx() = anatomy.dy() = anatomy.dz() = 0.2;
+      anatomy.offset_x() = anatomy.offset_y() = anatomy.offset_z() = 0;
+      SymmetricTensor sigma;
+      sigma.a11 = 0.15; sigma.a12 = 0.01; sigma.a13 = 0.01;
+      sigma.a22 = 0.05; sigma.a23 = 0.01;
+      sigma.a33 = 0.05;
+      vector<AnatomyCell>& cell = anatomy.cellArray();
+      const unsigned nCells = opt.nx_*opt.ny_*opt.nz_;
+      cell.resize(nCells);
+      for (unsigned ii=0; ii<nCells; ++ii)
+      {
+         cell[ii].gid_ = ii;
+         cell[ii].cellType_ = 100;
+         cell[ii].sigma_ = sigma;
+         cell[ii].dest_ = 0;
+         cell[ii].sortind_ = ii;
+      }
+      anatomy.nRemote() = 0;
+      anatomy.nGlobal() = nCells;
+   }
+
+   struct DiffusionStep
+   {
+      Diffusion* diffusion_;
+      lazy_array<double>& Vm_;
+      lazy_array<double>& VmRemote_;
+      lazy_array<double>& dVm_;
+      void operator()()
+      {
+         diffusion_->updateLocalVoltage(Vm_);
+         diffusion_->updateRemoteVoltage(VmRemote_);
+         diffusion_->calc(dVm_);
+      }
+   };
+
+   vector<KernelResult> benchmarkDiffusion(const Options& opt, const ThreadTeam& threads)
+   {
+      int myRank;
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+      Anatomy anatomy;
+      buildBoxAnatomy(opt, anatomy);
+      const unsigned nCells = anatomy.nLocal();
+
+      // No remote cells: every task has its own box.
+      vector<int> sendMap;
+      vector<int> sendTask;
+      vector<int> sendOffset(1, 0);
+      CommTable commTable(sendTask, sendOffset, MPI_COMM_SELF);
+
+      // name, object keywords, bytes per cell
+      const int nVariant = 5;
+      const char* variant[nVariant][2] = {
+         {"omp",          "method = FGR; variant = omp;"},
+         {"omp_float",    "method = FGR; variant = omp; floatWeights = 1;"},
+         {"sparse",       "method = FGR; variant = sparse;"},
+         {"implicit",     "method = implicit;"},
+         {"null",         "method = null;"},
+      };
+      // Vm in, dVm out and the 19 weights.  omp uses the build
+      // precision weights and reads the diagonal weight A0 in double
+      // on top of them.  The difference stencil of omp_float needs no
+      // A0 and sparse keeps it among its 19 weights.
+      const double bytesPerCell[nVariant] = {
+         3*sizeof(double) + sizeof(FGRUtils::DiffWeight),
+         2*sizeof(double) + 19*sizeof(float),
+         2*sizeof(double) + 19*sizeof(double),
+         0, // not fixed, see the top of the file
+         sizeof(double),
+      };
+
+      lazy_array<double> Vm, VmRemote, dVm;
+      Vm.resize(nCells);
+      dVm.resize(nCells);
+      {
+         // a smooth bump, so the stencil sees varying values
+         wo_array_ptr<double> VmPtr = Vm.writeonly(CPU);
+         for (unsigned ii=0; ii<nCells; ++ii)
+         {
+            Tuple gg = anatomy.globalTuple(ii);
+            VmPtr[ii] = -85.0 + 0.01*(gg.x()*gg.y() + gg.z());
+         }
+      }
+
+      vector<KernelResult> result;
+      for (int iv=0; iv<nVariant; ++iv)
+      {
+         string objectName = string("kernelBenchmark_") + variant[iv][0];
+         string text = objectName + " DIFFUSION { " + variant[iv][1] + " }";
+         object_compilestring(const_cast<char*>(text.c_str()));
+         string variantHint;
+         Diffusion* diffusion = diffusionFactory(objectName, anatomy, threads, threads,
+                                                 Simulate::omp, variantHint,
+                                                 0.01, sendMap, &commTable);
+
+         DiffusionStep step = {diffusion, Vm, VmRemote, dVm};
+         KernelResult r;
+         r.name_ = variant[iv][0];
+         r.nCells_ = nCells;
+         r.secondsPerStep_ = timeSteps(opt.nSteps_, step);
+         r.bytesPerCell_ = bytesPerCell[iv];
+         result.push_back(r);
+         if (myRank == 0)
+            cout << "diffusion " << r.name_ << ": " << nCells/r.secondsPerStep_*1e-6
+                 << " Mcells/s per task" << endl;
+         delete diffusion;
+      }
+      return result;
+   }
+
+   /** Tasks 2k and 2k+1 swap nItems doubles.  With an odd number of
+    *  tasks the last one takes part in the collective setup only.
+    *  correct is set to false on all tasks if any task received wrong
+    *  data. */
+   vector<HaloResult> benchmarkHalo(bool& correct)
+   {
+      int nTasks, myRank;
+      MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
+      MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+      int partner = myRank ^ 1;
+      bool active = (partner < nTasks);
+
+      const char* methodName[] = {"isend", "persistent", "neighbor", "rma", "shm"};
+      const int nItems[] = {1, 128, 16384, 262144};
+      HaloExchangeMethod defaultMethod = haloExchangeMethod();
+
+      vector<HaloResult> result;
+      for (unsigned im=0; im<sizeof(methodName)/sizeof(methodName[0]); ++im)
+      {
+         HaloExchangeMethod method;
+         bool known = haloExchangeMethodFromName(methodName[im], method);
+         assert(known);
+         setHaloExchangeMethod(method);
+         for (unsigned is=0; is<sizeof(nItems)/sizeof(nItems[0]); ++is)
+         {
+            const int n = nItems[is];
+            vector<int> sendTask;
+            vector<int> sendOffset(1, 0);
+            vector<int> sendMap;
+            if (active)
+            {
+               sendTask.push_back(partner);
+               sendOffset.push_back(n);
+               for (int ii=0; ii<n; ++ii)
+                  sendMap.push_back(ii);
+            }
+            CommTable commTable(sendTask, sendOffset, MPI_COMM_WORLD);
+            lazy_array<double> data;
+            data.resize(2*n);
+            {
+               wo_array_ptr<double> dataPtr = data.writeonly(CPU);
+               for (int ii=0; ii<2*n; ++ii)
+                  dataPtr[ii] = myRank;
+            }
+            HaloResult r;
+            r.method_ = methodName[im];
+            r.nItems_ = n;
+            r.nReps_ = max(20, min(1000, (1<<22)/n));
+            {
+               HaloExchange<double> exchange(sendMap, &commTable);
+               for (int ii=0; ii<2; ++ii)
+                  exchange.execute(data, n);
+               MPI_Barrier(MPI_COMM_WORLD);
+               double t0 = MPI_Wtime();
+               for (int ii=0; ii<r.nReps_; ++ii)
+                  exchange.execute(data, n);
+               r.secondsPerExchange_ = maxOverTasks(MPI_Wtime() - t0)/r.nReps_;
+               int nWrong = 0;
+               if (active)
+               {
+                  ro_array_ptr<double> dataPtr = data.readonly(CPU);
+                  for (int ii=n; ii<2*n; ++ii)
+                     if (dataPtr[ii] != partner)
+                        ++nWrong;
+               }
+               if (maxOverTasks(nWrong) > 0)
+               {
+                  if (myRank == 0)
+                     cout << "ERROR: halo " << r.method_ << " " << n*sizeof(double)
+                          << " bytes: wrong data received" << endl;
+                  correct = false;
+               }
+            }
+            result.push_back(r);
+            if (myRank == 0)
+               cout << "halo " << r.method_ << " " << n*sizeof(double) << " bytes: "
+                    << r.secondsPerExchange_*1e6 << " us" << endl;
+         }
+      }
+      setHaloExchangeMethod(defaultMethod);
+      return result;
+   }
+
+   void writeKernels(ostream& out, const string& key, const vector<KernelResult>& kernel,
+                     int nTasks, double roofline)
+   {
+      out << "  \"" << key << "\": [";
+      for (unsigned ii=0; ii<kernel.size(); ++ii)
+      {
+         const KernelResult& k = kernel[ii];
+         double cellsPerSecond = double(k.nCells_)*nTasks/k.secondsPerStep_;
+         double bytesPerSecond = cellsPerSecond*k.bytesPerCell_;
+         out << (ii == 0 ? "\n" : ",\n")
+             << "    {\"name\": \"" << k.name_ << "\""
+             << ", \"cells\": " << k.nCells_
+             << ", \"secondsPerStep\": " << k.secondsPerStep_
+             << ", \"cellsPerSecond\": " << cellsPerSecond
+             << ", \"bytesPerCell\": " << k.bytesPerCell_;
+         // no fixed traffic per cell, nothing to compare with the roofline
+         if (k.bytesPerCell_ > 0)
+            out << ", \"bytesPerSecond\": " << bytesPerSecond
+                << ", \"fractionOfRoofline\": " << bytesPerSecond/roofline;
+         out << "}";
+      }
+      out << "\n  ],\n";
+   }
+
+   void writeReport(const Options& opt, double roofline,
+                    const vector<KernelResult>& reaction,
+                    const vector<KernelResult>& diffusion,
+                    const vector<HaloResult>& halo)
+   {
+      int nTasks;
+      MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
+      int nThreads = 1;
+#ifdef _OPENMP
+      nThreads = omp_get_max_threads();
+#endif
+      ofstream out(opt.outFile_.c_str());
+      out.precision(6);
+      out << "{\n"
+          << "  \"nTasks\": " << nTasks << ",\n"
+          << "  \"nThreads\": " << nThreads << ",\n"
+          << "  \"grid\": [" << opt.nx_ << ", " << opt.ny_ << ", " << opt.nz_ << "],\n"
+          << "  \"steps\": " << opt.nSteps_ << ",\n"
+          << "  \"roofline\": {\"kernel\": \"triad\", \"bytesPerSecond\": " << roofline << "},\n";
+      writeKernels(out, "reaction", reaction, nTasks, roofline);
+      writeKernels(out, "diffusion", diffusion, nTasks, roofline);
+      out << "  \"halo\": [";
+      for (unsigned ii=0; ii<halo.size(); ++ii)
+      {
+         const HaloResult& h = halo[ii];
+         long long bytes = h.nItems_*sizeof(double);
+         out << (ii == 0 ? "\n" : ",\n")
+             << "    {\"name\": \"" << h.method_ << "\""
+             << ", \"bytes\": " << bytes
+             << ", \"reps\": " << h.nReps_
+             << ", \"secondsPerExchange\": " << h.secondsPerExchange_
+             << ", \"bytesPerSecond\": " << bytes/h.secondsPerExchange_ << "}";
+      }
+      out << "\n  ]\n}\n";
+      cout << "wrote " << opt.outFile_ << endl;
+   }
+}
@@ -1,5 +1,6 @@
 #include "reactionFactory.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <dlfcn.h>
@@ -27,8 +28,7 @@ using namespace std;
 
 static MAP<string,reactionFactoryFunction> g_factoryFromMethodName;
 
-Reaction* reactionFactory(const string& name, double dt, const int numPoints,
-                          const ThreadTeam& group)
+static void registerBuiltinsOnce()
 {
    static bool first = true;
    if (first)
@@ -36,6 +36,12 @@ Reaction* reactionFactory(const string& name, double dt, const int numPoints,
       registerBuiltinReactions();
       first = false;
    }
+}
+
+Reaction* reactionFactory(const string& name, double dt, const int numPoints,
+                          const ThreadTeam& group)
+{
+   registerBuiltinsOnce();
    
    OBJECT* obj = objectFind(name, "REACTION");
    string method; objectGet(obj, "method", method, "undefined");
@@ -84,3 +90,14 @@ void registerReactionFactory(const string method, reactionFactoryFunction scanFu
    g_factoryFromMethodName[method] = scanFunc;
 }
 
+vector<string> registeredReactionMethods()
+{
+   registerBuiltinsOnce();
+   vector<string> methods;
+   for (MAP<string,reactionFactoryFunction>::const_iterator iter = g_factoryFromMethodName.begin();
+        iter != g_factoryFromMethodName.end(); ++iter)
+      methods.push_back(iter->first);
+   sort(methods.begin(), methods.end());
+   return methods;
+}
+
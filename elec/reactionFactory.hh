@@ -15,6 +15,10 @@ void registerReactionFactory(const std::string method, reactionFactoryFunction s
 
 void registerBuiltinReactions();
 
+/** Sorted method names of the reactions built into this executable or
+ *  registered so far.  Models loaded with dlopen are not listed. */
+std::vector<std::string> registeredReactionMethods();
+
 #ifdef DYNAMIC_REACTION
 #define REACTION_FACTORY(name) extern "C" Reaction* factory
 #define FRIEND_FACTORY(name) friend Reaction* ::factory
@@ -8,6 +8,7 @@
 #include "BucketOfBits.hh"
 #include "ioUtils.h"
 #include <cstring>
+#include "ddcMalloc.h"
 
 using namespace std;
 
@@ -27,8 +28,10 @@ namespace
  *  field_types, but field_units are optional.  If there are no units
  *  then we just claim that all fields are dimensionless.
  *
- *  If we read an ascii file, the stl string that represents the record
- *  in the BucketOfBits will include the \n that ends the ascii record.
+ *  The records are copied from the read buffer of the PFILE into the
+ *  BucketOfBits in one go and the read buffer is released right away
+ *  instead of at Pclose.  Ascii records don't include the \n that
+ *  ends them.
  */
 BucketOfBits* readPioFile(PFILE* file)
 {
@@ -59,6 +62,10 @@ BucketOfBits* readPioFile(PFILE* file)
      default:
       assert(false);
    }
+   ddcFree(file->buf);
+   file->buf = NULL;
+   file->bufsize = 0;
+   file->bufpos = 0;
 
    return bucketP;
 }
@@ -111,14 +118,8 @@ namespace
 {
    void readAscii(PFILE* file, unsigned nRecords, BucketOfBits* bucketP)
    {
-      unsigned maxRec = 2048;
-      char buf[maxRec];
-      for (unsigned ii=0; ii<nRecords; ++ii)
-      {
-         Pfgets(buf, maxRec, file);
-         assert(strlen(buf) < maxRec);
-         bucketP->addRecord(buf);
-      }
+      bucketP->addLines(file->buf+file->bufpos, file->bufsize-file->bufpos, nRecords);
+      file->bufpos = file->bufsize;
    }
 }
 
@@ -126,11 +127,8 @@ namespace
 {
    void readBinary(PFILE* file, unsigned lrec, unsigned nRecords, BucketOfBits* bucketP)
    {
-      char buf[lrec];
-      for (unsigned ii=0; ii<nRecords; ++ii)
-      {
-         Pread(buf, lrec, 1, file);
-         bucketP->addRecord(string(buf, lrec));
-      }
+      assert(file->bufpos + size_t(lrec)*nRecords <= file->bufsize);
+      bucketP->addFixedRecords(file->buf+file->bufpos, size_t(lrec)*nRecords, lrec);
+      file->bufpos += size_t(lrec)*nRecords;
    }
 }
@@ -24,6 +24,8 @@
 #include "mpiUtils.h"
 #include "ReactionManager.hh"
 #include "DeviceFor.hh"
+#include "OutputService.hh"
+#include "Rebalancer.hh"
 #include  "cudaNVTX.h"
 
 /*
@@ -129,9 +131,16 @@ void loopIO(const Simulate& sim, int firstCall)
    // SENSORS
    #pragma omp critical
    {
+      // Sensors that still call pio directly must not run while the
+      // OutputService is writing.
+      OutputService& output = OutputService::getInstance();
       startTimer(sensorTimer);
       for (unsigned ii = 0; ii < sim.sensor_.size(); ++ii)
       {
+         if (!sim.sensor_[ii]->deferredPrint() && sim.sensor_[ii]->checkPrintAtStep(loop))
+         {
+            output.flush();
+         }
          sim.sensor_[ii]->run(sim.time_, loop);
       }
       stopTimer(sensorTimer);
@@ -139,6 +148,7 @@ void loopIO(const Simulate& sim, int firstCall)
       startTimer(loopIOTimer);
       if (sim.loop_ > 0 && sim.checkpointRate_ > 0 && sim.loop_ % sim.checkpointRate_ == 0)
       {
+         output.flush();
          writeCheckpoint(sim, MPI_COMM_WORLD);
       }
 
@@ -153,7 +163,9 @@ void simulationLoop(Simulate& sim)
    iStimTransport.resize(sim.anatomy_.nLocal());
    
    simulationProlog(sim);
-   HaloExchangeDevice<double> voltageExchange(sim.sendMap_, (sim.commTable_));
+   // a pointer since the halo changes when the rebalancer moves cells.
+   HaloExchangeDevice<double>* voltageExchange =
+      new HaloExchangeDevice<double>(sim.sendMap_, (sim.commTable_));
 
    PotentialData& vdata = sim.vdata_;
 
@@ -167,56 +179,104 @@ void simulationLoop(Simulate& sim)
    loopIO(sim, 1);
    profileStart(simulationLoopTimer);
 
+   // iStim only has to be cleared when a stimulus wrote to it in the
+   // previous step.
+   int stimWasOn = 1;
+
    while (sim.loop_ < sim.maxLoop_)
    {
+      profileTraceLoop(sim.loop_);
+      if (sim.rebalancer_ != NULL && sim.rebalancer_->due(sim.loop_))
+      {
+         if (sim.rebalancer_->rebalance(sim))
+         {
+            delete voltageExchange;
+            voltageExchange = new HaloExchangeDevice<double>(sim.sendMap_, (sim.commTable_));
+            iStimTransport.resize(sim.anatomy_.nLocal());
+            stimWasOn = 1;
+         }
+      }
       int nLocal = sim.anatomy_.nLocal();
+      const bool sampleCost = sim.rebalancer_ != NULL && sim.rebalancer_->sampling(sim.loop_);
+      sim.reaction_->sampleCost(sampleCost);
 
       //startTimer(imbalanceTimer);
       //voltageExchange.barrier();
       //stopTimer(imbalanceTimer);
 
       {
-         voltageExchange.fillSendBuffer(vdata.VmTransport_);
-         voltageExchange.startComm();
+         voltageExchange->fillSendBuffer(vdata.VmTransport_);
+         voltageExchange->startComm();
       }
 
       startTimer(stimulusTimer);
       {
+         if (stimWasOn)
          {
             wo_array_ptr<double> iStim = iStimTransport.useOn(DEFAULT_COMPUTE_SPACE);
             DEVICE_PARALLEL_FORALL(iStim.size(), ii, iStim[ii] = 0);
          }
+         stimWasOn = 0;
          //#pragma omp target teams distribute parallel for
          for (unsigned ii = 0; ii < sim.stimulus_.size(); ++ii)
          {
-            sim.stimulus_[ii]->stim(sim.time_, iStimTransport);
+            stimWasOn |= sim.stimulus_[ii]->stim(sim.time_, iStimTransport);
          }
       }
       stopTimer(stimulusTimer);
 
+      // The fused path (SIMULATE keyword fusedIntegrate) computes the
+      // diffusion first and then does the reaction and the Euler
+      // update in one pass over the cells.  The reaction no longer
+      // overlaps the halo exchange.
+      const bool fused = sim.fusedIntegrate_ && sim.reaction_->fusedIntegrate();
+
       // REACTION
       startTimer(reactionTimer);
+      if (!fused)
       {
+         sim.reaction_->selectFastCells(iStimTransport, vdata.dVmReactionTransport_, vdata.dVmDiffusionTransport_);
          sim.reaction_->calc(sim.dt_, vdata.VmTransport_, iStimTransport, vdata.dVmReactionTransport_);
       }
       stopTimer(reactionTimer);
       // DIFFUSION
       startTimer(diffusionCalcTimer);
       {
+         // the rebalancer only wants the diffusion work, not the wait
+         // for the neighbors.
+         double t0 = sampleCost ? MPI_Wtime() : 0;
          sim.diffusion_->updateLocalVoltage(vdata.VmTransport_);
-         voltageExchange.wait();
-         sim.diffusion_->updateRemoteVoltage(voltageExchange.getRecvBuf());
+         double t1 = sampleCost ? MPI_Wtime() : 0;
+         voltageExchange->wait();
+         double t2 = sampleCost ? MPI_Wtime() : 0;
+         sim.diffusion_->updateRemoteVoltage(voltageExchange->getRecvBuf());
          sim.diffusion_->calc(vdata.dVmDiffusionTransport_);
+         if (sampleCost)
+            sim.rebalancer_->addDiffusionTime((t1-t0) + (MPI_Wtime()-t2), nLocal);
       }
       stopTimer(diffusionCalcTimer);
+      // MULTIRATE: sub-cycle the reaction of cells in fast phases
+      // against the diffusion current of this step.
+      startTimer(reactionTimer);
+      sim.reaction_->calcFastCells(sim.dt_, vdata.VmTransport_, iStimTransport,
+                                   vdata.dVmDiffusionTransport_, vdata.dVmReactionTransport_);
+      stopTimer(reactionTimer);
 
       startTimer(integratorTimer);
-      if (sim.checkRange_.on)
-      {
+      if (sim.checkRange_.on && !fused)
          sim.checkRanges(vdata.VmTransport_, vdata.dVmReactionTransport_, vdata.dVmDiffusionTransport_);
+      if (fused)
+      {
+         stopTimer(integratorTimer);
+         startTimer(reactionTimer);
+         sim.reaction_->calcIntegrate(sim.dt_, vdata.VmTransport_, iStimTransport,
+                                      vdata.dVmDiffusionTransport_, vdata.dVmReactionTransport_);
+         stopTimer(reactionTimer);
+         startTimer(integratorTimer);
       }
       // no special BGQ integrator is this loop.  More bang for buck
       // from OMP threading.
+      else
       {
          rw_array_ptr<double> Vm = vdata.VmTransport_.readwrite(DEFAULT_COMPUTE_SPACE);
          ro_array_ptr<double> dVmR = vdata.dVmReactionTransport_.readonly(DEFAULT_COMPUTE_SPACE);
@@ -229,6 +289,10 @@ void simulationLoop(Simulate& sim)
 
       sim.time_ += sim.dt_;
       ++sim.loop_;
+      // dVm of a step isn't known before the fused path updates Vm, so
+      // it checks the new Vm and reports the dVm that led to it.
+      if (sim.checkRange_.on && fused)
+         sim.checkRanges(vdata.VmTransport_, vdata.dVmReactionTransport_, vdata.dVmDiffusionTransport_);
       stopTimer(integratorTimer);
 
       if (sim.checkIO()) { sim.bufferReactionData(); }
@@ -240,6 +304,7 @@ void simulationLoop(Simulate& sim)
       loopIO(sim, 0);
    }
    profileStop(simulationLoopTimer);
+   delete voltageExchange;
 }
 
 /** One stop shopping for all of the data that we would rather create
@@ -392,6 +457,7 @@ void diffusionLoop(Simulate& sim,
    if (globalSyncRate == -1) { globalSyncCnt = -1; }
    while (loopLocal < sim.maxLoop_)
    {
+      profileTraceLoop(loopLocal);
       if (globalSyncCnt >= 0) { globalSyncCnt--; }
       if (globalSyncCnt == 0)
       {
@@ -550,6 +616,7 @@ void reactionLoop(Simulate& sim, SimLoopData& loopData, L2_BarrierHandle_t& reac
    uint64_t loopLocal = sim.loop_;
    while (loopLocal < sim.maxLoop_)
    {
+      profileTraceLoop(loopLocal);
       threadBarrier(timingBarrierTimer, loopData.timingBarrier, &timingHandle, nTotalThreads);
 
       startTimer(reactionTimer);
@@ -717,6 +784,8 @@ void simulationLoopParallelDiffusionReaction(Simulate& sim)
    cout << "Rank[" << myRank << "]: numOfNeighborToSend=" << sim.commTable_->_sendTask.size() << " numOfNeighborToRecv=" << sim.commTable_->_recvTask.size() << " numOfBytesToSend=" << sim.commTable_->_sendOffset[sim.commTable_->_sendTask.size()] * sizeof (double) << " numOfBytesToRecv=" << sim.commTable_->_recvOffset[sim.commTable_->_recvTask.size()] * sizeof (double) << endl;
 #endif
 
+   profileTraceNameThreads(sim.diffusionThreads_, "diffusion");
+   profileTraceNameThreads(sim.reactionThreads_, "reaction");
    timestampBarrier("Entering threaded region", MPI_COMM_WORLD);
 
    #pragma omp parallel
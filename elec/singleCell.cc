@@ -20,6 +20,7 @@
 #include "DeviceFor.hh"
 
 #include "singleCellOptions.h"
+#include "singleCellEnsemble.hh"
 
 using namespace std;
 
@@ -230,6 +231,20 @@ int main(int argc, char* argv[])
       }
    }
 
+   if (params.ensemble_file_given)
+   {
+      if (params.clamp_file_given || params.save_state_file_given ||
+          params.save_state_time_given)
+      {
+         cerr << "ERROR: Clamping and saving state are not supported in ensemble mode.\n";
+         return -1;
+      }
+      int rc = runEnsemble(params, objectName, timeline.dt(),
+                           timeline.maxTimesteps(), stimTimesteps);
+      MPI_Finalize();
+      return rc;
+   }
+
    //create the dependent variables.
    ThreadServer& threadServer = ThreadServer::getInstance();
    ThreadTeam threads = threadServer.getThreadTeam(vector<unsigned>());
@@ -0,0 +1,465 @@
+#include "singleCellEnsemble.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <omp.h>
+
+#include "Reaction.hh"
+#include "reactionFactory.hh"
+#include "ThreadServer.hh"
+#include "DeviceFor.hh"
+#include "object_cc.hh"
+#include "singleCellOptions.h"
+
+using namespace std;
+
+EnsembleTable::EnsembleTable(const string& filename, MPI_Comm comm)
+: nRows_(0)
+{
+   int myRank;
+   MPI_Comm_rank(comm, &myRank);
+
+   string text;
+   int nChars = 0;
+   if (myRank == 0)
+   {
+      ifstream file(filename.c_str());
+      if (!file)
+      {
+         cerr << "ERROR: Can't open ensemble file " << filename << endl;
+         MPI_Abort(comm, -1);
+      }
+      stringstream buf;
+      buf << file.rdbuf();
+      text = buf.str();
+      nChars = text.size();
+   }
+   MPI_Bcast(&nChars, 1, MPI_INT, 0, comm);
+   text.resize(nChars);
+   MPI_Bcast(&text[0], nChars, MPI_CHAR, 0, comm);
+
+   stringstream in(text);
+   string line;
+   while (getline(in, line))
+   {
+      if (line.empty() || line[0] == '#')
+         continue;
+      stringstream fields(line);
+      if (names_.empty())
+      {
+         string name;
+         while (fields >> name)
+            names_.push_back(name);
+         continue;
+      }
+      unsigned nFound = 0;
+      double value;
+      while (fields >> value)
+      {
+         values_.push_back(value);
+         ++nFound;
+      }
+      if (nFound == 0)
+         continue;
+      if (nFound != names_.size())
+      {
+         if (myRank == 0)
+            cerr << "ERROR: Ensemble file " << filename << " row " << nRows_
+                 << " has " << nFound << " values, expected "
+                 << names_.size() << endl;
+         MPI_Abort(comm, -1);
+      }
+      ++nRows_;
+   }
+}
+
+
+const char* BiomarkerTracker::name(int iBiomarker)
+{
+   static const char* names[] = {"APD90", "dVdtMax", "Vrest", "Vpeak"};
+   assert(iBiomarker >= 0 && iBiomarker < nBiomarkers);
+   return names[iBiomarker];
+}
+
+BiomarkerTracker::BiomarkerTracker(int nCells, const double* Vm)
+: vPrev_(nCells),
+  vRest_(nCells),
+  vPeak_(nCells),
+  dVdtMax_(nCells),
+  tUp_(nCells),
+  apd_(nCells)
+{
+   beginBeat(Vm);
+}
+
+void BiomarkerTracker::beginBeat(const double* Vm)
+{
+   const double nan = numeric_limits<double>::quiet_NaN();
+   for (unsigned ii=0; ii<vPrev_.size(); ++ii)
+   {
+      vPrev_[ii] = Vm[ii];
+      vRest_[ii] = Vm[ii];
+      vPeak_[ii] = Vm[ii];
+      dVdtMax_[ii] = 0;
+      tUp_[ii] = nan;
+      apd_[ii] = nan;
+   }
+}
+
+/** time is the time at the end of the step that produced Vm. */
+void BiomarkerTracker::update(double time, double dt, const double* Vm)
+{
+   // A beat whose amplitude stays below this never gets an APD.
+   const double activationThreshold = 10; // mV
+   for (unsigned ii=0; ii<vPrev_.size(); ++ii)
+   {
+      double dVdt = (Vm[ii] - vPrev_[ii])/dt;
+      if (dVdt > dVdtMax_[ii])
+      {
+         dVdtMax_[ii] = dVdt;
+         tUp_[ii] = time - 0.5*dt;
+      }
+      vPeak_[ii] = max(vPeak_[ii], Vm[ii]);
+
+      double amplitude = vPeak_[ii] - vRest_[ii];
+      double v90 = vRest_[ii] + 0.1*amplitude;
+      if (amplitude > activationThreshold && std::isnan(apd_[ii]) &&
+          vPrev_[ii] >= v90 && Vm[ii] < v90)
+      {
+         double tCross = time - dt*(Vm[ii] - v90)/(Vm[ii] - vPrev_[ii]);
+         apd_[ii] = tCross - tUp_[ii];
+      }
+      vPrev_[ii] = Vm[ii];
+   }
+}
+
+double BiomarkerTracker::get(int iCell, int iBiomarker) const
+{
+   switch (iBiomarker)
+   {
+     case APD90:    return apd_[iCell];
+     case DVDT_MAX: return dVdtMax_[iCell];
+     case VREST:    return vRest_[iCell];
+     case VPEAK:    return vPeak_[iCell];
+     default:
+      assert(false);
+   }
+   return 0;
+}
+
+
+namespace
+{
+   /** A set of variants that share one Reaction.  All variants in a
+    *  block have the same values for every keyword column so they can
+    *  be integrated together in the vector lanes of one model. */
+   struct EnsembleBlock
+   {
+      string objectName;
+      vector<int> rows;
+      Reaction* reaction;
+      lazy_array<double> Vm;
+      lazy_array<double> iStim;
+      lazy_array<double> dVm;
+      vector<double> biomarker;
+   };
+
+   /** Builds a REACTION object that is a copy of baseName with the
+    *  keyword columns of row overridden.  The object is compiled
+    *  into the object database so reactionFactory can find it. */
+   string variantObject(const string& baseName, const string& variantName,
+                        const EnsembleTable& table, int row,
+                        const vector<int>& paramColumn)
+   {
+      if (paramColumn.empty())
+         return baseName;
+      OBJECT* baseObj = objectFind(baseName, "REACTION");
+      stringstream buf;
+      buf.precision(17);
+      buf << variantName << " REACTION { " << baseObj->value;
+      for (unsigned ii=0; ii<paramColumn.size(); ++ii)
+         buf << " " << table.columnName(paramColumn[ii]) << "="
+             << table(row, paramColumn[ii]) << ";";
+      buf << " }";
+      string objString = buf.str();
+      object_compilestring(const_cast<char*>(objString.c_str()));
+      return variantName;
+   }
+
+   void integrateBlock(EnsembleBlock& block, const gengetopt_args_info& params,
+                       double dt, int maxTimesteps,
+                       const vector<int>& stimTimesteps)
+   {
+      const int timestepsInEachStimulus = round(params.stim_duration_arg/dt);
+      int timestepsLeftInStimulus = 0;
+      vector<int>::const_iterator nextStimulus = stimTimesteps.begin();
+
+      BiomarkerTracker tracker(block.rows.size(), block.Vm.readonly(CPU).raw());
+      for (int itime=0; itime<maxTimesteps; ++itime)
+      {
+         if (nextStimulus != stimTimesteps.end() && itime == *nextStimulus)
+         {
+            ++nextStimulus;
+            timestepsLeftInStimulus = timestepsInEachStimulus;
+            tracker.beginBeat(block.Vm.readonly(CPU).raw());
+         }
+         {
+            double stimAmount = 0;
+            if (timestepsLeftInStimulus > 0)
+            {
+               // same sign convention as the single cell driver.
+               stimAmount = -params.stim_strength_arg;
+               timestepsLeftInStimulus--;
+            }
+            wo_array_ptr<double> iStim = block.iStim.writeonly(DEFAULT_COMPUTE_SPACE);
+            DEVICE_PARALLEL_FORALL(iStim.size(), ii,
+                                   iStim[ii] = -stimAmount);
+         }
+         if (params.alternate_update_flag)
+         {
+            block.reaction->updateNonGate(dt, block.Vm, block.dVm);
+            block.reaction->updateGate(dt, block.Vm);
+         }
+         else
+         {
+            block.reaction->calc(dt, block.Vm, block.iStim, block.dVm);
+         }
+         {
+            rw_array_ptr<double> Vm = block.Vm.readwrite(DEFAULT_COMPUTE_SPACE);
+            ro_array_ptr<double> iStim = block.iStim.readonly(DEFAULT_COMPUTE_SPACE);
+            ro_array_ptr<double> dVm = block.dVm.readonly(DEFAULT_COMPUTE_SPACE);
+            DEVICE_PARALLEL_FORALL(Vm.size(), ii,
+                                   Vm[ii] += dt*(dVm[ii]+iStim[ii]));
+         }
+         tracker.update((itime+1)*dt, dt, block.Vm.readonly(CPU).raw());
+      }
+
+      const int nCells = block.rows.size();
+      block.biomarker.resize(nCells*BiomarkerTracker::nBiomarkers);
+      for (int ii=0; ii<nCells; ++ii)
+         for (int jj=0; jj<BiomarkerTracker::nBiomarkers; ++jj)
+            block.biomarker[ii*BiomarkerTracker::nBiomarkers + jj] = tracker.get(ii, jj);
+   }
+}
+
+
+/** Population of models driver.  Every row of the ensemble table is
+ *  one variant and is simulated in its own cell.
+ *
+ *  Columns are interpreted by name:
+ *  - Vm sets the initial membrane voltage.
+ *  - Names the reaction knows as state variables set the initial
+ *    value of that state.
+ *  - Names the reaction accepts as per-cell parameters (see
+ *    Reaction::getParameterHandle) set that parameter for the cell.
+ *  - Anything else is a REACTION keyword that overrides the value in
+ *    the base object.
+ *
+ *  Rows are block distributed over tasks.  On each task the rows are
+ *  grouped by their REACTION keyword values, since those are per
+ *  Reaction, and each group is split into blocks so that every thread
+ *  has work.  A block is one Reaction whose cells are integrated
+ *  together; blocks are independent and run concurrently.  Tables that
+ *  vary only state and per-cell parameter columns therefore use the
+ *  full vector width.
+ *
+ *  No traces are written.  At the end the biomarkers of the last beat
+ *  are gathered to task 0 and written one line per variant, in table
+ *  order, followed by the table columns. */
+int runEnsemble(const gengetopt_args_info& params,
+                const string& objectName,
+                double dt, int maxTimesteps,
+                const vector<int>& stimTimesteps)
+{
+   int nTasks, myRank;
+   MPI_Comm_size(MPI_COMM_WORLD, &nTasks);
+   MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+
+   EnsembleTable table(params.ensemble_file_arg, MPI_COMM_WORLD);
+   if (table.nRows() == 0)
+   {
+      if (myRank == 0)
+         cerr << "ERROR: Ensemble file " << params.ensemble_file_arg
+              << " has no variants." << endl;
+      return -1;
+   }
+
+   ThreadServer& threadServer = ThreadServer::getInstance();
+   ThreadTeam threads = threadServer.getThreadTeam(vector<unsigned>());
+
+   // Sort the columns into voltage, state, per-cell parameter, and
+   // keyword columns.
+   int VmColumn = -1;
+   vector<int> stateColumn;
+   vector<int> stateHandle;
+   vector<int> cellParamColumn;
+   vector<int> cellParamHandle;
+   vector<int> paramColumn;
+   {
+      Reaction* prototype = reactionFactory(objectName, dt, 1, threads);
+      for (int jj=0; jj<table.nColumns(); ++jj)
+      {
+         const string& name = table.columnName(jj);
+         int handle = prototype->getVarHandle(name);
+         if (name == "Vm")
+            VmColumn = jj;
+         else if (handle != -1)
+         {
+            stateColumn.push_back(jj);
+            stateHandle.push_back(handle);
+         }
+         else if (prototype->getParameterHandle(name) != -1)
+         {
+            cellParamColumn.push_back(jj);
+            cellParamHandle.push_back(prototype->getParameterHandle(name));
+         }
+         else
+            paramColumn.push_back(jj);
+      }
+      delete prototype;
+   }
+
+   const int rowBegin = (long long)(table.nRows())*myRank/nTasks;
+   const int rowEnd = (long long)(table.nRows())*(myRank+1)/nTasks;
+   const int nLocal = rowEnd - rowBegin;
+
+   map<vector<double>, vector<int> > groups;
+   for (int row=rowBegin; row<rowEnd; ++row)
+   {
+      vector<double> key(paramColumn.size());
+      for (unsigned jj=0; jj<paramColumn.size(); ++jj)
+         key[jj] = table(row, paramColumn[jj]);
+      groups[key].push_back(row);
+   }
+
+#ifdef USE_CUDA
+   const int nThreads = 1;
+#else
+   const int nThreads = omp_get_max_threads();
+#endif
+   const int targetBlockSize = max(1, (nLocal+nThreads-1)/nThreads);
+
+   vector<EnsembleBlock*> blocks;
+   for (map<vector<double>, vector<int> >::const_iterator iter=groups.begin();
+        iter!=groups.end(); ++iter)
+   {
+      const vector<int>& rows = iter->second;
+      stringstream variantName;
+      variantName << objectName << "_variant" << rows[0];
+      string blockObject = variantObject(objectName, variantName.str(),
+                                         table, rows[0], paramColumn);
+      for (unsigned first=0; first<rows.size(); first+=targetBlockSize)
+      {
+         unsigned last = min<unsigned>(rows.size(), first+targetBlockSize);
+         EnsembleBlock* block = new EnsembleBlock;
+         block->objectName = blockObject;
+         block->rows.assign(rows.begin()+first, rows.begin()+last);
+         blocks.push_back(block);
+      }
+   }
+
+   // Object database access and reaction construction are serial.
+   for (unsigned ib=0; ib<blocks.size(); ++ib)
+   {
+      EnsembleBlock& block = *blocks[ib];
+      const int nCells = block.rows.size();
+      block.reaction = reactionFactory(block.objectName, dt, nCells, threads);
+      block.Vm.resize(nCells);
+      block.iStim.resize(nCells);
+      block.dVm.resize(nCells);
+
+      // Parameters first, the initial state may depend on them.
+      vector<double> column(nCells);
+      for (unsigned jj=0; jj<cellParamColumn.size(); ++jj)
+      {
+         for (int ii=0; ii<nCells; ++ii)
+            column[ii] = table(block.rows[ii], cellParamColumn[jj]);
+         block.reaction->setParameterColumn(cellParamHandle[jj], 0, nCells, &column[0]);
+      }
+      initializeMembraneState(block.reaction, block.objectName, block.Vm);
+
+      for (unsigned jj=0; jj<stateColumn.size(); ++jj)
+      {
+         for (int ii=0; ii<nCells; ++ii)
+            column[ii] = table(block.rows[ii], stateColumn[jj]);
+         block.reaction->setColumn(stateHandle[jj], 0, nCells, &column[0]);
+      }
+      if (VmColumn >= 0)
+      {
+         wo_array_ptr<double> Vm = block.Vm.writeonly(CPU);
+         for (int ii=0; ii<nCells; ++ii)
+            Vm[ii] = table(block.rows[ii], VmColumn);
+      }
+   }
+
+   #pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+   for (int ib=0; ib<(int)blocks.size(); ++ib)
+      integrateBlock(*blocks[ib], params, dt, maxTimesteps, stimTimesteps);
+
+   // Put the local results in table order and gather them on task 0.
+   const int nBio = BiomarkerTracker::nBiomarkers;
+   vector<double> localBio(nLocal*nBio);
+   for (unsigned ib=0; ib<blocks.size(); ++ib)
+   {
+      EnsembleBlock& block = *blocks[ib];
+      for (unsigned ii=0; ii<block.rows.size(); ++ii)
+         for (int jj=0; jj<nBio; ++jj)
+            localBio[(block.rows[ii]-rowBegin)*nBio + jj] = block.biomarker[ii*nBio + jj];
+      delete block.reaction;
+      delete blocks[ib];
+   }
+
+   vector<int> recvCount(nTasks);
+   vector<int> displ(nTasks);
+   for (int ii=0; ii<nTasks; ++ii)
+   {
+      int begin = (long long)(table.nRows())*ii/nTasks;
+      int end = (long long)(table.nRows())*(ii+1)/nTasks;
+      recvCount[ii] = (end-begin)*nBio;
+      displ[ii] = begin*nBio;
+   }
+   vector<double> allBio;
+   if (myRank == 0)
+      allBio.resize(table.nRows()*nBio);
+   MPI_Gatherv(localBio.data(), nLocal*nBio, MPI_DOUBLE,
+               allBio.data(), &recvCount[0], &displ[0], MPI_DOUBLE,
+               0, MPI_COMM_WORLD);
+
+   if (myRank == 0)
+   {
+      FILE* file = stdout;
+      if (params.biomarker_file_given)
+      {
+         file = fopen(params.biomarker_file_arg, "w");
+         if (file == NULL)
+         {
+            perror(("Can't open "+string(params.biomarker_file_arg)+" for writing: ").c_str());
+            return -1;
+         }
+      }
+      fprintf(file, "# %7s", "variant");
+      for (int jj=0; jj<nBio; ++jj)
+         fprintf(file, " %21s", BiomarkerTracker::name(jj));
+      for (int jj=0; jj<table.nColumns(); ++jj)
+         fprintf(file, " %21s", table.columnName(jj).c_str());
+      fprintf(file, "\n");
+      for (int row=0; row<table.nRows(); ++row)
+      {
+         fprintf(file, "%9d", row);
+         for (int jj=0; jj<nBio; ++jj)
+            fprintf(file, " %21.14g", allBio[row*nBio + jj]);
+         for (int jj=0; jj<table.nColumns(); ++jj)
+            fprintf(file, " %21.14g", table(row, jj));
+         fprintf(file, "\n");
+      }
+      if (file != stdout)
+         fclose(file);
+   }
+   return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef SINGLE_CELL_ENSEMBLE_HH
+#define SINGLE_CELL_ENSEMBLE_HH
+
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+struct gengetopt_args_info;
+
+/** A population of models table.  The first non-comment line holds
+ *  the column names, every following line is one variant.  Lines that
+ *  start with # are ignored.
+ *
+ *      # g_Kr scaled by 0.5, 1.0, 1.5 with two initial Vm
+ *      g_Kr    Vm
+ *      0.0765  -86.2
+ *      0.153   -86.2
+ *      0.2295  -84.0
+ *
+ *  Task 0 reads the file and broadcasts the contents so that large
+ *  tables don't hit the file system from every task.
+ */
+class EnsembleTable
+{
+ public:
+   EnsembleTable(const std::string& filename, MPI_Comm comm);
+
+   int nRows() const {return nRows_;}
+   int nColumns() const {return names_.size();}
+   const std::string& columnName(int iColumn) const {return names_[iColumn];}
+   double operator()(int iRow, int iColumn) const
+   {
+      return values_[iRow*names_.size() + iColumn];
+   }
+
+ private:
+   int nRows_;
+   std::vector<std::string> names_;
+   std::vector<double> values_;
+};
+
+/** Computes action potential biomarkers on the fly so that ensemble
+ *  runs don't need to store traces.  All values refer to the most
+ *  recent beat, i.e., the one started by the last call to beginBeat.
+ *
+ *  - VREST:    Vm at the time the beat started.
+ *  - VPEAK:    maximum Vm during the beat.
+ *  - DVDT_MAX: maximum upstroke velocity (mV/ms).
+ *  - APD90:    time from the maximum upstroke to 90% repolarization.
+ *              NaN if the cell didn't fire or hasn't repolarized yet.
+ */
+class BiomarkerTracker
+{
+ public:
+   enum {APD90, DVDT_MAX, VREST, VPEAK, nBiomarkers};
+   static const char* name(int iBiomarker);
+
+   BiomarkerTracker(int nCells, const double* Vm);
+
+   void beginBeat(const double* Vm);
+   void update(double time, double dt, const double* Vm);
+   double get(int iCell, int iBiomarker) const;
+
+ private:
+   std::vector<double> vPrev_;
+   std::vector<double> vRest_;
+   std::vector<double> vPeak_;
+   std::vector<double> dVdtMax_;
+   std::vector<double> tUp_;
+   std::vector<double> apd_;
+};
+
+int runEnsemble(const gengetopt_args_info& params,
+                const std::string& objectName,
+                double dt, int maxTimesteps,
+                const std::vector<int>& stimTimesteps);
+
+#endif
@@ -56,6 +56,8 @@ const char *gengetopt_args_info_help[] = {
   "  -t, --stim-duration=DOUBLE    Duration of the stimulus  (default=`1')",
   "  -N, --num-points=INT          Number of points to stimulate  (default=`1')",
   "  -U, --alternate-update        Use updateGates/nonGates formulation.\n                                  (default=off)",
+  "  -E, --ensemble-file=STRING    Run one variant per cell from a parameter table",
+  "  -B, --biomarker-file=STRING   Write ensemble biomarkers to this file",
     0
 };
 
@@ -106,6 +108,8 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->stim_duration_given = 0 ;
   args_info->num_points_given = 0 ;
   args_info->alternate_update_given = 0 ;
+  args_info->ensemble_file_given = 0 ;
+  args_info->biomarker_file_given = 0 ;
 }
 
 static
@@ -147,6 +151,10 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->num_points_arg = 1;
   args_info->num_points_orig = NULL;
   args_info->alternate_update_flag = 0;
+  args_info->ensemble_file_arg = NULL;
+  args_info->ensemble_file_orig = NULL;
+  args_info->biomarker_file_arg = NULL;
+  args_info->biomarker_file_orig = NULL;
   
 }
 
@@ -183,6 +191,8 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->stim_duration_help = gengetopt_args_info_help[19] ;
   args_info->num_points_help = gengetopt_args_info_help[20] ;
   args_info->alternate_update_help = gengetopt_args_info_help[21] ;
+  args_info->ensemble_file_help = gengetopt_args_info_help[22] ;
+  args_info->biomarker_file_help = gengetopt_args_info_help[23] ;
   
 }
 
@@ -352,6 +362,10 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->stim_strength_orig));
   free_string_field (&(args_info->stim_duration_orig));
   free_string_field (&(args_info->num_points_orig));
+  free_string_field (&(args_info->ensemble_file_arg));
+  free_string_field (&(args_info->ensemble_file_orig));
+  free_string_field (&(args_info->biomarker_file_arg));
+  free_string_field (&(args_info->biomarker_file_orig));
   
   
 
@@ -431,6 +445,10 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "num-points", args_info->num_points_orig, 0);
   if (args_info->alternate_update_given)
     write_into_file(outfile, "alternate-update", 0, 0 );
+  if (args_info->ensemble_file_given)
+    write_into_file(outfile, "ensemble-file", args_info->ensemble_file_orig, 0);
+  if (args_info->biomarker_file_given)
+    write_into_file(outfile, "biomarker-file", args_info->biomarker_file_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -1021,10 +1039,12 @@ cmdline_parser_internal (
         { "stim-duration",	1, NULL, 't' },
         { "num-points",	1, NULL, 'N' },
         { "alternate-update",	0, NULL, 'U' },
+        { "ensemble-file",	1, NULL, 'E' },
+        { "biomarker-file",	1, NULL, 'B' },
         { 0,  0, 0, 0 }
       };
 
-      c = getopt_long (argc, argv, "Vo:m:r:h:d:S:T:p:c:AHC:n:b:f:s:a:t:N:U", long_options, &option_index);
+      c = getopt_long (argc, argv, "Vo:m:r:h:d:S:T:p:c:AHC:n:b:f:s:a:t:N:UE:B:", long_options, &option_index);
 
       if (c == -1) break;	/* Exit from `while (1)' loop.  */
 
@@ -1260,6 +1280,30 @@ cmdline_parser_internal (
             goto failure;
         
           break;
+        case 'E':	/* Run one variant per cell from a parameter table.  */
+        
+        
+          if (update_arg( (void *)&(args_info->ensemble_file_arg), 
+               &(args_info->ensemble_file_orig), &(args_info->ensemble_file_given),
+              &(local_args_info.ensemble_file_given), optarg, 0, 0, ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "ensemble-file", 'E',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'B':	/* Write ensemble biomarkers to this file.  */
+        
+        
+          if (update_arg( (void *)&(args_info->biomarker_file_arg), 
+               &(args_info->biomarker_file_orig), &(args_info->biomarker_file_given),
+              &(local_args_info.biomarker_file_given), optarg, 0, 0, ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "biomarker-file", 'B',
+              additional_error))
+            goto failure;
+        
+          break;
 
         case 0:	/* Long option with no short option */
           if (strcmp (long_options[option_index].name, "help") == 0) {
@@ -102,6 +102,12 @@ struct gengetopt_args_info
   const char *num_points_help; /**< @brief Number of points to stimulate help description.  */
   int alternate_update_flag;	/**< @brief Use updateGates/nonGates formulation. (default=off).  */
   const char *alternate_update_help; /**< @brief Use updateGates/nonGates formulation. help description.  */
+  char * ensemble_file_arg;	/**< @brief Run one variant per cell from a parameter table.  */
+  char * ensemble_file_orig;	/**< @brief Run one variant per cell from a parameter table original value given at command line.  */
+  const char *ensemble_file_help; /**< @brief Run one variant per cell from a parameter table help description.  */
+  char * biomarker_file_arg;	/**< @brief Write ensemble biomarkers to this file.  */
+  char * biomarker_file_orig;	/**< @brief Write ensemble biomarkers to this file original value given at command line.  */
+  const char *biomarker_file_help; /**< @brief Write ensemble biomarkers to this file help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int version_given ;	/**< @brief Whether version was given.  */
@@ -125,6 +131,8 @@ struct gengetopt_args_info
   unsigned int stim_duration_given ;	/**< @brief Whether stim-duration was given.  */
   unsigned int num_points_given ;	/**< @brief Whether num-points was given.  */
   unsigned int alternate_update_given ;	/**< @brief Whether alternate-update was given.  */
+  unsigned int ensemble_file_given ;	/**< @brief Whether ensemble-file was given.  */
+  unsigned int biomarker_file_given ;	/**< @brief Whether biomarker-file was given.  */
 
 } ;
 
@@ -0,0 +1,41 @@
+#ifndef SNAPSHOT_INDEX_API_H
+#define SNAPSHOT_INDEX_API_H
+
+#include <stdint.h>
+
+/** C interface to SnapshotIndex for the python tools (see
+ *  tools/cardiac_py/pio/index_read.py).  The functions that return a
+ *  status return 0 (or a count) on success and -1 on failure, in which
+ *  case snapshotIndex_error() says why.  The error message is shared
+ *  by all threads. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SnapshotIndexHandle SnapshotIndexHandle;
+
+SnapshotIndexHandle* snapshotIndex_open(const char* stem, int saveIndex);
+void snapshotIndex_close(SnapshotIndexHandle* handle);
+const char* snapshotIndex_error(void);
+
+int64_t snapshotIndex_nRecords(const SnapshotIndexHandle* handle);
+int snapshotIndex_nFields(const SnapshotIndexHandle* handle);
+const char* snapshotIndex_fieldName(const SnapshotIndexHandle* handle, int index);
+int snapshotIndex_fieldIndex(const SnapshotIndexHandle* handle, const char* name);
+double snapshotIndex_time(const SnapshotIndexHandle* handle);
+
+int64_t snapshotIndex_read(const SnapshotIndexHandle* handle,
+                           const uint64_t* gids, uint64_t nGids,
+                           const int* fields, int nFields, double* value);
+
+int64_t snapshotIndex_gatherTimeSeries(const char** stems, int nStems,
+                                       const uint64_t* gids, uint64_t nGids,
+                                       const char** fieldNames, int nFields,
+                                       double* time, double* value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -108,16 +108,13 @@ BucketOfBits* readStateData(const string& filename, MPI_Comm comm,
    assert(gidIndex < bucket->nFields());
    unsigned nRecords = bucket->nRecords();
    gid.resize(nRecords);
-   records.reserve(nRecords*lRec);
+   if (nRecords > 0)
+      bucket->getColumn(gidIndex, &gid[0]);
+   records.resize(size_t(nRecords)*lRec);
    for (unsigned ii=0; ii<nRecords; ++ii)
    {
       BucketOfBits::Record rr = bucket->getRecord(ii);
-      rr.getValue(gidIndex, gid[ii]);
-      const char* src = rr.getRawData().data();
-      records.push_back('\0'); 
-      unsigned char* dest = &records.back();
-      records.resize(records.size()+lRec-1);
-      copyBytes(dest, src, lRec);
+      copyBytes(&records[size_t(ii)*lRec], rr.getRawData(), lRec);
    }
 
    Pclose(file);
@@ -51,6 +51,14 @@ enum PIO_ENUMS { PIO_NONE, SPLIT, FIXRECORDASCII, FIXRECORDBINARY,
 					  VARRECORDASCII, VARRECORDBINARY, CRC32};
 extern char* PioNames[];
 
+/** How Pclose writes the files.  PIO_WRITE_PIPELINED: the writer of
+ *  each group receives the data of the group members and writes it
+ *  with stdio, overlapping the receive of the next task with the write
+ *  of the current one.  PIO_WRITE_MPIIO: all tasks of a group write
+ *  their data at its offset in the group file with
+ *  MPI_File_write_at_all.  Both produce the same files. */
+enum PIO_WRITE_METHOD { PIO_WRITE_PIPELINED, PIO_WRITE_MPIIO };
+
 typedef unsigned long long pio_long64;
 	
 typedef struct pfile_st
@@ -88,7 +96,8 @@ typedef struct pfile_st
 /** When writing data pio requires a scratch heap large enough to hold
  *  the output message plus the mpi buffer to recive that message on the
  *  writer task.  So, allocate a scratch heap at least twice the size of
- *  the maximum data written per task.
+ *  the maximum data written per task.  The pipelined writer only
+ *  overlaps receives and writes if the heap is three times that size.
  *
  *  When reading data pio does not require a scratch heap (it gets
  *  memory from malloc).
@@ -103,6 +112,7 @@ size_t Pwrite(const void *ptr, size_t size, size_t nmemb, PFILE*file);
 size_t Pread(void* ptr, size_t size, size_t nitems, PFILE* file);
 void slave_Pio_setNumWriteFiles(int* nWriteFiles);
 void Pio_setNumWriteFiles(int nWriteFiles);
+void Pio_setWriteMethod(int method);
 void PioReserve(PFILE* file, size_t size);
 // What should be the behavior of Pprintf when the line is too long for
 // the 1024 character buffer that is allocated?  Right now the line is
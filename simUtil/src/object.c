@@ -53,6 +53,15 @@ static FIELD object_parse(OBJECT *, const char *, int, const char *, int);
 #define EXTRA_ARGS
 #endif
 
+/* The parser makes a few allocations per object.  Decks with tens of
+ * thousands of objects would exhaust the block table of ddcMalloc, and
+ * every ddcFree searches that table, so the object database bypasses
+ * it.  (ddcFree and ddcRealloc accept pointers that aren't in the
+ * table.) */
+#define ObjectMalloc malloc
+#define ObjectRealloc realloc
+#define ObjectFree free
+
 #define MAXKEYWORDS 4096
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
@@ -65,6 +74,55 @@ static int nobject = 0, mobject = 0;
 static int niobject = 0, miobject = 0;
 static OBJECT **object = NULL;
 static OBJECT **object_list = NULL;
+
+/* Open addressing hash index of object[] keyed on (objclass, name).
+ * Entries are indices into object[], -1 marks an empty slot.  The
+ * table is kept at most half full. */
+static int *objectHash = NULL;
+static unsigned objectHashSize = 0;
+
+static unsigned object_hashKey(const char *name, const char *objclass)
+{
+	unsigned h = 2166136261u;   /* FNV-1a */
+	for (const char *c = objclass; *c; ++c) h = (h ^ (unsigned char)*c) * 16777619u;
+	h = (h ^ ' ') * 16777619u;
+	for (const char *c = name; *c; ++c) h = (h ^ (unsigned char)*c) * 16777619u;
+	return h;
+}
+
+/* Returns the index of the object in object[] or -1. */
+static int object_hashFind(const char *name, const char *objclass)
+{
+	if (objectHashSize == 0) return -1;
+	unsigned mask = objectHashSize-1;
+	for (unsigned slot = object_hashKey(name, objclass) & mask; objectHash[slot] >= 0; slot = (slot+1) & mask)
+	{
+		OBJECT *o = object[objectHash[slot]];
+		if (!strcmp(o->name, name) && !strcmp(o->objclass, objclass)) return objectHash[slot];
+	}
+	return -1;
+}
+
+static void object_hashInsert(int index)
+{
+	unsigned mask = objectHashSize-1;
+	unsigned slot = object_hashKey(object[index]->name, object[index]->objclass) & mask;
+	while (objectHash[slot] >= 0) slot = (slot+1) & mask;
+	objectHash[slot] = index;
+}
+
+/* (Re)builds the index for the first nobject entries of object[]
+ * whenever the table would become more than half full. */
+static void object_hashUpdate(void)
+{
+	if (2*(unsigned)nobject <= objectHashSize) return;
+	unsigned size = 1024;
+	while (size < 4*(unsigned)nobject) size *= 2;
+	objectHash = (int*) ObjectRealloc(objectHash, size*sizeof(int));
+	objectHashSize = size;
+	for (unsigned i = 0; i < size; i++) objectHash[i] = -1;
+	for (int i = 0; i < nobject; i++) object_hashInsert(i);
+}
 void object_set(const char *get, ... )
 {
 	va_list ap;
@@ -713,35 +771,37 @@ void object_compilestring(char *string)
 	rc = object_lineparse(line, &obj);
 	if (rc < 2)
 	{
-		for (i = 0; i < nobject; i++)
-		{
-			if (!strcmp(object[i]->objclass, obj.objclass) && !strcmp(object[i]->name, obj.name)) break;
-		}
-		if (i == nobject)   //object is not in database
+		i = object_hashFind(obj.name, obj.objclass);
+		if (i < 0)   //object is not in database
 		{
+			i = nobject;
 			nobject++;
 			if (mobject < nobject) 
 			{
 				mobject += 100;
-				object = (OBJECT**) Realloc(object, mobject*sizeof(OBJECT*));
+				object = (OBJECT**) ObjectRealloc(object, mobject*sizeof(OBJECT*));
 			}
-         object[i] = (OBJECT *)ddcMalloc(sizeof(OBJECT)); 
+         object[i] = (OBJECT *)ObjectMalloc(sizeof(OBJECT)); 
 			object[i]->name = strdup(obj.name);
 			object[i]->objclass = strdup(obj.objclass);
 			object[i]->value = strdup(obj.value);
 			object[i]->valueptr = NULL;;
+			if (2*(unsigned)nobject > objectHashSize)
+				object_hashUpdate();
+			else
+				object_hashInsert(i);
 		}
 		else
 		{
 			l = strlen(object[i]->value) + strlen(obj.value) + 1;
-			object[i]->value = (char*) Realloc(object[i]->value, l);
+			object[i]->value = (char*) ObjectRealloc(object[i]->value, l);
 			strcat(object[i]->value, obj.value);
 		}
 	}
-	Free(obj.name);
-	Free(obj.objclass);
-	Free(obj.value);
-	Free(line); 
+	ObjectFree(obj.name);
+	ObjectFree(obj.objclass);
+	ObjectFree(obj.value);
+	ObjectFree(line); 
 }
 void object_compilefilesubset(const char *filename, int first, int last)
 {
@@ -782,7 +842,7 @@ void object_compile(void)
 	if (mobject < nobject)
 	{
 		mobject += 100;
-		object = (OBJECT**) Realloc(object, mobject*sizeof(OBJECT*));
+		object = (OBJECT**) ObjectRealloc(object, mobject*sizeof(OBJECT*));
 	}
 	for (k = 0; k < nfiles; k++)
 	{
@@ -826,22 +886,17 @@ void object_reset(OBJECT*target)
 
 int object_exists(const char *name, const char *objclass)
 {
-	int i;
-	for (i = 0; i < nobject; i++)
-	{
-		if (!strcmp(object[i]->objclass, objclass) && !strcmp(object[i]->name, name)) return 1;
-	}
-	return 0; 
+	return object_hashFind(name, objclass) >= 0;
 }
 
 OBJECT *object_find(const char *name, const char *objclass)
 {
-	int i;
-	for (i = 0; i < nobject; i++)
+	int i = object_hashFind(name, objclass);
+	if (i < 0)
 	{
-		if (!strcmp(object[i]->objclass, objclass) && !strcmp(object[i]->name, name)) return object[i];
+		error_action("Unable to locate object <<", name,">> of class <<",objclass,">> in object files <<",filename_list ,">>", ERROR_IN("object_find", ABORT));
+		return NULL;
 	}
-	if (i == nobject) error_action("Unable to locate object <<", name,">> of class <<",objclass,">> in object files <<",filename_list ,">>", ERROR_IN("object_find", ABORT));
 	return object[i];
 }
 OBJECT *object_longFind(const char *name, const char *objclass)
@@ -857,12 +912,8 @@ OBJECT *object_longFind(const char *name, const char *objclass)
 
 OBJECT *object_find2(const char *name, const char *objclass, enum OBJECTACTION action)
 {
-	int i;
-	for (i = 0; i < nobject; i++)
-	{
-		if (!strcmp(object[i]->objclass, objclass) && !strcmp(object[i]->name, name)) break;
-	}
-	if (i == nobject)
+	int i = object_hashFind(name, objclass);
+	if (i < 0)
 	{
 		switch (action)
 		{
@@ -886,7 +937,7 @@ OBJECT *object_find2(const char *name, const char *objclass, enum OBJECTACTION a
 OBJECT *object_initialize(char *name, char *objclass, int size)
 {
 	OBJECT *object_short, *object_long;
-	object_long = (OBJECT*) Malloc(size);
+	object_long = (OBJECT*) ObjectMalloc(size);
 	object_short = object_find(name, objclass);
 	object_long->name = object_short->name;
 	object_long->objclass = object_short->objclass;
@@ -1123,8 +1174,17 @@ void object_check(char *objectLine)
 #define STRING "\"[^\"]+\"" //string
 #define OP "(=|\\+=)"
 	char *pattern = WORD WS WORD OWS "\\{ *(" KEYWORD OWS OP  OWS "([^;=}]+|" STRING ")+" OWS ";" OWS ")*}";
+	/* compiled once, recompiling for every object dominated the parse time */
+	static regex_t re;
+	static int compiled = 0;
+	if (!compiled)
+	{
+		int rc = regcomp(&re, pattern, REG_EXTENDED);
+		assert(rc == 0);
+		compiled = 1;
+	}
 	char *end;
-	char *start = findpattern(objectLine,pattern,&end);
+	char *start = findpattern1(objectLine,&re,&end);
 	if (start != objectLine || strlen(end) >0  )
 	{
 		printf("Error in object:\n\n");
@@ -1164,7 +1224,7 @@ int object_lineparse(char *line, OBJECT*object)
 		l = strlen(object->value);
 		if (l>0 && object->value[l - 1] != ';')
 		{
-			object->value = (char*) Realloc(object->value, l + 2);
+			object->value = (char*) ObjectRealloc(object->value, l + 2);
 			strcat(object->value, ";");
 		}
 	}
@@ -1216,15 +1276,21 @@ int modeindex(char *mode)
 	if (!strcasecmp(mode, "UNFORMATTED")) return BINARY;
 	return ASCII;
 }
+/* The image is the name, objclass and value strings of all objects,
+ * each including its terminating null. */
 static void object_pack(PACKBUF *buf)
 {
 	int i,l,n;
 	n=0;
+	for (i=0;i<nobject;i++)
+		n += strlen(object[i]->name) + strlen(object[i]->objclass) + strlen(object[i]->value) + 3;
+	buf->buffer=(char*) Realloc(buf->buffer,MAX(n,1));
+	n=0;
 	for (i=0;i<nobject;i++)
 	{
-		n+= l =  strlen(object[i]->name)+1 ; buf->buffer=(char*) Realloc(buf->buffer,n);memcpy(buf->buffer+n-l,object[i]->name,l); 
-		n+= l =  strlen(object[i]->objclass)+1; buf->buffer=(char*) Realloc(buf->buffer,n);memcpy(buf->buffer+n-l,object[i]->objclass,l); 
-		n+= l =  strlen(object[i]->value)+1; buf->buffer=(char*) Realloc(buf->buffer,n);memcpy(buf->buffer+n-l,object[i]->value,l);
+		l = strlen(object[i]->name)+1;     memcpy(buf->buffer+n,object[i]->name,l);     n += l;
+		l = strlen(object[i]->objclass)+1; memcpy(buf->buffer+n,object[i]->objclass,l); n += l;
+		l = strlen(object[i]->value)+1;    memcpy(buf->buffer+n,object[i]->value,l);    n += l;
 	}
 	buf->n =n; 
 	buf->nobject =nobject; 
@@ -1236,16 +1302,18 @@ static void object_unpack(PACKBUF *buf)
 	char *ptr; 
 	nobject=buf->nobject ; 
 	mobject=buf->mobject ; 
-	object = (OBJECT**) Realloc(object, mobject*sizeof(OBJECT*));
+	object = (OBJECT**) ObjectRealloc(object, mobject*sizeof(OBJECT*));
 	ptr = buf->buffer; 
 	for (i=0;i<nobject;i++)
 	{
-      object[i] = (OBJECT *)ddcMalloc(sizeof(OBJECT)); 
+      object[i] = (OBJECT *)ObjectMalloc(sizeof(OBJECT)); 
 		l = strlen(ptr)+1 ; object[i]->name = strdup(ptr);ptr += l;
 		l = strlen(ptr)+1 ; object[i]->objclass = strdup(ptr);ptr += l;
 		l = strlen(ptr)+1 ; object[i]->value = strdup(ptr);ptr += l;
 		object[i]->valueptr = NULL;;
 	}
+	objectHashSize = 0;
+	object_hashUpdate();
 }
 
 void object_print_all(FILE* file)
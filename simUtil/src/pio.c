@@ -39,6 +39,8 @@ static void   Pfile_free(PFILE*);
 static void   Popen_forRead(PFILE*);
 static int    Pclose_forRead(PFILE*);
 static int    Pclose_forWrite(PFILE*);
+static void   pipelinedWrite(PFILE* file, int* error);
+static void   mpiioWrite(PFILE* file, int* error);
 static char*  readPheader(char* filename, int* rawHeaderLength);
 static int64_t fillBuffer(char* buf, int tid, const PFILE* file);
 static int    setupIoIds(PFILE* file);
@@ -58,6 +60,7 @@ static void   internalSelfTest(const PFILE* file);
 static char string[1024];
 static int error_global; 
 static int _nWriteFiles = 0;
+static int _writeMethod = PIO_WRITE_PIPELINED;
 
 PFILE *Popen(const char *filename, const char *mode, MPI_Comm comm)
 {
@@ -278,60 +281,134 @@ int Pclose_forRead(PFILE* file)
  * 1 and so on.  If all files were concatenated the tasks would be in
  * order.  The internalSelfTest function ensures that the groups contain
  * the tasks in strict sequential order so the group iteration we
- * perform below satifies this requirement.  */
+ * perform in the writers satifies this requirement.  */
 int Pclose_forWrite(PFILE*file)
 {
-	unsigned pio_msg_blk;
 	heapEndBlock(file->pio_buf_blk, file->bufsize);
+
+	int error = 0;
+	if (_writeMethod == PIO_WRITE_MPIIO)
+		mpiioWrite(file, &error);
+	else
+		pipelinedWrite(file, &error);
+
+ 	MPI_Reduce(&error,&error_global,1,MPI_INT,MPI_BOR,0,file->comm);
+	heapFree(file->pio_buf_blk);
+	// Since write gets file->buf from the scratch heap instead of malloc
+	// we must NULL the pointer before calling Pfile_free to ensure that
+	// Pfile_free doesn't free the scratch heap.
+	file->buf=NULL;
+	Pfile_free(file);
+	return error_global; 
+}
+
+static void writeChunk(FILE* fp, const char* data, size_t n, int* error)
+{
+	if (n == 0)
+		return;
+	int cnt = fwrite(data, n, 1, fp);
+	if (cnt == 0) *error = 1;
+}
+
+/** Sends this task's buffer to its writer once the writer asks for
+ *  it. */
+static void sendToWriter(PFILE* file)
+{
+	int flag;
+	MPI_Recv(&flag, 1, MPI_INT, file->io_id, file->goTag, file->comm, MPI_STATUS_IGNORE);
+	MPI_Send(&file->bufsize, sizeof(size_t), MPI_BYTE, file->io_id, file->msgTag, file->comm);
+	assert(file->bufsize <= _maxMpiCount);
+	MPI_Send(file->buf, (int)file->bufsize, MPI_BYTE, file->io_id, file->msgTag, file->comm);
+}
+
+/** The writer of each group asks the members for their data one task
+ *  at a time.  The scratch heap block is split in two halves so that
+ *  the data of the next task is received (MPI_Irecv) while the data of
+ *  the current task is written.  A message that doesn't fit in half of
+ *  the block is received into the whole block after the pending data
+ *  is written, i.e., without overlap.  Hence a scratch heap twice the
+ *  size of the largest message is still sufficient, but three times
+ *  the size allows full overlap. */
+static void pipelinedWrite(PFILE* file, int* error)
+{
+	unsigned pio_msg_blk;
 	char* buffer = (char*) heapGet(&pio_msg_blk);
 	size_t bufMax = heapBlockSize(pio_msg_blk);
 	heapEndBlock(pio_msg_blk, bufMax);
-	
+	size_t halfMax = bufMax/2;
+	char* half[2] = {buffer, buffer+halfMax};
+	int nextHalf = 0;
+
 	int flag = 1;
-	int error = 0;
 	int dataWritten = 0;
 	if (file->groupToHandle >= 0)
 	{
 		sprintf(string, "%s#%6.6d", file->name, file->groupToHandle);
 		file->file = fopen(string, file->mode);
 
+		// Received (or own) data that still has to be written.
+		const char* pending = NULL;
+		size_t pendingSize = 0;
+		int pendingUsesBlock = 0;
 		for (int id = groupBegin(file->groupToHandle, file); id < groupEnd(file->groupToHandle, file); id++)
 		{
 			// Check another writer is asking for this task's data.  If so, send it.
 			MPI_Iprobe(file->io_id, file->goTag, file->comm, &flag, MPI_STATUS_IGNORE);
 			if (flag == 1)
 			{
-				MPI_Recv(&flag, 1, MPI_INT, file->io_id, file->goTag, file->comm, MPI_STATUS_IGNORE);
-				MPI_Send(&file->bufsize, sizeof(size_t), MPI_BYTE, file->io_id, file->msgTag, file->comm);
-				assert(file->bufsize <= _maxMpiCount);
-				MPI_Send(file->buf, (int)file->bufsize, MPI_BYTE, file->io_id, file->msgTag, file->comm);
+				sendToWriter(file);
 				dataWritten = 1;
 			}
 			
 			if (id == file->id)
 			{
-				int cnt = fwrite(file->buf, file->bufsize, 1, file->file); fflush(file->file); 
-				if (cnt == 0) error &= ferror(file->file);
+				writeChunk(file->file, pending, pendingSize, error);
+				pending = file->buf;
+				pendingSize = file->bufsize;
+				pendingUsesBlock = 0;
 				dataWritten = 1;
+				continue;
+			}
+
+			size_t bufsize;
+			MPI_Send(&flag, 1, MPI_INT, id, file->goTag, file->comm);
+			MPI_Recv(&bufsize, sizeof(size_t), MPI_BYTE, id, file->msgTag, file->comm, MPI_STATUS_IGNORE);
+			if (bufsize > bufMax)
+			{
+				printf("ERROR:  Buffer size exceeded.  Size = %zu\n"
+						 "Task %d attempting to send %zu bytes to I/O task %d\n",
+						 bufMax, id, bufsize, file->id);
+				MPI_Abort(file->comm, 11);
+			}
+			assert(bufsize < _maxMpiCount);
+			char* target;
+			if (bufsize <= halfMax && !pendingUsesBlock)
+			{
+				target = half[nextHalf];
+				nextHalf = 1-nextHalf;
 			}
 			else
 			{
-				size_t bufsize;
-				MPI_Send(&flag, 1, MPI_INT, id, file->goTag, file->comm);
-				MPI_Recv(&bufsize, sizeof(size_t), MPI_BYTE, id, file->msgTag, file->comm, MPI_STATUS_IGNORE);
-				if (bufsize > bufMax)
+				// no room next to the pending data
+				writeChunk(file->file, pending, pendingSize, error);
+				pendingSize = 0;
+				if (bufsize <= halfMax)
 				{
-					printf("ERROR:  Buffer size exceeded.  Size = %zu\n"
-							 "Task %d attempting to send %zu bytes to I/O task %d\n",
-							 bufMax, id, bufsize, file->id);
-					MPI_Abort(file->comm, 11);
+					target = half[nextHalf];
+					nextHalf = 1-nextHalf;
 				}
-				assert(bufsize < _maxMpiCount);
-				MPI_Recv(buffer, (int)bufsize, MPI_BYTE, id, file->msgTag, file->comm, MPI_STATUS_IGNORE);
-				int cnt = fwrite(buffer, bufsize, 1, file->file); fflush(file->file); 
-				if (cnt == 0) error &= ferror(file->file);
+				else
+					target = buffer;
 			}
+			MPI_Request request;
+			MPI_Irecv(target, (int)bufsize, MPI_BYTE, id, file->msgTag, file->comm, &request);
+			writeChunk(file->file, pending, pendingSize, error);
+			MPI_Wait(&request, MPI_STATUS_IGNORE);
+			pending = target;
+			pendingSize = bufsize;
+			pendingUsesBlock = (target == buffer && bufsize > halfMax);
 		}
+		writeChunk(file->file, pending, pendingSize, error);
 		fclose(file->file);
 	}
 
@@ -340,21 +417,47 @@ int Pclose_forWrite(PFILE*file)
 	//  own data and might have finished writing before they were asked
 	//  to send their data elsewhere.
 	if (dataWritten == 0)
+		sendToWriter(file);
+	heapFree(pio_msg_blk);
+}
+
+/** The tasks of each group write their buffers at their offset in the
+ *  group file with MPI_File_write_at_all.  The files are identical to
+ *  the ones written by pipelinedWrite. */
+static void mpiioWrite(PFILE* file, int* error)
+{
+	int myGroup = groupId(file->id, file);
+	MPI_Comm groupComm;
+	MPI_Comm_split(file->comm, myGroup, file->id, &groupComm);
+
+	unsigned long long mySize = file->bufsize;
+	unsigned long long offset = 0;
+	unsigned long long fileSize = 0;
+	MPI_Exscan(&mySize, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, groupComm);
+	MPI_Allreduce(&mySize, &fileSize, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, groupComm);
+	int groupRank;
+	MPI_Comm_rank(groupComm, &groupRank);
+	if (groupRank == 0)
+		offset = 0; // MPI_Exscan leaves rank 0 undefined
+
+	char filename[1024];
+	sprintf(filename, "%s#%6.6d", file->name, myGroup);
+	MPI_File fh;
+	int rc = MPI_File_open(groupComm, filename, MPI_MODE_WRONLY|MPI_MODE_CREATE, MPI_INFO_NULL, &fh);
+	if (rc != MPI_SUCCESS)
 	{
-		MPI_Recv(&flag, 1, MPI_INT, file->io_id, file->goTag, file->comm, MPI_STATUS_IGNORE);
-		MPI_Send(&file->bufsize, sizeof(size_t), MPI_BYTE, file->io_id, file->msgTag, file->comm);
-		assert(file->bufsize <= _maxMpiCount);
-		MPI_Send(file->buf, (int)file->bufsize, MPI_BYTE, file->io_id, file->msgTag, file->comm);
+		printf("ERROR:  Task %d can't open %s with MPI-IO\n", file->id, filename);
+		MPI_Abort(file->comm, 12);
 	}
- 	MPI_Reduce(&error,&error_global,1,MPI_INT,MPI_BAND,0,file->comm);
-	heapFree(pio_msg_blk);
-	heapFree(file->pio_buf_blk);
-	// Since write gets file->buf from the scratch heap instead of malloc
-	// we must NULL the pointer before calling Pfile_free to ensure that
-	// Pfile_free doesn't free the scratch heap.
-	file->buf=NULL;
-	Pfile_free(file);
-	return error_global; 
+	// truncate files left over from a previous run
+	MPI_File_set_size(fh, (MPI_Offset)fileSize);
+	assert(file->bufsize <= _maxMpiCount);
+	rc = MPI_File_write_at_all(fh, (MPI_Offset)offset, file->buf, (int)file->bufsize,
+									  MPI_BYTE, MPI_STATUS_IGNORE);
+	if (rc != MPI_SUCCESS)
+		*error = 1;
+	MPI_File_close(&fh);
+	MPI_Comm_free(&groupComm);
 }
 
 void slave_Pio_setNumWriteFiles(int* nWriteFiles)
@@ -369,6 +472,12 @@ void Pio_setNumWriteFiles(int nWriteFiles)
    _nWriteFiles = nWriteFiles;
 }
 
+void Pio_setWriteMethod(int method)
+{
+   assert(method == PIO_WRITE_PIPELINED || method == PIO_WRITE_MPIIO);
+   _writeMethod = method;
+}
+
 void PioReserve(PFILE* file, size_t capacity)
 {
    if (strcmp(file->mode, "w") != 0)
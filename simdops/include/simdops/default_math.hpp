@@ -19,7 +19,7 @@ inline float64v name(const float64v x)                  \
 }
 
 expandMathFunc(exp)
-//expandMathFunc(expm1)
+expandMathFunc(expm1)
 expandMathFunc(log)
 expandMathFunc(sqrt)
 #undef expandMathFunc
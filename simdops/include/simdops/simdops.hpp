@@ -64,8 +64,19 @@ inline float64v ternary_if(const float64v mask, const double   tt, const double
 inline float64v ternary_if(const float64v mask, const double   tt, const float64v ff) { return b_or(b_and(mask,float64v(tt)),b_and(b_not(mask),ff)); }
 
 inline bool all(const float64v mask) { return !any(b_not(mask)); }
+
+/** Stores the first n lanes of y.  For the last block of an array
+ *  whose length isn't a multiple of the width. */
+inline void store_partial(double* x, const float64v y, const int n)
+{
+   if (n >= SIMDOPS_FLOAT64V_WIDTH) { store(x, y); return; }
+   double el[SIMDOPS_FLOAT64V_WIDTH];
+   store(el, y);
+   for (int ii=0; ii<n; ii++) { x[ii] = el[ii]; }
+}
 }
 
 #define SIMDOPS_ALIGN(width)
 
+#include <simdops/vector_math.hpp>
 #include <simdops/default_math.hpp>
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+/* exp, expm1, log and pow for the vector backends that provide the
+   building blocks (fma, round_nearest, scale2n, exponent, mantissa).
+   exp and expm1 reduce the argument to |r| <= ln(2)/2 and use a
+   polynomial for (e^r-1-r)/r^2.  log splits off the exponent and uses
+   the fdlibm form with a polynomial in s^2, s=(m-1)/(m+1).  The
+   polynomials are Chebyshev fits on the reduced ranges.
+
+   Two accuracy tiers:
+     default            exp and log within about 1 ulp, expm1 within 3
+     SIMDOPS_MATH_FAST  shorter polynomials, relative error below 5e-13
+   pow(x,y) is exp(y*log(x)), so its error grows with |y*log(x)|.
+
+   simdops/mathAccuracy.cc measures the errors against the long double
+   libm.
+
+   With SIMDOPS_INTEL_VECTOR_LIBM the SVML exp, expm1 and log are used
+   instead and only pow comes from here. */
+
+#if defined(SIMDOPS_HAS_MATH_PRIMITIVES)
+
+namespace simdops {
+
+namespace vector_math {
+
+#if defined(SIMDOPS_MATH_FAST)
+//(e^r-1-r)/r^2, |r| <= ln(2)/2
+const double expCoef[] = {
+   4.99999999999547473e-01,
+   1.66666666666625551e-01,
+   4.16666667869855581e-02,
+   8.33333334426839510e-03,
+   1.38888389109960561e-03,
+   1.98412244182919433e-04,
+   2.48680029780569623e-05,
+   2.76176854651650672e-06,
+};
+//(log((1+s)/(1-s))-2s)/s^3 as a function of z=s^2, |s| <= 3-2sqrt(2)
+const double logCoef[] = {
+   6.66666666673786823e-01,
+   3.99999987924416878e-01,
+   2.85717555350329444e-01,
+   2.21913374280657827e-01,
+   1.93638849866331980e-01,
+};
+#else
+const double expCoef[] = {
+   5.00000000000000111e-01,
+   1.66666666666666685e-01,
+   4.16666666666238236e-02,
+   8.33333333333003898e-03,
+   1.38888889173670814e-03,
+   1.98412698631715573e-04,
+   2.48015210578682038e-05,
+   2.75572682769056960e-06,
+   2.76202015910315469e-07,
+   2.51004725056949961e-08,
+};
+const double logCoef[] = {
+   6.66666666666666963e-01,
+   3.99999999998988887e-01,
+   2.85714286262538364e-01,
+   2.22222110893794955e-01,
+   1.81828924325368707e-01,
+   1.53316117220550080e-01,
+   1.46178071534173254e-01,
+};
+#endif
+
+//ln(2) split so that n*ln2Hi is exact for |n| < 2^20
+const double ln2Hi = 6.93147180369123816490e-01;
+const double ln2Lo = 1.90821492927058770002e-10;
+const double log2e = 1.44269504088896338700e+00;
+
+template <int N>
+inline float64v horner(const float64v x, const double (&coef)[N])
+{
+   float64v p(coef[N-1]);
+   for (int ii=N-2; ii>=0; ii--)
+      p = fma(p, x, float64v(coef[ii]));
+   return p;
+}
+
+//x = n*ln(2) + r with |r| <= ln(2)/2.  Returns e^r-1.
+inline float64v expm1Reduced(const float64v x, float64v& n)
+{
+   n = round_nearest(x*log2e);
+   const float64v r = fma(n, float64v(-ln2Lo), fma(n, float64v(-ln2Hi), x));
+   return fma(r*r, horner(r, expCoef), r);
+}
+
+}
+
+#if !defined(SIMDOPS_MATH_IS_DEFINED)
+
+inline float64v exp(const float64v x)
+{
+   //beyond these e^x is inf or 0 anyway.  The clamp keeps n in the
+   //range of scale2n.
+   const float64v xc = ternary_if(x > 710.0, 710.0, ternary_if(x < -746.0, -746.0, x));
+   float64v n;
+   const float64v em1 = vector_math::expm1Reduced(xc, n);
+   return scale2n(em1+1.0, n);
+}
+
+inline float64v expm1(const float64v x)
+{
+   //below -40 e^x is lost in the rounding of e^x-1.
+   const float64v xc = ternary_if(x > 710.0, 710.0, ternary_if(x < -40.0, -40.0, x));
+   float64v n;
+   const float64v em1 = vector_math::expm1Reduced(xc, n);
+   //2^n(e^r-1) + (2^n-1) is exact for n=0 so small x keep their
+   //accuracy.  Working with half of it keeps 2^n finite for n=1024.
+   const float64v half = scale2n(float64v(1.0), n-1.0);
+   return 2.0*fma(half, em1, half-0.5);
+}
+
+inline float64v log(const float64v x)
+{
+   using namespace vector_math;
+   //subnormals are scaled into the normal range first
+   const float64v tiny = x < std::numeric_limits<double>::min();
+   const float64v xs = ternary_if(tiny, x*4503599627370496.0, x);
+   float64v k = exponent(xs) - ternary_if(tiny, 52.0, 0.0);
+   float64v m = mantissa(xs);
+   //x = 2^k m with sqrt(1/2) <= m < sqrt(2)
+   const float64v big = m > M_SQRT2;
+   m = ternary_if(big, m*0.5, m);
+   k = ternary_if(big, k+1.0, k);
+
+   const float64v f = m-1.0;
+   const float64v s = f/(f+2.0);
+   const float64v z = s*s;
+   const float64v R = z*horner(z, logCoef);
+   const float64v hfsq = 0.5*f*f;
+   float64v y = k*ln2Hi - ((hfsq - (s*(hfsq+R) + k*ln2Lo)) - f);
+
+   y = ternary_if(x == 0.0, -std::numeric_limits<double>::infinity(), y);
+   y = ternary_if(x < 0.0, std::numeric_limits<double>::quiet_NaN(), y);
+   y = ternary_if(x == std::numeric_limits<double>::infinity(), x, y);
+   return ternary_if(x == x, y, x);
+}
+
+#endif
+
+/* Special values as std::pow: pow(-0,y) keeps the sign for odd
+   integer y, pow(-inf,y) is +-inf or +-0, only finite x < 0 with a
+   non-integer y gives nan. */
+inline float64v pow(const float64v x, const double y)
+{
+   const double inf = std::numeric_limits<double>::infinity();
+   if (y == 0) { return float64v(1.0); }
+   if (y == 1) { return x; }
+   if (y == 2) { return x*x; }
+   // sqrt(-0) is -0 and sqrt(-inf) is nan where pow gives +0 and +inf
+   if (y == 0.5) { return ternary_if(x == -inf, inf, ternary_if(x == 0.0, 0.0, float64v(sqrt(x)))); }
+   if (y == -1) { return 1.0/x; }
+
+   const bool yInteger = (y == std::floor(y));
+   // 1/x < 0 catches -0
+   const float64v negative = (x < 0.0) || (1.0/x < 0.0);
+   const float64v ax = ternary_if(negative, -x, x);
+   float64v result = exp(y*log(ax));
+   if (!yInteger)
+      return ternary_if(x < 0.0 && x != -inf, std::numeric_limits<double>::quiet_NaN(), result);
+   if (std::fmod(std::fabs(y), 2.0) == 1.0)
+      return ternary_if(negative, -1.0*result, result); // neg() is 0-x, which gives +0
+   return result;
+}
+
+}
+
+#define SIMDOPS_MATH_IS_DEFINED
+#endif
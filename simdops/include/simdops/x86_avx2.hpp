@@ -28,9 +28,46 @@ inline native_vector_type eq(const native_vector_type a, const native_vector_typ
 inline native_vector_type neq(const native_vector_type a, const native_vector_type b) { return _mm256_cmp_pd(a,b,_CMP_NEQ_OQ); }
 inline native_vector_type b_and(const native_vector_type a, const native_vector_type b) { return _mm256_and_pd(a,b); }
 inline native_vector_type b_or(const native_vector_type a, const native_vector_type b) { return _mm256_or_pd(a,b); }
-inline native_vector_type b_not(const native_vector_type a) { return _mm256_xor_pd(a,eq(a,a)); }
+//true lanes have all bits set, which is a NaN, so eq(a,a) can't supply the ones.
+inline native_vector_type b_not(const native_vector_type a) { return _mm256_xor_pd(a,_mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
 
 inline bool any(const native_vector_type a) {return _mm256_movemask_pd(a); }
+
+inline native_vector_type sqrt(const native_vector_type a) { return _mm256_sqrt_pd(a); }
+
+//building blocks of the polynomial math in vector_math.hpp
+#if defined(__FMA__)
+inline native_vector_type fma(const native_vector_type a, const native_vector_type b, const native_vector_type c) { return _mm256_fmadd_pd(a,b,c); }
+#else
+inline native_vector_type fma(const native_vector_type a, const native_vector_type b, const native_vector_type c) { return add(mul(a,b),c); }
+#endif
+inline native_vector_type round_nearest(const native_vector_type a) { return _mm256_round_pd(a,_MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC); }
+//2^n for integral n in [-1022,1023].  Adding 2^52 puts n+1023 in the low bits.
+inline native_vector_type pow2n(const native_vector_type n)
+{
+   __m256i bits = _mm256_castpd_si256(add(n,make_float(4503599627370496.0+1023)));
+   return _mm256_castsi256_pd(_mm256_slli_epi64(bits,52));
+}
+//a*2^n for integral n in [-1076,1025], in two steps so that neither factor leaves the normal range.
+inline native_vector_type scale2n(const native_vector_type a, const native_vector_type n)
+{
+   native_vector_type half = round_nearest(mul(n,make_float(0.5)));
+   return mul(mul(a,pow2n(half)),pow2n(sub(n,half)));
+}
+//the unbiased exponent of a normal, positive a
+inline native_vector_type exponent(const native_vector_type a)
+{
+   __m256i bits = _mm256_srli_epi64(_mm256_castpd_si256(a),52);
+   bits = _mm256_or_si256(bits,_mm256_castpd_si256(make_float(4503599627370496.0)));
+   return sub(_mm256_castsi256_pd(bits),make_float(4503599627370496.0+1023));
+}
+//the significand of a normal, positive a, in [1,2)
+inline native_vector_type mantissa(const native_vector_type a)
+{
+   native_vector_type fraction = _mm256_castsi256_pd(_mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL));
+   return _mm256_or_pd(_mm256_and_pd(a,fraction),make_float(1.0));
+}
+#define SIMDOPS_HAS_MATH_PRIMITIVES
    
 /*
 inline double extract(const native_vector_type a, const int k)
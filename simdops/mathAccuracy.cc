@@ -0,0 +1,221 @@
+// Measures the error of the simdops exp, expm1, log and pow against
+// the long double libm in units in the last place (ulp) of the result.
+// Build it for the backend to check, e.g.
+//   g++ -std=c++11 -O2 -mavx2 -mfma -DSIMDOPS_ARCH_X86_AVX2 -Iinclude mathAccuracy.cc -o mathAccuracy.x
+// and add -DSIMDOPS_MATH_FAST for the fast tier.  Returns non-zero if
+// a function is less accurate than its tier promises or a special
+// value (0, inf, nan, subnormals) comes out wrong.  pow has to give the
+// same special values as std::pow.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+#include "simdops/simdops.hpp"
+
+#if defined(SIMDOPS_ARCH_NULL)
+// The null backend has no math of its own, float64v converts to double
+// and the libm is used.
+namespace simdops
+{
+   using std::exp;
+   using std::expm1;
+   using std::log;
+   using std::pow;
+}
+#endif
+
+using namespace std;
+
+namespace
+{
+   const int width = SIMDOPS_FLOAT64V_WIDTH;
+   const double inf = numeric_limits<double>::infinity();
+   const double qnan = numeric_limits<double>::quiet_NaN();
+
+#if defined(SIMDOPS_MATH_FAST)
+   const double maxUlp = 2000;
+#else
+   const double maxUlp = 3;
+#endif
+
+   // 64 bit LCG, so every build sees the same points
+   uint64_t seed = 12345;
+   double uniform(double a, double b)
+   {
+      seed = seed*6364136223846793005ULL + 1442695040888963407ULL;
+      return a + (b-a)*((seed >> 11)*(1.0/9007199254740992.0));
+   }
+
+   double ulpError(double got, long double ref)
+   {
+      if (isnan(got) || isnan((double)ref))
+         return (isnan(got) && isnan((double)ref)) ? 0 : inf;
+      if (isinf(got) || isinf((double)ref))
+         return (got == (double)ref) ? 0 : inf;
+      double r = (double) ref;
+      int e = (r == 0) ? -1074 : max(ilogb(r)-52, -1074);
+      return fabsl(got-ref)/ldexp(1.0, e);
+   }
+
+   struct Func
+   {
+      const char* name;
+      simdops::float64v (*vec)(simdops::float64v);
+      long double (*ref)(long double);
+   };
+
+   simdops::float64v vexp(simdops::float64v x) { return simdops::exp(x); }
+   simdops::float64v vexpm1(simdops::float64v x) { return simdops::expm1(x); }
+   simdops::float64v vlog(simdops::float64v x) { return simdops::log(x); }
+   long double rexp(long double x) { return expl(x); }
+   long double rexpm1(long double x) { return expm1l(x); }
+   long double rlog(long double x) { return logl(x); }
+
+   void evaluate(const Func& f, const vector<double>& x, vector<double>& y)
+   {
+      y.resize(x.size());
+      for (unsigned ii=0; ii+width<=x.size(); ii+=width)
+         simdops::store(&y[ii], f.vec(simdops::load(&x[ii])));
+   }
+
+   // max and mean ulp error over n uniform points of [a,b]
+   bool checkRange(const Func& f, double a, double b, int n)
+   {
+      vector<double> x(n), y;
+      for (int ii=0; ii<n; ++ii)
+         x[ii] = uniform(a, b);
+      evaluate(f, x, y);
+      double maxErr = 0, sumErr = 0, xMax = x[0];
+      for (int ii=0; ii<n; ++ii)
+      {
+         double err = ulpError(y[ii], f.ref(x[ii]));
+         sumErr += err;
+         if (err > maxErr) {maxErr = err; xMax = x[ii];}
+      }
+      bool ok = (maxErr <= maxUlp);
+      printf("%-6s [%11.4g, %11.4g]  max %9.3f ulp at %-12.6g mean %7.3f ulp %s\n",
+             f.name, a, b, maxErr, xMax, sumErr/n, ok ? "" : "FAIL");
+      return ok;
+   }
+
+   bool checkSpecial(const Func& f, const vector<double>& special)
+   {
+      vector<double> x(special), y;
+      while (x.size() % width != 0)
+         x.push_back(1);
+      evaluate(f, x, y);
+      bool ok = true;
+      for (unsigned ii=0; ii<special.size(); ++ii)
+      {
+         if (ulpError(y[ii], f.ref(x[ii])) > maxUlp)
+         {
+            printf("%-6s (%g) = %.17g, expected %.17Lg FAIL\n", f.name, x[ii], y[ii], f.ref(x[ii]));
+            ok = false;
+         }
+      }
+      return ok;
+   }
+
+   bool checkPow(double a, double b, double y, int n)
+   {
+      vector<double> x(n), r(n);
+      for (int ii=0; ii<n; ++ii)
+         x[ii] = uniform(a, b);
+      for (unsigned ii=0; ii+width<=x.size(); ii+=width)
+         simdops::store(&r[ii], simdops::pow(simdops::load(&x[ii]), y));
+      // exp(y*log(x)) carries the error of log(x), scaled by y*log(x),
+      // over to the result
+      double maxErr = 0, allowed = 0;
+      for (int ii=0; ii<n; ++ii)
+      {
+         double err = ulpError(r[ii], powl(x[ii], y));
+         maxErr = max(maxErr, err);
+         allowed = max(allowed, maxUlp*(1 + fabs(y*log(x[ii]))));
+      }
+      bool ok = (maxErr <= allowed);
+      printf("pow    [%11.4g, %11.4g]^%-5g max %9.3f ulp (allowed %.1f) %s\n",
+             a, b, y, maxErr, allowed, ok ? "" : "FAIL");
+      return ok;
+   }
+
+   // zeros, infinities and nan have to match std::pow exactly, including
+   // the sign of zero
+   bool checkPowSpecial(const vector<double>& special, double y)
+   {
+      vector<double> x(special), r;
+      while (x.size() % width != 0)
+         x.push_back(1);
+      r.resize(x.size());
+      for (unsigned ii=0; ii+width<=x.size(); ii+=width)
+         simdops::store(&r[ii], simdops::pow(simdops::load(&x[ii]), y));
+      bool ok = true;
+      for (unsigned ii=0; ii<special.size(); ++ii)
+      {
+         double ref = std::pow(x[ii], y);
+         bool exact = (ref == 0 || isinf(ref) || isnan(ref));
+         bool good = exact ?
+            ((isnan(ref) && isnan(r[ii])) || (r[ii] == ref && signbit(r[ii]) == signbit(ref))) :
+            ulpError(r[ii], powl(x[ii], y)) <= maxUlp*(1 + fabs(y*log(fabs(x[ii]))));
+         if (!good)
+         {
+            printf("pow    (%g)^%g = %.17g, expected %.17g FAIL\n", x[ii], y, r[ii], ref);
+            ok = false;
+         }
+      }
+      return ok;
+   }
+}
+
+int main()
+{
+   const int n = 1 << 20;
+   const Func fExp = {"exp", vexp, rexp};
+   const Func fExpm1 = {"expm1", vexpm1, rexpm1};
+   const Func fLog = {"log", vlog, rlog};
+   bool ok = true;
+
+   printf("width %d, %s tier\n", width,
+#if defined(SIMDOPS_MATH_FAST)
+          "fast"
+#else
+          "default"
+#endif
+          );
+
+   ok &= checkRange(fExp, -1, 1, n);
+   ok &= checkRange(fExp, -100, 100, n);
+   ok &= checkRange(fExp, -708, 709.7, n);
+   ok &= checkRange(fExp, -745, -708, n);
+   ok &= checkRange(fExpm1, -1e-8, 1e-8, n);
+   ok &= checkRange(fExpm1, -1, 1, n);
+   ok &= checkRange(fExpm1, -50, 50, n);
+   ok &= checkRange(fExpm1, -50, 709.7, n);
+   ok &= checkRange(fLog, 0.5, 2, n);
+   ok &= checkRange(fLog, 1e-10, 1e10, n);
+   ok &= checkRange(fLog, 0, 1e-300, n);
+   ok &= checkRange(fLog, 1e300, 1.7e308, n);
+
+   const double denorm = numeric_limits<double>::denorm_min();
+   double expSpecial[] = {0, -0.0, 1, -1, inf, -inf, qnan, 709.78, 709.79, -745.2, -746, 1e-300};
+   double logSpecial[] = {0, -0.0, 1, -1, inf, -inf, qnan, denorm, 1e-310, 2, 0.5};
+   ok &= checkSpecial(fExp, vector<double>(expSpecial, expSpecial+12));
+   ok &= checkSpecial(fExpm1, vector<double>(expSpecial, expSpecial+12));
+   ok &= checkSpecial(fLog, vector<double>(logSpecial, logSpecial+11));
+
+   ok &= checkPow(1e-3, 10, 1.6, n);
+   ok &= checkPow(1e-3, 10, -0.5, n);
+   ok &= checkPow(0.5, 2, 1.0/3.0, n);
+   ok &= checkPow(-10, 10, 3, n);
+   ok &= checkPow(1e-3, 100, 8.5, n);
+
+   double powSpecial[] = {0, -0.0, 1, -1, 2, -2, 0.25, inf, -inf, qnan, denorm};
+   double powExponent[] = {0.5, 2, -1, 3, -3, 4, -2, 1.5, -0.5, 1.0/3.0};
+   for (unsigned ii=0; ii<10; ++ii)
+      ok &= checkPowSpecial(vector<double>(powSpecial, powSpecial+11), powExponent[ii]);
+
+   printf("%s\n", ok ? "PASS" : "FAIL");
+   return ok ? 0 : 1;
+}
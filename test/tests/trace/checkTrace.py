@@ -0,0 +1,85 @@
+#!/usr/bin/env python
+
+# Usage: checkTrace.py traceDir nRanks firstLoop lastLoop [bufferSize]
+#
+# Checks the trace.<rank>.json files written by profileTraceWrite.  With
+# bufferSize the ring buffers are expected to have overflowed and only
+# the most recent events of every thread are expected.
+
+import json
+import sys
+
+def checkRank(fileName, rank, firstLoop, lastLoop, bufferSize):
+    errors = []
+    trace = json.load(open(fileName))
+    other = trace["otherData"]
+    if (other["rank"], other["firstLoop"], other["lastLoop"]) != (rank, firstLoop, lastLoop):
+        errors.append("wrong otherData %s" % str(other))
+    if bufferSize == 0 and other["droppedEvents"] != 0:
+        errors.append("dropped %d events" % other["droppedEvents"])
+    if bufferSize > 0 and other["droppedEvents"] == 0:
+        errors.append("no events dropped")
+
+    named = set()
+    events = {}
+    for ev in trace["traceEvents"]:
+        if ev["pid"] != rank:
+            errors.append("pid %d" % ev["pid"])
+        if ev["ph"] == "M":
+            if ev["name"] == "thread_name":
+                named.add(ev["tid"])
+            continue
+        events.setdefault(ev["tid"], []).append(ev)
+        if ev["ts"] < 0:
+            errors.append("negative time stamp %s" % str(ev))
+        if ev["ph"] == "X":
+            if not ev["name"] or ev["dur"] < 0:
+                errors.append("bad event %s" % str(ev))
+
+    if bufferSize == 0 and len(events) < 2:
+        errors.append("%d threads traced" % len(events))
+    for tid in events:
+        if tid not in named:
+            errors.append("thread %d has no name" % tid)
+        loops = []
+        for ev in events[tid]:
+            if ev["ph"] == "X":
+                loops.append(ev["args"]["loop"])
+            else:
+                loops.append(int(ev["name"].split()[1]))
+        if loops != sorted(loops):
+            errors.append("thread %d: loops out of order" % tid)
+        if min(loops) < firstLoop or max(loops) > lastLoop:
+            errors.append("thread %d: loops %d to %d" % (tid, min(loops), max(loops)))
+        if bufferSize > 0 and len(events[tid]) > bufferSize:
+            errors.append("thread %d: %d events" % (tid, len(events[tid])))
+
+    # thread 0 marks the start of every loop
+    markers = [ev["name"] for ev in events.get(0, []) if ev["ph"] == "i"]
+    if bufferSize == 0:
+        expected = ["loop %d" % loop for loop in range(firstLoop, lastLoop+1)]
+        if markers != expected:
+            errors.append("loop markers %s" % str(markers))
+    elif not markers or markers[-1] != "loop %d" % lastLoop:
+        errors.append("the last loop marker isn't the most recent")
+    return ["%s: %s" % (fileName, error) for error in errors]
+
+if __name__ == '__main__':
+    traceDir = sys.argv[1]
+    nRanks = int(sys.argv[2])
+    firstLoop = int(sys.argv[3])
+    lastLoop = int(sys.argv[4])
+    bufferSize = 0
+    if len(sys.argv) > 5:
+        bufferSize = int(sys.argv[5])
+
+    errors = []
+    for rank in range(nRanks):
+        fileName = "%s/trace.%d.json" % (traceDir, rank)
+        try:
+            errors += checkRank(fileName, rank, firstLoop, lastLoop, bufferSize)
+        except (IOError, ValueError, KeyError) as e:
+            errors.append("%s: %s" % (fileName, str(e)))
+    for error in errors:
+        print(error)
+    sys.exit(len(errors))
@@ -0,0 +1,132 @@
+'''
+index_read: Random access to PIO file sets by gid through the
+heart_snapshot_index library (elec/SnapshotIndex.hh).
+
+The first time a file set is opened the library builds an index of
+where every record is and stores it next to the data (state.gidx for
+state#).  After that reading a few gids only touches the pages that hold
+them, instead of scanning every file like seeker_read / iter_read.
+
+The library is found through the CARDIOID_LIB environment variable
+(the full path of libheart_snapshot_index.so) or the library search path.
+
+    r = index_read.Reader("snapshot.000000001000/state#")
+    vm = r.read([528, 562], ["Vm"])        # shape (2, 1)
+    t, trace = index_read.time_series(glob.glob("snapshot.*"), [528], ["Vm"])
+'''
+import ctypes
+import os
+
+import numpy as np
+
+_lib = None
+
+
+def _library():
+    global _lib
+    if _lib is not None:
+        return _lib
+    name = os.environ.get("CARDIOID_LIB", "libheart_snapshot_index.so")
+    lib = ctypes.CDLL(name)
+    handle = ctypes.c_void_p
+    u64p = ctypes.POINTER(ctypes.c_uint64)
+    dblp = ctypes.POINTER(ctypes.c_double)
+    lib.snapshotIndex_open.restype = handle
+    lib.snapshotIndex_open.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    lib.snapshotIndex_close.argtypes = [handle]
+    lib.snapshotIndex_error.restype = ctypes.c_char_p
+    lib.snapshotIndex_nRecords.restype = ctypes.c_int64
+    lib.snapshotIndex_nRecords.argtypes = [handle]
+    lib.snapshotIndex_nFields.argtypes = [handle]
+    lib.snapshotIndex_fieldName.restype = ctypes.c_char_p
+    lib.snapshotIndex_fieldName.argtypes = [handle, ctypes.c_int]
+    lib.snapshotIndex_fieldIndex.argtypes = [handle, ctypes.c_char_p]
+    lib.snapshotIndex_time.restype = ctypes.c_double
+    lib.snapshotIndex_time.argtypes = [handle]
+    lib.snapshotIndex_read.restype = ctypes.c_int64
+    lib.snapshotIndex_read.argtypes = [handle, u64p, ctypes.c_uint64,
+                                       ctypes.POINTER(ctypes.c_int),
+                                       ctypes.c_int, dblp]
+    lib.snapshotIndex_gatherTimeSeries.restype = ctypes.c_int64
+    lib.snapshotIndex_gatherTimeSeries.argtypes = [
+        ctypes.POINTER(ctypes.c_char_p), ctypes.c_int, u64p, ctypes.c_uint64,
+        ctypes.POINTER(ctypes.c_char_p), ctypes.c_int, dblp, dblp]
+    _lib = lib
+    return lib
+
+
+def _bytes(s):
+    if isinstance(s, bytes):
+        return s
+    return s.encode()
+
+
+def _strings(names):
+    array = (ctypes.c_char_p * len(names))()
+    array[:] = [_bytes(n) for n in names]
+    return array
+
+
+def _gid_array(gids):
+    gids = np.ascontiguousarray(gids, dtype=np.uint64)
+    return gids, gids.ctypes.data_as(ctypes.POINTER(ctypes.c_uint64))
+
+
+class Reader():
+    '''
+    Reader: One PIO file set (name ending in #, or a snapshot directory
+    meaning dir/state#) that can be read by gid.
+    '''
+
+    def __init__(self, file_stem, save_index=True):
+        lib = _library()
+        self.handle = lib.snapshotIndex_open(_bytes(file_stem),
+                                             int(save_index))
+        if not self.handle:
+            raise IOError(lib.snapshotIndex_error().decode())
+        n = lib.snapshotIndex_nFields(self.handle)
+        self.field_names = [lib.snapshotIndex_fieldName(self.handle, i).decode()
+                            for i in range(n)]
+        self.records = lib.snapshotIndex_nRecords(self.handle)
+        self.time = lib.snapshotIndex_time(self.handle)
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            _library().snapshotIndex_close(self.handle)
+            self.handle = None
+
+    def read(self, gids, fields):
+        '''
+        Returns an array of shape (len(gids), len(fields)).  Missing
+        gids and fields are nan.
+        '''
+        lib = _library()
+        gids, gid_ptr = _gid_array(gids)
+        index = (ctypes.c_int * len(fields))(
+            *[lib.snapshotIndex_fieldIndex(self.handle, _bytes(f))
+              for f in fields])
+        value = np.empty((len(gids), len(fields)))
+        lib.snapshotIndex_read(
+            self.handle, gid_ptr, len(gids), index, len(fields),
+            value.ctypes.data_as(ctypes.POINTER(ctypes.c_double)))
+        return value
+
+
+def time_series(file_stems, gids, fields):
+    '''
+    Gathers fields of gids from every file set in file_stems.  Returns
+    (time, value) with time of shape (len(file_stems),) and value of
+    shape (len(file_stems), len(gids), len(fields)).
+    '''
+    lib = _library()
+    gids, gid_ptr = _gid_array(gids)
+    time = np.empty(len(file_stems))
+    value = np.empty((len(file_stems), len(gids), len(fields)))
+    dblp = ctypes.POINTER(ctypes.c_double)
+    rc = lib.snapshotIndex_gatherTimeSeries(
+        _strings(file_stems), len(file_stems), gid_ptr, len(gids),
+        _strings(fields), len(fields),
+        time.ctypes.data_as(dblp), value.ctypes.data_as(dblp))
+    if rc < 0:
+        raise IOError(lib.snapshotIndex_error().decode())
+    return time, value
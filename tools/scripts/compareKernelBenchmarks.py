@@ -0,0 +1,52 @@
+#! /usr/bin/env python3
+
+# Compares two kernelBenchmark JSON reports (elec/kernelBenchmark.cc),
+# e.g. from the last release and the current build, and lists every
+# kernel that got slower by more than the threshold.  Exits with 1 if
+# there is such a kernel, so it can be used in a test script.
+#
+# e.g.  compareKernelBenchmarks.py old.json new.json 0.05
+
+import json
+import sys
+
+if len(sys.argv) < 3:
+    print('usage:  compareKernelBenchmarks.py [old.json] [new.json] [threshold (default 0.1)]')
+    sys.exit(2)
+
+old = json.load(open(sys.argv[1]))
+new = json.load(open(sys.argv[2]))
+threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 0.1
+
+for key in ('nTasks', 'nThreads', 'grid', 'steps'):
+    if old[key] != new[key]:
+        print('WARNING: %s differs (%s vs %s)' % (key, old[key], new[key]))
+
+
+def times(report):
+    t = {}
+    for section in ('reaction', 'diffusion'):
+        for k in report[section]:
+            t[(section, k['name'])] = k['secondsPerStep']
+    for k in report['halo']:
+        t[('halo', '%s %d bytes' % (k['name'], k['bytes']))] = k['secondsPerExchange']
+    return t
+
+
+oldTimes = times(old)
+newTimes = times(new)
+slower = 0
+print('%-10s %-28s %12s %12s %8s' % ('kernel', 'name', 'old (s)', 'new (s)', 'change'))
+for key in sorted(oldTimes):
+    if key not in newTimes:
+        print('%-10s %-28s missing in %s' % (key[0], key[1], sys.argv[2]))
+        continue
+    change = newTimes[key]/oldTimes[key] - 1
+    flag = ''
+    if change > threshold:
+        flag = 'SLOWER'
+        slower += 1
+    print('%-10s %-28s %12.4g %12.4g %+7.1f%% %s'
+          % (key[0], key[1], oldTimes[key], newTimes[key], 100*change, flag))
+
+sys.exit(1 if slower else 0)